@@ -0,0 +1,42 @@
+-- premake5.lua
+-- Headless renderer workspace: premake5 --file=Build-Caustic-Headless.lua gmake2
+newoption {
+   trigger = "vertex-layout",
+   value = "LAYOUT",
+   description = "Vertex format uploaded to the GPU (Caustic/src/Engine/vertex_layout.h)",
+   allowed = {
+      { "full", "32-byte float vertices" },
+      { "compact", "16-byte half float / unorm vertices" }
+   },
+   default = "full"
+}
+
+workspace "CausticHeadless"
+   architecture "x64"
+   configurations { "Debug", "Release", "Dist" }
+   startproject "Caustic-Headless"
+
+   if _OPTIONS["vertex-layout"] == "compact" then
+      defines { "VENG_COMPACT_VERTICES" }
+   end
+
+   -- Workspace-wide build options for MSVC
+   filter "system:windows"
+      buildoptions { "/EHsc", "/Zc:preprocessor", "/Zc:__cplusplus" }
+
+outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
+
+include "Build-Walnut-Headless-External.lua"
+
+-- The renderer still needs Vulkan; on Linux the system headers and loader are used
+VULKAN_SDK = os.getenv("VULKAN_SDK")
+if VULKAN_SDK then
+   IncludeDir["VulkanSDK"] = "%{VULKAN_SDK}/Include"
+   Library = { Vulkan = "%{VULKAN_SDK}/Lib/vulkan-1.lib" }
+else
+   IncludeDir["VulkanSDK"] = "/usr/include"
+   Library = { Vulkan = "vulkan" }
+end
+
+include "Caustic/Build-Caustic-Headless.lua"
+include "Caustic/Build-Caustic-Bench.lua"
@@ -1,9 +1,24 @@
 -- premake5.lua
+newoption {
+   trigger = "vertex-layout",
+   value = "LAYOUT",
+   description = "Vertex format uploaded to the GPU (Caustic/src/Engine/vertex_layout.h)",
+   allowed = {
+      { "full", "32-byte float vertices" },
+      { "compact", "16-byte half float / unorm vertices" }
+   },
+   default = "full"
+}
+
 workspace "WalnutApp"
    architecture "x64"
    configurations { "Debug", "Release", "Dist" }
    startproject "Caustic"
 
+   if _OPTIONS["vertex-layout"] == "compact" then
+      defines { "VENG_COMPACT_VERTICES" }
+   end
+
    -- Workspace-wide build options for MSVC
    filter "system:windows"
       buildoptions { "/EHsc", "/Zc:preprocessor", "/Zc:__cplusplus" }
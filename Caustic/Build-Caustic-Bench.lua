@@ -0,0 +1,67 @@
+project "Caustic-Bench"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++20"
+   targetdir "bin/%{cfg.buildcfg}"
+   staticruntime "off"
+
+   -- Fixed scenes on the headless renderer, timings written as JSON
+   files {
+      "src/Engine/**.h",
+      "src/Engine/**.cpp",
+      "bench/**.h",
+      "bench/**.cpp",
+      "shaders/**"
+   }
+
+   includedirs
+   {
+      "../Walnut/Source",
+      "../Walnut/Platform/Headless",
+
+      "%{IncludeDir.VulkanSDK}",
+      "%{IncludeDir.glm}",
+      "%{IncludeDir.spdlog}",
+      "../vendor/tinyobjloader",
+
+      -- Local engine includes
+      "src/",
+      "src/Engine/"
+   }
+
+   links
+   {
+      "Walnut-Headless"
+   }
+
+   defines { "WL_HEADLESS" }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+      systemversion "latest"
+      defines { "WL_PLATFORM_WINDOWS" }
+      buildoptions { "/utf-8" }
+      links { "%{Library.Vulkan}" }
+
+   filter "system:linux"
+      defines { "WL_PLATFORM_LINUX" }
+      links { "vulkan", "pthread" }
+
+   filter "configurations:Debug"
+      defines { "WL_DEBUG" }
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "WL_RELEASE" }
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      defines { "WL_DIST" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
@@ -0,0 +1,66 @@
+project "Caustic-Headless"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++20"
+   targetdir "bin/%{cfg.buildcfg}"
+   staticruntime "off"
+
+   -- The renderer without the ImGui layer: no window, no surface, no GLFW
+   files {
+      "src/Engine/**.h",
+      "src/Engine/**.cpp",
+      "headless/**.h",
+      "headless/**.cpp",
+      "shaders/**"
+   }
+
+   includedirs
+   {
+      "../Walnut/Source",
+      "../Walnut/Platform/Headless",
+
+      "%{IncludeDir.VulkanSDK}",
+      "%{IncludeDir.glm}",
+      "%{IncludeDir.spdlog}",
+
+      -- Local engine includes
+      "src/",
+      "src/Engine/"
+   }
+
+   links
+   {
+      "Walnut-Headless"
+   }
+
+   defines { "WL_HEADLESS" }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+      systemversion "latest"
+      defines { "WL_PLATFORM_WINDOWS" }
+      buildoptions { "/utf-8" }
+      links { "%{Library.Vulkan}" }
+
+   filter "system:linux"
+      defines { "WL_PLATFORM_LINUX" }
+      links { "vulkan", "pthread" }
+
+   filter "configurations:Debug"
+      defines { "WL_DEBUG" }
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "WL_RELEASE" }
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      defines { "WL_DIST" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
@@ -0,0 +1,497 @@
+#include "BenchLayer.h"
+
+#include "Walnut/Application.h"
+#include "Walnut/Profiler.h"
+#include "Engine/vertex_layout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+BenchSummary Summarize(std::vector<double> values)
+{
+ BenchSummary summary;
+ if (values.empty()) {
+ return summary;
+ }
+ std::sort(values.begin(), values.end());
+ // Nearest-rank percentiles: every reported value is one that was measured
+ auto percentile = [&](double p) {
+ const size_t rank = static_cast<size_t>(std::ceil(p * values.size()));
+ return values[std::clamp<size_t>(rank,1, values.size()) -1];
+ };
+ double sum =0.0;
+ for (double v : values) {
+ sum += v;
+ }
+ summary.avg = sum / values.size();
+ summary.min = values.front();
+ summary.p50 = percentile(0.50);
+ summary.p95 = percentile(0.95);
+ summary.p99 = percentile(0.99);
+ summary.max = values.back();
+ return summary;
+}
+
+const char* DeviceTypeName(VkPhysicalDeviceType type)
+{
+ switch (type) {
+ case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+ case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+ case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+ case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+ default: return "other";
+ }
+}
+
+void WriteString(std::ostream& stream, const std::string& value)
+{
+ stream << '"';
+ for (char c : value) {
+ switch (c) {
+ case '"': stream << "\\\""; break;
+ case '\\': stream << "\\\\"; break;
+ case '\n': stream << "\\n"; break;
+ case '\t': stream << "\\t"; break;
+ default:
+ if (static_cast<unsigned char>(c) <0x20) {
+ stream << ' ';
+ } else {
+ stream << c;
+ }
+ }
+ }
+ stream << '"';
+}
+
+void WriteSummary(std::ostream& stream, const char* name, const BenchSummary& s)
+{
+ stream << std::format("      \"{}\": {{\"avg\": {:.4f}, \"min\": {:.4f}, \"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f}}}",
+ name, s.avg, s.min, s.p50, s.p95, s.p99, s.max);
+}
+
+const veng::GpuScopeStats* FindScope(const std::vector<veng::GpuScopeStats>& scopes, const char* name)
+{
+ for (const veng::GpuScopeStats& scope : scopes) {
+ if (scope.name == name) {
+ return &scope;
+ }
+ }
+ return nullptr;
+}
+
+} // namespace
+
+BenchLayer::BenchLayer(const BenchConfig& config)
+ : m_Config(config)
+{
+}
+
+BenchLayer::~BenchLayer()
+{
+ OnDetach();
+}
+
+void BenchLayer::OnAttach()
+{
+ try {
+ if (m_Config.runImport) {
+ m_ImportResult = RunImportBenchmark(m_Config.import);
+ }
+ if (m_Config.runCulling) {
+ m_CullResult = RunCullBenchmark(m_Config.culling);
+ }
+ if (m_Config.runSceneGraph) {
+ m_SceneGraphResult = RunSceneGraphBenchmark(m_Config.sceneGraph);
+ }
+ if (m_Config.runMeshlets) {
+ m_MeshletResult = RunMeshletBenchmark(m_Config.meshlets);
+ }
+ if (m_Config.runBvh) {
+ m_BvhResult = RunBvhBenchmark(m_Config.bvh);
+ }
+ if (!m_Config.runScenes) {
+ Finish();
+ return;
+ }
+
+ m_Device = std::make_unique<veng::HeadlessDevice>(m_Config.device);
+ std::cout << "Bench device: " << m_Device->GetProperties().deviceName << std::endl;
+
+ for (const BenchSceneInfo& scene : GetBenchScenes(m_Config.sceneOptions)) {
+ if (!m_Config.scenes.empty() && std::find(m_Config.scenes.begin(), m_Config.scenes.end(), scene.name) == m_Config.scenes.end()) {
+ continue;
+ }
+ for (const BenchResolution& resolution : m_Config.resolutions) {
+ m_Runs.push_back({ scene, resolution });
+ }
+ }
+ if (m_Runs.empty()) {
+ throw std::runtime_error("No scene matches the requested names");
+ }
+
+ BeginRun();
+ } catch (const std::exception& e) {
+ Abort(e.what());
+ }
+}
+
+void BenchLayer::OnDetach()
+{
+ if (m_Graphics && m_Scene) {
+ m_Scene->Unload(*m_Graphics);
+ }
+ m_Scene.reset();
+ m_Graphics.reset();
+ m_Device.reset();
+}
+
+void BenchLayer::OnUpdate(float ts)
+{
+ if (m_Finished) {
+ return;
+ }
+
+ try {
+ RenderFrame();
+ if (m_Frame < m_Config.warmupFrames + m_Config.frames) {
+ return;
+ }
+ EndRun();
+ if (++m_CurrentRun < m_Runs.size()) {
+ BeginRun();
+ } else {
+ Finish();
+ }
+ } catch (const std::exception& e) {
+ Abort(e.what());
+ }
+}
+
+void BenchLayer::BeginRun()
+{
+ const Run& run = m_Runs[m_CurrentRun];
+ std::cout << "[" << (m_CurrentRun +1) << "/" << m_Runs.size() << "] " << run.scene.name
+ << " " << run.resolution.width << "x" << run.resolution.height << std::flush;
+
+ // A fresh renderer per run: allocator pools, staging ring and GPU timings
+ // start empty, so runs do not depend on their order
+ m_Graphics = std::make_unique<veng::WalnutGraphics>();
+ if (!m_Graphics->Initialize(m_Device->Get())) {
+ throw std::runtime_error("Failed to initialize Vulkan graphics engine");
+ }
+ m_Graphics->Resize(run.resolution.width, run.resolution.height);
+
+ m_Scene = run.scene.create();
+ const auto loadStart = std::chrono::steady_clock::now();
+ m_Scene->Load(*m_Graphics, run.resolution.width, run.resolution.height);
+ m_Graphics->WaitForUploads(m_Graphics->GetPendingUploadTicket());
+
+ m_Result = {};
+ m_Result.scene = run.scene.name;
+ m_Result.parameters = m_Scene->GetParameters();
+ m_Result.resolution = run.resolution;
+ m_Result.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+ m_Result.loadBytes = m_Graphics->GetUploadStats().bytesUploaded;
+
+ m_Samples = {};
+ m_Frame =0;
+}
+
+void BenchLayer::RenderFrame()
+{
+ WL_PROFILE_FUNC();
+
+ if (m_Frame == m_Config.warmupFrames) {
+ m_UploadBaseline = m_Graphics->GetUploadStats();
+ m_MeasureStart = std::chrono::steady_clock::now();
+ }
+
+ const auto frameStart = std::chrono::steady_clock::now();
+ if (!m_Graphics->BeginFrame()) {
+ return;
+ }
+ m_Scene->Render(*m_Graphics, m_Frame);
+ m_Graphics->EndFrame();
+ const double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+
+ if (m_Frame++ < m_Config.warmupFrames) {
+ return;
+ }
+
+ const veng::FrameStats& frameStats = m_Graphics->GetFrameStats();
+ const veng::AllocatorStats memory = m_Graphics->GetMemoryStats();
+ m_Samples.cpuFrameMs.push_back(frameMs);
+ m_Samples.cpuRecordMs.push_back(frameStats.cpuRecordMs);
+ m_Samples.fenceWaitMs.push_back(frameStats.fenceWaitMs);
+ m_Samples.allocations.push_back(memory.allocationsLastFrame);
+ m_Samples.deviceAllocations.push_back(memory.deviceAllocationsLastFrame);
+ m_Samples.queueBinds.push_back(frameStats.queueBinds);
+ m_Samples.queueBindsSaved.push_back(frameStats.queueBindsSaved);
+ m_Samples.queueRecordMs.push_back(frameStats.queueRecordMs);
+ m_Samples.cullMs.push_back(frameStats.cullMs);
+ m_Samples.cullVisible.push_back(frameStats.cullVisible);
+ m_Samples.triangles.push_back(static_cast<double>(frameStats.triangles));
+ m_Samples.gpuCullVisible.push_back(frameStats.gpuCullVisible);
+
+ // Timestamps resolve when a frame slot comes around again, so once the
+ // pipeline is full every BeginFrame adds exactly one "Frame" sample, that of
+ // the frame MAX_FRAMES_IN_FLIGHT submissions ago
+ const std::vector<veng::GpuScopeStats> timings = m_Graphics->GetGpuTimings();
+ if (const veng::GpuScopeStats* frame = FindScope(timings, "Frame")) {
+ m_Samples.gpuFrameMs.push_back(frame->lastMs);
+ }
+}
+
+void BenchLayer::EndRun()
+{
+ // Let the last frames (and their timestamps) finish before reading totals
+ m_Graphics->FlushReadbacks();
+ const double measuredSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_MeasureStart).count();
+
+ const veng::UploadStats& uploads = m_Graphics->GetUploadStats();
+ m_Result.uploadBytes = uploads.bytesUploaded - m_UploadBaseline.bytesUploaded;
+ m_Result.uploadSubmissions = uploads.submissions - m_UploadBaseline.submissions;
+ m_Result.stagingStalls = uploads.stagingStalls - m_UploadBaseline.stagingStalls;
+ m_Result.uploadMiBPerSecond = measuredSeconds >0.0 ? m_Result.uploadBytes / (1024.0 *1024.0) / measuredSeconds :0.0;
+
+ const std::vector<veng::GpuScopeStats> timings = m_Graphics->GetGpuTimings();
+ if (const veng::GpuScopeStats* upload = FindScope(timings, "Uploads")) {
+ m_Result.gpuUploadMs = upload->avgMs;
+ }
+
+ m_Result.cpuFrameMs = Summarize(std::move(m_Samples.cpuFrameMs));
+ m_Result.cpuRecordMs = Summarize(std::move(m_Samples.cpuRecordMs));
+ m_Result.fenceWaitMs = Summarize(std::move(m_Samples.fenceWaitMs));
+ m_Result.gpuSamples = static_cast<uint32_t>(m_Samples.gpuFrameMs.size());
+ m_Result.gpuFrameMs = Summarize(std::move(m_Samples.gpuFrameMs));
+ m_Result.allocationsPerFrame = Summarize(std::move(m_Samples.allocations));
+ m_Result.deviceAllocationsPerFrame = Summarize(std::move(m_Samples.deviceAllocations));
+ m_Result.queueBindsPerFrame = Summarize(std::move(m_Samples.queueBinds));
+ m_Result.queueBindsSavedPerFrame = Summarize(std::move(m_Samples.queueBindsSaved));
+ m_Result.queueRecordMs = Summarize(std::move(m_Samples.queueRecordMs));
+ m_Result.cullMs = Summarize(std::move(m_Samples.cullMs));
+ m_Result.cullVisiblePerFrame = Summarize(std::move(m_Samples.cullVisible));
+ m_Result.trianglesPerFrame = Summarize(std::move(m_Samples.triangles));
+ m_Result.gpuCullVisiblePerFrame = Summarize(std::move(m_Samples.gpuCullVisible));
+
+ std::cout << ": cpu " << m_Result.cpuFrameMs.avg << " ms (p99 " << m_Result.cpuFrameMs.p99 << ")";
+ if (m_Result.gpuSamples >0) {
+ std::cout << ", gpu " << m_Result.gpuFrameMs.avg << " ms";
+ }
+ std::cout << std::endl;
+
+ m_Results.push_back(std::move(m_Result));
+
+ m_Scene->Unload(*m_Graphics);
+ m_Scene.reset();
+ m_Graphics.reset();
+}
+
+void BenchLayer::Finish()
+{
+ m_Finished = true;
+ PrintScaling("meshes", &BenchRunResult::cpuRecordMs, "CPU record time by mesh count (avg ms)");
+ PrintScaling("recordingThreads", &BenchRunResult::queueRecordMs, "Render queue record time by recording threads (avg ms)");
+ if (WriteResults()) {
+ std::cout << "Wrote " << m_Config.output.string() << std::endl;
+ } else {
+ std::cerr << "Failed to write " << m_Config.output.string() << std::endl;
+ }
+ Walnut::Application::Get().Close();
+}
+
+void BenchLayer::PrintScaling(const char* parameter, BenchSummary BenchRunResult::* metric, const char* title) const
+{
+ std::vector<std::pair<const BenchRunResult*, double>> rows;
+ double longest =0.0;
+ for (const BenchRunResult& result : m_Results) {
+ for (const auto& [name, value] : result.parameters) {
+ if (name == parameter) {
+ rows.push_back({ &result, value });
+ longest = std::max(longest, (result.*metric).avg);
+ }
+ }
+ }
+ if (rows.empty() || longest <=0.0) {
+ return;
+ }
+
+ std::stable_sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.first->scene < b.first->scene; });
+ std::cout << title << std::endl;
+ for (const auto& [result, value] : rows) {
+ const std::string resolution = std::format("{}x{}", result->resolution.width, result->resolution.height);
+ const double ms = (result->*metric).avg;
+ const int bar = static_cast<int>(std::lround(ms / longest *40.0));
+ std::cout << std::format("  {:<16} {:>9} {:>7} {:>9.3f} {}", result->scene, resolution, value, ms, std::string(bar, '#')) << std::endl;
+ }
+}
+
+void BenchLayer::Abort(const char* what)
+{
+ std::cerr << "\nBenchmark failed: " << what << std::endl;
+ m_Finished = true;
+ Walnut::Application::Get().Close();
+}
+
+bool BenchLayer::WriteResults() const
+{
+ if (m_Config.output.has_parent_path()) {
+ std::error_code error;
+ std::filesystem::create_directories(m_Config.output.parent_path(), error);
+ }
+
+ std::ofstream stream(m_Config.output);
+ if (!stream) {
+ return false;
+ }
+
+ // Bump schemaVersion whenever a field changes meaning, so comparison
+ // scripts can refuse to diff incompatible files
+ stream << "{\n  \"schemaVersion\": 1,\n  \"label\": ";
+ WriteString(stream, m_Config.label);
+ stream << ",\n  \"frames\": " << m_Config.frames << ",\n  \"warmupFrames\": " << m_Config.warmupFrames;
+ // Compile time choice: compare files from both builds to see its cost
+ stream << std::format(",\n  \"vertexLayout\": {{\"name\": \"{}\", \"stride\": {}}}", veng::kGpuVertexLayoutName, veng::GpuVertexLayout::kStride);
+ if (m_Device) {
+ const VkPhysicalDeviceProperties& props = m_Device->GetProperties();
+ stream << ",\n  \"device\": {\"name\": ";
+ WriteString(stream, props.deviceName);
+ stream << std::format(", \"type\": \"{}\", \"vendorID\": {}, \"deviceID\": {}, \"driverVersion\": {}, \"apiVersion\": \"{}.{}.{}\"}}",
+ DeviceTypeName(props.deviceType), props.vendorID, props.deviceID, props.driverVersion,
+ VK_VERSION_MAJOR(props.apiVersion), VK_VERSION_MINOR(props.apiVersion), VK_VERSION_PATCH(props.apiVersion));
+ }
+
+ if (m_ImportResult) {
+ const ImportBenchResult& r = *m_ImportResult;
+ stream << ",\n  \"import\": {\"file\": ";
+ WriteString(stream, r.file);
+ stream << std::format(", \"fileBytes\": {}, \"triangles\": {}, \"vertices\": {}, \"threads\": {},\n", r.fileBytes, r.triangles, r.vertices, r.threads);
+ stream << std::format("    \"tinyobjParseMs\": {:.4f}, \"tinyobjMs\": {:.4f}, \"importSingleThreadMs\": {:.4f}, \"importMs\": {:.4f},\n",
+ r.tinyobjParseMs, r.tinyobjMs, r.importSingleThreadMs, r.importMs);
+ stream << std::format("    \"importReadMs\": {:.4f}, \"importParseMs\": {:.4f}, \"importMergeMs\": {:.4f}, \"chunks\": {},\n",
+ r.stats.readMs, r.stats.parseMs, r.stats.mergeMs, r.stats.chunks);
+ stream << std::format("    \"cacheColdMs\": {:.4f}, \"cacheWarmMs\": {:.4f}, \"cacheBytes\": {},\n", r.cacheColdMs, r.cacheWarmMs, r.cacheBytes);
+ stream << "    \"optimize\": [";
+ for (size_t i =0; i < r.optimize.size(); ++i) {
+ const MeshOptimizeResult& o = r.optimize[i];
+ stream << (i ==0 ? "\n      {\"file\": " : ",\n      {\"file\": ");
+ WriteString(stream, o.file);
+ stream << std::format(", \"expandedVertices\": {}, \"indexedVertices\": {}, \"optimizedVertices\": {}, \"optimizeMs\": {:.4f},\n",
+ o.expandedVertices, o.indexedVertices, o.stats.verticesAfter, o.stats.milliseconds);
+ stream << std::format("       \"acmrBefore\": {:.4f}, \"acmrAfter\": {:.4f}, \"atvrBefore\": {:.4f}, \"atvrAfter\": {:.4f}}}",
+ o.stats.before.acmr, o.stats.after.acmr, o.stats.before.atvr, o.stats.after.atvr);
+ }
+ stream << "]}";
+ }
+
+ if (m_CullResult) {
+ const CullBenchResult& r = *m_CullResult;
+ stream << std::format(",\n  \"culling\": {{\"objects\": {}, \"visible\": {}, \"kernels\": [", r.objects, r.visible);
+ for (size_t i =0; i < r.kernels.size(); ++i) {
+ const CullKernelResult& k = r.kernels[i];
+ stream << std::format("{}\n    {{\"kernel\": \"{}\", \"ms\": {:.4f}, \"objectsPerMicrosecond\": {:.4f}}}",
+ i ==0 ? "" : ",", veng::GetCullKernelName(k.kernel), k.ms, k.objectsPerMicrosecond);
+ }
+ stream << "]}";
+ }
+
+ if (m_SceneGraphResult) {
+ const SceneGraphBenchResult& r = *m_SceneGraphResult;
+ stream << std::format(",\n  \"sceneGraph\": {{\"nodes\": {}, \"levels\": {}, \"threads\": {}, \"buildMs\": {:.4f},\n", r.nodes, r.levels, r.threads, r.buildMs);
+ stream << std::format("    \"fullSingleThreadMs\": {:.4f}, \"fullMs\": {:.4f}, \"partialMs\": {:.4f}, \"partialUpdated\": {}, \"cleanMs\": {:.4f}}}",
+ r.fullSingleThreadMs, r.fullMs, r.partialMs, r.partialUpdated, r.cleanMs);
+ }
+
+ if (m_MeshletResult) {
+ const MeshletBenchResult& r = *m_MeshletResult;
+ stream << ",\n  \"meshlets\": {\"file\": ";
+ WriteString(stream, r.file);
+ stream << std::format(", \"triangles\": {}, \"meshlets\": {}, \"avgVertices\": {:.4f}, \"avgTriangles\": {:.4f}, \"cones\": {}, \"buildMs\": {:.4f},\n",
+ r.triangles, r.meshlets, r.avgVertices, r.avgTriangles, r.cones, r.buildMs);
+ stream << "    \"views\": [";
+ for (size_t i =0; i < r.views.size(); ++i) {
+ const MeshletViewResult& v = r.views[i];
+ stream << std::format("{}\n      {{\"view\": \"{}\", \"visibleMeshlets\": {}, \"frustumCulled\": {}, \"backfacing\": {}, \"trianglesDrawn\": {}, \"culledTriangleRatio\": {:.4f}}}",
+ i ==0 ? "" : ",", v.view, v.visibleMeshlets, v.frustumCulled, v.backfacing, v.trianglesDrawn, v.culledTriangleRatio);
+ }
+ stream << "],\n    \"kernels\": [";
+ for (size_t i =0; i < r.kernels.size(); ++i) {
+ const MeshletKernelResult& k = r.kernels[i];
+ stream << std::format("{}\n      {{\"kernel\": \"{}\", \"microseconds\": {:.4f}}}", i ==0 ? "" : ",", veng::GetCullKernelName(k.kernel), k.microseconds);
+ }
+ stream << "]}";
+ }
+
+ if (m_BvhResult) {
+ stream << ",\n  \"bvh\": [";
+ for (size_t m =0; m < m_BvhResult->meshes.size(); ++m) {
+ const BvhMeshResult& r = m_BvhResult->meshes[m];
+ stream << (m ==0 ? "\n    {\"mesh\": " : ",\n    {\"mesh\": ");
+ WriteString(stream, r.mesh);
+ stream << std::format(", \"triangles\": {}, \"nodes\": {}, \"leaves\": {}, \"maxDepth\": {}, \"sahCost\": {:.4f},\n",
+ r.triangles, r.nodes, r.leaves, r.maxDepth, r.sahCost);
+ stream << std::format("     \"buildSingleThreadMs\": {:.4f}, \"buildMs\": {:.4f}, \"threads\": {}, \"rays\": {}, \"cameraHits\": {}, \"randomHits\": {},\n",
+ r.buildSingleThreadMs, r.buildMs, r.threads, r.rays, r.cameraHits, r.randomHits);
+ stream << "     \"kernels\": [";
+ for (size_t i =0; i < r.kernels.size(); ++i) {
+ const BvhKernelResult& k = r.kernels[i];
+ stream << std::format("{}\n       {{\"kernel\": \"{}\", \"cameraMs\": {:.4f}, \"cameraMraysPerSecond\": {:.4f}, \"randomMs\": {:.4f}, \"randomMraysPerSecond\": {:.4f}}}",
+ i ==0 ? "" : ",", veng::GetCullKernelName(k.kernel), k.cameraMs, k.cameraMraysPerSecond, k.randomMs, k.randomMraysPerSecond);
+ }
+ stream << "]}";
+ }
+ stream << "]";
+ }
+
+ stream << ",\n  \"results\": [";
+ for (size_t i =0; i < m_Results.size(); ++i) {
+ const BenchRunResult& r = m_Results[i];
+ stream << (i ==0 ? "\n" : ",\n") << "    {\n      \"scene\": ";
+ WriteString(stream, r.scene);
+ stream << ",\n      \"width\": " << r.resolution.width << ",\n      \"height\": " << r.resolution.height;
+ stream << ",\n      \"parameters\": {";
+ for (size_t p =0; p < r.parameters.size(); ++p) {
+ stream << (p ==0 ? "" : ", ");
+ WriteString(stream, r.parameters[p].first);
+ stream << ": " << r.parameters[p].second;
+ }
+ stream << "},\n";
+ stream << std::format("      \"loadMs\": {:.4f},\n      \"loadBytes\": {},\n", r.loadMs, r.loadBytes);
+ WriteSummary(stream, "cpuFrameMs", r.cpuFrameMs);
+ stream << ",\n";
+ WriteSummary(stream, "cpuRecordMs", r.cpuRecordMs);
+ stream << ",\n";
+ WriteSummary(stream, "fenceWaitMs", r.fenceWaitMs);
+ stream << ",\n";
+ WriteSummary(stream, "gpuFrameMs", r.gpuFrameMs);
+ stream << ",\n      \"gpuSamples\": " << r.gpuSamples << ",\n";
+ stream << std::format("      \"upload\": {{\"bytes\": {}, \"submissions\": {}, \"stagingStalls\": {}, \"mibPerSecond\": {:.4f}, \"gpuMsAvg\": {:.4f}}},\n",
+ r.uploadBytes, r.uploadSubmissions, r.stagingStalls, r.uploadMiBPerSecond, r.gpuUploadMs);
+ WriteSummary(stream, "allocationsPerFrame", r.allocationsPerFrame);
+ stream << ",\n";
+ WriteSummary(stream, "deviceAllocationsPerFrame", r.deviceAllocationsPerFrame);
+ stream << ",\n";
+ WriteSummary(stream, "queueBindsPerFrame", r.queueBindsPerFrame);
+ stream << ",\n";
+ WriteSummary(stream, "queueBindsSavedPerFrame", r.queueBindsSavedPerFrame);
+ stream << ",\n";
+ WriteSummary(stream, "queueRecordMs", r.queueRecordMs);
+ stream << ",\n";
+ WriteSummary(stream, "cullMs", r.cullMs);
+ stream << ",\n";
+ WriteSummary(stream, "cullVisiblePerFrame", r.cullVisiblePerFrame);
+ stream << ",\n";
+ WriteSummary(stream, "trianglesPerFrame", r.trianglesPerFrame);
+ stream << ",\n";
+ WriteSummary(stream, "gpuCullVisiblePerFrame", r.gpuCullVisiblePerFrame);
+ stream << "\n    }";
+ }
+ stream << "\n  ]\n}\n";
+ return static_cast<bool>(stream);
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "Walnut/Layer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Engine/WalnutGraphics.h"
+#include "Engine/graphics_device.h"
+#include "BenchScenes.h"
+#include "BvhBench.h"
+#include "CullBench.h"
+#include "ImportBench.h"
+#include "MeshletBench.h"
+#include "SceneGraphBench.h"
+
+struct BenchResolution
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+struct BenchConfig
+{
+    uint32_t frames = 300;             // measured frames per run
+    uint32_t warmupFrames = 30;        // rendered first and discarded (pipeline caches, allocator pools)
+    std::vector<BenchResolution> resolutions = { { 1280, 720 }, { 1920, 1080 } };
+    std::vector<std::string> scenes;   // empty runs every scene
+    BenchSceneOptions sceneOptions;
+    std::filesystem::path output = "bench_results.json";
+    std::string label;                 // free-form, e.g. the commit hash; stored in the results
+    veng::HeadlessDeviceOptions device;
+
+    bool runScenes = true;
+    bool runImport = false;            // OBJ import timings, before the scenes
+    ImportBenchConfig import;
+    bool runCulling = false;           // frustum culling throughput per kernel, before the scenes
+    CullBenchConfig culling;
+    bool runSceneGraph = false;        // transform hierarchy updates, before the scenes
+    SceneGraphBenchConfig sceneGraph;
+    bool runMeshlets = false;          // meshlet building and cluster culling, before the scenes
+    MeshletBenchConfig meshlets;
+    bool runBvh = false;               // BVH builds and ray casts, before the scenes
+    BvhBenchConfig bvh;
+};
+
+// Min/avg/percentiles of one per-frame metric over the measured frames
+struct BenchSummary
+{
+    double avg = 0.0;
+    double min = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+struct BenchRunResult
+{
+    std::string scene;
+    std::vector<std::pair<std::string, double>> parameters;
+    BenchResolution resolution;
+
+    double loadMs = 0.0;               // scene Load until its uploads completed
+    uint64_t loadBytes = 0;
+    BenchSummary cpuFrameMs;           // BeginFrame -> EndFrame, including the fence wait
+    BenchSummary cpuRecordMs;
+    BenchSummary fenceWaitMs;
+    BenchSummary gpuFrameMs;           // "Frame" timestamp scope
+    uint32_t gpuSamples = 0;
+
+    uint64_t uploadBytes = 0;          // during the measured frames
+    uint64_t uploadSubmissions = 0;
+    uint64_t stagingStalls = 0;
+    double uploadMiBPerSecond = 0.0;
+    double gpuUploadMs = 0.0;          // average "Uploads" scope, 0 when nothing was uploaded
+    BenchSummary allocationsPerFrame;
+    BenchSummary deviceAllocationsPerFrame;
+    BenchSummary queueBindsPerFrame;   // binds recorded for queued RenderIndexedBuffer draws
+    BenchSummary queueBindsSavedPerFrame;
+    BenchSummary queueRecordMs;        // sorting and recording the queued draws, across all recording threads
+    BenchSummary cullMs;               // frustum culling draws with bounds
+    BenchSummary cullVisiblePerFrame;
+    BenchSummary trianglesPerFrame;    // of indexed draws, after culling and LOD selection
+    BenchSummary gpuCullVisiblePerFrame; // GPU objects drawn after compute culling, both phases
+};
+
+// Runs every (scene, resolution) pair for a fixed number of frames on a
+// headless device, one frame per OnUpdate, writes the results as JSON and
+// closes the application. The import, culling, scene graph, meshlet and BVH
+// benchmarks, when enabled, run first.
+class BenchLayer : public Walnut::Layer
+{
+public:
+    explicit BenchLayer(const BenchConfig& config);
+    virtual ~BenchLayer();
+
+    virtual void OnAttach() override;
+    virtual void OnDetach() override;
+    virtual void OnUpdate(float ts) override;
+
+private:
+    struct Run
+    {
+        BenchSceneInfo scene;
+        BenchResolution resolution;
+    };
+
+    // Per-frame samples of the run in progress
+    struct RunSamples
+    {
+        std::vector<double> cpuFrameMs;
+        std::vector<double> cpuRecordMs;
+        std::vector<double> fenceWaitMs;
+        std::vector<double> gpuFrameMs;
+        std::vector<double> allocations;
+        std::vector<double> deviceAllocations;
+        std::vector<double> queueBinds;
+        std::vector<double> queueBindsSaved;
+        std::vector<double> queueRecordMs;
+        std::vector<double> cullMs;
+        std::vector<double> cullVisible;
+        std::vector<double> triangles;
+        std::vector<double> gpuCullVisible;
+    };
+
+    void BeginRun();
+    void RenderFrame();
+    void EndRun();
+    void Finish();
+    void Abort(const char* what);
+    // Text chart of `metric` against a scene parameter, for runs that have it
+    void PrintScaling(const char* parameter, BenchSummary BenchRunResult::* metric, const char* title) const;
+    bool WriteResults() const;
+
+private:
+    BenchConfig m_Config;
+
+    // Declared before m_Graphics so the device outlives the renderer
+    std::unique_ptr<veng::HeadlessDevice> m_Device;
+    std::unique_ptr<veng::WalnutGraphics> m_Graphics;
+    std::unique_ptr<BenchScene> m_Scene;
+
+    std::vector<Run> m_Runs;
+    size_t m_CurrentRun = 0;
+    uint32_t m_Frame = 0;
+    RunSamples m_Samples;
+    BenchRunResult m_Result;
+    veng::UploadStats m_UploadBaseline;
+    std::chrono::steady_clock::time_point m_MeasureStart;
+
+    std::vector<BenchRunResult> m_Results;
+    std::optional<ImportBenchResult> m_ImportResult;
+    std::optional<CullBenchResult> m_CullResult;
+    std::optional<SceneGraphBenchResult> m_SceneGraphResult;
+    std::optional<MeshletBenchResult> m_MeshletResult;
+    std::optional<BvhBenchResult> m_BvhResult;
+    bool m_Finished = false;
+};
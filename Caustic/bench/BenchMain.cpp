@@ -0,0 +1,211 @@
+#include "Walnut/Application.h"
+#include "Walnut/EntryPoint.h"
+
+#include "BenchLayer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static void PrintUsage()
+{
+	std::cout << "Usage: Caustic-Bench [options]\n"
+		<< "  --frames <n>            measured frames per run (default 300)\n"
+		<< "  --warmup <n>            discarded frames before measuring (default 30)\n"
+		<< "  --resolution <w>x<h>    run at this size; repeat for several (default 1280x720 and 1920x1080)\n"
+		<< "  --scene <name>          run only this scene; repeat for several (quads, fish_instanced, fish_gpu_instanced, fish_meshlets, fish_crowd,\n"
+		<< "                          fish_crowd_lod, texture_stream, dense_mesh, meshes_separate, meshes_pooled,\n"
+		<< "                          meshes_gpu_culled, occluders_frustum, occluders_hiz, queue_draws)\n"
+		<< "  --instances <n>         fish count of the fish scenes; repeat for several, e.g. 1000, 10000, 100000 (default 64)\n"
+		<< "  --crowd <n>             fish count of the fish_crowd scenes (default 10000)\n"
+		<< "  --reload-interval <n>   frames between texture uploads in texture_stream (default 8)\n"
+		<< "  --dense-triangles <n>   triangle count of dense_mesh (default 2000000)\n"
+		<< "  --meshes <n>            mesh count of the meshes and occluders scenes; repeat for several (default 1000)\n"
+		<< "  --queue-draws <n>       draw count of queue_draws (default 50000)\n"
+		<< "  --recording-threads <n> threads recording queue_draws; repeat for several, 0 for all (default 1, 2, 4 and 0)\n"
+		<< "  --output <file>         results file (default bench_results.json)\n"
+		<< "  --label <text>          stored in the results, e.g. a commit hash (default $CAUSTIC_BENCH_LABEL)\n"
+		<< "  --device <name>         prefer the device whose name contains <name>, e.g. llvmpipe\n"
+		<< "  --validation            enable VK_LAYER_KHRONOS_validation (skews timings)\n"
+		<< "  --import                also time OBJ import against tinyobjloader\n"
+		<< "  --import-only           only the import benchmark; no device is created\n"
+		<< "  --import-file <obj>     import this file instead of a generated grid\n"
+		<< "  --import-triangles <n>  size of the generated grid (default 1000000)\n"
+		<< "  --culling               also time frustum culling with each supported SIMD kernel\n"
+		<< "  --culling-only          only the culling benchmark; no device is created\n"
+		<< "  --culling-objects <n>   boxes tested per call (default 1000000)\n"
+		<< "  --scene-graph           also time transform hierarchy updates\n"
+		<< "  --scene-graph-only      only the scene graph benchmark; no device is created\n"
+		<< "  --scene-graph-nodes <n> node count of the hierarchy (default 1000000)\n"
+		<< "  --meshlets              also build meshlets and report cluster culling from several views\n"
+		<< "  --meshlets-only         only the meshlet benchmark; no device is created\n"
+		<< "  --meshlets-file <obj>   split this file instead of models/fish.obj\n"
+		<< "  --bvh                   also time BVH builds and ray casts with each supported SIMD kernel\n"
+		<< "  --bvh-only              only the BVH benchmark; no device is created\n"
+		<< "  --bvh-file <obj>        build over this file instead of models/fish.obj\n"
+		<< "  --bvh-triangles <n>     triangle count of a generated heightfield; repeat for several (default 1000000)\n";
+}
+
+Walnut::Application* Walnut::CreateApplication(int argc, char** argv)
+{
+	BenchConfig config;
+	if (const char* label = std::getenv("CAUSTIC_BENCH_LABEL"))
+		config.label = label;
+
+	bool customResolutions = false;
+	bool customInstances = false;
+	bool customMeshCounts = false;
+	bool customRecordingThreads = false;
+	bool customBvhTriangles = false;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (std::strcmp(arg, "--frames") == 0 && hasValue)
+			config.frames = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(arg, "--warmup") == 0 && hasValue)
+			config.warmupFrames = (uint32_t)std::max(0, std::atoi(argv[++i]));
+		else if (std::strcmp(arg, "--resolution") == 0 && hasValue)
+		{
+			BenchResolution resolution;
+			if (std::sscanf(argv[++i], "%ux%u", &resolution.width, &resolution.height) != 2 || resolution.width == 0 || resolution.height == 0)
+			{
+				std::cout << "Invalid resolution: " << argv[i] << "\n";
+				continue;
+			}
+			if (!customResolutions)
+				config.resolutions.clear();
+			customResolutions = true;
+			config.resolutions.push_back(resolution);
+		}
+		else if (std::strcmp(arg, "--scene") == 0 && hasValue)
+			config.scenes.push_back(argv[++i]);
+		else if (std::strcmp(arg, "--instances") == 0 && hasValue)
+		{
+			if (!customInstances)
+				config.sceneOptions.fishInstances.clear();
+			customInstances = true;
+			config.sceneOptions.fishInstances.push_back((uint32_t)std::max(1, std::atoi(argv[++i])));
+		}
+		else if (std::strcmp(arg, "--crowd") == 0 && hasValue)
+			config.sceneOptions.crowdFish = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(arg, "--reload-interval") == 0 && hasValue)
+			config.sceneOptions.textureReloadInterval = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(arg, "--dense-triangles") == 0 && hasValue)
+			config.sceneOptions.denseTriangles = (uint32_t)std::max(2, std::atoi(argv[++i]));
+		else if (std::strcmp(arg, "--meshes") == 0 && hasValue)
+		{
+			if (!customMeshCounts)
+				config.sceneOptions.meshCounts.clear();
+			customMeshCounts = true;
+			config.sceneOptions.meshCounts.push_back((uint32_t)std::max(1, std::atoi(argv[++i])));
+		}
+		else if (std::strcmp(arg, "--queue-draws") == 0 && hasValue)
+			config.sceneOptions.queueDraws = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(arg, "--recording-threads") == 0 && hasValue)
+		{
+			if (!customRecordingThreads)
+				config.sceneOptions.recordingThreads.clear();
+			customRecordingThreads = true;
+			config.sceneOptions.recordingThreads.push_back((uint32_t)std::max(0, std::atoi(argv[++i])));
+		}
+		else if (std::strcmp(arg, "--output") == 0 && hasValue)
+			config.output = argv[++i];
+		else if (std::strcmp(arg, "--label") == 0 && hasValue)
+			config.label = argv[++i];
+		else if (std::strcmp(arg, "--device") == 0 && hasValue)
+			config.device.preferredDevice = argv[++i];
+		else if (std::strcmp(arg, "--validation") == 0)
+			config.device.validation = true;
+		else if (std::strcmp(arg, "--import") == 0)
+			config.runImport = true;
+		else if (std::strcmp(arg, "--import-only") == 0)
+		{
+			config.runImport = true;
+			config.runScenes = false;
+		}
+		else if (std::strcmp(arg, "--import-file") == 0 && hasValue)
+		{
+			config.runImport = true;
+			config.import.objPath = argv[++i];
+		}
+		else if (std::strcmp(arg, "--import-triangles") == 0 && hasValue)
+		{
+			config.runImport = true;
+			config.import.triangles = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(arg, "--culling") == 0)
+			config.runCulling = true;
+		else if (std::strcmp(arg, "--culling-only") == 0)
+		{
+			config.runCulling = true;
+			config.runScenes = false;
+		}
+		else if (std::strcmp(arg, "--culling-objects") == 0 && hasValue)
+		{
+			config.runCulling = true;
+			config.culling.objects = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(arg, "--scene-graph") == 0)
+			config.runSceneGraph = true;
+		else if (std::strcmp(arg, "--scene-graph-only") == 0)
+		{
+			config.runSceneGraph = true;
+			config.runScenes = false;
+		}
+		else if (std::strcmp(arg, "--scene-graph-nodes") == 0 && hasValue)
+		{
+			config.runSceneGraph = true;
+			config.sceneGraph.nodes = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(arg, "--meshlets") == 0)
+			config.runMeshlets = true;
+		else if (std::strcmp(arg, "--meshlets-only") == 0)
+		{
+			config.runMeshlets = true;
+			config.runScenes = false;
+		}
+		else if (std::strcmp(arg, "--meshlets-file") == 0 && hasValue)
+		{
+			config.runMeshlets = true;
+			config.meshlets.file = argv[++i];
+		}
+		else if (std::strcmp(arg, "--bvh") == 0)
+			config.runBvh = true;
+		else if (std::strcmp(arg, "--bvh-only") == 0)
+		{
+			config.runBvh = true;
+			config.runScenes = false;
+		}
+		else if (std::strcmp(arg, "--bvh-file") == 0 && hasValue)
+		{
+			config.runBvh = true;
+			config.bvh.file = argv[++i];
+		}
+		else if (std::strcmp(arg, "--bvh-triangles") == 0 && hasValue)
+		{
+			if (!customBvhTriangles)
+				config.bvh.syntheticTriangles.clear();
+			customBvhTriangles = true;
+			config.runBvh = true;
+			config.bvh.syntheticTriangles.push_back((uint32_t)std::max(2, std::atoi(argv[++i])));
+		}
+		else
+		{
+			std::cout << "Unknown argument: " << arg << "\n";
+			PrintUsage();
+		}
+	}
+
+	Walnut::ApplicationSpecification spec;
+	spec.Name = "Caustic Bench";
+	spec.Width = config.resolutions.front().width;
+	spec.Height = config.resolutions.front().height;
+
+	Walnut::Application* app = new Walnut::Application(spec);
+	app->PushLayer(std::make_shared<BenchLayer>(config));
+	return app;
+}
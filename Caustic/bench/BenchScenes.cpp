@@ -0,0 +1,827 @@
+#include "BenchScenes.h"
+
+#include "Engine/mesh_cache.h"
+#include "Engine/meshlet.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+// Frame a bounding sphere from the same diagonal as the viewport camera (Z-up)
+void SetCameraForBounds(veng::WalnutGraphics& graphics, glm::vec3 center, float radius, uint32_t width, uint32_t height)
+{
+ const float aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+ const float verticalFOV = glm::radians(45.0f);
+ const float tanHalfV = std::tan(verticalFOV *0.5f);
+ const float distance = glm::max(radius / tanHalfV, radius / (tanHalfV * aspectRatio)) *1.1f;
+
+ const glm::vec3 direction = glm::normalize(glm::vec3(1.0f,1.0f,1.0f));
+ glm::mat4 view = glm::lookAt(center + direction * distance, center, glm::vec3(0.0f,0.0f,1.0f));
+ glm::mat4 projection = glm::perspective(verticalFOV, aspectRatio, glm::max(0.01f, distance - radius *2.0f), distance + radius *2.0f);
+ projection[1][1] *= -1.0f; // Flip Y for Vulkan
+
+ graphics.SetViewProjection(view, projection);
+}
+
+struct QuadMesh {
+ veng::BufferHandle vertices;
+ veng::BufferHandle indices;
+
+ void Create(veng::WalnutGraphics& graphics)
+ {
+ std::array<veng::Vertex,8> quadVertices = {
+     veng::Vertex{glm::vec3{-0.7f, -0.7f, -0.1f}, glm::vec3{1.0f, 0.0f, 0.0f}, glm::vec2{0.0f, 1.0f}}, // Red
+     veng::Vertex{glm::vec3{ 0.0f, -0.7f, -0.1f}, glm::vec3{1.0f, 0.0f, 0.0f}, glm::vec2{1.0f, 1.0f}},
+     veng::Vertex{glm::vec3{ 0.0f,  0.0f, -0.1f}, glm::vec3{1.0f, 0.0f, 0.0f}, glm::vec2{1.0f, 0.0f}},
+     veng::Vertex{glm::vec3{-0.7f,  0.0f, -0.1f}, glm::vec3{1.0f, 0.0f, 0.0f}, glm::vec2{0.0f, 0.0f}},
+     veng::Vertex{glm::vec3{ 0.0f, 0.0f, 0.1f }, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{0.0f, 1.0f}}, // Blue
+     veng::Vertex{glm::vec3{ 0.7f, 0.0f, 0.1f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{1.0f, 1.0f}},
+     veng::Vertex{glm::vec3{ 0.7f, 0.7f, 0.1f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{1.0f, 0.0f}},
+     veng::Vertex{glm::vec3{ 0.0f, 0.7f, 0.1f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{0.0f, 0.0f}}
+ };
+ std::array<std::uint32_t,12> quadIndices = {
+0,1,2,
+2,3,0,
+4,5,6,
+6,7,4
+ };
+ vertices = graphics.CreateVertexBuffer(quadVertices);
+ indices = graphics.CreateIndexBuffer(quadIndices);
+ }
+
+ void Destroy(veng::WalnutGraphics& graphics)
+ {
+ graphics.DestroyBuffer(vertices);
+ graphics.DestroyBuffer(indices);
+ vertices = {};
+ indices = {};
+ }
+};
+
+class QuadScene : public BenchScene {
+public:
+ const char* GetName() const override { return "quads"; }
+
+ void Load(veng::WalnutGraphics& graphics, uint32_t width, uint32_t height) override
+ {
+ m_Mesh.Create(graphics);
+ SetCameraForBounds(graphics, glm::vec3(0.0f), 1.0f, width, height);
+ }
+
+ void Render(veng::WalnutGraphics& graphics, uint32_t frame) override
+ {
+ graphics.SetModelMatrix(glm::rotate(glm::mat4(1.0f),0.02f * frame, glm::vec3(0.0f,0.0f,1.0f)));
+ graphics.RenderIndexedBuffer(m_Mesh.vertices, m_Mesh.indices,12);
+ }
+
+ void Unload(veng::WalnutGraphics& graphics) override { m_Mesh.Destroy(graphics); }
+
+private:
+ QuadMesh m_Mesh;
+};
+
+class FishInstancedScene : public BenchScene {
+public:
+ FishInstancedScene(uint32_t instances, bool gpuInstancing)
+ : m_Instances(instances), m_GpuInstancing(gpuInstancing) {}
+
+ const char* GetName() const override { return m_GpuInstancing ? "fish_gpu_instanced" : "fish_instanced"; }
+
+ void Load(veng::WalnutGraphics& graphics, uint32_t width, uint32_t height) override
+ {
+ veng::ObjImportOptions options;
+ options.normalsAsColor = true;
+ // The first run imports and writes models/fish.obj.cmesh; the load time of
+ // later runs is the cached path
+ const veng::MeshAsset mesh = veng::LoadMesh("models/fish.obj", options);
+
+ m_IndexCount = static_cast<std::uint32_t>(mesh.GetIndices().size());
+ m_VertexBuffer = graphics.CreateVertexBuffer(mesh.GetVertices());
+ m_IndexBuffer = graphics.CreateIndexBuffer(mesh.GetIndices());
+ graphics.LoadTextureFromFile("textures/fish.png");
+ m_SingleDraw = graphics.IsInstancingSupported();
+
+ // Square grid centered on the origin, one mesh diameter apart
+ m_MeshCenter = (mesh.GetBoundsMin() + mesh.GetBoundsMax()) *0.5f;
+ const float meshRadius = glm::length(mesh.GetBoundsMax() - mesh.GetBoundsMin()) *0.5f;
+ m_Spacing = meshRadius *2.0f;
+ m_GridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(m_Instances))));
+ const float gridRadius = meshRadius + m_Spacing * (m_GridSize -1) *0.7072f;
+ SetCameraForBounds(graphics, glm::vec3(0.0f), gridRadius, width, height);
+ }
+
+ void Render(veng::WalnutGraphics& graphics, uint32_t frame) override
+ {
+ const float halfExtent = m_Spacing * (m_GridSize -1) *0.5f;
+ m_InstanceData.resize(m_GpuInstancing ? m_Instances :0);
+ for (uint32_t i =0; i < m_Instances; ++i) {
+ const glm::vec3 offset(m_Spacing * (i % m_GridSize) - halfExtent, m_Spacing * (i / m_GridSize) - halfExtent,0.0f);
+ // Each instance spins at its own phase so no two draws share a matrix
+ glm::mat4 model = glm::translate(glm::mat4(1.0f), offset);
+ model = glm::rotate(model,0.02f * frame +0.1f * i, glm::vec3(0.0f,0.0f,1.0f));
+ model = glm::translate(model, -m_MeshCenter);
+ if (m_GpuInstancing) {
+ m_InstanceData[i].transformation = model;
+ } else {
+ graphics.SetModelMatrix(model);
+ graphics.RenderIndexedBuffer(m_VertexBuffer, m_IndexBuffer, m_IndexCount);
+ }
+ }
+ // Same transforms, one draw
+ if (m_GpuInstancing) {
+ graphics.RenderIndexedInstanced(m_VertexBuffer, m_IndexBuffer, m_IndexCount, m_InstanceData);
+ }
+ }
+
+ void Unload(veng::WalnutGraphics& graphics) override
+ {
+ graphics.DestroyBuffer(m_VertexBuffer);
+ graphics.DestroyBuffer(m_IndexBuffer);
+ m_VertexBuffer = {};
+ m_IndexBuffer = {};
+ }
+
+ std::vector<std::pair<std::string, double>> GetParameters() const override
+ {
+ std::vector<std::pair<std::string, double>> parameters = { { "instances", static_cast<double>(m_Instances) }, { "trianglesPerInstance", m_IndexCount /3.0 } };
+ if (m_GpuInstancing) {
+ // 0 when the instanced shader was missing and the renderer fell back to a draw per fish
+ parameters.push_back({ "singleDraw", m_SingleDraw ?1.0 :0.0 });
+ }
+ return parameters;
+ }
+
+private:
+ uint32_t m_Instances =0;
+ bool m_GpuInstancing = false;
+ bool m_SingleDraw = false;
+ std::vector<veng::InstanceData> m_InstanceData;
+ uint32_t m_GridSize =1;
+ float m_Spacing =1.0f;
+ glm::vec3 m_MeshCenter{0.0f};
+ veng::BufferHandle m_VertexBuffer;
+ veng::BufferHandle m_IndexBuffer;
+ std::uint32_t m_IndexCount =0;
+};
+
+// The fish grid of FishInstancedScene, each fish split into meshlets and
+// drawn with RenderMeshlets, so only its clusters facing the camera are drawn
+class FishMeshletsScene : public BenchScene {
+public:
+ explicit FishMeshletsScene(uint32_t instances)
+ : m_Instances(instances) {}
+
+ const char* GetName() const override { return "fish_meshlets"; }
+
+ void Load(veng::WalnutGraphics& graphics, uint32_t width, uint32_t height) override
+ {
+ veng::ObjImportOptions options;
+ options.normalsAsColor = true;
+ const veng::MeshAsset mesh = veng::LoadMesh("models/fish.obj", options);
+
+ m_Meshlets = veng::BuildMeshlets(mesh.GetVertices(), mesh.GetIndices());
+ m_VertexBuffer = graphics.CreateVertexBuffer(mesh.GetVertices());
+ m_IndexBuffer = graphics.CreateIndexBuffer(m_Meshlets.indices);
+ graphics.LoadTextureFromFile("textures/fish.png");
+
+ m_MeshCenter = (mesh.GetBoundsMin() + mesh.GetBoundsMax()) *0.5f;
+ const float meshRadius = glm::length(mesh.GetBoundsMax() - mesh.GetBoundsMin()) *0.5f;
+ m_Spacing = meshRadius *2.0f;
+ m_GridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(m_Instances))));
+ const float gridRadius = meshRadius + m_Spacing * (m_GridSize -1) *0.7072f;
+ SetCameraForBounds(graphics, glm::vec3(0.0f), gridRadius, width, height);
+ }
+
+ void Render(veng::WalnutGraphics& graphics, uint32_t frame) override
+ {
+ const float halfExtent = m_Spacing * (m_GridSize -1) *0.5f;
+ for (uint32_t i =0; i < m_Instances; ++i) {
+ const glm::vec3 offset(m_Spacing * (i % m_GridSize) - halfExtent, m_Spacing * (i / m_GridSize) - halfExtent,0.0f);
+ glm::mat4 model = glm::translate(glm::mat4(1.0f), offset);
+ model = glm::rotate(model,0.02f * frame +0.1f * i, glm::vec3(0.0f,0.0f,1.0f));
+ model = glm::translate(model, -m_MeshCenter);
+ graphics.SetModelMatrix(model);
+ graphics.RenderMeshlets(m_VertexBuffer, m_IndexBuffer, m_Meshlets);
+ }
+ }
+
+ void Unload(veng::WalnutGraphics& graphics) override
+ {
+ graphics.DestroyBuffer(m_VertexBuffer);
+ graphics.DestroyBuffer(m_IndexBuffer);
+ m_VertexBuffer = {};
+ m_IndexBuffer = {};
+ }
+
+ std::vector<std::pair<std::string, double>> GetParameters() const override
+ {
+ return { { "instances", static_cast<double>(m_Instances) }, { "meshlets", static_cast<double>(m_Meshlets.meshlets.size()) },
+ { "trianglesPerInstance", m_Meshlets.indices.size() /3.0 } };
+ }
+
+private:
+ uint32_t m_Instances =0;
+ veng::MeshletMesh m_Meshlets;
+ uint32_t m_GridSize =1;
+ float m_Spacing =1.0f;
+ glm::vec3 m_MeshCenter{0.0f};
+ veng::BufferHandle m_VertexBuffer;
+ veng::BufferHandle m_IndexBuffer;
+};
+
+// A crowd of fish on a grid, one instanced draw per LOD level. Without LODs
+// every fish draws the base mesh; with them each fish is put in the bucket of
+// the level WalnutGraphics::SelectLod picks for it.
+class FishCrowdScene : public BenchScene {
+public:
+ FishCrowdScene(uint32_t fish, bool lods)
+ : m_Fish(fish), m_UseLods(lods) {}
+
+ const char* GetName() const override { return m_UseLods ? "fish_crowd_lod" : "fish_crowd"; }
+
+ void Load(veng::WalnutGraphics& graphics, uint32_t width, uint32_t height) override
+ {
+ veng::ObjImportOptions options;
+ options.normalsAsColor = true;
+ options.lodLevels =4;
+ const veng::MeshAsset mesh = veng::LoadMesh("models/fish.obj", options);
+
+ m_Lods.assign(mesh.GetLods().begin(), mesh.GetLods().end());
+ if (m_Lods.empty()) {
+ m_Lods.push_back({0, static_cast<std::uint32_t>(mesh.GetIndices().size()),0.0f });
+ }
+ m_VertexBuffer = graphics.CreateVertexBuffer(mesh.GetVertices());
+ m_IndexBuffer = graphics.CreateIndexBuffer(mesh.GetIndices());
+ graphics.LoadTextureFromFile("textures/fish.png");
+
+ m_MeshCenter = (mesh.GetBoundsMin() + mesh.GetBoundsMax()) *0.5f;
+ const float meshRadius = glm::length(mesh.GetBoundsMax() - mesh.GetBoundsMin()) *0.5f;
+ m_Spacing = meshRadius *2.0f;
+ m_GridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(m_Fish))));
+ const float gridRadius = meshRadius + m_Spacing * (m_GridSize -1) *0.7072f;
+ SetCameraForBounds(graphics, glm::vec3(0.0f), gridRadius, width, height);
+ }
+
+ void Render(veng::WalnutGraphics& graphics, uint32_t frame) override
+ {
+ const float halfExtent = m_Spacing * (m_GridSize -1) *0.5f;
+ m_Buckets.resize(m_Lods.size());
+ for (std::vector<veng::InstanceData>& bucket : m_Buckets) {
+ bucket.clear();
+ }
+ for (uint32_t i =0; i < m_Fish; ++i) {
+ const glm::vec3 offset(m_Spacing * (i % m_GridSize) - halfExtent, m_Spacing * (i / m_GridSize) - halfExtent,0.0f);
+ glm::mat4 model = glm::translate(glm::mat4(1.0f), offset);
+ model = glm::rotate(model,0.02f * frame +0.1f * i, glm::vec3(0.0f,0.0f,1.0f));
+ model = glm::translate(model, -m_MeshCenter);
+ const uint32_t level = m_UseLods ? graphics.SelectLod(m_Lods, model, m_MeshCenter) :0;
+ m_Buckets[level].push_back(veng::InstanceData{ model });
+ }
+ for (size_t level =0; level < m_Lods.size(); ++level) {
+ if (!m_Buckets[level].empty()) {
+ graphics.RenderIndexedInstanced(m_VertexBuffer, m_IndexBuffer, m_Lods[level].indexCount, m_Buckets[level], m_Lods[level].firstIndex);
+ }
+ }
+ }
+
+ void Unload(veng::WalnutGraphics& graphics) override
+ {
+ graphics.DestroyBuffer(m_VertexBuffer);
+ graphics.DestroyBuffer(m_IndexBuffer);
+ m_VertexBuffer = {};
+ m_IndexBuffer = {};
+ }
+
+ std::vector<std::pair<std::string, double>> GetParameters() const override
+ {
+ return { { "fish", static_cast<double>(m_Fish) }, { "lodLevels", static_cast<double>(m_Lods.size()) },
+ { "trianglesPerFish", m_Lods.empty() ?0.0 : m_Lods[0].indexCount /3.0 } };
+ }
+
+private:
+ uint32_t m_Fish =0;
+ bool m_UseLods = false;
+ std::vector<veng::MeshLod> m_Lods;
+ std::vector<std::vector<veng::InstanceData>> m_Buckets;
+ uint32_t m_GridSize =1;
+ float m_Spacing =1.0f;
+ glm::vec3 m_MeshCenter{0.0f};
+ veng::BufferHandle m_VertexBuffer;
+ veng::BufferHandle m_IndexBuffer;
+};
+
+// One large, finely tessellated grid: geometry bound rather than fill bound,
+// so vertex fetch bandwidth (and with it the vertex layout) shows up in the
+// GPU time. Colors and texture coordinates stay in [0, 1] for unorm layouts.
+class DenseMeshScene : public BenchScene {
+public:
+ explicit DenseMeshScene(uint32_t triangles)
+ : m_Cells(std::max(1u, static_cast<uint32_t>(std::sqrt(triangles *0.5)))) {}
+
+ const char* GetName() const override { return "dense_mesh"; }
+
+ void Load(veng::WalnutGraphics& graphics, uint32_t width, uint32_t height) override
+ {
+ const uint32_t n = m_Cells;
+ const float step =1.0f / n;
+ std::vector<veng::Vertex> vertices;
+ vertices.reserve(static_cast<size_t>(n +1) * (n +1));
+ for (uint32_t y =0; y <= n; ++y) {
+ for (uint32_t x =0; x <= n; ++x) {
+ const float u = x * step;
+ const float v = y * step;
+ const float height =0.05f * std::sin(u *40.0f) * std::cos(v *27.0f);
+ vertices.push_back({ glm::vec3(u -0.5f, v -0.5f, height), glm::vec3(u, v, height *10.0f +0.5f), glm::vec2(u, v) });
+ }
+ }
+ std::vector<std::uint32_t> indices;
+ indices.reserve(static_cast<size_t>(n) * n *6);
+ for (uint32_t y =0; y < n; ++y) {
+ for (uint32_t x =0; x < n; ++x) {
+ const uint32_t a = y * (n +1) + x;
+ const uint32_t b = a + n +1;
+ indices.insert(indices.end(), { a, a +1, b +1, a, b +1, b });
+ }
+ }
+
+ m_IndexCount = static_cast<std::uint32_t>(indices.size());
+ m_VertexCount = static_cast<std::uint32_t>(vertices.size());
+ m_VertexBuffer = graphics.CreateVertexBuffer(vertices);
+ m_IndexBuffer = graphics.CreateIndexBuffer(indices);
+ SetCameraForBounds(graphics, glm::vec3(0.0f),0.75f, width, height);
+ }
+
+ void Render(veng::WalnutGraphics& graphics, uint32_t frame) override
+ {
+ graphics.SetModelMatrix(glm::rotate(glm::mat4(1.0f),0.01f * frame, glm::vec3(0.0f,0.0f,1.0f)));
+ graphics.RenderIndexedBuffer(m_VertexBuffer, m_IndexBuffer, m_IndexCount);
+ }
+
+ void Unload(veng::WalnutGraphics& graphics) override
+ {
+ graphics.DestroyBuffer(m_VertexBuffer);
+ graphics.DestroyBuffer(m_IndexBuffer);
+ m_VertexBuffer = {};
+ m_IndexBuffer = {};
+ }
+
+ std::vector<std::pair<std::string, double>> GetParameters() const override
+ {
+ return { { "triangles", m_IndexCount /3.0 }, { "vertices", static_cast<double>(m_VertexCount) } };
+ }
+
+private:
+ uint32_t m_Cells =1;
+ veng::BufferHandle m_VertexBuffer;
+ veng::BufferHandle m_IndexBuffer;
+ std::uint32_t m_IndexCount =0;
+ std::uint32_t m_VertexCount =0;
+};
+
+// A lumpy low-poly sphere, different for every seed: many small distinct meshes
+// are what the mesh pool is for
+void MakeRock(uint32_t seed, std::vector<veng::Vertex>& vertices, std::vector<std::uint32_t>& indices)
+{
+ constexpr uint32_t kRings =6;
+ constexpr uint32_t kSegments =8;
+ auto hash = [](uint32_t x) {
+ x ^= x >>16;
+ x *=0x7feb352du;
+ x ^= x >>15;
+ x *=0x846ca68bu;
+ x ^= x >>16;
+ return (x &0xffffu) /65535.0f;
+ };
+ const glm::vec3 color(0.4f +0.6f * hash(seed *3),0.4f +0.6f * hash(seed *3 +1),0.4f +0.6f * hash(seed *3 +2));
+
+ vertices.clear();
+ indices.clear();
+ for (uint32_t ring =0; ring <= kRings; ++ring) {
+ const float theta = glm::pi<float>() * ring / kRings;
+ for (uint32_t segment =0; segment <= kSegments; ++segment) {
+ // The seam column repeats the first one so the surface stays closed
+ const float phi = glm::two_pi<float>() * segment / kSegments;
+ const uint32_t column = segment % kSegments;
+ const uint32_t point = (ring ==0 || ring == kRings) ? ring : ring * kSegments + column;
+ const float radius =0.3f +0.15f * hash(seed *977 + point);
+ const glm::vec3 direction(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+ vertices.push_back({ direction * radius, color, glm::vec2(static_cast<float>(segment) / kSegments, static_cast<float>(ring) / kRings) });
+ }
+ }
+ for (uint32_t ring =0; ring < kRings; ++ring) {
+ for (uint32_t segment =0; segment < kSegments; ++segment) {
+ const uint32_t a = ring * (kSegments +1) + segment;
+ const uint32_t b = a + kSegments +1;
+ indices.insert(indices.end(), { a, b, a +1, a +1, b, b +1 });
+ }
+ }
+}
+
+enum class RockDraws {
+ Separate,
+ Pooled,
+ GpuCulled
+};
+
+// `meshes` different rocks on a grid, each drawn once per frame. Separate:
+// every rock has its own vertex and index buffer and a draw with a push
+// constant. Pooled: the rocks live in the mesh pool and the frame is a
+// handful of indirect draws. GpuCulled: pooled rocks kept on the GPU as
+// objects; only kMovingRocks of them spin, so the frame's CPU work stays the
+// same however many rocks there are, culling included.
+class RockFieldScene : public BenchScene {
+public:
+ static constexpr uint32_t kMovingRocks =64;
+
+ RockFieldScene(uint32_t meshes, RockDraws draws)
+ : m_Meshes(meshes), m_DrawMode(draws), m_Pooled(draws != RockDraws::Separate) {}
+
+ const char* GetName() const override
+ {
+ switch (m_DrawMode) {
+ case RockDraws::Pooled: return "meshes_pooled";
+ case RockDraws::GpuCulled: return "meshes_gpu_culled";
+ default: return "meshes_separate";
+ }
+ }
+
+ void Load(veng::WalnutGraphics& graphics, uint32_t width, uint32_t height) override
+ {
+ std::vector<veng::Vertex> vertices;
+ std::vector<std::uint32_t> indices;
+ for (uint32_t i =0; i < m_Meshes; ++i) {
+ MakeRock(i, vertices, indices);
+ if (m_Pooled) {
+ m_PoolMeshes.push_back(graphics.AddPoolMesh(vertices, indices));
+ } else {
+ m_Buffers.push_back({ graphics.CreateVertexBuffer(vertices), graphics.CreateIndexBuffer(indices) });
+ m_Bounds.push_back(veng::ComputeBounds(vertices));
+ }
+ }
+ m_IndexCount = static_cast<std::uint32_t>(indices.size());
+ m_Indirect = graphics.IsMultiDrawIndirectSupported();
+ m_GpuCulling = graphics.IsGpuCullingSupported();
+ m_DrawIndirectCount = graphics.IsDrawIndirectCountSupported();
+ m_Pages = graphics.GetMeshPoolStats().pages;
+
+ m_GridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(m_Meshes))));
+ const float extent = (m_GridSize -1) *0.5f;
+ SetCameraForBounds(graphics, glm::vec3(0.0f), extent *1.42f +0.5f, width, height);
+
+ if (m_DrawMode == RockDraws::GpuCulled) {
+ for (uint32_t i =0; i < m_Meshes; ++i) {
+ veng::InstanceData instance;
+ instance.transformation = GetModel(i,0);
+ m_Objects.push_back(graphics.AddGpuObject(m_PoolMeshes[i], instance));
+ }
+ }
+ }
+
+ void Render(veng::WalnutGraphics& graphics, uint32_t frame) override
+ {
+ if (m_DrawMode == RockDraws::GpuCulled) {
+ // A different few rocks each frame
+ const uint32_t moving = std::min(kMovingRocks, m_Meshes);
+ for (uint32_t k =0; k < moving; ++k) {
+ const uint32_t i = (frame * moving + k) % m_Meshes;
+ veng::InstanceData instance;
+ instance.transformation = GetModel(i, frame);
+ graphics.UpdateGpuObject(m_Objects[i], instance);
+ }
+ graphics.RenderGpuObjects();
+ return;
+ }
+
+ m_Draws.resize(m_Pooled ? m_Meshes :0);
+ for (uint32_t i =0; i < m_Meshes; ++i) {
+ const glm::mat4 model = GetModel(i, frame);
+ if (m_Pooled) {
+ m_Draws[i].mesh = m_PoolMeshes[i];
+ m_Draws[i].instance.transformation = model;
+ } else {
+ graphics.SetModelMatrix(model);
+ graphics.RenderIndexedBuffer(m_Buffers[i].first, m_Buffers[i].second, m_IndexCount, m_Bounds[i]);
+ }
+ }
+ if (m_Pooled) {
+ graphics.RenderPoolMeshes(m_Draws);
+ }
+ }
+
+ void Unload(veng::WalnutGraphics& graphics) override
+ {
+ for (veng::GpuObjectHandle object : m_Objects) {
+ graphics.RemoveGpuObject(object);
+ }
+ for (veng::MeshHandle mesh : m_PoolMeshes) {
+ graphics.RemovePoolMesh(mesh);
+ }
+ for (auto& [vertexBuffer, indexBuffer] : m_Buffers) {
+ graphics.DestroyBuffer(vertexBuffer);
+ graphics.DestroyBuffer(indexBuffer);
+ }
+ m_Objects.clear();
+ m_PoolMeshes.clear();
+ m_Buffers.clear();
+ m_Bounds.clear();
+ }
+
+ std::vector<std::pair<std::string, double>> GetParameters() const override
+ {
+ std::vector<std::pair<std::string, double>> parameters = { { "meshes", static_cast<double>(m_Meshes) }, { "trianglesPerMesh", m_IndexCount /3.0 } };
+ if (m_Pooled) {
+ // 0 when the device lacks multiDrawIndirect and the commands were recorded as direct draws
+ parameters.push_back({ "indirect", m_Indirect ?1.0 :0.0 });
+ parameters.push_back({ "poolPages", static_cast<double>(m_Pages) });
+ }
+ if (m_DrawMode == RockDraws::GpuCulled) {
+ // 0 when the compute path is unavailable and the objects went through RenderPoolMeshes
+ parameters.push_back({ "gpuCulling", m_GpuCulling ?1.0 :0.0 });
+ parameters.push_back({ "drawIndirectCount", m_DrawIndirectCount ?1.0 :0.0 });
+ parameters.push_back({ "updatesPerFrame", static_cast<double>(std::min(kMovingRocks, m_Meshes)) });
+ }
+ return parameters;
+ }
+
+private:
+ glm::mat4 GetModel(uint32_t i, uint32_t frame) const
+ {
+ const float halfExtent = (m_GridSize -1) *0.5f;
+ const glm::vec3 offset(static_cast<float>(i % m_GridSize) - halfExtent, static_cast<float>(i / m_GridSize) - halfExtent,0.0f);
+ return glm::rotate(glm::translate(glm::mat4(1.0f), offset),0.02f * frame +0.1f * i, glm::vec3(0.0f,0.0f,1.0f));
+ }
+
+ uint32_t m_Meshes =0;
+ RockDraws m_DrawMode = RockDraws::Separate;
+ bool m_Pooled = false;
+ bool m_Indirect = false;
+ bool m_GpuCulling = false;
+ bool m_DrawIndirectCount = false;
+ uint32_t m_Pages =0;
+ uint32_t m_GridSize =1;
+ std::uint32_t m_IndexCount =0;
+ std::vector<std::pair<veng::BufferHandle, veng::BufferHandle>> m_Buffers;
+ std::vector<veng::Aabb> m_Bounds; // culled like the pooled meshes, for a fair comparison
+ std::vector<veng::MeshHandle> m_PoolMeshes;
+ std::vector<veng::MeshDraw> m_Draws;
+ std::vector<veng::GpuObjectHandle> m_Objects;
+};
+
+// A unit cube around the origin, one color, four vertices a face
+void MakeBox(const glm::vec3& color, std::vector<veng::Vertex>& vertices, std::vector<std::uint32_t>& indices)
+{
+ vertices.clear();
+ indices.clear();
+ for (int axis =0; axis <3; ++axis) {
+ for (const float side : { -0.5f,0.5f }) {
+ glm::vec3 u(0.0f);
+ glm::vec3 v(0.0f);
+ // u x v points out of the face, so the corners go counter-clockwise
+ // seen from outside
+ u[(axis + (side >0.0f ?1 :2)) %3] =1.0f;
+ v[(axis + (side >0.0f ?2 :1)) %3] =1.0f;
+ glm::vec3 faceCenter(0.0f);
+ faceCenter[axis] = side;
+ const uint32_t first = static_cast<uint32_t>(vertices.size());
+ vertices.push_back({ faceCenter -0.5f * u -0.5f * v, color, glm::vec2(0.0f,0.0f) });
+ vertices.push_back({ faceCenter +0.5f * u -0.5f * v, color, glm::vec2(1.0f,0.0f) });
+ vertices.push_back({ faceCenter +0.5f * u +0.5f * v, color, glm::vec2(1.0f,1.0f) });
+ vertices.push_back({ faceCenter -0.5f * u +0.5f * v, color, glm::vec2(0.0f,1.0f) });
+ indices.insert(indices.end(), { first, first +1, first +2, first +2, first +3, first });
+ }
+ }
+}
+
+// `meshes` rocks as GPU objects on a grid behind a wall of kWalls segments
+// with narrow gaps, the camera below the top of the wall and swaying side to
+// side so rocks come into view through the gaps and go out again. With
+// `occlusion` the rocks the wall hides are culled against the depth pyramid;
+// without, only the frustum culls and nearly every rock is drawn.
+class OccludersScene : public BenchScene {
+public:
+ static constexpr uint32_t kWalls =8;
+
+ OccludersScene(uint32_t meshes, bool occlusion)
+ : m_Meshes(meshes), m_Occlusion(occlusion) {}
+
+ const char* GetName() const override { return m_Occlusion ? "occluders_hiz" : "occluders_frustum"; }
+
+ void Load(veng::WalnutGraphics& graphics, uint32_t width, uint32_t height) override
+ {
+ std::vector<veng::Vertex> vertices;
+ std::vector<std::uint32_t> indices;
+ for (uint32_t i =0; i < m_Meshes; ++i) {
+ MakeRock(i, vertices, indices);
+ m_PoolMeshes.push_back(graphics.AddPoolMesh(vertices, indices));
+ }
+ MakeBox(glm::vec3(0.55f,0.5f,0.45f), vertices, indices);
+ m_PoolMeshes.push_back(graphics.AddPoolMesh(vertices, indices));
+ m_GpuCulling = graphics.IsGpuCullingSupported();
+ m_OcclusionCulling = m_Occlusion && graphics.IsOcclusionCullingSupported();
+ graphics.SetOcclusionCulling(m_Occlusion);
+
+ // Rocks one unit apart starting two units behind the wall, which runs
+ // along the x axis well past the sides of the view
+ m_GridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(m_Meshes))));
+ const float halfExtent = (m_GridSize -1) *0.5f;
+ for (uint32_t i =0; i < m_Meshes; ++i) {
+ const glm::vec3 offset(static_cast<float>(i % m_GridSize) - halfExtent,2.0f + static_cast<float>(i / m_GridSize),0.0f);
+ veng::InstanceData instance;
+ instance.transformation = glm::rotate(glm::translate(glm::mat4(1.0f), offset),0.1f * i, glm::vec3(0.0f,0.0f,1.0f));
+ m_Objects.push_back(graphics.AddGpuObject(m_PoolMeshes[i], instance));
+ }
+ const float wallLength = std::max(40.0f,4.0f * m_GridSize);
+ const float segmentLength = wallLength / kWalls;
+ for (uint32_t wall =0; wall < kWalls; ++wall) {
+ const float center = -0.5f * wallLength + (wall +0.5f) * segmentLength;
+ veng::InstanceData instance;
+ instance.transformation = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(center,0.0f,0.5f)), glm::vec3(segmentLength -0.15f,0.2f,3.0f));
+ m_Objects.push_back(graphics.AddGpuObject(m_PoolMeshes.back(), instance));
+ }
+
+ m_Depth =2.0f + m_GridSize;
+ m_AspectRatio = static_cast<float>(width) / static_cast<float>(height);
+ }
+
+ void Render(veng::WalnutGraphics& graphics, uint32_t frame) override
+ {
+ // Eye at height 1, under the top of the wall at 2, so everything behind
+ // it is hidden but for what the gaps show
+ const glm::vec3 eye(std::sin(0.01f * frame) *2.0f, -3.0f,1.0f);
+ glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, m_Depth,0.5f), glm::vec3(0.0f,0.0f,1.0f));
+ glm::mat4 projection = glm::perspective(glm::radians(45.0f), m_AspectRatio,0.1f, m_Depth +4.0f);
+ projection[1][1] *= -1.0f; // Flip Y for Vulkan
+ graphics.SetViewProjection(view, projection);
+ graphics.RenderGpuObjects();
+ }
+
+ void Unload(veng::WalnutGraphics& graphics) override
+ {
+ for (veng::GpuObjectHandle object : m_Objects) {
+ graphics.RemoveGpuObject(object);
+ }
+ for (veng::MeshHandle mesh : m_PoolMeshes) {
+ graphics.RemovePoolMesh(mesh);
+ }
+ m_Objects.clear();
+ m_PoolMeshes.clear();
+ graphics.SetOcclusionCulling(true);
+ }
+
+ std::vector<std::pair<std::string, double>> GetParameters() const override
+ {
+ // 0 when the device cannot take the compute path; occlusionCulling also
+ // when the depth pyramid shader is missing
+ return {
+ { "meshes", static_cast<double>(m_Meshes) },
+ { "walls", static_cast<double>(kWalls) },
+ { "gpuCulling", m_GpuCulling ?1.0 :0.0 },
+ { "occlusionCulling", m_OcclusionCulling ?1.0 :0.0 }
+ };
+ }
+
+private:
+ uint32_t m_Meshes =0;
+ bool m_Occlusion = false;
+ bool m_GpuCulling = false;
+ bool m_OcclusionCulling = false;
+ uint32_t m_GridSize =1;
+ float m_Depth =0.0f; // of the rock field, from the wall
+ float m_AspectRatio =1.0f;
+ std::vector<veng::MeshHandle> m_PoolMeshes; // the rocks, then the wall
+ std::vector<veng::GpuObjectHandle> m_Objects;
+};
+
+// `draws` RenderIndexedBuffer draws of a few rocks on a grid, all going
+// through the render queue, recorded by `threads` threads (0: all of them).
+// Run with several thread counts to see recording time scale with cores.
+class QueueDrawsScene : public BenchScene {
+public:
+ QueueDrawsScene(uint32_t draws, uint32_t threads)
+ : m_Draws(draws), m_Threads(threads) {}
+
+ const char* GetName() const override { return "queue_draws"; }
+
+ void Load(veng::WalnutGraphics& graphics, uint32_t width, uint32_t height) override
+ {
+ std::vector<veng::Vertex> vertices;
+ std::vector<std::uint32_t> indices;
+ for (uint32_t i =0; i < kMeshes; ++i) {
+ MakeRock(i, vertices, indices);
+ m_Buffers.push_back({ graphics.CreateVertexBuffer(vertices), graphics.CreateIndexBuffer(indices) });
+ }
+ m_IndexCount = static_cast<std::uint32_t>(indices.size());
+ graphics.SetRecordingThreads(m_Threads);
+ m_ResolvedThreads = graphics.GetRecordingThreads();
+
+ m_GridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(m_Draws))));
+ const float extent = (m_GridSize -1) *0.5f;
+ SetCameraForBounds(graphics, glm::vec3(0.0f), extent *1.42f +0.5f, width, height);
+ }
+
+ void Render(veng::WalnutGraphics& graphics, uint32_t frame) override
+ {
+ const float halfExtent = (m_GridSize -1) *0.5f;
+ for (uint32_t i =0; i < m_Draws; ++i) {
+ const glm::vec3 offset(static_cast<float>(i % m_GridSize) - halfExtent, static_cast<float>(i / m_GridSize) - halfExtent,0.0f);
+ graphics.SetModelMatrix(glm::rotate(glm::translate(glm::mat4(1.0f), offset),0.02f * frame +0.1f * i, glm::vec3(0.0f,0.0f,1.0f)));
+ const auto& [vertexBuffer, indexBuffer] = m_Buffers[i % kMeshes];
+ graphics.RenderIndexedBuffer(vertexBuffer, indexBuffer, m_IndexCount);
+ }
+ }
+
+ void Unload(veng::WalnutGraphics& graphics) override
+ {
+ for (auto& [vertexBuffer, indexBuffer] : m_Buffers) {
+ graphics.DestroyBuffer(vertexBuffer);
+ graphics.DestroyBuffer(indexBuffer);
+ }
+ m_Buffers.clear();
+ }
+
+ std::vector<std::pair<std::string, double>> GetParameters() const override
+ {
+ return { { "draws", static_cast<double>(m_Draws) }, { "recordingThreads", static_cast<double>(m_ResolvedThreads) } };
+ }
+
+private:
+ static constexpr uint32_t kMeshes =64;
+ uint32_t m_Draws =0;
+ uint32_t m_Threads =0;
+ uint32_t m_ResolvedThreads =1;
+ uint32_t m_GridSize =1;
+ std::uint32_t m_IndexCount =0;
+ std::vector<std::pair<veng::BufferHandle, veng::BufferHandle>> m_Buffers;
+};
+
+// Keeps the upload path busy: a full texture (with mips) goes through staging
+// every `interval` frames while the quads are drawn with the previous one
+class TextureStreamScene : public BenchScene {
+public:
+ explicit TextureStreamScene(uint32_t interval)
+ : m_Interval(interval >0 ? interval :1) {}
+
+ const char* GetName() const override { return "texture_stream"; }
+
+ void Load(veng::WalnutGraphics& graphics, uint32_t width, uint32_t height) override
+ {
+ m_Mesh.Create(graphics);
+ graphics.LoadTextureFromFile(kTextures[0]);
+ SetCameraForBounds(graphics, glm::vec3(0.0f),1.0f, width, height);
+ }
+
+ void Render(veng::WalnutGraphics& graphics, uint32_t frame) override
+ {
+ if (frame % m_Interval == m_Interval -1) {
+ graphics.LoadTextureFromFile(kTextures[(frame / m_Interval +1) % kTextures.size()]);
+ }
+ graphics.SetModelMatrix(glm::mat4(1.0f));
+ graphics.RenderIndexedBuffer(m_Mesh.vertices, m_Mesh.indices,12);
+ }
+
+ void Unload(veng::WalnutGraphics& graphics) override { m_Mesh.Destroy(graphics); }
+
+ std::vector<std::pair<std::string, double>> GetParameters() const override
+ {
+ return { { "reloadInterval", static_cast<double>(m_Interval) } };
+ }
+
+private:
+ static constexpr std::array<const char*,2> kTextures = { "textures/texture.png", "textures/fish.png" };
+ uint32_t m_Interval =1;
+ QuadMesh m_Mesh;
+};
+
+} // namespace
+
+std::vector<BenchSceneInfo> GetBenchScenes(const BenchSceneOptions& options)
+{
+ std::vector<BenchSceneInfo> scenes = { { "quads", [] { return std::make_unique<QuadScene>(); } } };
+ // One run per instance count, every draw path next to the others
+ for (const uint32_t instances : options.fishInstances) {
+ scenes.push_back({ "fish_instanced", [instances] { return std::make_unique<FishInstancedScene>(instances, false); } });
+ scenes.push_back({ "fish_gpu_instanced", [instances] { return std::make_unique<FishInstancedScene>(instances, true); } });
+ scenes.push_back({ "fish_meshlets", [instances] { return std::make_unique<FishMeshletsScene>(instances); } });
+ }
+ scenes.push_back({ "fish_crowd", [options] { return std::make_unique<FishCrowdScene>(options.crowdFish, false); } });
+ scenes.push_back({ "fish_crowd_lod", [options] { return std::make_unique<FishCrowdScene>(options.crowdFish, true); } });
+ scenes.push_back({ "texture_stream", [options] { return std::make_unique<TextureStreamScene>(options.textureReloadInterval); } });
+ scenes.push_back({ "dense_mesh", [options] { return std::make_unique<DenseMeshScene>(options.denseTriangles); } });
+ for (const uint32_t meshes : options.meshCounts) {
+ scenes.push_back({ "meshes_separate", [meshes] { return std::make_unique<RockFieldScene>(meshes, RockDraws::Separate); } });
+ scenes.push_back({ "meshes_pooled", [meshes] { return std::make_unique<RockFieldScene>(meshes, RockDraws::Pooled); } });
+ scenes.push_back({ "meshes_gpu_culled", [meshes] { return std::make_unique<RockFieldScene>(meshes, RockDraws::GpuCulled); } });
+ scenes.push_back({ "occluders_frustum", [meshes] { return std::make_unique<OccludersScene>(meshes, false); } });
+ scenes.push_back({ "occluders_hiz", [meshes] { return std::make_unique<OccludersScene>(meshes, true); } });
+ }
+ for (const uint32_t threads : options.recordingThreads) {
+ scenes.push_back({ "queue_draws", [options, threads] { return std::make_unique<QueueDrawsScene>(options.queueDraws, threads); } });
+ }
+ return scenes;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Engine/WalnutGraphics.h"
+#include "Engine/buffer_handle.h"
+
+// A fixed, reproducible workload. Everything that moves is driven by the frame
+// index, never by wall time, so two runs record identical command streams.
+class BenchScene
+{
+public:
+    virtual ~BenchScene() = default;
+
+    virtual const char* GetName() const = 0;
+
+    // Create resources and set the camera; uploads are waited on by the runner
+    virtual void Load(veng::WalnutGraphics& graphics, uint32_t width, uint32_t height) = 0;
+    // Record the frame's draws (between BeginFrame and EndFrame)
+    virtual void Render(veng::WalnutGraphics& graphics, uint32_t frame) = 0;
+    virtual void Unload(veng::WalnutGraphics& graphics) = 0;
+
+    // Scene parameters worth keeping next to the results (instance counts, ...)
+    virtual std::vector<std::pair<std::string, double>> GetParameters() const { return {}; }
+};
+
+using BenchSceneFactory = std::function<std::unique_ptr<BenchScene>()>;
+
+struct BenchSceneInfo
+{
+    std::string name;
+    BenchSceneFactory create;
+};
+
+struct BenchSceneOptions
+{
+    std::vector<uint32_t> fishInstances = { 64 }; // one fish run per count
+    uint32_t crowdFish = 10000;
+    uint32_t textureReloadInterval = 8; // frames between texture uploads in texture_stream
+    uint32_t denseTriangles = 2000000;
+    std::vector<uint32_t> meshCounts = { 1000 }; // one run of each rock field and occluders scene per count
+    uint32_t queueDraws = 50000;
+    std::vector<uint32_t> recordingThreads = { 1, 2, 4, 0 }; // one queue_draws run per count, 0: every thread
+};
+
+// quads: the two-quad demo scene
+// fish_instanced: models/fish.obj drawn `fishInstances` times on a grid, one
+//   draw and push constant per fish
+// fish_gpu_instanced: the same grid as a single RenderIndexedInstanced draw
+// fish_meshlets: the fish_instanced grid drawn with RenderMeshlets, meshlets
+//   facing away or outside the frustum dropped per fish
+// fish_crowd: `crowdFish` fish, all at full detail, one instanced draw
+// fish_crowd_lod: the same crowd with fish.obj's LOD chain, each fish at the
+//   level its screen-space error allows, one instanced draw per level
+// texture_stream: textured quads re-uploading a texture every few frames
+// dense_mesh: one grid of `denseTriangles` triangles, bound by vertex work
+// meshes_separate: `meshCounts` distinct small meshes, one buffer pair and
+//   draw each
+// meshes_pooled: the same meshes in the mesh pool, drawn with indirect draws
+// meshes_gpu_culled: the pooled meshes as resident GPU objects, culled and
+//   drawn by a compute dispatch; a fixed few move each frame
+// occluders_frustum: `meshCounts` GPU object rocks behind a gapped wall, seen
+//   from a swaying camera low enough for the wall to hide most of them;
+//   frustum culling only
+// occluders_hiz: the same with occlusion culling against the depth pyramid
+// queue_draws: `queueDraws` queued draws of a few meshes, recorded by each of
+//   `recordingThreads` in turn
+std::vector<BenchSceneInfo> GetBenchScenes(const BenchSceneOptions& options);
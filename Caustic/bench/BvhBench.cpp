@@ -0,0 +1,178 @@
+#include "BvhBench.h"
+
+#include "Engine/bvh.h"
+#include "Engine/mesh_importer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point start)
+{
+ return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// A rolling square heightfield of about `triangles` triangles, in two per cell
+veng::MeshData MakeHeightfield(uint32_t triangles)
+{
+ const uint32_t cells = std::max(1u, static_cast<uint32_t>(std::sqrt(triangles /2.0)));
+ veng::MeshData mesh;
+ mesh.vertices.reserve(static_cast<size_t>(cells +1) * (cells +1));
+ for (uint32_t y =0; y <= cells; ++y) {
+ for (uint32_t x =0; x <= cells; ++x) {
+ const float u = static_cast<float>(x) / cells;
+ const float v = static_cast<float>(y) / cells;
+ const float height =0.05f * std::sin(u *40.0f) * std::cos(v *30.0f) +0.1f * std::sin((u + v) *6.0f);
+ mesh.vertices.push_back({ glm::vec3(u -0.5f, v -0.5f, height), glm::vec3(u, v,1.0f), glm::vec2(u, v) });
+ }
+ }
+ mesh.indices.reserve(static_cast<size_t>(cells) * cells *6);
+ for (uint32_t y =0; y < cells; ++y) {
+ for (uint32_t x =0; x < cells; ++x) {
+ const uint32_t corner = y * (cells +1) + x;
+ mesh.indices.insert(mesh.indices.end(), { corner, corner +1, corner + cells +2, corner + cells +2, corner + cells +1, corner });
+ }
+ }
+ return mesh;
+}
+
+uint32_t CountHits(const std::vector<veng::RayHit>& hits)
+{
+ return static_cast<uint32_t>(std::count_if(hits.begin(), hits.end(), [](const veng::RayHit& hit) { return hit.IsHit(); }));
+}
+
+BvhMeshResult BenchmarkMesh(const std::string& name, const veng::MeshData& mesh, const BvhBenchConfig& config)
+{
+ BvhMeshResult result;
+ result.mesh = name;
+ const uint32_t iterations = std::max(1u, config.iterations);
+
+ veng::Bvh bvh;
+ veng::BvhBuildOptions singleThread;
+ singleThread.maxThreads =1;
+ result.buildSingleThreadMs =1e30;
+ result.buildMs =1e30;
+ for (uint32_t i =0; i < iterations; ++i) {
+ bvh.Build(mesh.vertices, mesh.indices, singleThread);
+ result.buildSingleThreadMs = std::min(result.buildSingleThreadMs, bvh.GetBuildStats().ms);
+ }
+ for (uint32_t i =0; i < iterations; ++i) {
+ bvh.Build(mesh.vertices, mesh.indices);
+ result.buildMs = std::min(result.buildMs, bvh.GetBuildStats().ms);
+ }
+ const veng::BvhBuildStats& stats = bvh.GetBuildStats();
+ if (bvh.IsEmpty()) {
+ throw std::runtime_error("No triangles in " + name);
+ }
+ result.triangles = stats.triangles;
+ result.nodes = stats.nodes;
+ result.leaves = stats.leaves;
+ result.maxDepth = stats.maxDepth;
+ result.sahCost = stats.sahCost;
+ result.threads = stats.threads;
+ std::cout << "  BVH " << name << ": " << result.triangles << " triangles, " << result.nodes << " nodes, depth " << result.maxDepth
+  << ", SAH cost " << result.sahCost << "; built in " << result.buildSingleThreadMs << " ms on 1 thread, " << result.buildMs
+  << " ms on " << result.threads << std::endl;
+
+ // Camera rays framed like the bench scenes: the bounding sphere fills a
+ // 45 degree view from a diagonal
+ const veng::Aabb bounds = bvh.GetBounds();
+ const float radius = std::max(1e-3f, glm::length(bounds.extent));
+ const float tanHalf = std::tan(glm::radians(45.0f) *0.5f);
+ const glm::vec3 forward = -glm::normalize(glm::vec3(1.0f,1.0f,1.0f));
+ const glm::vec3 camera = bounds.center - forward * (radius / tanHalf *1.1f);
+ const glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f,0.0f,1.0f)));
+ const glm::vec3 up = glm::cross(right, forward);
+ const uint32_t side = std::max(1u, config.raysPerSide);
+ std::vector<veng::Ray> cameraRays;
+ cameraRays.reserve(static_cast<size_t>(side) * side);
+ for (uint32_t y =0; y < side; ++y) {
+ for (uint32_t x =0; x < side; ++x) {
+ const float px = ((x +0.5f) / side *2.0f -1.0f) * tanHalf;
+ const float py = (1.0f - (y +0.5f) / side *2.0f) * tanHalf;
+ cameraRays.push_back({ camera, forward + right * px + up * py });
+ }
+ }
+
+ // Segments between random points of the bounds, as visibility queries
+ std::mt19937 random(1234);
+ std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+ auto randomPoint = [&]() { return bounds.center + bounds.extent * glm::vec3(unit(random), unit(random), unit(random)); };
+ std::vector<veng::Ray> randomRays(cameraRays.size());
+ for (veng::Ray& ray : randomRays) {
+ ray.origin = randomPoint();
+ ray.direction = randomPoint() - ray.origin;
+ ray.tMax =1.0f;
+ }
+ result.rays = static_cast<uint32_t>(cameraRays.size());
+
+ std::vector<veng::RayHit> cameraReference(cameraRays.size());
+ std::vector<veng::RayHit> randomReference(randomRays.size());
+ bvh.IntersectRays(cameraRays, cameraReference, veng::CullKernel::Scalar);
+ bvh.IntersectRays(randomRays, randomReference, veng::CullKernel::Scalar);
+ result.cameraHits = CountHits(cameraReference);
+ result.randomHits = CountHits(randomReference);
+
+ std::vector<veng::RayHit> hits(cameraRays.size());
+ auto check = [&](veng::CullKernel kernel, const std::vector<veng::RayHit>& reference) {
+ for (size_t i =0; i < hits.size(); ++i) {
+ if (hits[i].IsHit() != reference[i].IsHit() || hits[i].t != reference[i].t) {
+ throw std::runtime_error(std::string("BVH kernel ") + veng::GetCullKernelName(kernel) + " disagrees with the scalar kernel");
+ }
+ }
+ };
+ auto best = [&](veng::CullKernel kernel, const std::vector<veng::Ray>& rays) {
+ double fastest =1e30;
+ for (uint32_t i =0; i < iterations; ++i) {
+ const auto start = Clock::now();
+ bvh.IntersectRays(rays, hits, kernel);
+ fastest = std::min(fastest, MillisecondsSince(start));
+ }
+ return fastest;
+ };
+ for (veng::CullKernel kernel : { veng::CullKernel::Scalar, veng::CullKernel::Sse, veng::CullKernel::Avx, veng::CullKernel::Neon }) {
+ if (!veng::IsCullKernelSupported(kernel)) {
+ continue;
+ }
+
+ bvh.IntersectRays(cameraRays, hits, kernel);
+ check(kernel, cameraReference);
+ bvh.IntersectRays(randomRays, hits, kernel);
+ check(kernel, randomReference);
+
+ BvhKernelResult timing;
+ timing.kernel = kernel;
+ timing.cameraMs = best(kernel, cameraRays);
+ timing.cameraMraysPerSecond = result.rays / (std::max(timing.cameraMs,1e-6) *1000.0);
+ timing.randomMs = best(kernel, randomRays);
+ timing.randomMraysPerSecond = result.rays / (std::max(timing.randomMs,1e-6) *1000.0);
+ std::cout << "  BVH rays " << veng::GetCullKernelName(kernel) << ": " << timing.cameraMraysPerSecond << " Mrays/s camera ("
+  << result.cameraHits << " of " << result.rays << " hit), " << timing.randomMraysPerSecond << " Mrays/s random ("
+  << result.randomHits << " hit)" << std::endl;
+ result.kernels.push_back(timing);
+ }
+ return result;
+}
+
+} // namespace
+
+BvhBenchResult RunBvhBenchmark(const BvhBenchConfig& config)
+{
+ BvhBenchResult result;
+ if (!config.file.empty()) {
+ const veng::MeshData mesh = veng::ImportObj(config.file);
+ result.meshes.push_back(BenchmarkMesh(config.file.string(), mesh, config));
+ }
+ for (uint32_t triangles : config.syntheticTriangles) {
+ const veng::MeshData mesh = MakeHeightfield(triangles);
+ result.meshes.push_back(BenchmarkMesh("heightfield", mesh, config));
+ }
+ return result;
+}
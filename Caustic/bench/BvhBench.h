@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Engine/culling.h"
+
+struct BvhBenchConfig
+{
+    std::filesystem::path file = "models/fish.obj"; // empty skips it
+    std::vector<uint32_t> syntheticTriangles = { 1000000 }; // generated heightfields
+    uint32_t iterations = 5;           // best of, per build and per kernel
+    uint32_t raysPerSide = 512;        // camera rays: a raysPerSide x raysPerSide image
+};
+
+struct BvhKernelResult
+{
+    veng::CullKernel kernel = veng::CullKernel::Scalar;
+    double cameraMs = 0.0;             // fastest IntersectRays call over the camera rays
+    double cameraMraysPerSecond = 0.0;
+    double randomMs = 0.0;             // the same number of rays between random points in the bounds
+    double randomMraysPerSecond = 0.0;
+};
+
+struct BvhMeshResult
+{
+    std::string mesh;                  // the OBJ path, or "heightfield"
+    uint32_t triangles = 0;
+    uint32_t nodes = 0;
+    uint32_t leaves = 0;
+    uint32_t maxDepth = 0;
+    float sahCost = 0.0f;
+    double buildSingleThreadMs = 0.0;
+    double buildMs = 0.0;              // the whole pool
+    uint32_t threads = 0;              // used by the parallel build
+    uint32_t rays = 0;                 // per set
+    uint32_t cameraHits = 0;           // the same for every kernel
+    uint32_t randomHits = 0;
+    std::vector<BvhKernelResult> kernels;
+};
+
+struct BvhBenchResult
+{
+    std::vector<BvhMeshResult> meshes;
+};
+
+// Builds a veng::Bvh over `file` and each synthetic heightfield, on one thread
+// and on the whole pool, and casts camera rays (coherent) and rays between
+// random points (incoherent) through it with every kernel this CPU
+// supports. Each kernel's hits are checked against the scalar ones before
+// timing.
+BvhBenchResult RunBvhBenchmark(const BvhBenchConfig& config);
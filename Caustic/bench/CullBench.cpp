@@ -0,0 +1,74 @@
+#include "CullBench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point start)
+{
+ return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+CullBenchResult RunCullBenchmark(const CullBenchConfig& config)
+{
+ // Boxes scattered over a cube; the camera at the center sees a 90 degree
+ // cone of it, so branches in the kernels can't predict the outcome
+ std::mt19937 random(1234);
+ std::uniform_real_distribution<float> position(-100.0f,100.0f);
+ std::uniform_real_distribution<float> size(0.1f,2.0f);
+ veng::CullingSet boxes;
+ boxes.Reserve(config.objects);
+ for (uint32_t i =0; i < config.objects; ++i) {
+ boxes.Add({ glm::vec3(position(random), position(random), position(random)), glm::vec3(size(random), size(random), size(random)) });
+ }
+
+ const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f,0.0f,0.0f), glm::vec3(0.0f,0.0f,1.0f));
+ glm::mat4 projection = glm::perspective(glm::radians(90.0f),16.0f /9.0f,0.1f,150.0f);
+ projection[1][1] *= -1.0f;
+ const veng::Frustum frustum = veng::Frustum::FromViewProjection(projection * view);
+
+ CullBenchResult result;
+ result.objects = config.objects;
+
+ std::vector<uint32_t> reference;
+ result.visible = veng::CullBoxes(frustum, boxes, reference, veng::CullKernel::Scalar);
+
+ std::vector<uint32_t> visible;
+ visible.reserve(config.objects);
+ for (veng::CullKernel kernel : { veng::CullKernel::Scalar, veng::CullKernel::Sse, veng::CullKernel::Avx, veng::CullKernel::Neon }) {
+ if (!veng::IsCullKernelSupported(kernel)) {
+ continue;
+ }
+
+ visible.clear();
+ veng::CullBoxes(frustum, boxes, visible, kernel);
+ if (visible != reference) {
+ throw std::runtime_error(std::string("Culling kernel ") + veng::GetCullKernelName(kernel) + " disagrees with the scalar kernel");
+ }
+
+ CullKernelResult timing;
+ timing.kernel = kernel;
+ timing.ms = 1e30;
+ for (uint32_t i =0; i < std::max(1u, config.iterations); ++i) {
+ visible.clear();
+ const auto start = Clock::now();
+ veng::CullBoxes(frustum, boxes, visible, kernel);
+ timing.ms = std::min(timing.ms, MillisecondsSince(start));
+ }
+ timing.objectsPerMicrosecond = config.objects / std::max(timing.ms *1000.0,1e-9);
+ std::cout << "  CullBoxes " << veng::GetCullKernelName(kernel) << ": " << timing.ms << " ms, "
+  << timing.objectsPerMicrosecond << " objects/us" << std::endl;
+ result.kernels.push_back(timing);
+ }
+ std::cout << "  Culling: " << result.visible << " of " << result.objects << " boxes visible" << std::endl;
+ return result;
+}
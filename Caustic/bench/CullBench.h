@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Engine/culling.h"
+
+struct CullBenchConfig
+{
+    uint32_t objects = 1000000;
+    uint32_t iterations = 20;          // best of
+};
+
+struct CullKernelResult
+{
+    veng::CullKernel kernel = veng::CullKernel::Scalar;
+    double ms = 0.0;                   // fastest CullBoxes call over the whole set
+    double objectsPerMicrosecond = 0.0;
+};
+
+struct CullBenchResult
+{
+    uint32_t objects = 0;
+    uint32_t visible = 0;              // the same for every kernel
+    std::vector<CullKernelResult> kernels;
+};
+
+// Times veng::CullBoxes with every kernel this CPU supports on a field of
+// random boxes around a fixed camera, about a quarter of them visible. Each
+// kernel's visible list is checked against the scalar one before timing.
+CullBenchResult RunCullBenchmark(const CullBenchConfig& config);
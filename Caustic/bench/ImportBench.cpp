@@ -0,0 +1,262 @@
+#include "ImportBench.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point start)
+{
+ return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Regular grid with positions, texture coordinates and normals on every
+// corner, written the way DCC exporters do (v/vt/vn blocks, then faces).
+// The content only depends on the triangle count, so the file is reused.
+std::filesystem::path WriteGridObj(uint32_t triangles)
+{
+ const uint32_t n = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(triangles *0.5))));
+ const std::filesystem::path path = std::filesystem::temp_directory_path() / ("caustic_grid_" + std::to_string(n * n *2) + ".obj");
+ if (std::filesystem::exists(path)) {
+ return path;
+ }
+
+ std::cout << "Generating " << path.string() << " (" << n * n *2 << " triangles)" << std::endl;
+ std::ofstream file(path, std::ios::binary);
+ if (!file) {
+ throw std::runtime_error("Failed to create " + path.string());
+ }
+
+ char line[128];
+ const auto write = [&](int length) { file.write(line, length); };
+ const float step =1.0f / n;
+ for (uint32_t y =0; y <= n; ++y) {
+ for (uint32_t x =0; x <= n; ++x) {
+ const float height =0.05f * std::sin(x *0.37f) * std::cos(y *0.23f);
+ write(std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", x * step, y * step, height));
+ }
+ }
+ for (uint32_t y =0; y <= n; ++y) {
+ for (uint32_t x =0; x <= n; ++x) {
+ write(std::snprintf(line, sizeof(line), "vt %.6f %.6f\n", x * step, y * step));
+ }
+ }
+ for (uint32_t y =0; y <= n; ++y) {
+ for (uint32_t x =0; x <= n; ++x) {
+ const float dx = -0.05f *0.37f * std::cos(x *0.37f) * std::cos(y *0.23f) * n;
+ const float dy =0.05f *0.23f * std::sin(x *0.37f) * std::sin(y *0.23f) * n;
+ const float length = std::sqrt(dx * dx + dy * dy +1.0f);
+ write(std::snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", dx / length, dy / length,1.0f / length));
+ }
+ }
+ for (uint32_t y =0; y < n; ++y) {
+ for (uint32_t x =0; x < n; ++x) {
+ const uint32_t a = y * (n +1) + x +1;
+ const uint32_t b = a +1;
+ const uint32_t c = a + n +2;
+ const uint32_t d = a + n +1;
+ write(std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c));
+ write(std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, c, c, c, d, d, d));
+ }
+ }
+ if (!file) {
+ throw std::runtime_error("Failed to write " + path.string());
+ }
+ return path;
+}
+
+struct IndexKey {
+ int v;
+ int vt;
+ int vn;
+
+ bool operator==(const IndexKey& other) const { return v == other.v && vt == other.vt && vn == other.vn; }
+};
+
+struct IndexKeyHash {
+ size_t operator()(const IndexKey& key) const
+ {
+ return std::hash<int>()(key.v) ^ (std::hash<int>()(key.vt) <<1) ^ (std::hash<int>()(key.vn) <<2);
+ }
+};
+
+// The usual single-threaded path: LoadObj, then a hash map from index triple
+// to vertex. Vertices come out in first use order, like veng::ImportObj.
+veng::MeshData LoadWithTinyObj(const std::filesystem::path& path, double& parseMs)
+{
+ const Clock::time_point start = Clock::now();
+ tinyobj::attrib_t attrib;
+ std::vector<tinyobj::shape_t> shapes;
+ std::vector<tinyobj::material_t> materials;
+ std::string error;
+ const std::string file = path.string();
+ if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &error, file.c_str(), nullptr)) {
+ throw std::runtime_error("tinyobjloader failed on " + file + ": " + error);
+ }
+ parseMs = MillisecondsSince(start);
+
+ veng::MeshData mesh;
+ std::unordered_map<IndexKey, uint32_t, IndexKeyHash> vertexIds;
+ for (const tinyobj::shape_t& shape : shapes) {
+ for (const tinyobj::index_t& index : shape.mesh.indices) {
+ const IndexKey key{ index.vertex_index, index.texcoord_index, index.normal_index };
+ auto [it, inserted] = vertexIds.try_emplace(key, static_cast<uint32_t>(mesh.vertices.size()));
+ if (inserted) {
+ veng::Vertex vertex{};
+ vertex.position = glm::vec3(attrib.vertices[3 * key.v +0], attrib.vertices[3 * key.v +1], attrib.vertices[3 * key.v +2]);
+ vertex.color = glm::vec3(1.0f);
+ if (key.vt >=0) {
+ vertex.texCoord = glm::vec2(attrib.texcoords[2 * key.vt +0],1.0f - attrib.texcoords[2 * key.vt +1]);
+ }
+ mesh.vertices.push_back(vertex);
+ }
+ mesh.indices.push_back(it->second);
+ }
+ }
+ return mesh;
+}
+
+void CheckSameMesh(const veng::MeshData& expected, const veng::MeshData& actual)
+{
+ if (expected.indices.size() != actual.indices.size() || expected.vertices.size() != actual.vertices.size()) {
+ throw std::runtime_error("ImportObj and tinyobjloader disagree on the vertex or index count");
+ }
+ for (size_t i =0; i < expected.indices.size(); ++i) {
+ const veng::Vertex& a = expected.vertices[expected.indices[i]];
+ const veng::Vertex& b = actual.vertices[actual.indices[i]];
+ if (a.position != b.position || a.texCoord != b.texCoord) {
+ throw std::runtime_error("ImportObj and tinyobjloader disagree at index " + std::to_string(i));
+ }
+ }
+}
+
+// Stand-in for the staging copy: touches every byte of the mapping once
+double CopyOut(const veng::MeshAsset& asset, std::vector<uint8_t>& staging)
+{
+ const Clock::time_point start = Clock::now();
+ const auto vertices = asset.GetVertices();
+ const auto indices = asset.GetIndices();
+ staging.resize(vertices.size_bytes() + indices.size_bytes());
+ std::memcpy(staging.data(), vertices.data(), vertices.size_bytes());
+ std::memcpy(staging.data() + vertices.size_bytes(), indices.data(), indices.size_bytes());
+ return MillisecondsSince(start);
+}
+
+MeshOptimizeResult MeasureOptimize(const std::filesystem::path& path)
+{
+ MeshOptimizeResult result;
+ result.file = path.string();
+
+ veng::ObjImportOptions options;
+ options.optimize = false;
+ options.deduplicate = false;
+ result.expandedVertices = veng::ImportObj(path, options).vertices.size();
+ options.deduplicate = true;
+ veng::MeshData mesh = veng::ImportObj(path, options);
+ result.indexedVertices = mesh.vertices.size();
+ result.stats = veng::OptimizeMesh(mesh);
+
+ const veng::MeshOptimizeStats& s = result.stats;
+ std::cout << "  OptimizeMesh " << path.filename().string() << ": vertices " << result.expandedVertices << " expanded, "
+ << s.verticesBefore << " indexed, " << s.verticesAfter << " welded; ACMR " << s.before.acmr << " -> " << s.after.acmr
+ << ", ATVR " << s.before.atvr << " -> " << s.after.atvr << " (" << s.milliseconds << " ms)" << std::endl;
+ return result;
+}
+
+} // namespace
+
+ImportBenchResult RunImportBenchmark(const ImportBenchConfig& config)
+{
+ const std::filesystem::path path = config.objPath.empty() ? WriteGridObj(config.triangles) : config.objPath;
+ if (!std::filesystem::is_regular_file(path)) {
+ throw std::runtime_error("OBJ file not found: " + path.string());
+ }
+
+ ImportBenchResult result;
+ result.file = path.string();
+ result.fileBytes = std::filesystem::file_size(path);
+ result.tinyobjMs = result.tinyobjParseMs = result.importSingleThreadMs = result.importMs =1e30;
+ result.cacheColdMs = result.cacheWarmMs =1e30;
+
+ veng::MeshCacheOptions cacheOptions;
+ cacheOptions.directory = std::filesystem::temp_directory_path() / "caustic_mesh_cache";
+ std::vector<uint8_t> staging;
+
+ // tinyobjloader keeps file order, so compare against unoptimized imports
+ veng::ObjImportOptions singleThread;
+ singleThread.maxThreads =1;
+ singleThread.optimize = false;
+ veng::ObjImportOptions allThreads;
+ allThreads.optimize = false;
+ const veng::ObjImportOptions cached;
+
+ const uint32_t iterations = std::max(1u, config.iterations);
+ for (uint32_t i =0; i < iterations; ++i) {
+ std::cout << "Import " << path.filename().string() << " " << (i +1) << "/" << iterations << std::endl;
+
+ double parseMs =0.0;
+ Clock::time_point start = Clock::now();
+ const veng::MeshData reference = LoadWithTinyObj(path, parseMs);
+ result.tinyobjMs = std::min(result.tinyobjMs, MillisecondsSince(start));
+ result.tinyobjParseMs = std::min(result.tinyobjParseMs, parseMs);
+
+ start = Clock::now();
+ const veng::MeshData single = veng::ImportObj(path, singleThread);
+ result.importSingleThreadMs = std::min(result.importSingleThreadMs, MillisecondsSince(start));
+
+ veng::ObjImportStats stats;
+ start = Clock::now();
+ const veng::MeshData mesh = veng::ImportObj(path, allThreads, &stats);
+ const double importMs = MillisecondsSince(start);
+ if (importMs < result.importMs) {
+ result.importMs = importMs;
+ result.stats = stats;
+ }
+
+ std::error_code error;
+ std::filesystem::remove(veng::GetMeshCachePath(path, cacheOptions), error);
+ veng::MeshLoadStats loadStats;
+ start = Clock::now();
+ const veng::MeshAsset cold = veng::LoadMesh(path, cached, cacheOptions, &loadStats);
+ result.cacheColdMs = std::min(result.cacheColdMs, MillisecondsSince(start) + CopyOut(cold, staging));
+ start = Clock::now();
+ const veng::MeshAsset warm = veng::LoadMesh(path, cached, cacheOptions, &loadStats);
+ result.cacheWarmMs = std::min(result.cacheWarmMs, MillisecondsSince(start) + CopyOut(warm, staging));
+ if (!loadStats.cacheHit) {
+ throw std::runtime_error("Mesh cache was not used on the second load of " + path.string());
+ }
+ result.cacheBytes = loadStats.cacheBytes;
+
+ if (i ==0) {
+ CheckSameMesh(reference, single);
+ CheckSameMesh(reference, mesh);
+ result.triangles = mesh.indices.size() /3;
+ result.vertices = mesh.vertices.size();
+ }
+ }
+ result.threads = result.stats.threads;
+
+ std::cout << "  tinyobjloader " << result.tinyobjMs << " ms (parse " << result.tinyobjParseMs << " ms), ImportObj "
+ << result.importSingleThreadMs << " ms on 1 thread, " << result.importMs << " ms on " << result.threads << std::endl;
+ std::cout << "  Mesh cache: cold " << result.cacheColdMs << " ms, warm " << result.cacheWarmMs << " ms (" << result.cacheBytes << " bytes)" << std::endl;
+
+ result.optimize.push_back(MeasureOptimize(path));
+ for (const std::filesystem::path& extra : config.optimizePaths) {
+ if (std::filesystem::is_regular_file(extra)) {
+ result.optimize.push_back(MeasureOptimize(extra));
+ }
+ }
+ return result;
+}
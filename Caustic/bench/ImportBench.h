@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Engine/mesh_cache.h"
+#include "Engine/mesh_importer.h"
+#include "Engine/mesh_optimizer.h"
+
+struct ImportBenchConfig
+{
+    std::filesystem::path objPath;     // empty: generate a grid mesh of `triangles` triangles
+    uint32_t triangles = 1000000;
+    uint32_t iterations = 3;           // best of; the first run also warms the page cache
+    // Also reported by the optimizer section, next to the benchmarked file
+    // (skipped when missing)
+    std::vector<std::filesystem::path> optimizePaths = { "models/fish.obj" };
+};
+
+struct MeshOptimizeResult
+{
+    std::string file;
+    size_t expandedVertices = 0;       // one vertex per face corner
+    size_t indexedVertices = 0;        // one per distinct v/vt/vn triple
+    veng::MeshOptimizeStats stats;     // OptimizeMesh on the indexed mesh, in file order
+};
+
+struct ImportBenchResult
+{
+    std::string file;
+    uint64_t fileBytes = 0;
+    size_t triangles = 0;
+    size_t vertices = 0;
+
+    double tinyobjParseMs = 0.0;       // tinyobj::LoadObj alone
+    double tinyobjMs = 0.0;            // LoadObj + deduplicated veng::Vertex/index arrays
+    double importSingleThreadMs = 0.0; // veng::ImportObj limited to one thread
+    double importMs = 0.0;             // veng::ImportObj on the whole pool
+    uint32_t threads = 0;
+    veng::ObjImportStats stats;        // of the fastest multithreaded run
+
+    // veng::LoadMesh through the binary cache, plus copying the vertex and
+    // index data out once (what creating the GPU buffers does)
+    double cacheColdMs = 0.0;          // import + cache write
+    double cacheWarmMs = 0.0;          // map + validate + copy
+    uint64_t cacheBytes = 0;
+
+    std::vector<MeshOptimizeResult> optimize;
+};
+
+// Times single-threaded tinyobjloader against veng::ImportObj on the same file,
+// then cold and warm loads through the mesh cache, and reports what
+// veng::OptimizeMesh does to vertex count and post-transform cache behaviour.
+// Both produce the same deduplicated vertex/index arrays (optimize off); the importer's
+// output is checked against tinyobjloader's before any timing is reported.
+ImportBenchResult RunImportBenchmark(const ImportBenchConfig& config);
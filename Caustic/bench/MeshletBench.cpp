@@ -0,0 +1,148 @@
+#include "MeshletBench.h"
+
+#include "Engine/meshlet.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point start)
+{
+ return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct ViewDirection {
+ const char* name;
+ glm::vec3 direction;
+};
+
+const std::array<ViewDirection,10> kViews = { {
+ { "+x", glm::vec3(1.0f,0.0f,0.0f) },
+ { "-x", glm::vec3(-1.0f,0.0f,0.0f) },
+ { "+y", glm::vec3(0.0f,1.0f,0.0f) },
+ { "-y", glm::vec3(0.0f, -1.0f,0.0f) },
+ { "+z", glm::vec3(0.0f,0.0f,1.0f) },
+ { "-z", glm::vec3(0.0f,0.0f, -1.0f) },
+ { "+x+y+z", glm::vec3(1.0f,1.0f,1.0f) },
+ { "-x+y-z", glm::vec3(-1.0f,1.0f, -1.0f) },
+ { "+x-y+z", glm::vec3(1.0f, -1.0f,1.0f) },
+ { "-x-y-z", glm::vec3(-1.0f, -1.0f, -1.0f) },
+} };
+
+} // namespace
+
+MeshletBenchResult RunMeshletBenchmark(const MeshletBenchConfig& config)
+{
+ veng::ObjImportOptions options;
+ options.normalsAsColor = true;
+ const veng::MeshData mesh = veng::ImportObj(config.file, options);
+
+ MeshletBenchResult result;
+ result.file = config.file.string();
+ result.triangles = mesh.indices.size() /3;
+
+ const auto buildStart = Clock::now();
+ const veng::MeshletMesh meshlets = veng::BuildMeshlets(mesh.vertices, mesh.indices);
+ result.buildMs = MillisecondsSince(buildStart);
+ result.meshlets = static_cast<uint32_t>(meshlets.meshlets.size());
+ if (result.meshlets ==0) {
+ throw std::runtime_error("No triangles in " + result.file);
+ }
+ for (const veng::Meshlet& meshlet : meshlets.meshlets) {
+ result.avgVertices += meshlet.vertexCount;
+ result.avgTriangles += meshlet.triangleCount;
+ result.cones += meshlet.bounds.coneCutoff <1.0f ?1 :0;
+ }
+ result.avgVertices /= result.meshlets;
+ result.avgTriangles /= result.meshlets;
+ std::cout << "  Meshlets: " << result.meshlets << " from " << result.triangles << " triangles in " << result.buildMs << " ms, "
+  << result.avgVertices << " vertices and " << result.avgTriangles << " triangles each" << std::endl;
+
+ // The same bounds without cones tell frustum and cone culling apart
+ veng::ClusterCullingSet spheres;
+ spheres.Reserve(result.meshlets);
+ for (const veng::Meshlet& meshlet : meshlets.meshlets) {
+ veng::ClusterBounds bounds = meshlet.bounds;
+ bounds.coneCutoff =1.0f;
+ spheres.Add(bounds);
+ }
+
+ // Framed like the bench scenes: the bounding sphere fills a 45 degree view
+ glm::vec3 min = mesh.vertices.front().position;
+ glm::vec3 max = min;
+ for (const veng::Vertex& vertex : mesh.vertices) {
+ min = glm::min(min, vertex.position);
+ max = glm::max(max, vertex.position);
+ }
+ const glm::vec3 center = (min + max) *0.5f;
+ const float radius = glm::length(max - min) *0.5f;
+ const float verticalFOV = glm::radians(45.0f);
+ const float distance = radius / std::tan(verticalFOV *0.5f) *1.1f;
+ glm::mat4 projection = glm::perspective(verticalFOV,16.0f /9.0f,0.01f * radius, distance + radius *2.0f);
+ projection[1][1] *= -1.0f;
+
+ std::vector<uint32_t> visible;
+ std::vector<uint32_t> inFrustum;
+ std::vector<uint32_t> reference;
+ for (const ViewDirection& view : kViews) {
+ const glm::vec3 direction = glm::normalize(view.direction);
+ const glm::vec3 camera = center + direction * distance;
+ const glm::vec3 up = std::abs(direction.z) >0.9f ? glm::vec3(0.0f,1.0f,0.0f) : glm::vec3(0.0f,0.0f,1.0f);
+ const veng::Frustum frustum = veng::Frustum::FromViewProjection(projection * glm::lookAt(camera, center, up));
+
+ MeshletViewResult viewResult;
+ viewResult.view = view.name;
+ visible.clear();
+ inFrustum.clear();
+ viewResult.visibleMeshlets = veng::CullClusters(frustum, camera, meshlets.cullingSet, visible);
+ const uint32_t insideFrustum = veng::CullClusters(frustum, camera, spheres, inFrustum);
+ viewResult.frustumCulled = result.meshlets - insideFrustum;
+ viewResult.backfacing = insideFrustum - viewResult.visibleMeshlets;
+ for (uint32_t index : visible) {
+ viewResult.trianglesDrawn += meshlets.meshlets[index].triangleCount;
+ }
+ viewResult.culledTriangleRatio =1.0 - static_cast<double>(viewResult.trianglesDrawn) / static_cast<double>(result.triangles);
+ std::cout << "  Meshlets from " << view.name << ": " << viewResult.visibleMeshlets << " visible, " << viewResult.backfacing << " backfacing, "
+  << viewResult.frustumCulled << " outside; " << viewResult.culledTriangleRatio *100.0 << "% of triangles culled" << std::endl;
+ result.views.push_back(viewResult);
+ }
+
+ // Timed from the first view
+ const glm::vec3 direction = glm::normalize(kViews[0].direction);
+ const glm::vec3 camera = center + direction * distance;
+ const veng::Frustum frustum = veng::Frustum::FromViewProjection(projection * glm::lookAt(camera, center, glm::vec3(0.0f,0.0f,1.0f)));
+ reference.clear();
+ veng::CullClusters(frustum, camera, meshlets.cullingSet, reference, veng::CullKernel::Scalar);
+ for (veng::CullKernel kernel : { veng::CullKernel::Scalar, veng::CullKernel::Sse, veng::CullKernel::Avx, veng::CullKernel::Neon }) {
+ if (!veng::IsCullKernelSupported(kernel)) {
+ continue;
+ }
+
+ visible.clear();
+ veng::CullClusters(frustum, camera, meshlets.cullingSet, visible, kernel);
+ if (visible != reference) {
+ throw std::runtime_error(std::string("Cluster culling kernel ") + veng::GetCullKernelName(kernel) + " disagrees with the scalar kernel");
+ }
+
+ MeshletKernelResult timing;
+ timing.kernel = kernel;
+ timing.microseconds =1e30;
+ for (uint32_t i =0; i < std::max(1u, config.iterations); ++i) {
+ visible.clear();
+ const auto start = Clock::now();
+ veng::CullClusters(frustum, camera, meshlets.cullingSet, visible, kernel);
+ timing.microseconds = std::min(timing.microseconds, MillisecondsSince(start) *1000.0);
+ }
+ std::cout << "  CullClusters " << veng::GetCullKernelName(kernel) << ": " << timing.microseconds << " us" << std::endl;
+ result.kernels.push_back(timing);
+ }
+ return result;
+}
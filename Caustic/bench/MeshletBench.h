@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Engine/culling.h"
+
+struct MeshletBenchConfig
+{
+    std::filesystem::path file = "models/fish.obj";
+    uint32_t iterations = 100;         // best of, per kernel
+};
+
+// One camera looking at the mesh center from outside its bounding sphere
+struct MeshletViewResult
+{
+    std::string view;                  // direction the camera sits in, e.g. "+x"
+    uint32_t visibleMeshlets = 0;
+    uint32_t frustumCulled = 0;        // meshlets outside the frustum
+    uint32_t backfacing = 0;           // meshlets inside it whose normal cone faces away
+    uint64_t trianglesDrawn = 0;
+    double culledTriangleRatio = 0.0;  // of all triangles
+};
+
+struct MeshletKernelResult
+{
+    veng::CullKernel kernel = veng::CullKernel::Scalar;
+    double microseconds = 0.0;         // fastest CullClusters call over every meshlet
+};
+
+struct MeshletBenchResult
+{
+    std::string file;
+    uint64_t triangles = 0;
+    uint32_t meshlets = 0;
+    double avgVertices = 0.0;          // per meshlet
+    double avgTriangles = 0.0;
+    uint32_t cones = 0;                // meshlets with a usable normal cone
+    double buildMs = 0.0;
+    std::vector<MeshletViewResult> views;
+    std::vector<MeshletKernelResult> kernels;
+};
+
+// Splits `file` with veng::BuildMeshlets and reports, from each axis and a
+// few diagonals, how many triangles frustum and normal cone culling drop.
+// Each kernel's visible list is checked against the scalar one before timing.
+MeshletBenchResult RunMeshletBenchmark(const MeshletBenchConfig& config);
@@ -0,0 +1,89 @@
+#include "SceneGraphBench.h"
+
+#include "Engine/scene_graph.h"
+#include "Engine/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point start)
+{
+ return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+SceneGraphBenchResult RunSceneGraphBenchmark(const SceneGraphBenchConfig& config)
+{
+ std::mt19937 random(1234);
+ std::uniform_real_distribution<float> offset(-1.0f,1.0f);
+ auto randomTransform = [&]() {
+ veng::Transform transform;
+ transform.translation = glm::vec3(offset(random), offset(random), offset(random));
+ transform.rotation = glm::angleAxis(offset(random) *3.14159f, glm::normalize(glm::vec3(offset(random), offset(random),2.0f)));
+ transform.scale = glm::vec3(1.0f +0.1f * offset(random));
+ return transform;
+ };
+
+ // Every 1000th node is a root, the rest fill the tree level by level
+ const uint32_t roots = std::max(1u, config.nodes /1000);
+ std::vector<veng::Transform> transforms(config.nodes);
+ for (veng::Transform& transform : transforms) {
+ transform = randomTransform();
+ }
+
+ veng::SceneGraph graph;
+ std::vector<veng::NodeHandle> nodes;
+ nodes.reserve(config.nodes);
+ const auto buildStart = Clock::now();
+ graph.Reserve(config.nodes);
+ for (uint32_t i =0; i < config.nodes; ++i) {
+ const veng::NodeHandle parent = i < roots ? veng::NodeHandle{} : nodes[(i - roots) / std::max(1u, config.children)];
+ nodes.push_back(graph.AddNode(transforms[i], parent));
+ }
+ graph.Update();
+ SceneGraphBenchResult result;
+ result.buildMs = MillisecondsSince(buildStart);
+ result.nodes = config.nodes;
+ result.levels = graph.GetLastUpdateStats().levels;
+
+ auto best = [&](uint32_t maxThreads, const auto& prepare) {
+ double fastest =1e30;
+ for (uint32_t i =0; i < std::max(1u, config.iterations); ++i) {
+ prepare();
+ fastest = std::min(fastest, static_cast<double>(graph.Update(maxThreads).ms));
+ }
+ return fastest;
+ };
+ auto moveRoots = [&]() {
+ for (uint32_t i =0; i < roots; ++i) {
+ graph.SetLocal(nodes[i], randomTransform());
+ }
+ };
+ std::uniform_int_distribution<uint32_t> pick(0, config.nodes -1);
+ const uint32_t moved = std::max(1u, static_cast<uint32_t>(config.nodes * config.dirtyFraction));
+ auto moveSome = [&]() {
+ for (uint32_t i =0; i < moved; ++i) {
+ graph.SetLocal(nodes[pick(random)], randomTransform());
+ }
+ };
+
+ result.fullSingleThreadMs = best(1, moveRoots);
+ result.fullMs = best(0, moveRoots);
+ result.threads = graph.GetLastUpdateStats().threads;
+ result.partialMs = best(0, moveSome);
+ result.partialUpdated = graph.GetLastUpdateStats().updated;
+ result.cleanMs = best(0, []() {});
+
+ std::cout << "  Scene graph: " << result.nodes << " nodes in " << result.levels << " levels, built in " << result.buildMs << " ms" << std::endl;
+ std::cout << "  Full update " << result.fullSingleThreadMs << " ms on 1 thread, " << result.fullMs << " ms on " << result.threads
+  << "; partial (" << result.partialUpdated << " nodes) " << result.partialMs << " ms; clean " << result.cleanMs << " ms" << std::endl;
+ return result;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+struct SceneGraphBenchConfig
+{
+    uint32_t nodes = 1000000;
+    uint32_t children = 4;             // per node; fills the tree breadth first
+    uint32_t iterations = 10;          // best of
+    double dirtyFraction = 0.01;       // nodes moved before each partial update
+};
+
+struct SceneGraphBenchResult
+{
+    uint32_t nodes = 0;
+    uint32_t levels = 0;
+    uint32_t threads = 0;              // used by the multithreaded updates
+    double buildMs = 0.0;              // AddNode for every node, then the first Update
+    double fullSingleThreadMs = 0.0;   // every root moved, one thread
+    double fullMs = 0.0;               // every root moved, the whole pool
+    double partialMs = 0.0;            // `dirtyFraction` of the nodes moved, whole pool
+    uint32_t partialUpdated = 0;       // world matrices recomputed by a partial update
+    double cleanMs = 0.0;              // nothing moved
+};
+
+// Builds a veng::SceneGraph of `nodes` nodes and times world matrix updates
+// with everything, a few random subtrees and nothing dirty.
+SceneGraphBenchResult RunSceneGraphBenchmark(const SceneGraphBenchConfig& config);
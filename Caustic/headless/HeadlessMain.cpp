@@ -0,0 +1,61 @@
+#include "Walnut/Application.h"
+#include "Walnut/EntryPoint.h"
+
+#include "HeadlessRenderLayer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static void PrintUsage()
+{
+	std::cout << "Usage: Caustic-Headless [options]\n"
+		<< "  --frames <n>        frames to render (default 60)\n"
+		<< "  --width <px>        render width (default 1280)\n"
+		<< "  --height <px>       render height (default 720)\n"
+		<< "  --output <dir>      directory for frame_NNNNN.ppm files (default renders)\n"
+		<< "  --no-output         read frames back but do not write them\n"
+		<< "  --device <name>     prefer the device whose name contains <name>, e.g. llvmpipe\n"
+		<< "  --validation        enable VK_LAYER_KHRONOS_validation\n";
+}
+
+Walnut::Application* Walnut::CreateApplication(int argc, char** argv)
+{
+	HeadlessRenderSettings settings;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (std::strcmp(arg, "--frames") == 0 && hasValue)
+			settings.frames = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(arg, "--width") == 0 && hasValue)
+			settings.width = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(arg, "--height") == 0 && hasValue)
+			settings.height = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(arg, "--output") == 0 && hasValue)
+			settings.outputDirectory = argv[++i];
+		else if (std::strcmp(arg, "--no-output") == 0)
+			settings.writeFrames = false;
+		else if (std::strcmp(arg, "--device") == 0 && hasValue)
+			settings.device.preferredDevice = argv[++i];
+		else if (std::strcmp(arg, "--validation") == 0)
+			settings.device.validation = true;
+		else
+		{
+			std::cout << "Unknown argument: " << arg << "\n";
+			PrintUsage();
+		}
+	}
+
+	Walnut::ApplicationSpecification spec;
+	spec.Name = "Caustic Headless";
+	spec.Width = settings.width;
+	spec.Height = settings.height;
+
+	Walnut::Application* app = new Walnut::Application(spec);
+	app->PushLayer(std::make_shared<HeadlessRenderLayer>(settings));
+	return app;
+}
@@ -0,0 +1,190 @@
+#include "HeadlessRenderLayer.h"
+
+#include "Walnut/Application.h"
+#include "Walnut/Profiler.h"
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+HeadlessRenderLayer::HeadlessRenderLayer(const HeadlessRenderSettings& settings)
+ : m_Settings(settings)
+{
+}
+
+HeadlessRenderLayer::~HeadlessRenderLayer()
+{
+ OnDetach();
+}
+
+void HeadlessRenderLayer::OnAttach()
+{
+ try {
+ m_Device = std::make_unique<veng::HeadlessDevice>(m_Settings.device);
+ std::cout << "Headless device: " << m_Device->GetProperties().deviceName << std::endl;
+
+ m_Graphics = std::make_unique<veng::WalnutGraphics>();
+ if (!m_Graphics->Initialize(m_Device->Get())) {
+ throw std::runtime_error("Failed to initialize Vulkan graphics engine");
+ }
+ m_Graphics->Resize(m_Settings.width, m_Settings.height);
+
+ if (m_Settings.writeFrames) {
+ std::filesystem::create_directories(m_Settings.outputDirectory);
+ }
+ m_Graphics->SetReadbackCallback([this](const veng::ReadbackFrame& frame) { WriteFrame(frame); });
+
+ CreateScene();
+ SetCamera();
+ // Frame 0 should already show the mesh, not just the clear color
+ m_Graphics->WaitForUploads(m_Graphics->GetPendingUploadTicket());
+ } catch (const std::exception& e) {
+ std::cerr << "Headless renderer failed to start: " << e.what() << std::endl;
+ m_Finished = true;
+ Walnut::Application::Get().Close();
+ }
+}
+
+void HeadlessRenderLayer::OnDetach()
+{
+ if (!m_Graphics) {
+ return;
+ }
+ m_Graphics->SetReadbackCallback({});
+ if (m_VertexBuffer.buffer != VK_NULL_HANDLE) {
+ m_Graphics->DestroyBuffer(m_VertexBuffer);
+ m_VertexBuffer = {};
+ }
+ if (m_IndexBuffer.buffer != VK_NULL_HANDLE) {
+ m_Graphics->DestroyBuffer(m_IndexBuffer);
+ m_IndexBuffer = {};
+ }
+ m_Graphics.reset();
+ m_Device.reset();
+}
+
+void HeadlessRenderLayer::OnUpdate(float ts)
+{
+ if (m_Finished) {
+ return;
+ }
+
+ if (m_FramesSubmitted ==0) {
+ m_RenderStart = std::chrono::steady_clock::now();
+ }
+
+ try {
+ if (m_Graphics->BeginFrame()) {
+ // Animate by frame index rather than time so runs are reproducible
+ const float angle = m_Settings.rotationPerFrame * static_cast<float>(m_FramesSubmitted);
+ m_Graphics->SetModelMatrix(glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f,0.0f,1.0f)));
+ m_Graphics->RenderIndexedBuffer(m_VertexBuffer, m_IndexBuffer,12);
+ m_Graphics->EndFrame();
+ ++m_FramesSubmitted;
+ }
+ } catch (const std::exception& e) {
+ // Unlike the viewport there is nobody to retry for; stop the batch
+ std::cerr << "Rendering error: " << e.what() << std::endl;
+ m_Finished = true;
+ Walnut::Application::Get().Close();
+ return;
+ }
+
+ if (m_FramesSubmitted >= m_Settings.frames) {
+ Finish();
+ }
+}
+
+void HeadlessRenderLayer::CreateScene()
+{
+ // Same two quads as the interactive viewport
+ std::array<veng::Vertex,8> vertices = {
+     veng::Vertex{glm::vec3{-0.7f, -0.7f, -0.1f}, glm::vec3{1.0f, 0.0f, 0.0f}, glm::vec2{0.0f, 1.0f}}, // Red
+     veng::Vertex{glm::vec3{ 0.0f, -0.7f, -0.1f}, glm::vec3{1.0f, 0.0f, 0.0f}, glm::vec2{1.0f, 1.0f}},
+     veng::Vertex{glm::vec3{ 0.0f,  0.0f, -0.1f}, glm::vec3{1.0f, 0.0f, 0.0f}, glm::vec2{1.0f, 0.0f}},
+     veng::Vertex{glm::vec3{-0.7f,  0.0f, -0.1f}, glm::vec3{1.0f, 0.0f, 0.0f}, glm::vec2{0.0f, 0.0f}},
+     veng::Vertex{glm::vec3{ 0.0f, 0.0f, 0.1f }, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{0.0f, 1.0f}}, // Blue
+     veng::Vertex{glm::vec3{ 0.7f, 0.0f, 0.1f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{1.0f, 1.0f}},
+     veng::Vertex{glm::vec3{ 0.7f, 0.7f, 0.1f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{1.0f, 0.0f}},
+     veng::Vertex{glm::vec3{ 0.0f, 0.7f, 0.1f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{0.0f, 0.0f}}
+ };
+ std::array<std::uint32_t,12> indices = {
+0,1,2,
+2,3,0,
+4,5,6,
+6,7,4
+ };
+
+ m_VertexBuffer = m_Graphics->CreateVertexBuffer(vertices);
+ m_IndexBuffer = m_Graphics->CreateIndexBuffer(indices);
+}
+
+void HeadlessRenderLayer::SetCamera()
+{
+ const float aspectRatio = static_cast<float>(m_Settings.width) / static_cast<float>(m_Settings.height);
+
+ glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspectRatio,0.1f,100.0f);
+ projection[1][1] *= -1.0f; // Flip Y for Vulkan
+
+ // Z-up, looking at the origin from the same diagonal as the viewport camera
+ glm::mat4 view = glm::lookAt(glm::vec3(2.0f,2.0f,2.0f), glm::vec3(0.0f), glm::vec3(0.0f,0.0f,1.0f));
+ m_Graphics->SetViewProjection(view, projection);
+}
+
+void HeadlessRenderLayer::WriteFrame(const veng::ReadbackFrame& frame)
+{
+ WL_PROFILE_FUNC();
+ ++m_FramesWritten;
+ if (!m_Settings.writeFrames) {
+ return;
+ }
+
+ char name[32];
+ std::snprintf(name, sizeof(name), "frame_%05llu.ppm", static_cast<unsigned long long>(frame.frameIndex));
+ std::filesystem::path path = m_Settings.outputDirectory / name;
+
+ std::ofstream file(path, std::ios::binary);
+ if (!file) {
+ std::cerr << "Failed to write " << path.string() << std::endl;
+ return;
+ }
+
+ // Binary PPM: no image library needed on build machines; RGBA8 -> RGB8
+ file << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+ std::vector<uint8_t> row(static_cast<size_t>(frame.width) *3);
+ for (uint32_t y =0; y < frame.height; ++y) {
+ const uint8_t* src = frame.pixels + static_cast<size_t>(y) * frame.rowPitch;
+ for (uint32_t x =0; x < frame.width; ++x) {
+ row[x *3 +0] = src[x *4 +0];
+ row[x *3 +1] = src[x *4 +1];
+ row[x *3 +2] = src[x *4 +2];
+ }
+ file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+ }
+}
+
+void HeadlessRenderLayer::Finish()
+{
+ // The last MAX_FRAMES_IN_FLIGHT frames are still in flight; their copies
+ // are only delivered once their fences are waited on
+ m_Graphics->FlushReadbacks();
+ m_Finished = true;
+
+ const double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_RenderStart).count();
+ std::cout << "Rendered " << m_FramesSubmitted << " frames at " << m_Settings.width << "x" << m_Settings.height
+ << " in " << totalMs << " ms (" << totalMs / m_FramesSubmitted << " ms/frame), "
+ << m_FramesWritten << " read back";
+ if (m_Settings.writeFrames) {
+ std::cout << " to " << m_Settings.outputDirectory.string();
+ }
+ std::cout << std::endl;
+
+ for (const veng::GpuScopeStats& scope : m_Graphics->GetGpuTimings()) {
+ std::cout << "  GPU " << scope.name << ": avg " << scope.avgMs << " ms, p99 " << scope.p99Ms << " ms" << std::endl;
+ }
+
+ Walnut::Application::Get().Close();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Walnut/Layer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "Engine/WalnutGraphics.h"
+#include "Engine/graphics_device.h"
+#include "Engine/buffer_handle.h"
+
+struct HeadlessRenderSettings
+{
+    uint32_t frames = 60;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    std::filesystem::path outputDirectory = "renders";
+    bool writeFrames = true;           // false: render and read back, but skip the disk
+    float rotationPerFrame = 0.02f;    // radians around Z, so every frame differs
+    veng::HeadlessDeviceOptions device;
+};
+
+// Renders the default scene to the offscreen target for a fixed number of
+// frames without a window, writes every read back frame as a binary PPM and
+// closes the application when the last one is on disk.
+class HeadlessRenderLayer : public Walnut::Layer
+{
+public:
+    explicit HeadlessRenderLayer(const HeadlessRenderSettings& settings);
+    virtual ~HeadlessRenderLayer();
+
+    virtual void OnAttach() override;
+    virtual void OnDetach() override;
+    virtual void OnUpdate(float ts) override;
+
+private:
+    void CreateScene();
+    void SetCamera();
+    void WriteFrame(const veng::ReadbackFrame& frame);
+    void Finish();
+
+private:
+    HeadlessRenderSettings m_Settings;
+
+    // Declared before m_Graphics so the device outlives the renderer
+    std::unique_ptr<veng::HeadlessDevice> m_Device;
+    std::unique_ptr<veng::WalnutGraphics> m_Graphics;
+
+    veng::BufferHandle m_VertexBuffer;
+    veng::BufferHandle m_IndexBuffer;
+
+    uint32_t m_FramesSubmitted = 0;
+    uint64_t m_FramesWritten = 0;
+    bool m_Finished = false;
+    std::chrono::steady_clock::time_point m_RenderStart;
+};
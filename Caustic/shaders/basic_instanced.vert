@@ -0,0 +1,19 @@
+#version 450
+#include "common.glsl"
+
+layout(location = 0) in vec3 input_position;
+layout(location = 1) in vec3 input_color;
+layout(location = 2) in vec2 input_texcoord;
+
+// Per instance (vertex binding 1, see InstanceData)
+layout(location = 3) in mat4 instance_transformation;
+layout(location = 7) in vec4 instance_color;
+
+layout(location = 0) out vec4 vertex_color;
+layout(location = 1) out vec2 v_TexCoord;
+
+void main() {
+    gl_Position = camera.projection * camera.view * instance_transformation * vec4(input_position, 1.0);
+    vertex_color = vec4(input_color, 1.0) * instance_color;
+    v_TexCoord = input_texcoord;
+}
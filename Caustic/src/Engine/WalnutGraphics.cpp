@@ -2,17 +2,21 @@
 #include "utilities.h"
 #include "uniform_transformations.h"
 #include "vertex.h"
+#include "vertex_layout.h"
 #include "Walnut/Application.h"
+#include "Walnut/Profiler.h"
 
 #include "texture.h"
+#include "mesh_simplifier.h"
 
 #include <iostream>
 #include <fstream>
 #include <set>
 #include <cstring>
 #include <chrono>
-#include <windows.h>
+#include <algorithm>
 #include <filesystem>
+#include <type_traits>
 
 // stb image header included in texture.cpp where implementation exists in Walnut.lib
 #include "../../vendor/stb_image/stb_image.h"
@@ -40,23 +44,61 @@ WalnutGraphics::~WalnutGraphics() {
  Shutdown();
 }
 
+#ifndef WL_HEADLESS
 bool WalnutGraphics::Initialize() {
+ // Get Vulkan objects from Walnut; uploads go to a separate transfer queue
+ // when Walnut found one
+ auto& app = Walnut::Application::Get();
+ GraphicsDevice device{};
+ device.instance = app.GetInstance();
+ device.physicalDevice = app.GetPhysicalDevice();
+ device.device = app.GetDevice();
+ device.graphicsQueueFamily = app.GetQueueFamilyIndex();
+ device.graphicsQueue = app.GetQueue();
+ device.transferQueueFamily = app.GetTransferQueueFamilyIndex();
+ device.transferQueue = app.GetTransferQueue();
+ device.multiDrawIndirect = app.GetEnabledDeviceFeatures().multiDrawIndirect == VK_TRUE;
+ device.drawIndirectFirstInstance = app.GetEnabledDeviceFeatures().drawIndirectFirstInstance == VK_TRUE;
+ device.drawIndirectCount = Walnut::Application::HasDrawIndirectCount();
+ return Initialize(device);
+}
+#endif
+
+bool WalnutGraphics::Initialize(const GraphicsDevice& device) {
  if (m_Initialized) {
  return true;
  }
 
- // Get Vulkan objects from Walnut
- auto& app = Walnut::Application::Get();
- m_Instance = app.GetInstance();
- m_PhysicalDevice = app.GetPhysicalDevice();
- m_Device = app.GetDevice();
- 
- // Find graphics queue family
- uint32_t queueFamilyIndex = FindGraphicsQueueFamily();
- vkGetDeviceQueue(m_Device, queueFamilyIndex,0, &m_GraphicsQueue);
+ m_Instance = device.instance;
+ m_PhysicalDevice = device.physicalDevice;
+ m_Device = device.device;
+ m_GraphicsQueueFamily = device.graphicsQueueFamily;
+ m_GraphicsQueue = device.graphicsQueue;
+ m_TransferQueueFamily = device.transferQueueFamily;
+ m_TransferQueue = device.transferQueue;
+ m_MultiDrawIndirect = device.multiDrawIndirect;
+ m_DrawIndirectFirstInstance = device.drawIndirectFirstInstance;
+ m_DrawIndirectCount = device.drawIndirectCount;
+ VkPhysicalDeviceProperties properties{};
+ vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+ m_MaxDrawIndirectCount = m_MultiDrawIndirect ? std::max(properties.limits.maxDrawIndirectCount,1u) :1;
+ for (int i =0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+ m_InstanceBuffers[i].usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+ m_IndirectBuffers[i].usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+ }
 
  // Create our rendering resources
  try {
+ m_Allocator = std::make_unique<DeviceAllocator>(m_PhysicalDevice, m_Device, MAX_FRAMES_IN_FLIGHT);
+ m_Uploads = std::make_unique<UploadContext>(m_Device, *m_Allocator, m_GraphicsQueue, m_GraphicsQueueFamily, m_TransferQueue, m_TransferQueueFamily);
+ m_MeshPool = std::make_unique<MeshPool>(m_Device, *m_Allocator, *m_Uploads, MAX_FRAMES_IN_FLIGHT);
+ m_GpuProfiler = std::make_unique<GpuProfiler>(m_PhysicalDevice, m_Device, m_GraphicsQueueFamily, MAX_FRAMES_IN_FLIGHT);
+ m_RecordingPool = std::make_unique<ThreadPool>();
+ if (m_GpuProfiler->IsSupported()) {
+ m_Uploads->EnableGpuTiming(m_GpuProfiler->GetTimestampPeriod(), m_GpuProfiler->GetTimestampValidBits());
+ } else {
+ std::cout << "WARNING: Graphics queue has no timestamp support; GPU timings disabled" << std::endl;
+ }
  CreateRenderTargets();
  CreateRenderPass();
  CreateDescriptorSetLayout();
@@ -70,6 +112,7 @@ bool WalnutGraphics::Initialize() {
  CreateUniformBuffers();
  CreateDescriptorPool();
  CreateDescriptorSet();
+ CreateGpuCulling();
  } catch (const std::exception& e) {
  std::cerr << "Failed to initialize WalnutGraphics: " << e.what() << std::endl;
  return false;
@@ -106,9 +149,15 @@ void WalnutGraphics::Shutdown() {
  vkDestroyImage(m_Device, m_DefaultTextureImage, nullptr);
  m_DefaultTextureImage = VK_NULL_HANDLE;
  }
- if (m_DefaultTextureImageMemory != VK_NULL_HANDLE) {
- vkFreeMemory(m_Device, m_DefaultTextureImageMemory, nullptr);
- m_DefaultTextureImageMemory = VK_NULL_HANDLE;
+ if (m_Allocator) {
+ m_Allocator->Free(m_DefaultTextureImageMemory);
+ }
+
+ // Texture memory comes from the allocator, so it must go first
+ m_Texture.reset();
+ m_PendingTexture.reset();
+ for (auto& retired : m_RetiredTextures) {
+ retired.clear();
  }
 
  // Destroy graphics pipelines first
@@ -120,6 +169,10 @@ void WalnutGraphics::Shutdown() {
  vkDestroyPipeline(m_Device, m_PipelineNoCull, nullptr);
  m_PipelineNoCull = VK_NULL_HANDLE;
  }
+ if (m_InstancedPipeline != VK_NULL_HANDLE) {
+ vkDestroyPipeline(m_Device, m_InstancedPipeline, nullptr);
+ m_InstancedPipeline = VK_NULL_HANDLE;
+ }
 
  // Destroy pipeline layout
  if (m_PipelineLayout != VK_NULL_HANDLE) {
@@ -138,26 +191,46 @@ void WalnutGraphics::Shutdown() {
  vkDestroyRenderPass(m_Device, m_RenderPass, nullptr);
  m_RenderPass = VK_NULL_HANDLE;
  }
-
- // Destroy framebuffers
- if (m_Framebuffer != VK_NULL_HANDLE) {
- vkDestroyFramebuffer(m_Device, m_Framebuffer, nullptr);
- m_Framebuffer = VK_NULL_HANDLE;
+ if (m_LateRenderPass != VK_NULL_HANDLE) {
+ vkDestroyRenderPass(m_Device, m_LateRenderPass, nullptr);
+ m_LateRenderPass = VK_NULL_HANDLE;
  }
 
- // Destroy render targets (images + views + wrapper)
+ // Destroy render targets (framebuffers + images + views + wrapper)
  CleanupRenderTargets();
 
+ // The viewport descriptor sets belong to ImGui's pool; only the sampler is ours
+ if (m_ColorSampler != VK_NULL_HANDLE) {
+ vkDestroySampler(m_Device, m_ColorSampler, nullptr);
+ m_ColorSampler = VK_NULL_HANDLE;
+ }
+ for (auto& target : m_RenderTargets) {
+ target.viewportTexture = VK_NULL_HANDLE;
+ }
+
  // Destroy descriptor pool
  if (m_DescriptorPool != VK_NULL_HANDLE) {
  vkDestroyDescriptorPool(m_Device, m_DescriptorPool, nullptr);
  m_DescriptorPool = VK_NULL_HANDLE;
  }
 
- // Destroy uniform buffer
- if (m_UniformBuffer.buffer != VK_NULL_HANDLE) {
- DestroyBuffer(m_UniformBuffer);
+ // Destroy uniform buffers (descriptor sets were released with the pool)
+ for (int i =0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+ if (m_UniformBuffers[i].buffer != VK_NULL_HANDLE) {
+ DestroyBuffer(m_UniformBuffers[i]);
+ m_UniformBuffers[i] = {};
+ }
+ m_UniformBufferLocations[i] = nullptr;
+ m_DescriptorSets[i] = VK_NULL_HANDLE;
+ }
+
+ for (int i =0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+ DestroyStreamBuffers(m_InstanceBuffers[i]);
+ DestroyStreamBuffers(m_IndirectBuffers[i]);
  }
+ m_GpuCulling.reset();
+ m_DepthPyramid.reset();
+ m_MeshPool.reset();
 
  // Destroy synchronization objects
  for (auto fence : m_InFlightFences) {
@@ -167,39 +240,101 @@ void WalnutGraphics::Shutdown() {
  }
  m_InFlightFences.clear();
 
- for (auto sem : m_RenderFinishedSemaphores) {
- if (sem != VK_NULL_HANDLE) {
- vkDestroySemaphore(m_Device, sem, nullptr);
+ for (auto& contexts : m_RecordingContexts) {
+ for (RecordingContext& context : contexts) {
+ vkDestroyCommandPool(m_Device, context.pool, nullptr);
  }
+ contexts.clear();
  }
- m_RenderFinishedSemaphores.clear();
-
- for (auto sem : m_ImageAvailableSemaphores) {
- if (sem != VK_NULL_HANDLE) {
-vkDestroySemaphore(m_Device, sem, nullptr);
- }
- }
- m_ImageAvailableSemaphores.clear();
+ m_RecordingPool.reset();
 
  // Destroy command pool (which releases command buffers)
  if (m_CommandPool != VK_NULL_HANDLE) {
  m_CommandBuffers.clear();
+ m_CullCommandBuffers.clear();
+ m_SecondaryCommandBuffers.clear();
  vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
  m_CommandPool = VK_NULL_HANDLE;
  }
 
+ // Every block goes back to the device at once; all resources are gone by now
+ m_GpuProfiler.reset();
+ m_Uploads.reset();
+ m_Allocator.reset();
+
  m_Initialized = false;
 }
 
 bool WalnutGraphics::BeginFrame() {
+ WL_PROFILE_FUNC();
  if (!m_Initialized) {
  return false;
  }
 
- // Wait for previous frame using per-frame fence
+ if (m_PendingDisplayMode != m_DisplayMode || IsReadbackRequested() != m_ReadbackEnabled) {
+ m_DisplayMode = m_PendingDisplayMode;
+ RecreateRenderTargets();
+ }
+
+ // Sample how many submissions are still executing before we block: if the
+ // previous frame is still running while we start recording, CPU and GPU overlap.
+ uint32_t pending =0;
+ for (VkFence inFlight : m_InFlightFences) {
+ if (vkGetFenceStatus(m_Device, inFlight) == VK_NOT_READY) {
+ ++pending;
+ }
+ }
+ const uint32_t previousFrame = (m_CurrentFrame + MAX_FRAMES_IN_FLIGHT -1) % MAX_FRAMES_IN_FLIGHT;
+ m_FrameStats.gpuBusyAtBegin = vkGetFenceStatus(m_Device, m_InFlightFences[previousFrame]) == VK_NOT_READY;
+ m_FrameStats.framesInFlight = pending;
+
+ // Wait until this frame slot's previous submission (N - MAX_FRAMES_IN_FLIGHT) retired
+ auto waitStart = std::chrono::steady_clock::now();
  VkFence fence = m_InFlightFences[m_CurrentFrame];
+ {
+ WL_PROFILE_SCOPE("WaitForFrameFence");
  vkWaitForFences(m_Device,1, &fence, VK_TRUE, UINT64_MAX);
+ }
  vkResetFences(m_Device,1, &fence);
+ m_FrameRecordStart = std::chrono::steady_clock::now();
+ m_FrameStats.fenceWaitMs = std::chrono::duration<float, std::milli>(m_FrameRecordStart - waitStart).count();
+
+ // The slot is free: whatever it copied out MAX_FRAMES_IN_FLIGHT frames ago is
+ // now complete, and its uniform buffer can take this frame's camera
+ m_Allocator->BeginFrame(m_CurrentFrame);
+ ReleaseStreamBuffers(m_InstanceBuffers[m_CurrentFrame]);
+ ReleaseStreamBuffers(m_IndirectBuffers[m_CurrentFrame]);
+ m_MeshPool->BeginFrame(m_CurrentFrame);
+ m_GpuCulling->BeginFrame(m_CurrentFrame);
+ m_Uploads->Collect();
+ float uploadGpuMs =0.0f;
+ if (m_Uploads->ConsumeGpuTime(uploadGpuMs)) {
+ m_GpuProfiler->AddSample("Uploads", uploadGpuMs);
+ }
+ m_RetiredTextures[m_CurrentFrame].clear();
+ if (m_PendingTexture && m_Uploads->IsReady(m_PendingTextureTicket)) {
+ PromotePendingTexture();
+ }
+ if (m_TextureDescriptorStale[m_CurrentFrame]) {
+ m_Texture->WriteDescriptor(m_Device, m_DescriptorSets[m_CurrentFrame],1);
+ m_TextureDescriptorStale[m_CurrentFrame] = false;
+ }
+ DeliverReadback(m_RenderTargets[m_CurrentFrame]);
+ if (m_UniformBufferLocations[m_CurrentFrame]) {
+ std::memcpy(m_UniformBufferLocations[m_CurrentFrame], &m_Transformations, sizeof(UniformTransformations));
+ }
+
+ m_FrameStats.cullTested =0;
+ m_FrameStats.cullVisible =0;
+ m_FrameStats.cullMs =0.0f;
+ m_FrameStats.clustersTested =0;
+ m_FrameStats.clustersVisible =0;
+ m_FrameStats.triangles =0;
+ const GpuCullingStats gpuCulling = m_GpuCulling->GetStats();
+ m_FrameStats.gpuCullTested = gpuCulling.tested;
+ m_FrameStats.gpuCullVisible = gpuCulling.visible;
+ m_FrameStats.gpuCullLateVisible = gpuCulling.lateVisible;
+ m_GpuCullingZeroCommands = false;
 
  BeginCommands();
  // Increment frame count for our limited logging
@@ -208,89 +343,116 @@ bool WalnutGraphics::BeginFrame() {
 }
 
 void WalnutGraphics::EndFrame() {
+ WL_PROFILE_FUNC();
  if (!m_Initialized) {
  return;
  }
 
  EndCommands();
 
- // Submit command buffer for the current frame
- VkCommandBuffer cmd = m_CommandBuffers[m_CurrentFrame];
+ // Anything uploaded since the last frame goes first so this frame can use it
+ m_Uploads->Submit();
+
+ // Submit command buffer for the current frame. GPU culling goes first in
+ // the same batch: recorded only now, it sees the frame's final camera and
+ // the draws recorded earlier wait for it through its barrier.
+ std::array<VkCommandBuffer,2> commandBuffers = { m_CullCommandBuffers[m_CurrentFrame], m_CommandBuffers[m_CurrentFrame] };
+ uint32_t firstCommandBuffer =1;
+ if (m_GpuCulling->IsPrepared()) {
+ VkCommandBuffer cullCmd = commandBuffers[0];
+ vkResetCommandBuffer(cullCmd,0);
+ VkCommandBufferBeginInfo beginInfo{};
+ beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+ beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+ vkBeginCommandBuffer(cullCmd, &beginInfo);
+ m_DepthPyramid->RecordInitialLayout(cullCmd);
+ m_GpuCulling->RecordCulling(cullCmd, m_FrustumCulling, m_GpuCullingZeroCommands);
+ vkEndCommandBuffer(cullCmd);
+ firstCommandBuffer =0;
+ }
 
  VkSubmitInfo submitInfo{};
  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
- // Wait semaphores
- VkSemaphore waitSemaphores[] = { m_ImageAvailableSemaphores[m_CurrentFrame] };
- VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
- submitInfo.waitSemaphoreCount =1;
- submitInfo.pWaitSemaphores = waitSemaphores;
- submitInfo.pWaitDstStageMask = waitStages;
-
- submitInfo.commandBufferCount =1;
- submitInfo.pCommandBuffers = &cmd;
-
- // Signal semaphores
- VkSemaphore signalSemaphores[] = { m_RenderFinishedSemaphores[m_CurrentFrame] };
- submitInfo.signalSemaphoreCount =1;
- submitInfo.pSignalSemaphores = signalSemaphores;
+ submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size()) - firstCommandBuffer;
+ submitInfo.pCommandBuffers = commandBuffers.data() + firstCommandBuffer;
 
  VkFence fence = m_InFlightFences[m_CurrentFrame];
 
+ {
+ WL_PROFILE_SCOPE("vkQueueSubmit");
  if (vkQueueSubmit(m_GraphicsQueue,1, &submitInfo, fence) != VK_SUCCESS) {
  std::cout << "ERROR: Failed to submit draw command buffer" << std::endl;
  }
- 
- // Wait for rendering to complete for copying to Walnut::Image
- vkWaitForFences(m_Device,1, &fence, VK_TRUE, UINT64_MAX);
- 
- // Copy the rendered Vulkan image to Walnut::Image for display
- if (m_RenderedImage && m_ColorImage != VK_NULL_HANDLE) {
- // Create a staging buffer to read the image data
- VkBuffer stagingBuffer;
- VkDeviceMemory stagingBufferMemory;
- VkDeviceSize imageSize = m_RenderWidth * m_RenderHeight *4; // RGBA
- // Create staging buffer
+ }
+
+ m_FrameStats.cpuRecordMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_FrameRecordStart).count();
+ ++m_FrameStats.totalFrames;
+ if (m_FrameStats.gpuBusyAtBegin) {
+ ++m_FrameStats.overlappedFrames;
+ }
+
+ m_FrameStats.readbackAllocations = m_ReadbackAllocationCount - m_ReadbackAllocationsAtFrameStart;
+ m_ReadbackAllocationsAtFrameStart = m_ReadbackAllocationCount;
+
+ // ImGui samples this frame's color target directly; the render pass
+ // dependencies order its reads after this submission on the same queue, so
+ // the host never waits here. CPU copies are picked up by BeginFrame once
+ // this slot comes around again.
+ m_DisplayFrame = m_CurrentFrame;
+
+ // Advance frame index
+ m_CurrentFrame = (m_CurrentFrame +1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+bool WalnutGraphics::IsReadbackRequested() const {
+ return m_PendingDisplayMode == DisplayMode::CpuReadback || static_cast<bool>(m_ReadbackCallback);
+}
+
+void WalnutGraphics::SetReadbackCallback(ReadbackCallback callback) {
+ m_ReadbackCallback = std::move(callback);
+}
+
+// Persistently mapped destination for this target's color copy. Prefers cached
+// host memory since the CPU reads every byte; non-coherent memory is
+// invalidated before each read in DeliverReadback.
+void WalnutGraphics::CreateReadbackBuffer(RenderTarget& target) {
  VkBufferCreateInfo bufferInfo{};
  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
- bufferInfo.size = imageSize;
+ bufferInfo.size = static_cast<VkDeviceSize>(m_RenderWidth) * m_RenderHeight *4; // RGBA8
  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
- 
- if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &stagingBuffer) == VK_SUCCESS) {
- VkMemoryRequirements memRequirements;
- vkGetBufferMemoryRequirements(m_Device, stagingBuffer, &memRequirements);
- 
- VkMemoryAllocateInfo allocInfo{};
- allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
- allocInfo.allocationSize = memRequirements.size;
- allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
- 
- if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &stagingBufferMemory) == VK_SUCCESS) {
- vkBindBufferMemory(m_Device, stagingBuffer, stagingBufferMemory,0);
- 
- // Copy image to staging buffer
- VkCommandBuffer copyCmd = BeginTransientCommandBuffer();
- 
- // Transition image layout for copying
+
+ if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &target.readbackBuffer.buffer) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create readback buffer!");
+ }
+
+ target.readbackBuffer.allocation = m_Allocator->AllocateForBuffer(target.readbackBuffer.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+ AllocationLifetime::Persistent, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+ ++m_ReadbackAllocationCount;
+}
+
+// Copy the finished color target into its readback buffer as part of the
+// frame's own command buffer; no extra submission and no host wait.
+void WalnutGraphics::RecordReadback(VkCommandBuffer cmd, RenderTarget& target) {
  VkImageMemoryBarrier barrier{};
  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
  barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
- barrier.image = m_ColorImage;
+ barrier.image = target.colorImage;
  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
  barrier.subresourceRange.baseMipLevel =0;
  barrier.subresourceRange.levelCount =1;
  barrier.subresourceRange.baseArrayLayer =0;
  barrier.subresourceRange.layerCount =1;
- barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+ // The render pass' outgoing dependency already made the color writes
+ // available to the transfer stage.
+ barrier.srcAccessMask =0;
  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
- 
- vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,0,0, nullptr,0, nullptr,1, &barrier);
- 
- // Copy image to buffer
+
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,0,0, nullptr,0, nullptr,1, &barrier);
+
  VkBufferImageCopy region{};
  region.bufferOffset =0;
  region.bufferRowLength =0;
@@ -301,51 +463,76 @@ void WalnutGraphics::EndFrame() {
  region.imageSubresource.layerCount =1;
  region.imageOffset = {0,0,0};
  region.imageExtent = { m_RenderWidth, m_RenderHeight,1 };
- 
- vkCmdCopyImageToBuffer(copyCmd, m_ColorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer,1, &region);
- 
- // Transition back
+
+ vkCmdCopyImageToBuffer(cmd, target.colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.readbackBuffer.buffer,1, &region);
+
+ // Back to the layout ImGui samples from
  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
  barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
- 
- vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,0,0, nullptr,0, nullptr,1, &barrier);
- 
- EndTransientCommandBuffer(copyCmd);
- 
- // Map and copy data
- void* data;
- if (vkMapMemory(m_Device, stagingBufferMemory, 0, imageSize, 0, &data) == VK_SUCCESS) {
- // Quick debug: scan the first N pixels and report how many are non-zero
- const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
- size_t pixelCount = static_cast<size_t>(m_RenderWidth) * static_cast<size_t>(m_RenderHeight);
- size_t samples = std::min<size_t>(pixelCount,1024);
- size_t nonZero =0;
- for (size_t i =0; i < samples; ++i) {
- const uint8_t* p = bytes + i *4;
- if (p[0] !=0 || p[1] !=0 || p[2] !=0 || p[3] !=0) {
- ++nonZero;
- }
- }
 
- m_RenderedImage->SetData(data);
- vkUnmapMemory(m_Device, stagingBufferMemory);
+ // Make the copied bytes visible to the host once the frame fence signals
+ VkBufferMemoryBarrier hostBarrier{};
+ hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+ hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+ hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+ hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+ hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+ hostBarrier.buffer = target.readbackBuffer.buffer;
+ hostBarrier.offset =0;
+ hostBarrier.size = VK_WHOLE_SIZE;
+
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,0,0, nullptr,0, nullptr,1, &barrier);
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,0,0, nullptr,1, &hostBarrier,0, nullptr);
+
+ target.readbackPending = true;
+ target.readbackFrameIndex = m_FrameStats.totalFrames;
+}
+
+// Hand a completed copy to its consumers. Only called after the target's frame
+// fence has signaled, so the mapped bytes are final.
+void WalnutGraphics::DeliverReadback(RenderTarget& target) {
+ if (!target.readbackPending || !target.readbackBuffer.allocation.mapped) {
+ return;
  }
- 
- // Cleanup
- vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
- vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
+ target.readbackPending = false;
+
+ m_Allocator->Invalidate(target.readbackBuffer.allocation);
+
+ ReadbackFrame frame{};
+ frame.pixels = static_cast<const uint8_t*>(target.readbackBuffer.allocation.mapped);
+ frame.width = m_RenderWidth;
+ frame.height = m_RenderHeight;
+ frame.rowPitch = m_RenderWidth *4;
+ frame.frameIndex = target.readbackFrameIndex;
+
+#ifndef WL_HEADLESS
+ if (m_DisplayMode == DisplayMode::CpuReadback && m_RenderedImage) {
+ m_RenderedImage->SetData(frame.pixels);
  }
+#endif
+ if (m_ReadbackCallback) {
+ m_ReadbackCallback(frame);
  }
+ ++m_FrameStats.readbackFramesDelivered;
+}
+
+// Wait for every submitted frame and deliver the copies still pending, oldest
+// first. Offscreen runs call this after their last EndFrame, since no later
+// BeginFrame will come around to pick those copies up.
+void WalnutGraphics::FlushReadbacks() {
+ if (!m_Initialized) {
+ return;
  }
 
- // Advance frame index
- m_CurrentFrame = (m_CurrentFrame +1) % MAX_FRAMES_IN_FLIGHT;
+ vkWaitForFences(m_Device, static_cast<uint32_t>(m_InFlightFences.size()), m_InFlightFences.data(), VK_TRUE, UINT64_MAX);
+ for (uint32_t i =0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+ DeliverReadback(m_RenderTargets[(m_CurrentFrame + i) % MAX_FRAMES_IN_FLIGHT]);
+ }
 }
 
-// Placeholder implementations - you'll need to implement these based on your original graphics.cpp
-void WalnutGraphics::CreateRenderTargets() {
+void WalnutGraphics::CreateRenderTarget(RenderTarget& target) {
  // Create color image
  VkImageCreateInfo colorImageInfo{};
  colorImageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -358,33 +545,21 @@ void WalnutGraphics::CreateRenderTargets() {
  colorImageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
  colorImageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
  colorImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
- colorImageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+ colorImageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
  colorImageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
  colorImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
- if (vkCreateImage(m_Device, &colorImageInfo, nullptr, &m_ColorImage) != VK_SUCCESS) {
+ if (vkCreateImage(m_Device, &colorImageInfo, nullptr, &target.colorImage) != VK_SUCCESS) {
  throw std::runtime_error("Failed to create color image!");
  }
 
  // Allocate memory for color image
- VkMemoryRequirements colorMemRequirements;
- vkGetImageMemoryRequirements(m_Device, m_ColorImage, &colorMemRequirements);
-
- VkMemoryAllocateInfo colorAllocInfo{};
- colorAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
- colorAllocInfo.allocationSize = colorMemRequirements.size;
- colorAllocInfo.memoryTypeIndex = FindMemoryType(colorMemRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
- if (vkAllocateMemory(m_Device, &colorAllocInfo, nullptr, &m_ColorImageMemory) != VK_SUCCESS) {
- throw std::runtime_error("Failed to allocate color image memory!");
- }
-
- vkBindImageMemory(m_Device, m_ColorImage, m_ColorImageMemory,0);
+ target.colorImageMemory = m_Allocator->AllocateForImage(target.colorImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
  // Create color image view
  VkImageViewCreateInfo colorViewInfo{};
  colorViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
- colorViewInfo.image = m_ColorImage;
+ colorViewInfo.image = target.colorImage;
  colorViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
  colorViewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
  colorViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -393,37 +568,25 @@ void WalnutGraphics::CreateRenderTargets() {
  colorViewInfo.subresourceRange.baseArrayLayer =0;
  colorViewInfo.subresourceRange.layerCount =1;
 
- if (vkCreateImageView(m_Device, &colorViewInfo, nullptr, &m_ColorImageView) != VK_SUCCESS) {
+ if (vkCreateImageView(m_Device, &colorViewInfo, nullptr, &target.colorImageView) != VK_SUCCESS) {
  throw std::runtime_error("Failed to create color image view!");
  }
 
  // Create depth image (similar process)
  VkImageCreateInfo depthImageInfo = colorImageInfo;
  depthImageInfo.format = VK_FORMAT_D32_SFLOAT;
- depthImageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+ depthImageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; // sampled by the depth pyramid
 
- if (vkCreateImage(m_Device, &depthImageInfo, nullptr, &m_DepthImage) != VK_SUCCESS) {
+ if (vkCreateImage(m_Device, &depthImageInfo, nullptr, &target.depthImage) != VK_SUCCESS) {
  throw std::runtime_error("Failed to create depth image!");
  }
 
- VkMemoryRequirements depthMemRequirements;
- vkGetImageMemoryRequirements(m_Device, m_DepthImage, &depthMemRequirements);
-
- VkMemoryAllocateInfo depthAllocInfo{};
- depthAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
- depthAllocInfo.allocationSize = depthMemRequirements.size;
- depthAllocInfo.memoryTypeIndex = FindMemoryType(depthMemRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
- if (vkAllocateMemory(m_Device, &depthAllocInfo, nullptr, &m_DepthImageMemory) != VK_SUCCESS) {
- throw std::runtime_error("Failed to allocate depth image memory!");
- }
-
- vkBindImageMemory(m_Device, m_DepthImage, m_DepthImageMemory,0);
+ target.depthImageMemory = m_Allocator->AllocateForImage(target.depthImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
  // Create depth image view
  VkImageViewCreateInfo depthViewInfo{};
  depthViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
- depthViewInfo.image = m_DepthImage;
+ depthViewInfo.image = target.depthImage;
  depthViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
  depthViewInfo.format = VK_FORMAT_D32_SFLOAT;
  depthViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
@@ -432,12 +595,98 @@ void WalnutGraphics::CreateRenderTargets() {
  depthViewInfo.subresourceRange.baseArrayLayer =0;
  depthViewInfo.subresourceRange.layerCount =1;
 
- if (vkCreateImageView(m_Device, &depthViewInfo, nullptr, &m_DepthImageView) != VK_SUCCESS) {
+ if (vkCreateImageView(m_Device, &depthViewInfo, nullptr, &target.depthImageView) != VK_SUCCESS) {
  throw std::runtime_error("Failed to create depth image view!");
  }
 
+#ifndef WL_HEADLESS
+ if (m_DisplayMode == DisplayMode::ZeroCopy) {
+ UpdateViewportTexture(target);
+ }
+#endif
+
+ if (m_ReadbackEnabled) {
+ CreateReadbackBuffer(target);
+ }
+}
+
+// One color/depth pair per frame in flight so frame N+1 can render while ImGui
+// still samples frame N's color target.
+void WalnutGraphics::CreateRenderTargets() {
+ m_ReadbackEnabled = IsReadbackRequested();
+ for (auto& target : m_RenderTargets) {
+ CreateRenderTarget(target);
+ }
+
+#ifndef WL_HEADLESS
+ if (m_DisplayMode == DisplayMode::CpuReadback) {
  // Create Walnut::Image wrapper for the color attachment
  m_RenderedImage = std::make_shared<Walnut::Image>(m_RenderWidth, m_RenderHeight, Walnut::ImageFormat::RGBA);
+ }
+#endif
+}
+
+
+#ifndef WL_HEADLESS
+// Point the target's ImGui viewport descriptor at its color view
+void WalnutGraphics::UpdateViewportTexture(RenderTarget& target) {
+ if (m_ColorSampler == VK_NULL_HANDLE) {
+ VkSamplerCreateInfo samplerInfo{};
+ samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+ samplerInfo.magFilter = VK_FILTER_LINEAR;
+ samplerInfo.minFilter = VK_FILTER_LINEAR;
+ samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+ samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+ samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+ samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+ samplerInfo.maxAnisotropy = 1.0f;
+ samplerInfo.minLod = 0.0f;
+ samplerInfo.maxLod = 0.0f;
+
+ if (vkCreateSampler(m_Device, &samplerInfo, nullptr, &m_ColorSampler) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create viewport sampler!");
+ }
+ }
+
+ if (target.viewportTexture == VK_NULL_HANDLE) {
+ target.viewportTexture = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_ColorSampler, target.colorImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+ return;
+ }
+
+ // Re-use the descriptor set allocated from ImGui's pool; callers guarantee the
+ // device is idle (RecreateRenderTargets) so no pending frame still reads it.
+ VkDescriptorImageInfo imageInfo{};
+ imageInfo.sampler = m_ColorSampler;
+ imageInfo.imageView = target.colorImageView;
+ imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+ VkWriteDescriptorSet write{};
+ write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+ write.dstSet = target.viewportTexture;
+ write.dstBinding = 0;
+ write.descriptorCount = 1;
+ write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+ write.pImageInfo = &imageInfo;
+ vkUpdateDescriptorSets(m_Device, 1, &write, 0, nullptr);
+}
+#endif
+
+VkDescriptorSet WalnutGraphics::GetViewportTexture() const {
+#ifdef WL_HEADLESS
+ // Nothing samples the targets without ImGui; frames leave through readback
+ return VK_NULL_HANDLE;
+#else
+ if (m_DisplayMode == DisplayMode::ZeroCopy) {
+ return m_RenderTargets[m_DisplayFrame].viewportTexture;
+ }
+ return m_RenderedImage ? m_RenderedImage->GetDescriptorSet() : VK_NULL_HANDLE;
+#endif
+}
+
+// The switch is applied at the next BeginFrame: this frame's ImGui draw list
+// may already reference the current viewport texture.
+void WalnutGraphics::SetDisplayMode(DisplayMode mode) {
+ m_PendingDisplayMode = mode;
 }
 
 void WalnutGraphics::CreateRenderPass() {
@@ -461,7 +710,7 @@ void WalnutGraphics::CreateRenderPass() {
  depthAttachment.format = VK_FORMAT_D32_SFLOAT;
  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
- depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // We don't need to read depth after rendering
+ depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // read by the depth pyramid and the late pass
  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -477,13 +726,24 @@ void WalnutGraphics::CreateRenderPass() {
  subpass.pColorAttachments = &colorAttachmentRef;
  subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
- VkSubpassDependency dependency{};
- dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
- dependency.dstSubpass =0;
- dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
- dependency.srcAccessMask =0;
- dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
- dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+ // Incoming: the previous frame's ImGui pass may still be sampling the color
+ // target (zero-copy viewport), so writes must wait for fragment shader reads.
+ std::array<VkSubpassDependency,2> dependencies{};
+ dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+ dependencies[0].dstSubpass =0;
+ dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+ dependencies[0].srcAccessMask =0;
+ dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+ dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+ // Outgoing: make color writes visible to ImGui sampling and readback copies
+ // submitted later on the same queue.
+ dependencies[1].srcSubpass =0;
+ dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+ dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+ dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+ dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+ dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
 
  std::array<VkAttachmentDescription,2> attachments = { colorAttachment, depthAttachment };
 
@@ -493,18 +753,34 @@ void WalnutGraphics::CreateRenderPass() {
  renderPassInfo.pAttachments = attachments.data();
  renderPassInfo.subpassCount =1;
  renderPassInfo.pSubpasses = &subpass;
- renderPassInfo.dependencyCount =1;
- renderPassInfo.pDependencies = &dependency;
+ renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+ renderPassInfo.pDependencies = dependencies.data();
 
  if (vkCreateRenderPass(m_Device, &renderPassInfo, nullptr, &m_RenderPass) != VK_SUCCESS) {
  throw std::runtime_error("Failed to create render pass!");
  }
+
+ // The late pass draws on top of what the first one left. Compatible with it,
+ // so the same framebuffers and pipelines work; the depth target comes back
+ // from the pyramid through a barrier of its own.
+ attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+ attachments[0].initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+ attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+ attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+ attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+ dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+ dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+ dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+ dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+ if (vkCreateRenderPass(m_Device, &renderPassInfo, nullptr, &m_LateRenderPass) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create late render pass!");
+ }
 }
 
 void WalnutGraphics::CreateGraphicsPipeline() {
  // Vertex input
- auto bindingDescription = Vertex::GetBindingDescription();
- auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+ constexpr auto bindingDescription = GpuVertexLayout::GetBindingDescription();
+ constexpr auto attributeDescriptions = GpuVertexLayout::GetAttributeDescriptions();
 
  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -643,12 +919,46 @@ void WalnutGraphics::CreateGraphicsPipeline() {
  std::cout << "Warning: failed to create no-cull debug pipeline; continuing without it." << std::endl;
  }
 
+ // Instanced variant: same state plus InstanceData at binding 1. Optional, so
+ // a build whose shaders were not recompiled still runs (one draw per instance)
+ std::vector<char> instancedShaderCode;
+ try {
+ instancedShaderCode = ReadFile("shaders/basic_instanced.vert.spv");
+ } catch (const std::runtime_error&) {
+ std::cout << "WARNING: shaders/basic_instanced.vert.spv not found; instanced draws fall back to one draw per instance" << std::endl;
+ }
+ if (!instancedShaderCode.empty()) {
+ const std::array<VkVertexInputBindingDescription,2> instancedBindings = { bindingDescription, InstanceData::GetBindingDescription() };
+ const auto instanceAttributes = InstanceData::GetAttributeDescriptions();
+ std::array<VkVertexInputAttributeDescription, GpuVertexLayout::kAttributeCount + InstanceData::kAttributeCount> instancedAttributes{};
+ std::copy(attributeDescriptions.begin(), attributeDescriptions.end(), instancedAttributes.begin());
+ std::copy(instanceAttributes.begin(), instanceAttributes.end(), instancedAttributes.begin() + attributeDescriptions.size());
+
+ VkPipelineVertexInputStateCreateInfo instancedInputInfo = vertexInputInfo;
+ instancedInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(instancedBindings.size());
+ instancedInputInfo.pVertexBindingDescriptions = instancedBindings.data();
+ instancedInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedAttributes.size());
+ instancedInputInfo.pVertexAttributeDescriptions = instancedAttributes.data();
+
+ VkShaderModule instancedShaderModule = CreateShaderModule(instancedShaderCode);
+ shaderStages[0].module = instancedShaderModule;
+ pipelineInfo.pVertexInputState = &instancedInputInfo;
+ // Cull like the pipeline RenderIndexedBuffer binds, so both paths draw the same
+ rasterizer.cullMode = m_PipelineNoCull != VK_NULL_HANDLE ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+ if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE,1, &pipelineInfo, nullptr, &m_InstancedPipeline) != VK_SUCCESS) {
+ m_InstancedPipeline = VK_NULL_HANDLE;
+ std::cout << "WARNING: Failed to create the instanced pipeline; instanced draws fall back to one draw per instance" << std::endl;
+ }
+ vkDestroyShaderModule(m_Device, instancedShaderModule, nullptr);
+ }
+
  vkDestroyShaderModule(m_Device, fragShaderModule, nullptr);
  vkDestroyShaderModule(m_Device, vertShaderModule, nullptr);
 }
 
 void WalnutGraphics::CreateFramebuffers() {
- std::array<VkImageView,2> attachments = { m_ColorImageView, m_DepthImageView };
+ for (auto& target : m_RenderTargets) {
+ std::array<VkImageView,2> attachments = { target.colorImageView, target.depthImageView };
 
  VkFramebufferCreateInfo framebufferInfo{};
  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -659,16 +969,17 @@ void WalnutGraphics::CreateFramebuffers() {
  framebufferInfo.height = m_RenderHeight;
  framebufferInfo.layers =1;
 
- if (vkCreateFramebuffer(m_Device, &framebufferInfo, nullptr, &m_Framebuffer) != VK_SUCCESS) {
+ if (vkCreateFramebuffer(m_Device, &framebufferInfo, nullptr, &target.framebuffer) != VK_SUCCESS) {
  throw std::runtime_error("Failed to create framebuffer!");
  }
+ }
 }
 
 void WalnutGraphics::CreateCommandPool() {
  VkCommandPoolCreateInfo poolInfo{};
  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
- poolInfo.queueFamilyIndex = FindGraphicsQueueFamily();
+ poolInfo.queueFamilyIndex = m_GraphicsQueueFamily;
 
  if (vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_CommandPool) != VK_SUCCESS) {
  throw std::runtime_error("Failed to create command pool");
@@ -687,24 +998,67 @@ void WalnutGraphics::CreateCommandBuffers() {
  if (vkAllocateCommandBuffers(m_Device, &allocInfo, m_CommandBuffers.data()) != VK_SUCCESS) {
  throw std::runtime_error("Failed to allocate command buffers");
  }
+
+ m_CullCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+ allocInfo.commandBufferCount = static_cast<uint32_t>(m_CullCommandBuffers.size());
+ if (vkAllocateCommandBuffers(m_Device, &allocInfo, m_CullCommandBuffers.data()) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to allocate culling command buffers");
+ }
+
+ m_SecondaryCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+ allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+ allocInfo.commandBufferCount = static_cast<uint32_t>(m_SecondaryCommandBuffers.size());
+ if (vkAllocateCommandBuffers(m_Device, &allocInfo, m_SecondaryCommandBuffers.data()) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to allocate secondary command buffers");
+ }
 }
 
+// Creates the current frame slot's recording pools up to `count`; they are
+// never shrunk, a frame recorded with fewer threads leaves the rest unused
+void WalnutGraphics::EnsureRecordingContexts(uint32_t count) {
+ std::vector<RecordingContext>& contexts = m_RecordingContexts[m_CurrentFrame];
+ while (contexts.size() < count) {
+ RecordingContext context;
+ VkCommandPoolCreateInfo poolInfo{};
+ poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+ poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+ poolInfo.queueFamilyIndex = m_GraphicsQueueFamily;
+ if (vkCreateCommandPool(m_Device, &poolInfo, nullptr, &context.pool) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create recording command pool");
+ }
+
+ VkCommandBufferAllocateInfo allocInfo{};
+ allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+ allocInfo.commandPool = context.pool;
+ allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+ allocInfo.commandBufferCount =1;
+ if (vkAllocateCommandBuffers(m_Device, &allocInfo, &context.commandBuffer) != VK_SUCCESS) {
+ vkDestroyCommandPool(m_Device, context.pool, nullptr);
+ throw std::runtime_error("Failed to allocate recording command buffer");
+ }
+ contexts.push_back(context);
+ }
+}
+
+uint32_t WalnutGraphics::GetRecordingThreads() const {
+ if (!m_RecordingPool) {
+ return 1;
+ }
+ const uint32_t available = m_RecordingPool->GetThreadCount();
+ return m_RecordingThreads ==0 ? available : std::min(m_RecordingThreads, available);
+}
+
+// Offscreen rendering has no swapchain to acquire from or present to, so a
+// fence per frame in flight is all the host needs to pace itself.
 void WalnutGraphics::CreateSyncObjects() {
- m_ImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
- m_RenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
  m_InFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
- VkSemaphoreCreateInfo semaphoreInfo{};
- semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
  VkFenceCreateInfo fenceInfo{};
  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
  for (int i =0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
- if (vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_ImageAvailableSemaphores[i]) != VK_SUCCESS ||
- vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]) != VK_SUCCESS ||
- vkCreateFence(m_Device, &fenceInfo, nullptr, &m_InFlightFences[i]) != VK_SUCCESS) {
+ if (vkCreateFence(m_Device, &fenceInfo, nullptr, &m_InFlightFences[i]) != VK_SUCCESS) {
  throw std::runtime_error("Failed to create synchronization objects for a frame");
  }
  }
@@ -740,15 +1094,15 @@ void WalnutGraphics::CreateDescriptorSetLayout() {
 void WalnutGraphics::CreateDescriptorPool() {
  std::array<VkDescriptorPoolSize,2> poolSizes{};
  poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
- poolSizes[0].descriptorCount =1;
+ poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
  poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
- poolSizes[1].descriptorCount =1;
+ poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
 
  VkDescriptorPoolCreateInfo poolInfo{};
  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
  poolInfo.pPoolSizes = poolSizes.data();
- poolInfo.maxSets =1;
+ poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
 
  if (vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &m_DescriptorPool) != VK_SUCCESS) {
  throw std::runtime_error("Failed to create descriptor pool!");
@@ -756,32 +1110,19 @@ void WalnutGraphics::CreateDescriptorPool() {
 }
 
 void WalnutGraphics::CreateDescriptorSet() {
+ std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+ layouts.fill(m_DescriptorSetLayout);
+
  VkDescriptorSetAllocateInfo allocInfo{};
  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
  allocInfo.descriptorPool = m_DescriptorPool;
- allocInfo.descriptorSetCount =1;
- allocInfo.pSetLayouts = &m_DescriptorSetLayout;
+ allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+ allocInfo.pSetLayouts = layouts.data();
 
- if (vkAllocateDescriptorSets(m_Device, &allocInfo, &m_DescriptorSet) != VK_SUCCESS) {
+ if (vkAllocateDescriptorSets(m_Device, &allocInfo, m_DescriptorSets.data()) != VK_SUCCESS) {
  throw std::runtime_error("Failed to allocate descriptor sets!");
  }
 
- VkDescriptorBufferInfo bufferInfo{};
- bufferInfo.buffer = m_UniformBuffer.buffer;
- bufferInfo.offset =0;
- bufferInfo.range = sizeof(UniformTransformations);
-
- VkWriteDescriptorSet uboWrite{};
- uboWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
- uboWrite.dstSet = m_DescriptorSet;
- uboWrite.dstBinding =0;
- uboWrite.dstArrayElement =0;
- uboWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
- uboWrite.descriptorCount =1;
- uboWrite.pBufferInfo = &bufferInfo;
-
- std::vector<VkWriteDescriptorSet> descriptorWrites = { uboWrite };
-
  VkDescriptorImageInfo imageInfo{};
  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
@@ -794,38 +1135,126 @@ void WalnutGraphics::CreateDescriptorSet() {
  imageInfo.sampler = m_DefaultTextureSampler;
  }
 
+ for (int i =0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+ VkDescriptorBufferInfo bufferInfo{};
+ bufferInfo.buffer = m_UniformBuffers[i].buffer;
+ bufferInfo.offset =0;
+ bufferInfo.range = sizeof(UniformTransformations);
+
+ VkWriteDescriptorSet uboWrite{};
+ uboWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+ uboWrite.dstSet = m_DescriptorSets[i];
+ uboWrite.dstBinding =0;
+ uboWrite.dstArrayElement =0;
+ uboWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+ uboWrite.descriptorCount =1;
+ uboWrite.pBufferInfo = &bufferInfo;
+
  VkWriteDescriptorSet samplerWrite{};
  samplerWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
- samplerWrite.dstSet = m_DescriptorSet;
+ samplerWrite.dstSet = m_DescriptorSets[i];
  samplerWrite.dstBinding =1;
  samplerWrite.dstArrayElement =0;
  samplerWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
  samplerWrite.descriptorCount =1;
  samplerWrite.pImageInfo = &imageInfo;
- descriptorWrites.push_back(samplerWrite);
- 
+
+ std::array<VkWriteDescriptorSet,2> descriptorWrites = { uboWrite, samplerWrite };
  vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(),0, nullptr);
+ }
 }
 
+// The texture is recorded into the upload batch and swapped in by BeginFrame
+// once the upload is ready, so loading never blocks on the copy.
 void WalnutGraphics::LoadTextureFromFile(const std::string& filename) {
- m_Texture = std::make_unique<Texture>(this);
- m_Texture->LoadFromFile(filename);
- if (m_DescriptorSet != VK_NULL_HANDLE) {
- m_Texture->WriteDescriptor(m_Device, m_DescriptorSet,1);
+ // A texture that is still streaming in is superseded; its batch must be done
+ // with the image before it can be destroyed
+ if (m_PendingTexture) {
+ m_Uploads->Wait(m_PendingTextureTicket);
+ m_PendingTexture.reset();
  }
+
+ auto texture = std::make_unique<Texture>(this);
+ try {
+ texture->LoadFromFile(filename);
+ } catch (...) {
+ // Commands for the half-built image may already sit in the open batch
+ m_Uploads->Wait(m_Uploads->GetCurrentTicket());
+ throw;
+ }
+ m_PendingTexture = std::move(texture);
+ m_PendingTextureTicket = m_Uploads->GetCurrentTicket();
 }
 
+// Called by BeginFrame once the slot's fence has signaled. The other slots'
+// descriptor sets may still be in use by their submissions, so each is
+// rewritten at its own BeginFrame; the old texture waits in this slot's
+// deletion queue until the slot comes around again, by which time every
+// submission that could sample it has completed.
+void WalnutGraphics::PromotePendingTexture() {
+ if (m_Texture) {
+ m_RetiredTextures[m_CurrentFrame].push_back(std::move(m_Texture));
+ }
+ m_Texture = std::move(m_PendingTexture);
+ for (int i =0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+ m_TextureDescriptorStale[i] = m_DescriptorSets[i] != VK_NULL_HANDLE;
+ }
+}
+
+// One uniform buffer per frame in flight: the CPU writes slot N while the GPU
+// may still read slot N-1.
 void WalnutGraphics::CreateUniformBuffers() {
  VkDeviceSize bufferSize = sizeof(UniformTransformations);
 
- m_UniformBuffer = CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+ for (int i =0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+ m_UniformBuffers[i] = CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
- if (vkMapMemory(m_Device, m_UniformBuffer.memory,0, bufferSize,0, &m_UniformBufferLocation) != VK_SUCCESS) {
- m_UniformBufferLocation = nullptr;
+ // Host-visible blocks stay mapped for the allocator's lifetime
+ m_UniformBufferLocations[i] = m_UniformBuffers[i].allocation.mapped;
+ if (!m_UniformBufferLocations[i]) {
  std::cout << "ERROR: Failed to map uniform buffer memory" << std::endl;
+ continue;
+ }
+ std::memcpy(m_UniformBufferLocations[i], &m_Transformations, sizeof(UniformTransformations));
+ }
+}
+
+// The object list always exists; the compute pipeline needs its shader, and
+// its draws the indirect draw features
+void WalnutGraphics::CreateGpuCulling() {
+ std::vector<char> shaderCode;
+ try {
+ shaderCode = ReadFile("shaders/gpu_cull.comp.spv");
+ } catch (const std::runtime_error&) {
+ std::cout << "WARNING: shaders/gpu_cull.comp.spv not found; GPU objects are culled and drawn on the CPU" << std::endl;
+ }
+ std::vector<char> pyramidCode;
+ try {
+ pyramidCode = ReadFile("shaders/depth_pyramid.comp.spv");
+ } catch (const std::runtime_error&) {
+ std::cout << "WARNING: shaders/depth_pyramid.comp.spv not found; GPU objects are not occlusion culled" << std::endl;
+ }
+ m_DepthPyramid = std::make_unique<DepthPyramid>(m_Device, *m_Allocator, pyramidCode);
+ m_GpuCulling = std::make_unique<GpuCulling>(m_Device, *m_Allocator, *m_MeshPool, MAX_FRAMES_IN_FLIGHT, shaderCode);
+ ResizeDepthPyramid();
+ if (m_GpuCulling->IsSupported() && !IsMultiDrawIndirectSupported()) {
+ std::cout << "WARNING: No multiDrawIndirect, drawIndirectFirstInstance or instanced pipeline; GPU objects are culled and drawn on the CPU" << std::endl;
+ }
+ if (m_DrawIndirectCount) {
+ m_CmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(m_Device, "vkCmdDrawIndexedIndirectCountKHR"));
  }
 }
 
+// After the render targets are (re)created; the device is idle
+void WalnutGraphics::ResizeDepthPyramid() {
+ std::array<VkImageView, MAX_FRAMES_IN_FLIGHT> depthViews{};
+ for (uint32_t i =0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+ depthViews[i] = m_RenderTargets[i].depthImageView;
+ }
+ m_DepthPyramid->Resize(m_RenderWidth, m_RenderHeight, depthViews);
+ m_GpuCulling->SetDepthPyramid(m_DepthPyramid->GetView(), m_DepthPyramid->GetSampler(), m_RenderWidth, m_RenderHeight);
+}
+
 void WalnutGraphics::BeginCommands() {
  VkCommandBuffer cmd = m_CommandBuffers[m_CurrentFrame];
  vkResetCommandBuffer(cmd,0);
@@ -836,10 +1265,15 @@ void WalnutGraphics::BeginCommands() {
 
  vkBeginCommandBuffer(cmd, &beginInfo);
 
+ // Resolves this slot's timestamps from MAX_FRAMES_IN_FLIGHT frames ago
+ m_GpuProfiler->BeginFrame(cmd, m_CurrentFrame);
+ m_FrameScope = m_GpuProfiler->BeginScope(cmd, "Frame");
+ m_RenderPassScope = m_GpuProfiler->BeginScope(cmd, "Render pass");
+
  VkRenderPassBeginInfo renderPassInfo{};
  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
  renderPassInfo.renderPass = m_RenderPass;
- renderPassInfo.framebuffer = m_Framebuffer;
+ renderPassInfo.framebuffer = m_RenderTargets[m_CurrentFrame].framebuffer;
  renderPassInfo.renderArea.offset = {0,0};
  renderPassInfo.renderArea.extent = { m_RenderWidth, m_RenderHeight };
 
@@ -850,7 +1284,44 @@ void WalnutGraphics::BeginCommands() {
  renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
  renderPassInfo.pClearValues = clearValues.data();
 
+ // With more than one recording thread the subpass only takes secondary
+ // command buffers: direct draws go into the frame's own one, executed ahead
+ // of those the render queue is recorded into
+ m_RecordSecondary = GetRecordingThreads() >1;
+ m_ExecutedCommandBuffers.clear();
+ if (m_RecordSecondary) {
+ vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+ m_DrawCommandBuffer = m_SecondaryCommandBuffers[m_CurrentFrame];
+ vkResetCommandBuffer(m_DrawCommandBuffer,0);
+ BeginSecondaryCommandBuffer(m_DrawCommandBuffer);
+ m_ExecutedCommandBuffers.push_back(m_DrawCommandBuffer);
+ return;
+ }
+
  vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+ m_DrawCommandBuffer = cmd;
+
+ VkViewport viewport = GetViewport();
+ vkCmdSetViewport(cmd,0,1, &viewport);
+
+ VkRect2D scissor = GetScissor();
+ vkCmdSetScissor(cmd,0,1, &scissor);
+}
+
+// Continues the current frame's render pass. Dynamic state is not inherited
+// from the primary buffer, so viewport and scissor are set again.
+void WalnutGraphics::BeginSecondaryCommandBuffer(VkCommandBuffer cmd) {
+ VkCommandBufferInheritanceInfo inheritance{};
+ inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+ inheritance.renderPass = m_RenderPass;
+ inheritance.subpass =0;
+ inheritance.framebuffer = m_RenderTargets[m_CurrentFrame].framebuffer;
+
+ VkCommandBufferBeginInfo beginInfo{};
+ beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+ beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+ beginInfo.pInheritanceInfo = &inheritance;
+ vkBeginCommandBuffer(cmd, &beginInfo);
 
  VkViewport viewport = GetViewport();
  vkCmdSetViewport(cmd,0,1, &viewport);
@@ -861,7 +1332,22 @@ void WalnutGraphics::BeginCommands() {
 
 void WalnutGraphics::EndCommands() {
  VkCommandBuffer cmd = m_CommandBuffers[m_CurrentFrame];
+ CullPendingDraws();
+ FlushRenderQueue(m_DrawCommandBuffer);
+ if (m_RecordSecondary) {
+ vkEndCommandBuffer(m_DrawCommandBuffer);
+ vkCmdExecuteCommands(cmd, static_cast<uint32_t>(m_ExecutedCommandBuffers.size()), m_ExecutedCommandBuffers.data());
+ }
+ m_DrawCommandBuffer = VK_NULL_HANDLE;
  vkCmdEndRenderPass(cmd);
+ m_GpuProfiler->EndScope(cmd, m_RenderPassScope);
+ RecordLateGpuObjects(cmd);
+ if (m_ReadbackEnabled) {
+ uint32_t readbackScope = m_GpuProfiler->BeginScope(cmd, "Readback");
+ RecordReadback(cmd, m_RenderTargets[m_CurrentFrame]);
+ m_GpuProfiler->EndScope(cmd, readbackScope);
+ }
+ m_GpuProfiler->EndScope(cmd, m_FrameScope);
  vkEndCommandBuffer(cmd);
 }
 
@@ -892,231 +1378,734 @@ void WalnutGraphics::SetModelMatrix(glm::mat4 model) {
  m_CurrentModel = model;
 }
 
+// Only kept here: between frames the current slot's uniform buffer may still
+// be read by its last submission, so BeginFrame copies the camera in once the
+// slot's fence has signaled.
 void WalnutGraphics::SetViewProjection(glm::mat4 view, glm::mat4 projection) {
- UniformTransformations transformations{ view, projection };
- if (!m_UniformBufferLocation) {
- std::cout << "ERROR: Uniform buffer memory not mapped (m_UniformBufferLocation == nullptr)\n";
- return;
- }
-
- std::memcpy(m_UniformBufferLocation, &transformations, sizeof(UniformTransformations));
+ m_Transformations = UniformTransformations{ view, projection };
+ m_Frustum = Frustum::FromViewProjection(projection * view);
 }
 
 void WalnutGraphics::RenderBuffer(BufferHandle handle, std::uint32_t vertex_count) {
  VkDeviceSize offset =0;
- VkCommandBuffer cmd = m_CommandBuffers[m_CurrentFrame];
- vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,0,1, &m_DescriptorSet,0, nullptr);
+ VkCommandBuffer cmd = m_DrawCommandBuffer;
+ vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,0,1, &m_DescriptorSets[m_CurrentFrame],0, nullptr);
  vkCmdPushConstants(cmd, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,0, sizeof(glm::mat4), &m_CurrentModel);
  vkCmdBindVertexBuffers(cmd,0,1, &handle.buffer, &offset);
  vkCmdDraw(cmd, vertex_count,1,0,0);
 }
 
 void WalnutGraphics::RenderIndexedBuffer(BufferHandle vertex_buffer, BufferHandle index_buffer, std::uint32_t count) {
+ QueuedDraw draw;
+ if (PrepareQueuedDraw(vertex_buffer, index_buffer, count,0, draw)) {
+ m_RenderQueue.Submit(draw, GetViewDepth(draw.model));
+ }
+}
+
+void WalnutGraphics::RenderIndexedBuffer(BufferHandle vertex_buffer, BufferHandle index_buffer, std::uint32_t count, const Aabb& bounds, std::uint32_t first_index) {
+ QueuedDraw draw;
+ if (!PrepareQueuedDraw(vertex_buffer, index_buffer, count, first_index, draw)) {
+ return;
+ }
+ if (!m_FrustumCulling) {
+ m_RenderQueue.Submit(draw, GetViewDepth(draw.model));
+ return;
+ }
+ m_CullingSet.Add(bounds.Transformed(draw.model));
+ m_CullCandidates.push_back(draw);
+}
+
+bool WalnutGraphics::PrepareQueuedDraw(BufferHandle vertex_buffer, BufferHandle index_buffer, std::uint32_t count, std::uint32_t first_index, QueuedDraw& draw) {
  if (m_Pipeline == VK_NULL_HANDLE) {
  std::cout << "WARNING: Skipping render - pipeline not ready" << std::endl;
- return;
+ return false;
  }
 
  if (vertex_buffer.buffer == VK_NULL_HANDLE || index_buffer.buffer == VK_NULL_HANDLE) {
  std::cout << "WARNING: Invalid buffers - vertex:" << (vertex_buffer.buffer != VK_NULL_HANDLE)
  << " index:" << (index_buffer.buffer != VK_NULL_HANDLE) << std::endl;
- return;
+ return false;
  }
 
- VkDeviceSize offset =0;
-
  VkPipeline pipelineToBind = m_PipelineNoCull != VK_NULL_HANDLE ? m_PipelineNoCull : m_Pipeline;
 
- VkCommandBuffer cmd = m_CommandBuffers[m_CurrentFrame];
-
- if (pipelineToBind != VK_NULL_HANDLE) {
- vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineToBind);
+ if (m_FrameCount <= m_LogFramesLimit) {
+ std::cout << "DEBUG: Queueing drawIndexed count=" << count << " frame=" << m_FrameCount << "\n";
  }
 
- vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,0,1, &m_DescriptorSet,0, nullptr);
- vkCmdPushConstants(cmd, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,0, sizeof(glm::mat4), &m_CurrentModel);
+ draw.pipeline = pipelineToBind;
+ draw.descriptorSet = m_DescriptorSets[m_CurrentFrame];
+ draw.vertexBuffer = vertex_buffer.buffer;
+ draw.indexBuffer = index_buffer.buffer;
+ draw.indexCount = count;
+ draw.firstIndex = first_index;
+ draw.model = m_CurrentModel;
+ return true;
+}
 
- if (m_FrameCount <= m_LogFramesLimit) {
- std::cout << "DEBUG: Recording drawIndexed count=" << count << " frame=" << m_FrameCount << "\n";
- }
+uint32_t WalnutGraphics::SelectLod(gsl::span<const MeshLod> lods, const glm::mat4& model, const glm::vec3& center) const {
+ // A unit length at view depth d covers projection[1][1] * height / 2 / d
+ // pixels; y may be flipped, hence the abs
+ const float pixelsPerUnit = std::abs(m_Transformations.projection[1][1]) *0.5f * static_cast<float>(GetRenderHeight());
+ const float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+ const glm::vec4 position = m_Transformations.view * (model * glm::vec4(center,1.0f));
+ return veng::SelectLod(std::span<const MeshLod>(lods.data(), lods.size()), -position.z, pixelsPerUnit * scale, m_LodErrorPixels);
+}
 
- vkCmdBindVertexBuffers(cmd,0,1, &vertex_buffer.buffer, &offset);
- vkCmdBindIndexBuffer(cmd, index_buffer.buffer,0, VK_INDEX_TYPE_UINT32);
- vkCmdDrawIndexed(cmd, count,1,0,0,0);
+// Sort depth of a draw: its origin's distance along the view direction (the
+// camera looks down -z in view space)
+float WalnutGraphics::GetViewDepth(const glm::mat4& model) const {
+ const glm::vec4 origin = m_Transformations.view * model[3];
+ return -origin.z;
+}
 
- if (m_FrameCount <= m_LogFramesLimit) {
- vkCmdDraw(cmd,3,1,0,0);
+// Tests the frame's draws with bounds against the final camera and queues the
+// visible ones
+void WalnutGraphics::CullPendingDraws() {
+ if (m_CullCandidates.empty()) {
+ return;
  }
+ const auto cullStart = std::chrono::steady_clock::now();
+ m_VisibleIndices.clear();
+ const uint32_t visible = CullBoxes(m_Frustum, m_CullingSet, m_VisibleIndices, m_CullKernel);
+ m_FrameStats.cullTested += m_CullingSet.GetSize();
+ m_FrameStats.cullVisible += visible;
+ m_FrameStats.cullMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cullStart).count();
+
+ for (uint32_t index : m_VisibleIndices) {
+ const QueuedDraw& draw = m_CullCandidates[index];
+ m_RenderQueue.Submit(draw, GetViewDepth(draw.model));
+ }
+ m_CullCandidates.clear();
+ m_CullingSet.Clear();
 }
 
-BufferHandle WalnutGraphics::CreateVertexBuffer(gsl::span<Vertex> vertices) {
- VkDeviceSize size = sizeof(Vertex) * vertices.size();
- BufferHandle staging_handle = CreateBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+// Records the frame's queued draws in sort key order into `cmd`, or, when the
+// render pass takes secondary command buffers and the queue is long enough,
+// splits the sorted draws into contiguous chunks recorded in parallel, one
+// secondary command buffer each. They execute after `cmd` in chunk order, so
+// the result is the same as recording them one after another.
+void WalnutGraphics::FlushRenderQueue(VkCommandBuffer cmd) {
+ m_FrameStats.queuedDraws = m_RenderQueue.GetDrawCount();
+ m_FrameStats.triangles += m_RenderQueue.GetIndexCount() /3;
+ m_FrameStats.queueBinds =0;
+ m_FrameStats.queueBindsSaved =0;
+ m_FrameStats.recordingThreads =0;
+ m_FrameStats.queueRecordMs =0.0f;
+ if (m_RenderQueue.IsEmpty()) {
+ return;
+ }
 
- void* data;
- vkMapMemory(m_Device, staging_handle.memory,0, size,0, &data);
- std::memcpy(data, vertices.data(), size);
- vkUnmapMemory(m_Device, staging_handle.memory);
+ const auto recordStart = std::chrono::steady_clock::now();
+ const std::span<const SortEntry> entries = m_RenderQueue.Sort();
+ const uint32_t drawCount = static_cast<uint32_t>(entries.size());
+ uint32_t chunks =1;
+ if (m_RecordSecondary) {
+ chunks = std::min(GetRecordingThreads(), (drawCount + kMinDrawsPerRecordingThread -1) / kMinDrawsPerRecordingThread);
+ }
 
- BufferHandle gpu_handle = CreateBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+ uint32_t binds =0;
+ uint32_t drawScope = m_GpuProfiler->BeginScope(cmd, "Draw");
+ if (chunks <=1) {
+ binds = RecordQueuedDraws(cmd, entries);
+ m_GpuProfiler->EndScope(cmd, drawScope);
+ } else {
+ EnsureRecordingContexts(chunks);
+ std::vector<RecordingContext>& contexts = m_RecordingContexts[m_CurrentFrame];
+ m_RecordingPool->ParallelFor(chunks, [&](uint32_t chunk) {
+ RecordingContext& context = contexts[chunk];
+ const uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * chunk / chunks);
+ const uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * (chunk +1) / chunks);
+
+ vkResetCommandPool(m_Device, context.pool,0);
+ BeginSecondaryCommandBuffer(context.commandBuffer);
+ context.binds = RecordQueuedDraws(context.commandBuffer, entries.subspan(first, last - first));
+ // Opened in `cmd`; only this thread touches the scope until the loop returns
+ if (chunk == chunks -1) {
+ m_GpuProfiler->EndScope(context.commandBuffer, drawScope);
+ }
+ vkEndCommandBuffer(context.commandBuffer);
+ });
+ for (uint32_t chunk =0; chunk < chunks; ++chunk) {
+ binds += contexts[chunk].binds;
+ m_ExecutedCommandBuffers.push_back(contexts[chunk].commandBuffer);
+ }
+ }
+
+ m_FrameStats.queueBinds = binds;
+ m_FrameStats.queueBindsSaved = m_FrameStats.queuedDraws *4 - binds;
+ m_FrameStats.recordingThreads = chunks;
+ m_FrameStats.queueRecordMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+ m_RenderQueue.Clear();
+}
 
- VkCommandBuffer transient_commands = BeginTransientCommandBuffer();
+// Records `entries` and returns the binds it needed. Nothing is assumed to be
+// bound on entry (direct draws may have bound anything, and a secondary buffer
+// starts empty); after that every bind is skipped when the previous draw
+// already bound the same object. Called from several threads at once.
+uint32_t WalnutGraphics::RecordQueuedDraws(VkCommandBuffer cmd, std::span<const SortEntry> entries) const {
+ VkPipeline boundPipeline = VK_NULL_HANDLE;
+ VkDescriptorSet boundSet = VK_NULL_HANDLE;
+ VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+ VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+ uint32_t binds =0;
+ const VkDeviceSize offset =0;
+
+ for (const SortEntry& entry : entries) {
+ const QueuedDraw& draw = m_RenderQueue.GetDraw(entry.index);
+ if (draw.pipeline != boundPipeline) {
+ vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+ boundPipeline = draw.pipeline;
+ ++binds;
+ }
+ // Every pipeline shares m_PipelineLayout, so the set survives pipeline changes
+ if (draw.descriptorSet != boundSet) {
+ vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,0,1, &draw.descriptorSet,0, nullptr);
+ boundSet = draw.descriptorSet;
+ ++binds;
+ }
+ if (draw.vertexBuffer != boundVertexBuffer) {
+ vkCmdBindVertexBuffers(cmd,0,1, &draw.vertexBuffer, &offset);
+ boundVertexBuffer = draw.vertexBuffer;
+ ++binds;
+ }
+ if (draw.indexBuffer != boundIndexBuffer) {
+ vkCmdBindIndexBuffer(cmd, draw.indexBuffer,0, VK_INDEX_TYPE_UINT32);
+ boundIndexBuffer = draw.indexBuffer;
+ ++binds;
+ }
+ vkCmdPushConstants(cmd, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,0, sizeof(glm::mat4), &draw.model);
+ vkCmdDrawIndexed(cmd, draw.indexCount,1, draw.firstIndex,0,0);
+ }
+ return binds;
+}
 
- VkBufferCopy copy_info = {};
- copy_info.srcOffset =0;
- copy_info.dstOffset =0;
- copy_info.size = size;
- vkCmdCopyBuffer(transient_commands, staging_handle.buffer, gpu_handle.buffer,1, &copy_info);
+void WalnutGraphics::RenderIndexedInstanced(BufferHandle vertex_buffer, BufferHandle index_buffer, std::uint32_t count, gsl::span<const InstanceData> instances, std::uint32_t first_index) {
+ if (instances.empty()) {
+ return;
+ }
+ if (m_InstancedPipeline == VK_NULL_HANDLE) {
+ const glm::mat4 model = m_CurrentModel;
+ QueuedDraw draw;
+ for (const InstanceData& instance : instances) {
+ m_CurrentModel = instance.transformation;
+ if (PrepareQueuedDraw(vertex_buffer, index_buffer, count, first_index, draw)) {
+ m_RenderQueue.Submit(draw, GetViewDepth(draw.model));
+ }
+ }
+ m_CurrentModel = model;
+ return;
+ }
+ if (vertex_buffer.buffer == VK_NULL_HANDLE || index_buffer.buffer == VK_NULL_HANDLE) {
+ std::cout << "WARNING: Invalid buffers - vertex:" << (vertex_buffer.buffer != VK_NULL_HANDLE)
+ << " index:" << (index_buffer.buffer != VK_NULL_HANDLE) << std::endl;
+ return;
+ }
 
- EndTransientCommandBuffer(transient_commands);
+ VkBuffer instanceBuffer = VK_NULL_HANDLE;
+ const VkDeviceSize instanceOffset = WriteStream(m_InstanceBuffers[m_CurrentFrame], instances.data(), instances.size_bytes(), instanceBuffer);
 
- DestroyBuffer(staging_handle);
+ VkCommandBuffer cmd = m_DrawCommandBuffer;
+ vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_InstancedPipeline);
+ vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,0,1, &m_DescriptorSets[m_CurrentFrame],0, nullptr);
 
- return gpu_handle;
+ uint32_t drawScope = m_GpuProfiler->BeginScope(cmd, "Draw");
+ const std::array<VkBuffer,2> buffers = { vertex_buffer.buffer, instanceBuffer };
+ const std::array<VkDeviceSize,2> offsets = {0, instanceOffset };
+ vkCmdBindVertexBuffers(cmd,0, static_cast<uint32_t>(buffers.size()), buffers.data(), offsets.data());
+ vkCmdBindIndexBuffer(cmd, index_buffer.buffer,0, VK_INDEX_TYPE_UINT32);
+ vkCmdDrawIndexed(cmd, count, static_cast<uint32_t>(instances.size()), first_index,0,0);
+ m_GpuProfiler->EndScope(cmd, drawScope);
+ m_FrameStats.triangles += static_cast<uint64_t>(count /3) * instances.size();
 }
 
-BufferHandle WalnutGraphics::CreateIndexBuffer(gsl::span<std::uint32_t> indices) {
- VkDeviceSize size = sizeof(std::uint32_t) * indices.size();
+MeshHandle WalnutGraphics::AddPoolMesh(gsl::span<const Vertex> vertices, gsl::span<const std::uint32_t> indices) {
+ return m_MeshPool->Add(vertices, indices);
+}
 
- BufferHandle staging_handle = CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+void WalnutGraphics::RemovePoolMesh(MeshHandle mesh) {
+ m_MeshPool->Remove(mesh);
+}
 
- void* data;
- vkMapMemory(m_Device, staging_handle.memory,0, size,0, &data);
- std::memcpy(data, indices.data(), size);
- vkUnmapMemory(m_Device, staging_handle.memory);
+MeshPoolStats WalnutGraphics::GetMeshPoolStats() const {
+ return m_MeshPool ? m_MeshPool->GetStats() : MeshPoolStats{};
+}
 
- BufferHandle gpu_handle = CreateBuffer(size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+void WalnutGraphics::RenderPoolMeshes(gsl::span<const MeshDraw> draws) {
+ if (draws.empty()) {
+ return;
+ }
+ if (m_Pipeline == VK_NULL_HANDLE) {
+ std::cout << "WARNING: Skipping render - pipeline not ready" << std::endl;
+ return;
+ }
 
- VkCommandBuffer transient_commands = BeginTransientCommandBuffer();
+ if (m_FrustumCulling) {
+ const auto cullStart = std::chrono::steady_clock::now();
+ m_PoolCullingSet.Clear();
+ m_PoolCullingSet.Reserve(static_cast<uint32_t>(draws.size()));
+ for (const MeshDraw& draw : draws) {
+ // Invalid handles stay in so indices line up; BuildDrawList skips them
+ m_PoolCullingSet.Add(draw.mesh.IsValid() ? m_MeshPool->GetBounds(draw.mesh).Transformed(draw.instance.transformation) : Aabb{});
+ }
+ m_VisibleIndices.clear();
+ const uint32_t visible = CullBoxes(m_Frustum, m_PoolCullingSet, m_VisibleIndices, m_CullKernel);
+ m_VisiblePoolDraws.clear();
+ for (uint32_t index : m_VisibleIndices) {
+ m_VisiblePoolDraws.push_back(draws[index]);
+ }
+ m_PoolCullingSet.Clear();
+ m_FrameStats.cullTested += static_cast<uint32_t>(draws.size());
+ m_FrameStats.cullVisible += visible;
+ m_FrameStats.cullMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cullStart).count();
+ if (m_VisiblePoolDraws.empty()) {
+ return;
+ }
+ draws = m_VisiblePoolDraws;
+ }
 
- VkBufferCopy copy_info = {};
- copy_info.srcOffset =0;
- copy_info.dstOffset =0;
- copy_info.size = size;
- vkCmdCopyBuffer(transient_commands, staging_handle.buffer, gpu_handle.buffer,1, &copy_info);
+ const MeshPool::DrawList list = m_MeshPool->BuildDrawList(draws);
+ for (const VkDrawIndexedIndirectCommand& command : list.commands) {
+ m_FrameStats.triangles += static_cast<uint64_t>(command.indexCount /3) * command.instanceCount;
+ }
+ VkCommandBuffer cmd = m_DrawCommandBuffer;
+ const VkDeviceSize zeroOffset =0;
 
- EndTransientCommandBuffer(transient_commands);
+ if (!IsInstancingSupported()) {
+ // No per-instance input: one push constant and draw per instance
+ vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineNoCull != VK_NULL_HANDLE ? m_PipelineNoCull : m_Pipeline);
+ vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,0,1, &m_DescriptorSets[m_CurrentFrame],0, nullptr);
+ uint32_t drawScope = m_GpuProfiler->BeginScope(cmd, "Draw");
+ for (const MeshPool::PageBatch& batch : list.batches) {
+ const VkBuffer vertexBuffer = m_MeshPool->GetVertexBuffer(batch.page);
+ vkCmdBindVertexBuffers(cmd,0,1, &vertexBuffer, &zeroOffset);
+ vkCmdBindIndexBuffer(cmd, m_MeshPool->GetIndexBuffer(batch.page),0, VK_INDEX_TYPE_UINT32);
+ for (uint32_t c = batch.firstCommand; c < batch.firstCommand + batch.commandCount; ++c) {
+ const VkDrawIndexedIndirectCommand& command = list.commands[c];
+ for (uint32_t i =0; i < command.instanceCount; ++i) {
+ vkCmdPushConstants(cmd, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,0, sizeof(glm::mat4), &list.instances[command.firstInstance + i].transformation);
+ vkCmdDrawIndexed(cmd, command.indexCount,1, command.firstIndex, command.vertexOffset,0);
+ }
+ }
+ }
+ m_GpuProfiler->EndScope(cmd, drawScope);
+ return;
+ }
 
- DestroyBuffer(staging_handle);
+ VkBuffer instanceBuffer = VK_NULL_HANDLE;
+ const VkDeviceSize instanceOffset = WriteStream(m_InstanceBuffers[m_CurrentFrame], list.instances.data(), list.instances.size_bytes(), instanceBuffer);
 
- return gpu_handle;
-}
+ vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_InstancedPipeline);
+ vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,0,1, &m_DescriptorSets[m_CurrentFrame],0, nullptr);
+ vkCmdBindVertexBuffers(cmd, InstanceData::kBinding,1, &instanceBuffer, &instanceOffset);
 
-void WalnutGraphics::DestroyBuffer(BufferHandle handle) {
- if (handle.buffer != VK_NULL_HANDLE) {
- vkDestroyBuffer(m_Device, handle.buffer, nullptr);
+ uint32_t drawScope = m_GpuProfiler->BeginScope(cmd, "Draw");
+ if (IsMultiDrawIndirectSupported()) {
+ VkBuffer indirectBuffer = VK_NULL_HANDLE;
+ const VkDeviceSize indirectOffset = WriteStream(m_IndirectBuffers[m_CurrentFrame], list.commands.data(), list.commands.size_bytes(), indirectBuffer);
+ for (const MeshPool::PageBatch& batch : list.batches) {
+ const VkBuffer vertexBuffer = m_MeshPool->GetVertexBuffer(batch.page);
+ vkCmdBindVertexBuffers(cmd,0,1, &vertexBuffer, &zeroOffset);
+ vkCmdBindIndexBuffer(cmd, m_MeshPool->GetIndexBuffer(batch.page),0, VK_INDEX_TYPE_UINT32);
+ for (uint32_t first =0; first < batch.commandCount; first += m_MaxDrawIndirectCount) {
+ const uint32_t count = std::min(batch.commandCount - first, m_MaxDrawIndirectCount);
+ const VkDeviceSize offset = indirectOffset + static_cast<VkDeviceSize>(batch.firstCommand + first) * sizeof(VkDrawIndexedIndirectCommand);
+ vkCmdDrawIndexedIndirect(cmd, indirectBuffer, offset, count, sizeof(VkDrawIndexedIndirectCommand));
  }
- if (handle.memory != VK_NULL_HANDLE) {
- vkFreeMemory(m_Device, handle.memory, nullptr);
  }
+ } else {
+ // Same commands, recorded directly; still no rebinding between meshes
+ for (const MeshPool::PageBatch& batch : list.batches) {
+ const VkBuffer vertexBuffer = m_MeshPool->GetVertexBuffer(batch.page);
+ vkCmdBindVertexBuffers(cmd,0,1, &vertexBuffer, &zeroOffset);
+ vkCmdBindIndexBuffer(cmd, m_MeshPool->GetIndexBuffer(batch.page),0, VK_INDEX_TYPE_UINT32);
+ for (uint32_t c = batch.firstCommand; c < batch.firstCommand + batch.commandCount; ++c) {
+ const VkDrawIndexedIndirectCommand& command = list.commands[c];
+ vkCmdDrawIndexed(cmd, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+ }
+ }
+ }
+ m_GpuProfiler->EndScope(cmd, drawScope);
 }
 
-std::uint32_t WalnutGraphics::FindMemoryType(std::uint32_t type_bits_filter, VkMemoryPropertyFlags required_properties) {
- VkPhysicalDeviceMemoryProperties memProperties;
- vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &memProperties);
+void WalnutGraphics::RenderMeshlets(BufferHandle vertex_buffer, BufferHandle index_buffer, const MeshletMesh& mesh) {
+ if (mesh.meshlets.empty()) {
+ return;
+ }
+ if (m_Pipeline == VK_NULL_HANDLE) {
+ std::cout << "WARNING: Skipping render - pipeline not ready" << std::endl;
+ return;
+ }
+ if (vertex_buffer.buffer == VK_NULL_HANDLE || index_buffer.buffer == VK_NULL_HANDLE) {
+ std::cout << "WARNING: Invalid buffers - vertex:" << (vertex_buffer.buffer != VK_NULL_HANDLE)
+ << " index:" << (index_buffer.buffer != VK_NULL_HANDLE) << std::endl;
+ return;
+ }
 
- for (uint32_t i =0; i < memProperties.memoryTypeCount; i++) {
- if ((type_bits_filter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & required_properties) == required_properties) {
- return i;
+ // Meshlets are back to back in the index buffer, so a run of visible ones
+ // is one command
+ m_MeshletCommands.clear();
+ auto append = [&](const Meshlet& meshlet) {
+ if (!m_MeshletCommands.empty()) {
+ VkDrawIndexedIndirectCommand& last = m_MeshletCommands.back();
+ if (last.firstIndex + last.indexCount == meshlet.firstIndex) {
+ last.indexCount += meshlet.triangleCount *3;
+ return;
+ }
  }
+ m_MeshletCommands.push_back({ meshlet.triangleCount *3,1, meshlet.firstIndex,0,0 });
+ };
+
+ if (m_FrustumCulling) {
+ const auto cullStart = std::chrono::steady_clock::now();
+ // Bounds stay in object space: the frustum of the whole transform, the
+ // camera brought back through the model matrix
+ const glm::mat4 modelView = m_Transformations.view * m_CurrentModel;
+ const Frustum frustum = Frustum::FromViewProjection(m_Transformations.projection * modelView);
+ const glm::vec3 camera = glm::vec3(glm::inverse(modelView)[3]);
+ m_VisibleIndices.clear();
+ const uint32_t visible = CullClusters(frustum, camera, mesh.cullingSet, m_VisibleIndices, m_CullKernel);
+ for (uint32_t index : m_VisibleIndices) {
+ append(mesh.meshlets[index]);
+ }
+ m_FrameStats.clustersTested += static_cast<uint32_t>(mesh.meshlets.size());
+ m_FrameStats.clustersVisible += visible;
+ m_FrameStats.cullMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cullStart).count();
+ if (m_MeshletCommands.empty()) {
+ return;
+ }
+ } else {
+ for (const Meshlet& meshlet : mesh.meshlets) {
+ append(meshlet);
  }
+ }
+ for (const VkDrawIndexedIndirectCommand& command : m_MeshletCommands) {
+ m_FrameStats.triangles += command.indexCount /3;
+ }
+
+ VkCommandBuffer cmd = m_DrawCommandBuffer;
+ const VkDeviceSize zeroOffset =0;
+ // The pipeline and culling of RenderIndexedBuffer's queued draws
+ vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineNoCull != VK_NULL_HANDLE ? m_PipelineNoCull : m_Pipeline);
+ vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,0,1, &m_DescriptorSets[m_CurrentFrame],0, nullptr);
+ vkCmdBindVertexBuffers(cmd,0,1, &vertex_buffer.buffer, &zeroOffset);
+ vkCmdBindIndexBuffer(cmd, index_buffer.buffer,0, VK_INDEX_TYPE_UINT32);
+ vkCmdPushConstants(cmd, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,0, sizeof(glm::mat4), &m_CurrentModel);
 
- throw std::runtime_error("Failed to find suitable memory type!");
+ uint32_t drawScope = m_GpuProfiler->BeginScope(cmd, "Draw");
+ const uint32_t commandCount = static_cast<uint32_t>(m_MeshletCommands.size());
+ if (m_MultiDrawIndirect) {
+ VkBuffer indirectBuffer = VK_NULL_HANDLE;
+ const VkDeviceSize indirectOffset = WriteStream(m_IndirectBuffers[m_CurrentFrame], m_MeshletCommands.data(),
+ m_MeshletCommands.size() * sizeof(VkDrawIndexedIndirectCommand), indirectBuffer);
+ for (uint32_t first =0; first < commandCount; first += m_MaxDrawIndirectCount) {
+ const uint32_t count = std::min(commandCount - first, m_MaxDrawIndirectCount);
+ vkCmdDrawIndexedIndirect(cmd, indirectBuffer, indirectOffset + static_cast<VkDeviceSize>(first) * sizeof(VkDrawIndexedIndirectCommand), count, sizeof(VkDrawIndexedIndirectCommand));
+ }
+ } else {
+ for (const VkDrawIndexedIndirectCommand& command : m_MeshletCommands) {
+ vkCmdDrawIndexed(cmd, command.indexCount,1, command.firstIndex,0,0);
+ }
+ }
+ m_GpuProfiler->EndScope(cmd, drawScope);
 }
 
-BufferHandle WalnutGraphics::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
- BufferHandle handle = {};
+GpuObjectHandle WalnutGraphics::AddGpuObject(MeshHandle mesh, const InstanceData& instance) {
+ return m_GpuCulling->Add(mesh, instance);
+}
 
- VkBufferCreateInfo buffer_info = {};
- buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
- buffer_info.size = size;
- buffer_info.usage = usage;
- buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+void WalnutGraphics::UpdateGpuObject(GpuObjectHandle object, const InstanceData& instance) {
+ m_GpuCulling->Update(object, instance);
+}
 
- VkResult result = vkCreateBuffer(m_Device, &buffer_info, nullptr, &handle.buffer);
- if (result != VK_SUCCESS) {
- throw std::runtime_error("Failed to create buffer!");
+void WalnutGraphics::RemoveGpuObject(GpuObjectHandle object) {
+ m_GpuCulling->Remove(object);
+}
+
+void WalnutGraphics::RenderGpuObjects() {
+ if (m_GpuCulling->GetObjectCount() ==0) {
+ return;
+ }
+ if (!IsGpuCullingSupported()) {
+ const std::span<const MeshHandle> meshes = m_GpuCulling->GetMeshes();
+ const std::span<const InstanceData> instances = m_GpuCulling->GetInstances();
+ m_GpuObjectDraws.resize(meshes.size());
+ for (size_t i =0; i < meshes.size(); ++i) {
+ m_GpuObjectDraws[i] = { meshes[i], instances[i] };
+ }
+ RenderPoolMeshes(m_GpuObjectDraws);
+ return;
  }
 
- VkMemoryRequirements memory_requirements;
- vkGetBufferMemoryRequirements(m_Device, handle.buffer, &memory_requirements);
+ // The first call of the frame brings the GPU copy up to date; the dispatch
+ // is recorded at EndFrame
+ if (!m_GpuCulling->IsPrepared() && !m_GpuCulling->Prepare(m_UniformBuffers[m_CurrentFrame].buffer, m_OcclusionCulling && IsOcclusionCullingSupported())) {
+ return;
+ }
+ RecordGpuObjectDraws(m_DrawCommandBuffer, false);
+}
 
- std::uint32_t chosen_memory_type = FindMemoryType(memory_requirements.memoryTypeBits, properties);
+// The early draws of GPU objects, or with `late` those of the late phase
+void WalnutGraphics::RecordGpuObjectDraws(VkCommandBuffer cmd, bool late) {
+ const VkDeviceSize zeroOffset =0;
+ const VkBuffer commandBuffer = m_GpuCulling->GetCommandBuffer();
+ const VkBuffer countBuffer = m_GpuCulling->GetCountBuffer();
+ const VkBuffer instanceBuffer = m_GpuCulling->GetInstanceBuffer();
+ vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_InstancedPipeline);
+ vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,0,1, &m_DescriptorSets[m_CurrentFrame],0, nullptr);
+ vkCmdBindVertexBuffers(cmd, InstanceData::kBinding,1, &instanceBuffer, &zeroOffset);
+
+ uint32_t drawScope = m_GpuProfiler->BeginScope(cmd, "Draw");
+ for (const GpuCulling::PageDraws& page : m_GpuCulling->GetPageDraws()) {
+ const VkBuffer vertexBuffer = m_MeshPool->GetVertexBuffer(page.page);
+ vkCmdBindVertexBuffers(cmd,0,1, &vertexBuffer, &zeroOffset);
+ vkCmdBindIndexBuffer(cmd, m_MeshPool->GetIndexBuffer(page.page),0, VK_INDEX_TYPE_UINT32);
+ const VkDeviceSize commandOffset = late ? page.lateCommandOffset : page.commandOffset;
+ if (m_CmdDrawIndexedIndirectCount && page.maxDraws <= m_MaxDrawIndirectCount) {
+ m_CmdDrawIndexedIndirectCount(cmd, commandBuffer, commandOffset, countBuffer, late ? page.lateCountOffset : page.countOffset, page.maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+ continue;
+ }
+ // Every slot of the range; the dispatch zeroes them first, so the ones
+ // no visible object filled draw nothing
+ m_GpuCullingZeroCommands = true;
+ for (uint32_t first =0; first < page.maxDraws; first += m_MaxDrawIndirectCount) {
+ const uint32_t count = std::min(page.maxDraws - first, m_MaxDrawIndirectCount);
+ vkCmdDrawIndexedIndirect(cmd, commandBuffer, commandOffset + static_cast<VkDeviceSize>(first) * sizeof(VkDrawIndexedIndirectCommand), count, sizeof(VkDrawIndexedIndirectCommand));
+ }
+ }
+ m_GpuProfiler->EndScope(cmd, drawScope);
+}
 
- VkMemoryAllocateInfo allocation_info = {};
- allocation_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
- allocation_info.allocationSize = memory_requirements.size;
- allocation_info.memoryTypeIndex = chosen_memory_type;
+// After the frame's render pass: builds the depth pyramid from what it drew,
+// runs the late culling phase against it and draws its objects in the late
+// render pass. Nothing without GPU objects drawn with occlusion culling.
+void WalnutGraphics::RecordLateGpuObjects(VkCommandBuffer cmd) {
+ if (!m_GpuCulling->IsOcclusionPrepared()) {
+ return;
+ }
+ RenderTarget& target = m_RenderTargets[m_CurrentFrame];
+ uint32_t occlusionScope = m_GpuProfiler->BeginScope(cmd, "Occlusion culling");
+ m_DepthPyramid->Record(cmd, m_CurrentFrame, target.depthImage);
+ m_GpuCulling->RecordLateCulling(cmd, m_FrustumCulling);
+ m_GpuProfiler->EndScope(cmd, occlusionScope);
 
- VkResult allocation_result = vkAllocateMemory(m_Device, &allocation_info, nullptr, &handle.memory);
+ VkRenderPassBeginInfo renderPassInfo{};
+ renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+ renderPassInfo.renderPass = m_LateRenderPass;
+ renderPassInfo.framebuffer = target.framebuffer;
+ renderPassInfo.renderArea.offset = {0,0};
+ renderPassInfo.renderArea.extent = { m_RenderWidth, m_RenderHeight };
+ uint32_t lateScope = m_GpuProfiler->BeginScope(cmd, "Late pass");
+ vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+ VkViewport viewport = GetViewport();
+ vkCmdSetViewport(cmd,0,1, &viewport);
+ VkRect2D scissor = GetScissor();
+ vkCmdSetScissor(cmd,0,1, &scissor);
+ RecordGpuObjectDraws(cmd, true);
+ vkCmdEndRenderPass(cmd);
+ m_GpuProfiler->EndScope(cmd, lateScope);
+}
+
+// Copies into a per-frame stream buffer and returns the offset of the copy.
+// The buffer lives in the allocator's arena of the frame, created by the
+// frame's first write with the capacity the last frame needed. Growing
+// replaces it: draws recorded earlier this frame still use the old one, so it
+// is only destroyed once the frame has retired.
+VkDeviceSize WalnutGraphics::WriteStream(StreamBuffer& stream, const void* data, VkDeviceSize size, VkBuffer& buffer) {
+ if (stream.buffer.buffer == VK_NULL_HANDLE || stream.used + size > stream.capacity) {
+ if (stream.buffer.buffer != VK_NULL_HANDLE) {
+ stream.retired.push_back(stream.buffer);
+ stream.capacity *=2;
+ }
+ stream.capacity = std::max<VkDeviceSize>({ stream.capacity, size,64 *1024 });
+ stream.buffer = CreateBuffer(stream.capacity, stream.usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, AllocationLifetime::Frame);
+ stream.used =0;
+ }
+
+ const VkDeviceSize offset = stream.used;
+ std::memcpy(static_cast<char*>(stream.buffer.allocation.mapped) + offset, data, size);
+ m_Allocator->Flush(stream.buffer.allocation);
+ // Attribute fetches and indirect commands are 4-byte aligned; keep every copy at 16
+ stream.used = (offset + size +15) & ~VkDeviceSize(15);
+ buffer = stream.buffer.buffer;
+ return offset;
+}
 
- if (allocation_result != VK_SUCCESS) {
- throw std::runtime_error("Failed to allocate buffer memory!");
+// After the allocator has recycled the slot's arena: the buffers' memory is
+// gone, so the buffers go too; `capacity` stays as the size of the next one
+void WalnutGraphics::ReleaseStreamBuffers(StreamBuffer& stream) {
+ for (BufferHandle& retired : stream.retired) {
+ DestroyBuffer(retired);
  }
+ stream.retired.clear();
+ if (stream.buffer.buffer != VK_NULL_HANDLE) {
+ DestroyBuffer(stream.buffer);
+ }
+ stream.buffer = {};
+ stream.used =0;
+}
 
- vkBindBufferMemory(m_Device, handle.buffer, handle.memory,0);
+void WalnutGraphics::DestroyStreamBuffers(StreamBuffer& stream) {
+ ReleaseStreamBuffers(stream);
+ stream.capacity =0;
+}
 
- return handle;
+// The copy is recorded into the upload context's open batch. With a dedicated
+// transfer queue the buffer belongs to the transfer family until the batch's
+// acquire has run, so it may only be drawn once IsUploadReady reports the
+// GetPendingUploadTicket taken after this call ready.
+BufferHandle WalnutGraphics::CreateDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage) {
+ BufferHandle gpu_handle = CreateBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+ m_Uploads->UploadBuffer(gpu_handle.buffer,0, data, size);
+ return gpu_handle;
 }
 
-VkCommandBuffer WalnutGraphics::BeginTransientCommandBuffer() {
- VkCommandBufferAllocateInfo allocation_info = {};
- allocation_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
- allocation_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
- allocation_info.commandPool = m_CommandPool;
- allocation_info.commandBufferCount =1;
+BufferHandle WalnutGraphics::CreateVertexBuffer(gsl::span<const Vertex> vertices) {
+ VkDeviceSize size = static_cast<VkDeviceSize>(GpuVertexLayout::kStride) * vertices.size();
+ if constexpr (std::is_same_v<GpuVertexLayout, FullVertexLayout>) {
+ return CreateDeviceLocalBuffer(vertices.data(), size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+ } else {
+ // Staging copies the data right away, so the packed vertices are temporary
+ std::vector<std::byte> packed(size);
+ GpuVertexLayout::Pack(vertices, packed.data());
+ return CreateDeviceLocalBuffer(packed.data(), size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+ }
+}
 
- VkCommandBuffer buffer;
- vkAllocateCommandBuffers(m_Device, &allocation_info, &buffer);
+BufferHandle WalnutGraphics::CreateIndexBuffer(gsl::span<const std::uint32_t> indices) {
+ VkDeviceSize size = sizeof(std::uint32_t) * indices.size();
+ return CreateDeviceLocalBuffer(indices.data(), size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+}
 
- VkCommandBufferBeginInfo begin_info = {};
- begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
- begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+UploadTicket WalnutGraphics::GetPendingUploadTicket() const {
+ return m_Uploads->GetCurrentTicket();
+}
+
+std::vector<GpuScopeStats> WalnutGraphics::GetGpuTimings() const {
+ if (!m_GpuProfiler) {
+ return {};
+ }
+ return m_GpuProfiler->GetStats();
+}
 
- vkBeginCommandBuffer(buffer, &begin_info);
+bool WalnutGraphics::IsUploadReady(UploadTicket ticket) {
+ return m_Uploads->IsReady(ticket);
+}
 
- return buffer;
+bool WalnutGraphics::IsUploadComplete(UploadTicket ticket) {
+ return m_Uploads->IsComplete(ticket);
 }
 
-void WalnutGraphics::EndTransientCommandBuffer(VkCommandBuffer command_buffer) {
- vkEndCommandBuffer(command_buffer);
+void WalnutGraphics::WaitForUploads(UploadTicket ticket) {
+ m_Uploads->Wait(ticket);
+}
+
+UploadBenchmarkResult WalnutGraphics::RunUploadBenchmark(VkDeviceSize totalBytes, VkDeviceSize chunkSize) {
+ UploadBenchmarkResult result{};
+ result.transferQueueAvailable = m_Uploads->HasDedicatedTransferQueue();
+
+ const uint32_t chunkCount = static_cast<uint32_t>(std::max<VkDeviceSize>(totalBytes / chunkSize,1));
+ // Submit in half-ring batches so copies keep streaming while the next batch is staged
+ const uint32_t chunksPerBatch = static_cast<uint32_t>(std::max<VkDeviceSize>((32ull *1024 *1024) / chunkSize,1));
+ result.bytes = static_cast<uint64_t>(chunkCount) * chunkSize;
+ std::vector<uint8_t> data(static_cast<size_t>(chunkSize),0x5a);
+ uint32_t graphicsFamily = m_GraphicsQueueFamily;
+
+ vkDeviceWaitIdle(m_Device);
+
+ auto runPath = [&](VkQueue transferQueue, uint32_t transferFamily, double& totalMs, double& probeMs) {
+ std::vector<BufferHandle> buffers;
+ buffers.reserve(chunkCount);
+ for (uint32_t i =0; i < chunkCount; ++i) {
+ buffers.push_back(CreateBuffer(chunkSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+ }
+
+ {
+ UploadContext uploads(m_Device, *m_Allocator, m_GraphicsQueue, graphicsFamily, transferQueue, transferFamily);
+ auto start = std::chrono::steady_clock::now();
+ for (uint32_t i =0; i < chunkCount; ++i) {
+ uploads.UploadBuffer(buffers[i].buffer,0, data.data(), chunkSize);
+ if ((i +1) % chunksPerBatch ==0) {
+ uploads.Submit();
+ }
+ }
+ uploads.Submit();
+
+ // An empty submission stands in for a frame queued behind the uploads
+ VkFenceCreateInfo fenceInfo{};
+ fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+ VkFence probe = VK_NULL_HANDLE;
+ vkCreateFence(m_Device, &fenceInfo, nullptr, &probe);
+ auto probeStart = std::chrono::steady_clock::now();
+ vkQueueSubmit(m_GraphicsQueue,0, nullptr, probe);
+ vkWaitForFences(m_Device,1, &probe, VK_TRUE, UINT64_MAX);
+ probeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - probeStart).count();
+ vkDestroyFence(m_Device, probe, nullptr);
+
+ uploads.WaitIdle();
+ totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+ }
 
- VkSubmitInfo submit_info = {};
- submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
- submit_info.commandBufferCount =1;
- submit_info.pCommandBuffers = &command_buffer;
+ for (BufferHandle& buffer : buffers) {
+ DestroyBuffer(buffer);
+ }
+ };
 
- vkQueueSubmit(m_GraphicsQueue,1, &submit_info, VK_NULL_HANDLE);
- vkQueueWaitIdle(m_GraphicsQueue);
+ runPath(VK_NULL_HANDLE, graphicsFamily, result.graphicsQueueMs, result.graphicsQueueProbeMs);
+ if (result.transferQueueAvailable) {
+ runPath(m_TransferQueue, m_TransferQueueFamily, result.transferQueueMs, result.transferQueueProbeMs);
+ }
+ return result;
+}
+
+void WalnutGraphics::DestroyBuffer(BufferHandle handle) {
+ if (handle.buffer != VK_NULL_HANDLE) {
+ vkDestroyBuffer(m_Device, handle.buffer, nullptr);
+ }
+ if (m_Allocator) {
+ m_Allocator->Free(handle.allocation);
+ }
+}
 
- vkFreeCommandBuffers(m_Device, m_CommandPool,1, &command_buffer);
+std::uint32_t WalnutGraphics::FindMemoryType(std::uint32_t type_bits_filter, VkMemoryPropertyFlags required_properties) {
+ return m_Allocator->FindMemoryType(type_bits_filter, required_properties);
 }
 
-uint32_t WalnutGraphics::FindGraphicsQueueFamily() {
- uint32_t queueFamilyCount =0;
- vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queueFamilyCount, nullptr);
+AllocatorStats WalnutGraphics::GetMemoryStats() const {
+ return m_Allocator ? m_Allocator->GetStats() : AllocatorStats{};
+}
 
- std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
- vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queueFamilyCount, queueFamilies.data());
+BufferHandle WalnutGraphics::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, AllocationLifetime lifetime) {
+ BufferHandle handle = {};
 
- for (uint32_t i =0; i < queueFamilyCount; i++) {
- if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
- return i;
+ VkBufferCreateInfo buffer_info = {};
+ buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+ buffer_info.size = size;
+ buffer_info.usage = usage;
+ buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+ VkResult result = vkCreateBuffer(m_Device, &buffer_info, nullptr, &handle.buffer);
+ if (result != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create buffer!");
  }
+
+ try {
+ handle.allocation = m_Allocator->AllocateForBuffer(handle.buffer, properties, lifetime);
+ } catch (...) {
+ vkDestroyBuffer(m_Device, handle.buffer, nullptr);
+ throw;
  }
 
- throw std::runtime_error("Failed to find graphics queue family!");
+ return handle;
 }
 
 std::vector<char> WalnutGraphics::ReadFile(const std::string& filename) {
  std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
  if (!file.is_open()) {
- char exePath[MAX_PATH];
- DWORD len = GetModuleFileNameA(nullptr, exePath, MAX_PATH);
- if (len >0 && len < MAX_PATH) {
- std::filesystem::path p(exePath);
- std::filesystem::path alt = p.parent_path() / filename;
+ std::filesystem::path exeDir = GetExecutableDirectory();
+ if (!exeDir.empty()) {
+ std::filesystem::path alt = exeDir / filename;
  file.open(alt.string(), std::ios::ate | std::ios::binary);
  }
  }
@@ -1149,39 +2138,51 @@ VkShaderModule WalnutGraphics::CreateShaderModule(const std::vector<char>& code)
  return shaderModule;
 }
 
-void WalnutGraphics::CleanupRenderTargets() {
- if (m_Framebuffer != VK_NULL_HANDLE) {
- vkDestroyFramebuffer(m_Device, m_Framebuffer, nullptr);
- m_Framebuffer = VK_NULL_HANDLE;
+void WalnutGraphics::CleanupRenderTarget(RenderTarget& target) {
+ if (target.readbackBuffer.buffer != VK_NULL_HANDLE) {
+ DestroyBuffer(target.readbackBuffer);
+ target.readbackBuffer = {};
  }
+ target.readbackPending = false;
 
- if (m_ColorImageView != VK_NULL_HANDLE) {
- vkDestroyImageView(m_Device, m_ColorImageView, nullptr);
- m_ColorImageView = VK_NULL_HANDLE;
+ if (target.framebuffer != VK_NULL_HANDLE) {
+ vkDestroyFramebuffer(m_Device, target.framebuffer, nullptr);
+ target.framebuffer = VK_NULL_HANDLE;
  }
- if (m_ColorImage != VK_NULL_HANDLE) {
- vkDestroyImage(m_Device, m_ColorImage, nullptr);
- m_ColorImage = VK_NULL_HANDLE;
+
+ if (target.colorImageView != VK_NULL_HANDLE) {
+ vkDestroyImageView(m_Device, target.colorImageView, nullptr);
+ target.colorImageView = VK_NULL_HANDLE;
+ }
+ if (target.colorImage != VK_NULL_HANDLE) {
+ vkDestroyImage(m_Device, target.colorImage, nullptr);
+ target.colorImage = VK_NULL_HANDLE;
  }
- if (m_ColorImageMemory != VK_NULL_HANDLE) {
- vkFreeMemory(m_Device, m_ColorImageMemory, nullptr);
- m_ColorImageMemory = VK_NULL_HANDLE;
+ if (m_Allocator) {
+ m_Allocator->Free(target.colorImageMemory);
  }
 
- if (m_DepthImageView != VK_NULL_HANDLE) {
- vkDestroyImageView(m_Device, m_DepthImageView, nullptr);
- m_DepthImageView = VK_NULL_HANDLE;
+ if (target.depthImageView != VK_NULL_HANDLE) {
+ vkDestroyImageView(m_Device, target.depthImageView, nullptr);
+ target.depthImageView = VK_NULL_HANDLE;
  }
- if (m_DepthImage != VK_NULL_HANDLE) {
- vkDestroyImage(m_Device, m_DepthImage, nullptr);
- m_DepthImage = VK_NULL_HANDLE;
+ if (target.depthImage != VK_NULL_HANDLE) {
+ vkDestroyImage(m_Device, target.depthImage, nullptr);
+ target.depthImage = VK_NULL_HANDLE;
  }
- if (m_DepthImageMemory != VK_NULL_HANDLE) {
- vkFreeMemory(m_Device, m_DepthImageMemory, nullptr);
- m_DepthImageMemory = VK_NULL_HANDLE;
+ if (m_Allocator) {
+ m_Allocator->Free(target.depthImageMemory);
  }
+}
 
+void WalnutGraphics::CleanupRenderTargets() {
+ for (auto& target : m_RenderTargets) {
+ CleanupRenderTarget(target);
+ }
+
+#ifndef WL_HEADLESS
  m_RenderedImage.reset();
+#endif
 }
 
 void WalnutGraphics::RecreateRenderTargets() {
@@ -1191,6 +2192,9 @@ void WalnutGraphics::RecreateRenderTargets() {
 
  CreateRenderTargets();
  CreateFramebuffers();
+ if (m_DepthPyramid) {
+ ResizeDepthPyramid();
+ }
 }
 
 void WalnutGraphics::Resize(uint32_t width, uint32_t height) {
@@ -1217,11 +2221,7 @@ void WalnutGraphics::CreateDefaultTexture() {
  uint8_t pixel[4] = {255,255,255,255};
  VkDeviceSize imageSize =4;
 
- BufferHandle staging = CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
- void* data;
- vkMapMemory(m_Device, staging.memory,0, imageSize,0, &data);
- memcpy(data, pixel, static_cast<size_t>(imageSize));
- vkUnmapMemory(m_Device, staging.memory);
+ UploadContext::StagingSpan staging = m_Uploads->Stage(pixel, imageSize);
 
  VkImageCreateInfo imageInfo{};
  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1239,25 +2239,17 @@ void WalnutGraphics::CreateDefaultTexture() {
  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
  if (vkCreateImage(m_Device, &imageInfo, nullptr, &m_DefaultTextureImage) != VK_SUCCESS) {
- DestroyBuffer(staging);
  throw std::runtime_error("Failed to create default texture image");
  }
 
- VkMemoryRequirements memReq;
- vkGetImageMemoryRequirements(m_Device, m_DefaultTextureImage, &memReq);
- VkMemoryAllocateInfo alloc{};
- alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
- alloc.allocationSize = memReq.size;
- alloc.memoryTypeIndex = FindMemoryType(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
- if (vkAllocateMemory(m_Device, &alloc, nullptr, &m_DefaultTextureImageMemory) != VK_SUCCESS) {
- DestroyBuffer(staging);
+ try {
+ m_DefaultTextureImageMemory = m_Allocator->AllocateForImage(m_DefaultTextureImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+ } catch (...) {
  throw std::runtime_error("Failed to allocate default texture memory");
  }
 
- vkBindImageMemory(m_Device, m_DefaultTextureImage, m_DefaultTextureImageMemory,0);
-
- VkCommandBuffer cmd = BeginTransientCommandBuffer();
+ // Too small to be worth a queue ownership transfer: record it all on the graphics side
+ VkCommandBuffer cmd = m_Uploads->GetGraphicsCommandBuffer();
 
  VkImageMemoryBarrier barrier{};
  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1277,7 +2269,7 @@ void WalnutGraphics::CreateDefaultTexture() {
  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,0,0, nullptr,0, nullptr,1, &barrier);
 
  VkBufferImageCopy region{};
- region.bufferOffset =0;
+ region.bufferOffset = staging.offset;
  region.bufferRowLength =0;
  region.bufferImageHeight =0;
  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1296,8 +2288,6 @@ void WalnutGraphics::CreateDefaultTexture() {
 
  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,0,0, nullptr,0, nullptr,1, &barrier);
 
- EndTransientCommandBuffer(cmd);
-
  VkImageViewCreateInfo viewInfo{};
  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
  viewInfo.image = m_DefaultTextureImage;
@@ -1311,10 +2301,8 @@ void WalnutGraphics::CreateDefaultTexture() {
 
  if (vkCreateImageView(m_Device, &viewInfo, nullptr, &m_DefaultTextureImageView) != VK_SUCCESS) {
  vkDestroyImage(m_Device, m_DefaultTextureImage, nullptr);
- vkFreeMemory(m_Device, m_DefaultTextureImageMemory, nullptr);
+ m_Allocator->Free(m_DefaultTextureImageMemory);
  m_DefaultTextureImage = VK_NULL_HANDLE;
- m_DefaultTextureImageMemory = VK_NULL_HANDLE;
- DestroyBuffer(staging);
  throw std::runtime_error("Failed to create default texture image view");
  }
 
@@ -1339,15 +2327,15 @@ void WalnutGraphics::CreateDefaultTexture() {
  if (vkCreateSampler(m_Device, &samplerInfo, nullptr, &m_DefaultTextureSampler) != VK_SUCCESS) {
  vkDestroyImageView(m_Device, m_DefaultTextureImageView, nullptr);
  vkDestroyImage(m_Device, m_DefaultTextureImage, nullptr);
- vkFreeMemory(m_Device, m_DefaultTextureImageMemory, nullptr);
+ m_Allocator->Free(m_DefaultTextureImageMemory);
  m_DefaultTextureImageView = VK_NULL_HANDLE;
  m_DefaultTextureImage = VK_NULL_HANDLE;
- m_DefaultTextureImageMemory = VK_NULL_HANDLE;
- DestroyBuffer(staging);
  throw std::runtime_error("Failed to create default texture sampler");
  }
 
- DestroyBuffer(staging);
+ // Every descriptor set samples this from the first frame on, before a
+ // dedicated transfer queue would have handed anything over
+ m_Uploads->Wait(m_Uploads->GetCurrentTicket());
 }
 
 // Implementation of FindSupportedFormat from the tutorial
@@ -1413,10 +2401,10 @@ static void HelperTransitionImageLayout(VkCommandBuffer cmd, VkImage image, VkFo
  vkCmdPipelineBarrier(cmd, sourceStage, destinationStage,0,0, nullptr,0, nullptr,1, &barrier);
 }
 
-static void HelperCopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+static void HelperCopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height)
 {
  VkBufferImageCopy region{};
- region.bufferOffset =0;
+ region.bufferOffset = bufferOffset;
  region.bufferRowLength =0;
  region.bufferImageHeight =0;
  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1435,9 +2423,9 @@ void WalnutGraphics::TransitionImageLayout(VkCommandBuffer cmd, VkImage image, V
  HelperTransitionImageLayout(cmd, image, format, oldLayout, newLayout, mipLevels);
 }
 
-void WalnutGraphics::CopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void WalnutGraphics::CopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height)
 {
- HelperCopyBufferToImage(cmd, buffer, image, width, height);
+ HelperCopyBufferToImage(cmd, buffer, bufferOffset, image, width, height);
 }
 
 } // namespace veng
\ No newline at end of file
@@ -3,8 +3,23 @@
 #include "precomp.h"
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <chrono>
+#include <functional>
 #include "vertex.h"
+#include "culling.h"
+#include "instance_data.h"
+#include "mesh_importer.h"
+#include "meshlet.h"
+#include "mesh_pool.h"
+#include "gpu_culling.h"
+#include "depth_pyramid.h"
+#include "render_queue.h"
+#include "thread_pool.h"
 #include "buffer_handle.h"
+#include "device_allocator.h"
+#include "upload_context.h"
+#include "gpu_profiler.h"
+#include "graphics_device.h"
 #include "uniform_transformations.h"
 #include <glm/glm.hpp>
 
@@ -12,6 +27,64 @@ namespace veng {
 
 class Texture; // forward
 
+// Host-side timings for the most recent frame, used to visualise how much CPU
+// recording overlaps with GPU execution of the previous frame(s).
+struct FrameStats {
+  float cpuRecordMs = 0.0f;     // BeginFrame -> EndFrame submit
+  float fenceWaitMs = 0.0f;     // time blocked in BeginFrame waiting for a free frame slot
+  bool gpuBusyAtBegin = false;  // previous frame still executing when recording started
+  uint32_t framesInFlight = 0;  // submissions still pending on the GPU at BeginFrame
+  uint64_t overlappedFrames = 0;
+  uint64_t totalFrames = 0;
+  uint32_t readbackAllocations = 0;      // device allocations made by the readback path this frame (should stay 0)
+  uint64_t readbackFramesDelivered = 0;
+  uint32_t queuedDraws = 0;              // RenderIndexedBuffer draws sorted and recorded at EndFrame
+  uint32_t queueBinds = 0;               // pipeline, descriptor set, vertex and index buffer binds they needed
+  uint32_t queueBindsSaved = 0;          // binds skipped because the state was already bound
+  uint32_t recordingThreads = 0;         // command buffers the queued draws were split across
+  float queueRecordMs = 0.0f;            // sorting and recording the queued draws
+  uint32_t cullTested = 0;               // draws with bounds tested against the view frustum
+  uint32_t cullVisible = 0;              // of those, the ones submitted
+  float cullMs = 0.0f;                   // building the bounds and testing them
+  uint32_t clustersTested = 0;           // meshlets of RenderMeshlets tested against frustum and cone
+  uint32_t clustersVisible = 0;          // of those, the ones drawn
+  uint64_t triangles = 0;                // of queued, instanced, pooled and meshlet indexed draws
+  uint32_t gpuCullTested = 0;            // objects of RenderGpuObjects culled by the compute dispatch,
+  uint32_t gpuCullVisible = 0;           // and found visible; read back MAX_FRAMES_IN_FLIGHT frames late
+  uint32_t gpuCullLateVisible = 0;       // of those, drawn after the occlusion test of the late phase
+};
+
+// A completed CPU copy of a rendered frame. `pixels` points into a persistently
+// mapped readback buffer and is only valid for the duration of the callback.
+struct ReadbackFrame {
+  const uint8_t* pixels = nullptr; // tightly packed RGBA8
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t rowPitch = 0;
+  uint64_t frameIndex = 0;         // frame that produced the pixels
+};
+
+// Result of WalnutGraphics::RunUploadBenchmark. Each path uploads the same
+// data; the probe latency is how long an empty graphics queue submission took
+// to retire while the copies were running, i.e. what a frame would have waited.
+struct UploadBenchmarkResult {
+  uint64_t bytes = 0;
+  double graphicsQueueMs = 0.0;
+  double graphicsQueueProbeMs = 0.0;
+  bool transferQueueAvailable = false;
+  double transferQueueMs = 0.0;
+  double transferQueueProbeMs = 0.0;
+};
+
+// How the rendered frame reaches the ImGui viewport.
+// ZeroCopy samples the GPU color target directly through its own ImGui
+// descriptor; CpuReadback copies it to host memory and re-uploads it into a
+// Walnut::Image (slow, kept for comparison and CPU-side consumers).
+enum class DisplayMode {
+  ZeroCopy,
+  CpuReadback
+};
+
 class WalnutGraphics final {
  public:
   WalnutGraphics();
@@ -19,22 +92,137 @@ class WalnutGraphics final {
 
   static constexpr int MAX_FRAMES_IN_FLIGHT =2;
 
+#ifndef WL_HEADLESS
+  // Renders with the instance, device and queues of Walnut::Application
   bool Initialize();
+#endif
+  bool Initialize(const GraphicsDevice& device);
   void Shutdown();
 
   bool BeginFrame();
   void SetModelMatrix(glm::mat4 model);
+  // The camera reaches the frame's uniform buffer at the next BeginFrame, so
+  // set it before BeginFrame for it to show in that frame
   void SetViewProjection(glm::mat4 view, glm::mat4 projection);
   void RenderBuffer(BufferHandle handle, std::uint32_t vertex_count);
+  // Queued with the current model matrix. At EndFrame the queue is sorted by
+  // state (see sort_key) and recorded after everything drawn directly, only
+  // binding what changed between consecutive draws.
   void RenderIndexedBuffer(BufferHandle vertex_buffer, BufferHandle index_buffer, std::uint32_t count);
+  // The same, but skipped at EndFrame when `bounds` (object space, placed by
+  // the model matrix) is outside the frustum of the last SetViewProjection.
+  // Indices start at `first_index`, e.g. a MeshLod's range.
+  void RenderIndexedBuffer(BufferHandle vertex_buffer, BufferHandle index_buffer, std::uint32_t count, const Aabb& bounds, std::uint32_t first_index = 0);
+  // One draw of `instances.size()` copies; the per-instance data is copied into
+  // this frame's instance buffer, the model matrix set with SetModelMatrix is
+  // ignored. Without shaders/basic_instanced.vert.spv it falls back to one
+  // draw per instance (and ignores the instance colors).
+  void RenderIndexedInstanced(BufferHandle vertex_buffer, BufferHandle index_buffer, std::uint32_t count, gsl::span<const InstanceData> instances, std::uint32_t first_index = 0);
+  bool IsInstancingSupported() const { return m_InstancedPipeline != VK_NULL_HANDLE; }
+
+  // Meshes sharing a few large vertex and index buffers (see MeshPool). Like
+  // CreateVertexBuffer, they may be drawn once GetPendingUploadTicket is ready.
+  MeshHandle AddPoolMesh(gsl::span<const Vertex> vertices, gsl::span<const std::uint32_t> indices);
+  void RemovePoolMesh(MeshHandle mesh);
+  // Draws every pooled mesh in `draws` with one vkCmdDrawIndexedIndirect per
+  // pool page, each draw with its own InstanceData. Falls back to direct draws
+  // from the same buffers when the device lacks multiDrawIndirect or
+  // drawIndirectFirstInstance, and to push constants without the instanced shader.
+  // Draws whose mesh bounds are outside the view frustum are dropped first.
+  void RenderPoolMeshes(gsl::span<const MeshDraw> draws);
+  MeshPoolStats GetMeshPoolStats() const;
+  // Draws a mesh split by BuildMeshlets with the current model matrix, right
+  // away like RenderIndexedInstanced; `index_buffer` holds mesh.indices. With
+  // frustum culling on, meshlets outside the view frustum or facing away from
+  // the camera are dropped first (CullClusters, in object space). The rest are
+  // drawn with one vkCmdDrawIndexedIndirect, consecutive meshlets merged into
+  // one command, or with direct draws without multiDrawIndirect.
+  void RenderMeshlets(BufferHandle vertex_buffer, BufferHandle index_buffer, const MeshletMesh& mesh);
+  bool IsMultiDrawIndirectSupported() const { return m_MultiDrawIndirect && m_DrawIndirectFirstInstance && IsInstancingSupported(); }
+
+  // Pooled meshes that stay on the GPU between frames (see GpuCulling): added
+  // once and updated only when they change, they cost RenderGpuObjects no CPU
+  // work per object. A compute dispatch submitted ahead of the frame culls
+  // them against the frustum of the frame's last SetViewProjection and writes
+  // the draw commands and their count per pool page, read by one
+  // vkCmdDrawIndexedIndirectCount per page, or by vkCmdDrawIndexedIndirect
+  // over every slot without VK_KHR_draw_indirect_count. Changes made after
+  // RenderGpuObjects show from the next frame. Without
+  // shaders/gpu_cull.comp.spv or IsMultiDrawIndirectSupported() the objects go
+  // through RenderPoolMeshes instead.
+  // With occlusion culling the objects visible last frame are drawn first; at
+  // EndFrame a Hi-Z pyramid of the depth target (see DepthPyramid) then
+  // decides which of the others are hidden, and the rest are drawn in a
+  // second render pass over the same target.
+  GpuObjectHandle AddGpuObject(MeshHandle mesh, const InstanceData& instance);
+  void UpdateGpuObject(GpuObjectHandle object, const InstanceData& instance);
+  void RemoveGpuObject(GpuObjectHandle object);
+  void RenderGpuObjects();
+  bool IsGpuCullingSupported() const { return m_GpuCulling && m_GpuCulling->IsSupported() && IsMultiDrawIndirectSupported(); }
+  bool IsDrawIndirectCountSupported() const { return m_CmdDrawIndexedIndirectCount != nullptr; }
+  GpuCullingStats GetGpuCullingStats() const { return m_GpuCulling ? m_GpuCulling->GetStats() : GpuCullingStats{}; }
+  // Occlusion culling of RenderGpuObjects; on by default. Needs
+  // shaders/depth_pyramid.comp.spv. Takes effect at the next frame's first
+  // RenderGpuObjects.
+  void SetOcclusionCulling(bool enabled) { m_OcclusionCulling = enabled; }
+  bool IsOcclusionCullingEnabled() const { return m_OcclusionCulling; }
+  bool IsOcclusionCullingSupported() const { return IsGpuCullingSupported() && m_DepthPyramid && m_DepthPyramid->IsSupported(); }
   void EndFrame();
 
-  BufferHandle CreateVertexBuffer(gsl::span<Vertex> vertices);
-  BufferHandle CreateIndexBuffer(gsl::span<std::uint32_t> indices);
+  // Threads that record the sorted render queue, each into a secondary command
+  // buffer of its own. 0 uses every thread of the recording pool, 1 records the
+  // whole frame into the primary command buffer on the calling thread. Takes
+  // effect at the next BeginFrame.
+  void SetRecordingThreads(uint32_t threads) { m_RecordingThreads = threads; }
+  uint32_t GetRecordingThreads() const;
+
+  // Frustum culling of draws that come with bounds (see culling.h); on by default
+  void SetFrustumCulling(bool enabled) { m_FrustumCulling = enabled; }
+  bool IsFrustumCullingEnabled() const { return m_FrustumCulling; }
+  CullKernel GetCullKernel() const { return m_CullKernel; }
+
+  // Level of `lods` (see GenerateLods) for an object placed by `model`, seen
+  // with the camera of the last SetViewProjection: the coarsest whose error,
+  // scaled by the model's largest axis scale and projected at the distance of
+  // `center` (object space), covers at most GetLodErrorPixels() pixels of
+  // the render target
+  uint32_t SelectLod(gsl::span<const MeshLod> lods, const glm::mat4& model, const glm::vec3& center = glm::vec3(0.0f)) const;
+  void SetLodErrorPixels(float pixels) { m_LodErrorPixels = pixels; }
+  float GetLodErrorPixels() const { return m_LodErrorPixels; }
+
+  // Converts to GpuVertexLayout (vertex_layout.h) on the way to staging memory
+  BufferHandle CreateVertexBuffer(gsl::span<const Vertex> vertices);
+  BufferHandle CreateIndexBuffer(gsl::span<const std::uint32_t> indices);
   void DestroyBuffer(BufferHandle handle);
 
-  // Get the rendered image for display in ImGui
+  // Uploads are batched and submitted with the next frame. Everything
+  // created so far retires with this ticket (or an earlier one).
+  UploadTicket GetPendingUploadTicket() const;
+  // Resources of the ticket may be drawn from the next frame on. Always true
+  // without a dedicated transfer queue; with one, the copies must have finished.
+  bool IsUploadReady(UploadTicket ticket);
+  bool IsUploadComplete(UploadTicket ticket);
+  void WaitForUploads(UploadTicket ticket);
+  const UploadStats& GetUploadStats() const { return m_Uploads->GetStats(); }
+
+  // Per-scope GPU time of recent frames (render pass, draws, readback, uploads)
+  std::vector<GpuScopeStats> GetGpuTimings() const;
+  bool IsGpuTimingSupported() const { return m_GpuProfiler && m_GpuProfiler->IsSupported(); }
+
+  // Uploads `totalBytes` into device-local buffers through the graphics queue
+  // and, if present, the dedicated transfer queue. Blocks until both are done.
+  UploadBenchmarkResult RunUploadBenchmark(VkDeviceSize totalBytes, VkDeviceSize chunkSize);
+
+#ifndef WL_HEADLESS
+  // Get the rendered image for display in ImGui (only valid in CpuReadback mode)
   std::shared_ptr<Walnut::Image> GetRenderedImage() const { return m_RenderedImage; }
+#endif
+
+  // Texture to pass to ImGui::Image for the current display mode (none when headless)
+  VkDescriptorSet GetViewportTexture() const;
+
+  void SetDisplayMode(DisplayMode mode);
+  DisplayMode GetDisplayMode() const { return m_PendingDisplayMode; }
 
   void Resize(uint32_t width, uint32_t height);
 
@@ -44,6 +232,16 @@ class WalnutGraphics final {
   uint32_t GetRenderWidth() const;
   uint32_t GetRenderHeight() const;
 
+  const FrameStats& GetFrameStats() const { return m_FrameStats; }
+  AllocatorStats GetMemoryStats() const;
+
+  // Receive a CPU copy of every rendered frame, MAX_FRAMES_IN_FLIGHT frames
+  // after it was submitted. Pass an empty function to stop reading back.
+  using ReadbackCallback = std::function<void(const ReadbackFrame&)>;
+  void SetReadbackCallback(ReadbackCallback callback);
+  // Block until all submitted frames are done and deliver their pending copies
+  void FlushReadbacks();
+
   // Texture loading - delegates to Texture helper
   void LoadTextureFromFile(const std::string& filename);
 
@@ -61,73 +259,224 @@ class WalnutGraphics final {
   void CreateDescriptorPool();
   void CreateDescriptorSet();
   void CreateUniformBuffers();
+  void CreateGpuCulling();
+  void ResizeDepthPyramid();
+  void RecordGpuObjectDraws(VkCommandBuffer cmd, bool late);
+  void RecordLateGpuObjects(VkCommandBuffer cmd);
 
   void BeginCommands();
   void EndCommands();
+  void FlushRenderQueue(VkCommandBuffer cmd);
+  bool PrepareQueuedDraw(BufferHandle vertex_buffer, BufferHandle index_buffer, std::uint32_t count, std::uint32_t first_index, QueuedDraw& draw);
+  float GetViewDepth(const glm::mat4& model) const;
+  void CullPendingDraws();
+  uint32_t RecordQueuedDraws(VkCommandBuffer cmd, std::span<const SortEntry> entries) const;
+  void BeginSecondaryCommandBuffer(VkCommandBuffer cmd);
+  void EnsureRecordingContexts(uint32_t count);
   void CreateDefaultTexture();
 
   std::vector<char> ReadFile(const std::string& filename);
   VkShaderModule CreateShaderModule(const std::vector<char>& code);
   std::uint32_t FindMemoryType(std::uint32_t type_bits_filter, VkMemoryPropertyFlags required_properties);
-  BufferHandle CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
-  VkCommandBuffer BeginTransientCommandBuffer();
-  void EndTransientCommandBuffer(VkCommandBuffer command_buffer);
-  
-  uint32_t FindGraphicsQueueFamily();
+  BufferHandle CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, AllocationLifetime lifetime = AllocationLifetime::Persistent);
+  BufferHandle CreateDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage);
+  void PromotePendingTexture();
 
   VkViewport GetViewport();
   VkRect2D GetScissor();
 
   // Helpers used by Texture for layout transitions and buffer->image copies
   void TransitionImageLayout(VkCommandBuffer cmd, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-  void CopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+  void CopyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height);
 
-  // Walnut/Vulkan objects (obtained from Walnut Application)
+  // Vulkan objects (from Walnut Application, or a HeadlessDevice); not owned
   VkInstance m_Instance = VK_NULL_HANDLE;
   VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
   VkDevice m_Device = VK_NULL_HANDLE;
+  uint32_t m_GraphicsQueueFamily = 0;
   VkQueue m_GraphicsQueue = VK_NULL_HANDLE;
+  VkQueue m_TransferQueue = VK_NULL_HANDLE;   // same as m_GraphicsQueue without a dedicated family
+  uint32_t m_TransferQueueFamily = 0;
+
+  // Sub-allocates every buffer and image the engine creates
+  std::unique_ptr<DeviceAllocator> m_Allocator;
+  // Batches staging copies for buffers and textures into few submissions
+  std::unique_ptr<UploadContext> m_Uploads;
+  // Timestamp queries around the frame's passes, resolved a few frames late
+  std::unique_ptr<GpuProfiler> m_GpuProfiler;
+  uint32_t m_FrameScope = UINT32_MAX;
+  uint32_t m_RenderPassScope = UINT32_MAX;
+
+  // One color/depth target per frame in flight so frame N+1 can be recorded
+  // and executed while frame N is still being rendered or sampled by ImGui.
+  struct RenderTarget {
+    VkImage colorImage = VK_NULL_HANDLE;
+    Allocation colorImageMemory;
+    VkImageView colorImageView = VK_NULL_HANDLE;
+
+    VkImage depthImage = VK_NULL_HANDLE;
+    Allocation depthImageMemory;
+    VkImageView depthImageView = VK_NULL_HANDLE;
+
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+    // Host copy of colorImage, filled by this frame's command buffer and read
+    // back the next time the slot's fence is waited on.
+    BufferHandle readbackBuffer{};
+    bool readbackPending = false;
+    uint64_t readbackFrameIndex = 0;
+
+    // ImGui descriptor used to display colorImageView without a CPU round trip.
+    // Allocated once and re-pointed at the new view on resize.
+    VkDescriptorSet viewportTexture = VK_NULL_HANDLE;
+  };
+
+  void CreateRenderTarget(RenderTarget& target);
+  void CleanupRenderTarget(RenderTarget& target);
+#ifndef WL_HEADLESS
+  void UpdateViewportTexture(RenderTarget& target);
+#endif
+  void CreateReadbackBuffer(RenderTarget& target);
+  void RecordReadback(VkCommandBuffer cmd, RenderTarget& target);
+  void DeliverReadback(RenderTarget& target);
+  bool IsReadbackRequested() const;
 
   // Our render targets and pipeline
+#ifndef WL_HEADLESS
   std::shared_ptr<Walnut::Image> m_RenderedImage;
-  VkImage m_ColorImage = VK_NULL_HANDLE;
-  VkDeviceMemory m_ColorImageMemory = VK_NULL_HANDLE;
-  VkImageView m_ColorImageView = VK_NULL_HANDLE;
-  
-  VkImage m_DepthImage = VK_NULL_HANDLE;
-  VkDeviceMemory m_DepthImageMemory = VK_NULL_HANDLE;
-  VkImageView m_DepthImageView = VK_NULL_HANDLE;
-
-  VkFramebuffer m_Framebuffer = VK_NULL_HANDLE;
+#endif
+  std::array<RenderTarget, MAX_FRAMES_IN_FLIGHT> m_RenderTargets;
+  // Frame slot whose target holds the most recently submitted image
+  uint32_t m_DisplayFrame = 0;
+
+  VkSampler m_ColorSampler = VK_NULL_HANDLE;
+  DisplayMode m_DisplayMode = DisplayMode::ZeroCopy;
+  DisplayMode m_PendingDisplayMode = DisplayMode::ZeroCopy;
+
+  // Readback ring: one persistently mapped buffer per render target, only
+  // allocated while something consumes CPU copies.
+  ReadbackCallback m_ReadbackCallback;
+  bool m_ReadbackEnabled = false;
+  uint64_t m_ReadbackAllocationCount = 0;
+  uint64_t m_ReadbackAllocationsAtFrameStart = 0;
+
   VkRenderPass m_RenderPass = VK_NULL_HANDLE;
+  // Continues m_RenderPass's target for the late GPU object draws: loads
+  // color and depth and ends in the same layouts
+  VkRenderPass m_LateRenderPass = VK_NULL_HANDLE;
   VkPipeline m_Pipeline = VK_NULL_HANDLE;
   VkPipeline m_PipelineNoCull = VK_NULL_HANDLE; // debug pipeline with culling disabled
+  VkPipeline m_InstancedPipeline = VK_NULL_HANDLE; // basic_instanced.vert, InstanceData at binding 1
   VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
   VkDescriptorSetLayout m_DescriptorSetLayout = VK_NULL_HANDLE;
 
   VkCommandPool m_CommandPool = VK_NULL_HANDLE;
   // Per-frame command buffers
   std::vector<VkCommandBuffer> m_CommandBuffers;
+  // Per-frame buffers for the GPU culling dispatch, submitted ahead of the frame's
+  std::vector<VkCommandBuffer> m_CullCommandBuffers;
+  // Per-frame secondary buffers taking the direct draws while the render pass
+  // is recorded from secondary command buffers
+  std::vector<VkCommandBuffer> m_SecondaryCommandBuffers;
+  // Where draws are recorded this frame: the primary buffer, or the secondary
+  // one above
+  VkCommandBuffer m_DrawCommandBuffer = VK_NULL_HANDLE;
+  bool m_RecordSecondary = false;
+
+  // Parallel recording of the render queue. Command pools are externally
+  // synchronized, so each chunk of the queue gets a pool of its own per frame
+  // in flight, reset by the thread recording it once the slot's fence has
+  // signaled.
+  struct RecordingContext {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    uint32_t binds = 0;
+  };
+  static constexpr uint32_t kMinDrawsPerRecordingThread = 512;
+  std::array<std::vector<RecordingContext>, MAX_FRAMES_IN_FLIGHT> m_RecordingContexts;
+  std::vector<VkCommandBuffer> m_ExecutedCommandBuffers; // secondary buffers of the current frame, in order
+  std::unique_ptr<ThreadPool> m_RecordingPool;
+  uint32_t m_RecordingThreads = 0;
 
-  // Per-frame synchronization objects
-  std::vector<VkSemaphore> m_ImageAvailableSemaphores;
-  std::vector<VkSemaphore> m_RenderFinishedSemaphores;
+  // Per-frame synchronization objects. Rendering is offscreen and consumed on
+  // the same queue, so fences are the only host/GPU sync needed.
   std::vector<VkFence> m_InFlightFences;
 
   // Current frame index for frame-in-flight resources
   uint32_t m_CurrentFrame =0;
 
   VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
-  VkDescriptorSet m_DescriptorSet = VK_NULL_HANDLE;
-  BufferHandle m_UniformBuffer;
-  void* m_UniformBufferLocation = nullptr;
+  // Per-frame descriptor sets and uniform buffers; the host copy of the camera
+  // is written into the current frame's buffer once its fence has signaled.
+  std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> m_DescriptorSets{};
+  std::array<BufferHandle, MAX_FRAMES_IN_FLIGHT> m_UniformBuffers{};
+  std::array<void*, MAX_FRAMES_IN_FLIGHT> m_UniformBufferLocations{};
+  UniformTransformations m_Transformations{ glm::mat4(1.0f), glm::mat4(1.0f) };
+
+  // Host-visible per-draw data of each frame in flight (instances, indirect
+  // commands), bump allocated from a buffer in the allocator's Frame arena
+  // and released with it when the slot's fence has signaled. When a frame
+  // needs more, the buffer is replaced by a larger one and the old one is
+  // kept until then too.
+  struct StreamBuffer {
+    VkBufferUsageFlags usage = 0;
+    BufferHandle buffer{};
+    VkDeviceSize capacity = 0;
+    VkDeviceSize used = 0;
+    std::vector<BufferHandle> retired;
+  };
+  std::array<StreamBuffer, MAX_FRAMES_IN_FLIGHT> m_InstanceBuffers;
+  std::array<StreamBuffer, MAX_FRAMES_IN_FLIGHT> m_IndirectBuffers;
+  VkDeviceSize WriteStream(StreamBuffer& stream, const void* data, VkDeviceSize size, VkBuffer& buffer);
+  void ReleaseStreamBuffers(StreamBuffer& stream);
+  void DestroyStreamBuffers(StreamBuffer& stream);
+
+  RenderQueue m_RenderQueue;
+
+  // View frustum of m_Transformations, and the draws waiting to be tested
+  // against it: their world space boxes in m_CullingSet, same order
+  Frustum m_Frustum;
+  bool m_FrustumCulling = true;
+  CullKernel m_CullKernel = GetBestCullKernel();
+  CullingSet m_CullingSet;
+  std::vector<QueuedDraw> m_CullCandidates;
+  std::vector<uint32_t> m_VisibleIndices;
+  CullingSet m_PoolCullingSet; // RenderPoolMeshes, tested right away
+  std::vector<MeshDraw> m_VisiblePoolDraws;
+  std::vector<VkDrawIndexedIndirectCommand> m_MeshletCommands; // RenderMeshlets
+  float m_LodErrorPixels = 1.0f;
+
+  // Pooled meshes; created with the other rendering resources
+  std::unique_ptr<MeshPool> m_MeshPool;
+  bool m_MultiDrawIndirect = false;
+  bool m_DrawIndirectFirstInstance = false;
+  uint32_t m_MaxDrawIndirectCount = 1;
+
+  // Resident objects culled by a compute dispatch; created with the mesh pool
+  std::unique_ptr<GpuCulling> m_GpuCulling;
+  PFN_vkCmdDrawIndexedIndirectCountKHR m_CmdDrawIndexedIndirectCount = nullptr; // VK_KHR_draw_indirect_count
+  bool m_DrawIndirectCount = false;
+  bool m_GpuCullingZeroCommands = false; // a page was drawn without the count this frame
+  std::vector<MeshDraw> m_GpuObjectDraws; // RenderPoolMeshes fallback
+  // Hi-Z of the depth target for the late phase; recreated with the targets
+  std::unique_ptr<DepthPyramid> m_DepthPyramid;
+  bool m_OcclusionCulling = true;
 
   // Texture helper (owns image/view/sampler and mipmaps)
   std::unique_ptr<Texture> m_Texture;
+  // Texture whose upload is still in flight; swapped in once it is ready
+  std::unique_ptr<Texture> m_PendingTexture;
+  UploadTicket m_PendingTextureTicket{};
+  // Replaced textures, destroyed when the slot they were retired in comes
+  // around again and every earlier submission has completed
+  std::array<std::vector<std::unique_ptr<Texture>>, MAX_FRAMES_IN_FLIGHT> m_RetiredTextures;
+  // Slots whose descriptor set still points at a replaced texture; each is
+  // rewritten at its own BeginFrame, once its last submission is done with it
+  std::array<bool, MAX_FRAMES_IN_FLIGHT> m_TextureDescriptorStale{};
 
   // Default placeholder texture used when no texture is loaded
   VkImage m_DefaultTextureImage = VK_NULL_HANDLE;
-  VkDeviceMemory m_DefaultTextureImageMemory = VK_NULL_HANDLE;
+  Allocation m_DefaultTextureImageMemory;
   VkImageView m_DefaultTextureImageView = VK_NULL_HANDLE;
   VkSampler m_DefaultTextureSampler = VK_NULL_HANDLE;
 
@@ -145,6 +494,9 @@ class WalnutGraphics final {
   // Current model matrix stored so push constants can be applied when recording
   glm::mat4 m_CurrentModel = glm::mat4(1.0f);
 
+  FrameStats m_FrameStats;
+  std::chrono::steady_clock::time_point m_FrameRecordStart;
+
   friend class Texture; // allow Texture helper access to private helpers
 };
 
@@ -1,12 +1,15 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include "device_allocator.h"
 
 namespace veng {
 
+// A buffer and the slice of a shared device memory block it is bound to.
+// `allocation.mapped` is a persistent host pointer for host-visible buffers.
 struct BufferHandle {
-  VkBuffer buffer;
-  VkDeviceMemory memory;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  Allocation allocation;
 };
 
 }  // namespace veng
@@ -0,0 +1,883 @@
+#include "bvh.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VENG_BVH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+// MSVC compiles AVX intrinsics in any function
+#define VENG_TARGET_AVX
+#else
+#define VENG_TARGET_AVX __attribute__((target("avx")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VENG_BVH_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace veng {
+
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+// Cost of visiting a node against testing one triangle, in the SAH
+constexpr float kTraversalCost =1.0f;
+
+// Down to this depth splits follow the SAH; below it they halve the
+// triangles, so no path is longer than kMaxSahDepth + 32 nodes and the
+// traversal stacks cannot overflow
+constexpr uint32_t kMaxSahDepth =48;
+constexpr uint32_t kStackSize =96;
+
+// Subtrees of at most this many triangles, or a 256th of the mesh when that
+// is more, are built as thread pool tasks
+constexpr uint32_t kMinTaskTriangles =4096;
+
+// Triangles per ParallelFor index when preparing and copying them
+constexpr uint32_t kChunkTriangles =16384;
+
+struct Bounds {
+ glm::vec3 min{std::numeric_limits<float>::max()};
+ glm::vec3 max{ -std::numeric_limits<float>::max()};
+
+ void Grow(const glm::vec3& point)
+ {
+ min = glm::min(min, point);
+ max = glm::max(max, point);
+ }
+ void Grow(const Bounds& other)
+ {
+ min = glm::min(min, other.min);
+ max = glm::max(max, other.max);
+ }
+ // 0 for an empty box
+ float Area() const
+ {
+ const glm::vec3 size = max - min;
+ return size.x <0.0f ?0.0f :2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+ }
+};
+
+BvhNode MakeNode(const Bounds& bounds, uint32_t first, uint32_t count)
+{
+ BvhNode node;
+ node.min = bounds.min;
+ node.max = bounds.max;
+ node.leftFirst = first;
+ node.count = count;
+ return node;
+}
+
+struct BuildTask {
+ uint32_t node =0;
+ uint32_t depth =0;
+};
+
+// Splits nodes over the shared triangle order; each subtree only reorders
+// its own range of it, so subtrees can be built at the same time
+class Builder {
+public:
+ Builder(std::span<const Bounds> triangleBounds, std::span<const glm::vec3> centroids, std::span<uint32_t> order, uint32_t maxLeafTriangles, uint32_t taskTriangles)
+ : m_TriangleBounds(triangleBounds), m_Centroids(centroids), m_Order(order), m_MaxLeafTriangles(maxLeafTriangles), m_TaskTriangles(taskTriangles)
+ {
+ }
+
+ // Splits node `index` of `nodes`, whose bounds and triangle range are set,
+ // and its children in turn. With `tasks`, nodes of at most taskTriangles
+ // triangles are left for later and listed there.
+ void Split(std::vector<BvhNode>& nodes, uint32_t index, uint32_t depth, std::vector<BuildTask>* tasks);
+
+ uint32_t GetMaxDepth() const { return m_MaxDepth; }
+
+private:
+ struct Bin {
+ Bounds bounds;
+ uint32_t count =0;
+ };
+
+ struct SahSplit {
+ int axis = -1;
+ uint32_t bin =0;
+ float cost = kInfinity; // left area * count + right area * count
+ Bounds left;
+ Bounds right;
+ };
+
+ static uint32_t GetBin(float centroid, float min, float scale)
+ {
+ return std::min(Bvh::kBins -1, static_cast<uint32_t>((centroid - min) * scale));
+ }
+
+ SahSplit FindSahSplit(uint32_t first, uint32_t count, const Bounds& centroidBounds) const;
+
+ std::span<const Bounds> m_TriangleBounds;
+ std::span<const glm::vec3> m_Centroids;
+ std::span<uint32_t> m_Order;
+ uint32_t m_MaxLeafTriangles =1;
+ uint32_t m_TaskTriangles =0;
+ uint32_t m_MaxDepth =0;
+};
+
+// Every axis in one pass over the triangles, then a sweep over each axis'
+// bins from both ends
+Builder::SahSplit Builder::FindSahSplit(uint32_t first, uint32_t count, const Bounds& centroidBounds) const
+{
+ std::array<std::array<Bin, Bvh::kBins>,3> bins{};
+ glm::vec3 scale(0.0f);
+ for (int axis =0; axis <3; ++axis) {
+ const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+ scale[axis] = extent >0.0f ? Bvh::kBins / extent :0.0f;
+ }
+ for (uint32_t i = first; i < first + count; ++i) {
+ const uint32_t triangle = m_Order[i];
+ for (int axis =0; axis <3; ++axis) {
+ Bin& bin = bins[axis][GetBin(m_Centroids[triangle][axis], centroidBounds.min[axis], scale[axis])];
+ bin.bounds.Grow(m_TriangleBounds[triangle]);
+ ++bin.count;
+ }
+ }
+
+ SahSplit best;
+ for (int axis =0; axis <3; ++axis) {
+ if (scale[axis] ==0.0f) {
+ continue; // every centroid in one bin
+ }
+ // Bounds and counts left of each plane, from the left end
+ std::array<Bounds, Bvh::kBins> leftBounds;
+ std::array<float, Bvh::kBins> leftCost{};
+ Bounds bounds;
+ uint32_t leftCount =0;
+ for (uint32_t plane =1; plane < Bvh::kBins; ++plane) {
+ bounds.Grow(bins[axis][plane -1].bounds);
+ leftCount += bins[axis][plane -1].count;
+ leftBounds[plane] = bounds;
+ leftCost[plane] = leftCount ==0 || leftCount == count ? kInfinity : bounds.Area() * leftCount;
+ }
+ bounds = {};
+ uint32_t rightCount =0;
+ for (uint32_t plane = Bvh::kBins -1; plane >0; --plane) {
+ bounds.Grow(bins[axis][plane].bounds);
+ rightCount += bins[axis][plane].count;
+ const float cost = leftCost[plane] + bounds.Area() * rightCount;
+ if (cost < best.cost) {
+ best.axis = axis;
+ best.bin = plane;
+ best.cost = cost;
+ best.left = leftBounds[plane];
+ best.right = bounds;
+ }
+ }
+ }
+ return best;
+}
+
+void Builder::Split(std::vector<BvhNode>& nodes, uint32_t index, uint32_t depth, std::vector<BuildTask>* tasks)
+{
+ m_MaxDepth = std::max(m_MaxDepth, depth);
+ const uint32_t first = nodes[index].leftFirst;
+ const uint32_t count = nodes[index].count;
+ if (count <=1) {
+ return;
+ }
+ if (tasks && count <= m_TaskTriangles) {
+ tasks->push_back({ index, depth });
+ return;
+ }
+
+ Bounds centroidBounds;
+ for (uint32_t i = first; i < first + count; ++i) {
+ centroidBounds.Grow(m_Centroids[m_Order[i]]);
+ }
+
+ uint32_t leftCount =0;
+ Bounds left;
+ Bounds right;
+ const SahSplit split = depth < kMaxSahDepth ? FindSahSplit(first, count, centroidBounds) : SahSplit{};
+ if (split.axis >=0) {
+ Bounds nodeBounds;
+ nodeBounds.min = nodes[index].min;
+ nodeBounds.max = nodes[index].max;
+ const float area = nodeBounds.Area();
+ const float splitCost = area >0.0f ? kTraversalCost + split.cost / area : kInfinity;
+ if (count <= m_MaxLeafTriangles && splitCost >= static_cast<float>(count)) {
+ return;
+ }
+ const int axis = split.axis;
+ const float min = centroidBounds.min[axis];
+ const float scale = Bvh::kBins / (centroidBounds.max[axis] - min);
+ const auto middle = std::partition(m_Order.begin() + first, m_Order.begin() + first + count, [&](uint32_t triangle) {
+ return GetBin(m_Centroids[triangle][axis], min, scale) < split.bin;
+ });
+ leftCount = static_cast<uint32_t>(middle - (m_Order.begin() + first));
+ left = split.left;
+ right = split.right;
+ } else {
+ if (count <= m_MaxLeafTriangles) {
+ return;
+ }
+ // No SAH split (too deep, or the centroids coincide): halve the
+ // triangles along the widest axis of their centroids
+ const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+ const int axis = extent.x >= extent.y && extent.x >= extent.z ?0 : (extent.y >= extent.z ?1 :2);
+ leftCount = count /2;
+ std::nth_element(m_Order.begin() + first, m_Order.begin() + first + leftCount, m_Order.begin() + first + count, [&](uint32_t a, uint32_t b) {
+ return m_Centroids[a][axis] < m_Centroids[b][axis];
+ });
+ for (uint32_t i = first; i < first + count; ++i) {
+ (i < first + leftCount ? left : right).Grow(m_TriangleBounds[m_Order[i]]);
+ }
+ }
+
+ // Siblings side by side; `nodes` may reallocate, so indices from here on
+ const uint32_t leftIndex = static_cast<uint32_t>(nodes.size());
+ nodes.push_back(MakeNode(left, first, leftCount));
+ nodes.push_back(MakeNode(right, first + leftCount, count - leftCount));
+ nodes[index].leftFirst = leftIndex;
+ nodes[index].count =0;
+ Split(nodes, leftIndex, depth +1, tasks);
+ Split(nodes, leftIndex +1, depth +1, tasks);
+}
+
+// 1 / d, with zero components nudged so the slab tests never compute 0 * inf
+glm::vec3 SafeInverse(const glm::vec3& direction)
+{
+ glm::vec3 inverse;
+ for (int axis =0; axis <3; ++axis) {
+ const float d = direction[axis];
+ inverse[axis] =1.0f / (std::abs(d) >1e-20f ? d : std::copysign(1e-20f, d));
+ }
+ return inverse;
+}
+
+// Distance at which the ray enters the box, or infinity when it misses it
+// or enters beyond tMax
+float BoxEntry(const BvhNode& node, const glm::vec3& origin, const glm::vec3& inverse, float tMax)
+{
+ const float tx1 = (node.min.x - origin.x) * inverse.x;
+ const float tx2 = (node.max.x - origin.x) * inverse.x;
+ const float ty1 = (node.min.y - origin.y) * inverse.y;
+ const float ty2 = (node.max.y - origin.y) * inverse.y;
+ const float tz1 = (node.min.z - origin.z) * inverse.z;
+ const float tz2 = (node.max.z - origin.z) * inverse.z;
+ const float enter = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2),0.0f));
+ const float exit = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), tMax));
+ return enter <= exit ? enter : kInfinity;
+}
+
+// Moller-Trumbore, written out per component in the order every packet
+// kernel evaluates it. A ray in the triangle's plane divides by zero and
+// fails the comparisons.
+bool IntersectTriangle(const BvhTriangle& triangle, const glm::vec3& origin, const glm::vec3& direction, float& t, float& u, float& v)
+{
+ const glm::vec3& e1 = triangle.edge1;
+ const glm::vec3& e2 = triangle.edge2;
+ const float hx = direction.y * e2.z - direction.z * e2.y;
+ const float hy = direction.z * e2.x - direction.x * e2.z;
+ const float hz = direction.x * e2.y - direction.y * e2.x;
+ const float f =1.0f / (e1.x * hx + e1.y * hy + e1.z * hz);
+ const float sx = origin.x - triangle.v0.x;
+ const float sy = origin.y - triangle.v0.y;
+ const float sz = origin.z - triangle.v0.z;
+ u = f * (sx * hx + sy * hy + sz * hz);
+ const float qx = sy * e1.z - sz * e1.y;
+ const float qy = sz * e1.x - sx * e1.z;
+ const float qz = sx * e1.y - sy * e1.x;
+ v = f * (direction.x * qx + direction.y * qy + direction.z * qz);
+ t = f * (e2.x * qx + e2.y * qy + e2.z * qz);
+ return u >=0.0f && v >=0.0f && u + v <=1.0f && t >=0.0f;
+}
+
+struct StackEntry {
+ uint32_t node;
+ float t; // where the ray enters it
+};
+
+// Closest hit below tMax, near child first, or with kAnyHit the first hit
+// found. `hit.triangle` is in leaf order.
+template <bool kAnyHit>
+bool Traverse(std::span<const BvhNode> nodes, std::span<const BvhTriangle> triangles, const Ray& ray, RayHit& hit)
+{
+ const glm::vec3 inverse = SafeInverse(ray.direction);
+ float best = ray.tMax;
+ if (BoxEntry(nodes[0], ray.origin, inverse, best) == kInfinity) {
+ return false;
+ }
+ std::array<StackEntry, kStackSize> stack;
+ uint32_t stackSize =0;
+ uint32_t index =0;
+ bool found = false;
+ for (;;) {
+ const BvhNode& node = nodes[index];
+ if (node.IsLeaf()) {
+ for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+ float t, u, v;
+ if (IntersectTriangle(triangles[i], ray.origin, ray.direction, t, u, v) && t < best) {
+ best = t;
+ hit.t = t;
+ hit.triangle = i;
+ hit.barycentrics = glm::vec2(u, v);
+ found = true;
+ if constexpr (kAnyHit) {
+ return true;
+ }
+ }
+ }
+ } else {
+ uint32_t nearIndex = node.leftFirst;
+ uint32_t farIndex = nearIndex +1;
+ float nearT = BoxEntry(nodes[nearIndex], ray.origin, inverse, best);
+ float farT = BoxEntry(nodes[farIndex], ray.origin, inverse, best);
+ if (farT < nearT) {
+ std::swap(nearIndex, farIndex);
+ std::swap(nearT, farT);
+ }
+ if (nearT != kInfinity) {
+ if (farT != kInfinity) {
+ stack[stackSize++] = { farIndex, farT };
+ }
+ index = nearIndex;
+ continue;
+ }
+ }
+ // Next from the stack, skipping boxes entered beyond the closest hit
+ while (stackSize >0 && stack[stackSize -1].t >= best) {
+ --stackSize;
+ }
+ if (stackSize ==0) {
+ return found;
+ }
+ index = stack[--stackSize].node;
+ }
+}
+
+// Rays of one packet, one array per component; lanes past the last ray
+// have tMax -1 so they hit nothing
+template <uint32_t kLanes>
+struct RayPacket {
+ alignas(32) float originX[kLanes];
+ alignas(32) float originY[kLanes];
+ alignas(32) float originZ[kLanes];
+ alignas(32) float directionX[kLanes];
+ alignas(32) float directionY[kLanes];
+ alignas(32) float directionZ[kLanes];
+ alignas(32) float inverseX[kLanes];
+ alignas(32) float inverseY[kLanes];
+ alignas(32) float inverseZ[kLanes];
+ // tMax in, distance of the closest hit out
+ alignas(32) float t[kLanes];
+ // Out: leaf order triangle, UINT32_MAX for a miss
+ alignas(32) uint32_t triangle[kLanes];
+ alignas(32) float u[kLanes];
+ alignas(32) float v[kLanes];
+};
+
+// Children of an inner node in the order a packet should visit them:
+// whichever the first active ray's direction reaches first
+bool IsLeftNear(const BvhNode& left, const BvhNode& right, const glm::vec3& direction)
+{
+ return glm::dot((right.min + right.max) - (left.min + left.max), direction) >=0.0f;
+}
+
+#ifdef VENG_BVH_X86
+
+__m128 SelectSse(__m128 mask, __m128 a, __m128 b)
+{
+ return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+void IntersectPacketSse(std::span<const BvhNode> nodes, std::span<const BvhTriangle> triangles, RayPacket<4>& packet)
+{
+ const __m128 ox = _mm_load_ps(packet.originX);
+ const __m128 oy = _mm_load_ps(packet.originY);
+ const __m128 oz = _mm_load_ps(packet.originZ);
+ const __m128 dx = _mm_load_ps(packet.directionX);
+ const __m128 dy = _mm_load_ps(packet.directionY);
+ const __m128 dz = _mm_load_ps(packet.directionZ);
+ const __m128 ix = _mm_load_ps(packet.inverseX);
+ const __m128 iy = _mm_load_ps(packet.inverseY);
+ const __m128 iz = _mm_load_ps(packet.inverseZ);
+ const __m128 zero = _mm_setzero_ps();
+ const __m128 one = _mm_set1_ps(1.0f);
+ __m128 best = _mm_load_ps(packet.t);
+ __m128 triangle = _mm_castsi128_ps(_mm_set1_epi32(-1));
+ __m128 bestU = zero;
+ __m128 bestV = zero;
+
+ std::array<uint32_t, kStackSize> stack;
+ uint32_t stackSize =0;
+ stack[stackSize++] =0;
+ while (stackSize >0) {
+ const BvhNode& node = nodes[stack[--stackSize]];
+ const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min.x), ox), ix);
+ const __m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max.x), ox), ix);
+ const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min.y), oy), iy);
+ const __m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max.y), oy), iy);
+ const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min.z), oz), iz);
+ const __m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max.z), oz), iz);
+ const __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_max_ps(_mm_min_ps(tz1, tz2), zero));
+ const __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_min_ps(_mm_max_ps(tz1, tz2), best));
+ const uint32_t active = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(enter, exit)));
+ if (active ==0) {
+ continue;
+ }
+
+ if (!node.IsLeaf()) {
+ const uint32_t lane = static_cast<uint32_t>(std::countr_zero(active));
+ const glm::vec3 direction(packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane]);
+ const bool leftNear = IsLeftNear(nodes[node.leftFirst], nodes[node.leftFirst +1], direction);
+ stack[stackSize++] = leftNear ? node.leftFirst +1 : node.leftFirst;
+ stack[stackSize++] = leftNear ? node.leftFirst : node.leftFirst +1;
+ continue;
+ }
+
+ for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+ const BvhTriangle& tri = triangles[i];
+ const __m128 e1x = _mm_set1_ps(tri.edge1.x);
+ const __m128 e1y = _mm_set1_ps(tri.edge1.y);
+ const __m128 e1z = _mm_set1_ps(tri.edge1.z);
+ const __m128 e2x = _mm_set1_ps(tri.edge2.x);
+ const __m128 e2y = _mm_set1_ps(tri.edge2.y);
+ const __m128 e2z = _mm_set1_ps(tri.edge2.z);
+ const __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+ const __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+ const __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+ const __m128 f = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz)));
+ const __m128 sx = _mm_sub_ps(ox, _mm_set1_ps(tri.v0.x));
+ const __m128 sy = _mm_sub_ps(oy, _mm_set1_ps(tri.v0.y));
+ const __m128 sz = _mm_sub_ps(oz, _mm_set1_ps(tri.v0.z));
+ const __m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+ const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+ const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+ const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+ const __m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+ const __m128 t = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+ const __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)),
+ _mm_and_ps(_mm_and_ps(_mm_cmple_ps(_mm_add_ps(u, v), one), _mm_cmpge_ps(t, zero)), _mm_cmplt_ps(t, best)));
+ if (_mm_movemask_ps(hit) ==0) {
+ continue;
+ }
+ best = SelectSse(hit, t, best);
+ bestU = SelectSse(hit, u, bestU);
+ bestV = SelectSse(hit, v, bestV);
+ triangle = SelectSse(hit, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(i))), triangle);
+ }
+ }
+ _mm_store_ps(packet.t, best);
+ _mm_store_ps(packet.u, bestU);
+ _mm_store_ps(packet.v, bestV);
+ _mm_store_si128(reinterpret_cast<__m128i*>(packet.triangle), _mm_castps_si128(triangle));
+}
+
+VENG_TARGET_AVX void IntersectPacketAvx(std::span<const BvhNode> nodes, std::span<const BvhTriangle> triangles, RayPacket<8>& packet)
+{
+ const __m256 ox = _mm256_load_ps(packet.originX);
+ const __m256 oy = _mm256_load_ps(packet.originY);
+ const __m256 oz = _mm256_load_ps(packet.originZ);
+ const __m256 dx = _mm256_load_ps(packet.directionX);
+ const __m256 dy = _mm256_load_ps(packet.directionY);
+ const __m256 dz = _mm256_load_ps(packet.directionZ);
+ const __m256 ix = _mm256_load_ps(packet.inverseX);
+ const __m256 iy = _mm256_load_ps(packet.inverseY);
+ const __m256 iz = _mm256_load_ps(packet.inverseZ);
+ const __m256 zero = _mm256_setzero_ps();
+ const __m256 one = _mm256_set1_ps(1.0f);
+ __m256 best = _mm256_load_ps(packet.t);
+ __m256 triangle = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+ __m256 bestU = zero;
+ __m256 bestV = zero;
+
+ std::array<uint32_t, kStackSize> stack;
+ uint32_t stackSize =0;
+ stack[stackSize++] =0;
+ while (stackSize >0) {
+ const BvhNode& node = nodes[stack[--stackSize]];
+ const __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.min.x), ox), ix);
+ const __m256 tx2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.max.x), ox), ix);
+ const __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.min.y), oy), iy);
+ const __m256 ty2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.max.y), oy), iy);
+ const __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.min.z), oz), iz);
+ const __m256 tz2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.max.z), oz), iz);
+ const __m256 enter = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx1, tx2), _mm256_min_ps(ty1, ty2)), _mm256_max_ps(_mm256_min_ps(tz1, tz2), zero));
+ const __m256 exit = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx1, tx2), _mm256_max_ps(ty1, ty2)), _mm256_min_ps(_mm256_max_ps(tz1, tz2), best));
+ const uint32_t active = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(enter, exit, _CMP_LE_OQ)));
+ if (active ==0) {
+ continue;
+ }
+
+ if (!node.IsLeaf()) {
+ // IsLeftNear written out: calling SSE code from here, with the upper
+ // halves of the registers in use, costs more than the whole test
+ const uint32_t lane = static_cast<uint32_t>(std::countr_zero(active));
+ const BvhNode& left = nodes[node.leftFirst];
+ const BvhNode& right = nodes[node.leftFirst +1];
+ const float along = ((right.min.x + right.max.x) - (left.min.x + left.max.x)) * packet.directionX[lane]
+  + ((right.min.y + right.max.y) - (left.min.y + left.max.y)) * packet.directionY[lane]
+  + ((right.min.z + right.max.z) - (left.min.z + left.max.z)) * packet.directionZ[lane];
+ const bool leftNear = along >=0.0f;
+ stack[stackSize++] = leftNear ? node.leftFirst +1 : node.leftFirst;
+ stack[stackSize++] = leftNear ? node.leftFirst : node.leftFirst +1;
+ continue;
+ }
+
+ for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+ const BvhTriangle& tri = triangles[i];
+ const __m256 e1x = _mm256_set1_ps(tri.edge1.x);
+ const __m256 e1y = _mm256_set1_ps(tri.edge1.y);
+ const __m256 e1z = _mm256_set1_ps(tri.edge1.z);
+ const __m256 e2x = _mm256_set1_ps(tri.edge2.x);
+ const __m256 e2y = _mm256_set1_ps(tri.edge2.y);
+ const __m256 e2z = _mm256_set1_ps(tri.edge2.z);
+ const __m256 hx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+ const __m256 hy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+ const __m256 hz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+ const __m256 f = _mm256_div_ps(one, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)), _mm256_mul_ps(e1z, hz)));
+ const __m256 sx = _mm256_sub_ps(ox, _mm256_set1_ps(tri.v0.x));
+ const __m256 sy = _mm256_sub_ps(oy, _mm256_set1_ps(tri.v0.y));
+ const __m256 sz = _mm256_sub_ps(oz, _mm256_set1_ps(tri.v0.z));
+ const __m256 u = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, hx), _mm256_mul_ps(sy, hy)), _mm256_mul_ps(sz, hz)));
+ const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+ const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+ const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+ const __m256 v = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)));
+ const __m256 t = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)));
+ const __m256 hit = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, zero, _CMP_GE_OQ)),
+ _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ), _mm256_cmp_ps(t, zero, _CMP_GE_OQ)), _mm256_cmp_ps(t, best, _CMP_LT_OQ)));
+ if (_mm256_movemask_ps(hit) ==0) {
+ continue;
+ }
+ best = _mm256_blendv_ps(best, t, hit);
+ bestU = _mm256_blendv_ps(bestU, u, hit);
+ bestV = _mm256_blendv_ps(bestV, v, hit);
+ triangle = _mm256_blendv_ps(triangle, _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(i))), hit);
+ }
+ }
+ _mm256_store_ps(packet.t, best);
+ _mm256_store_ps(packet.u, bestU);
+ _mm256_store_ps(packet.v, bestV);
+ _mm256_store_ps(reinterpret_cast<float*>(packet.triangle), triangle);
+}
+
+#endif // VENG_BVH_X86
+
+#ifdef VENG_BVH_NEON
+
+void IntersectPacketNeon(std::span<const BvhNode> nodes, std::span<const BvhTriangle> triangles, RayPacket<4>& packet)
+{
+ static const uint32_t kLaneBits[4] = {1,2,4,8 };
+ const uint32x4_t laneBits = vld1q_u32(kLaneBits);
+ const float32x4_t ox = vld1q_f32(packet.originX);
+ const float32x4_t oy = vld1q_f32(packet.originY);
+ const float32x4_t oz = vld1q_f32(packet.originZ);
+ const float32x4_t dx = vld1q_f32(packet.directionX);
+ const float32x4_t dy = vld1q_f32(packet.directionY);
+ const float32x4_t dz = vld1q_f32(packet.directionZ);
+ const float32x4_t ix = vld1q_f32(packet.inverseX);
+ const float32x4_t iy = vld1q_f32(packet.inverseY);
+ const float32x4_t iz = vld1q_f32(packet.inverseZ);
+ const float32x4_t zero = vdupq_n_f32(0.0f);
+ const float32x4_t one = vdupq_n_f32(1.0f);
+ float32x4_t best = vld1q_f32(packet.t);
+ uint32x4_t triangle = vdupq_n_u32(UINT32_MAX);
+ float32x4_t bestU = zero;
+ float32x4_t bestV = zero;
+
+ std::array<uint32_t, kStackSize> stack;
+ uint32_t stackSize =0;
+ stack[stackSize++] =0;
+ while (stackSize >0) {
+ const BvhNode& node = nodes[stack[--stackSize]];
+ const float32x4_t tx1 = vmulq_f32(vsubq_f32(vdupq_n_f32(node.min.x), ox), ix);
+ const float32x4_t tx2 = vmulq_f32(vsubq_f32(vdupq_n_f32(node.max.x), ox), ix);
+ const float32x4_t ty1 = vmulq_f32(vsubq_f32(vdupq_n_f32(node.min.y), oy), iy);
+ const float32x4_t ty2 = vmulq_f32(vsubq_f32(vdupq_n_f32(node.max.y), oy), iy);
+ const float32x4_t tz1 = vmulq_f32(vsubq_f32(vdupq_n_f32(node.min.z), oz), iz);
+ const float32x4_t tz2 = vmulq_f32(vsubq_f32(vdupq_n_f32(node.max.z), oz), iz);
+ const float32x4_t enter = vmaxq_f32(vmaxq_f32(vminq_f32(tx1, tx2), vminq_f32(ty1, ty2)), vmaxq_f32(vminq_f32(tz1, tz2), zero));
+ const float32x4_t exit = vminq_f32(vminq_f32(vmaxq_f32(tx1, tx2), vmaxq_f32(ty1, ty2)), vminq_f32(vmaxq_f32(tz1, tz2), best));
+ const uint32_t active = vaddvq_u32(vandq_u32(vcleq_f32(enter, exit), laneBits));
+ if (active ==0) {
+ continue;
+ }
+
+ if (!node.IsLeaf()) {
+ const uint32_t lane = static_cast<uint32_t>(std::countr_zero(active));
+ const glm::vec3 direction(packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane]);
+ const bool leftNear = IsLeftNear(nodes[node.leftFirst], nodes[node.leftFirst +1], direction);
+ stack[stackSize++] = leftNear ? node.leftFirst +1 : node.leftFirst;
+ stack[stackSize++] = leftNear ? node.leftFirst : node.leftFirst +1;
+ continue;
+ }
+
+ for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+ const BvhTriangle& tri = triangles[i];
+ // Separate multiplies and adds, not vfmaq: same rounding as the scalar test
+ const float32x4_t hx = vsubq_f32(vmulq_n_f32(dy, tri.edge2.z), vmulq_n_f32(dz, tri.edge2.y));
+ const float32x4_t hy = vsubq_f32(vmulq_n_f32(dz, tri.edge2.x), vmulq_n_f32(dx, tri.edge2.z));
+ const float32x4_t hz = vsubq_f32(vmulq_n_f32(dx, tri.edge2.y), vmulq_n_f32(dy, tri.edge2.x));
+ const float32x4_t f = vdivq_f32(one, vaddq_f32(vaddq_f32(vmulq_n_f32(hx, tri.edge1.x), vmulq_n_f32(hy, tri.edge1.y)), vmulq_n_f32(hz, tri.edge1.z)));
+ const float32x4_t sx = vsubq_f32(ox, vdupq_n_f32(tri.v0.x));
+ const float32x4_t sy = vsubq_f32(oy, vdupq_n_f32(tri.v0.y));
+ const float32x4_t sz = vsubq_f32(oz, vdupq_n_f32(tri.v0.z));
+ const float32x4_t u = vmulq_f32(f, vaddq_f32(vaddq_f32(vmulq_f32(sx, hx), vmulq_f32(sy, hy)), vmulq_f32(sz, hz)));
+ const float32x4_t qx = vsubq_f32(vmulq_n_f32(sy, tri.edge1.z), vmulq_n_f32(sz, tri.edge1.y));
+ const float32x4_t qy = vsubq_f32(vmulq_n_f32(sz, tri.edge1.x), vmulq_n_f32(sx, tri.edge1.z));
+ const float32x4_t qz = vsubq_f32(vmulq_n_f32(sx, tri.edge1.y), vmulq_n_f32(sy, tri.edge1.x));
+ const float32x4_t v = vmulq_f32(f, vaddq_f32(vaddq_f32(vmulq_f32(dx, qx), vmulq_f32(dy, qy)), vmulq_f32(dz, qz)));
+ const float32x4_t t = vmulq_f32(f, vaddq_f32(vaddq_f32(vmulq_n_f32(qx, tri.edge2.x), vmulq_n_f32(qy, tri.edge2.y)), vmulq_n_f32(qz, tri.edge2.z)));
+ const uint32x4_t hit = vandq_u32(vandq_u32(vcgeq_f32(u, zero), vcgeq_f32(v, zero)),
+ vandq_u32(vandq_u32(vcleq_f32(vaddq_f32(u, v), one), vcgeq_f32(t, zero)), vcltq_f32(t, best)));
+ if (vmaxvq_u32(hit) ==0) {
+ continue;
+ }
+ best = vbslq_f32(hit, t, best);
+ bestU = vbslq_f32(hit, u, bestU);
+ bestV = vbslq_f32(hit, v, bestV);
+ triangle = vbslq_u32(hit, vdupq_n_u32(i), triangle);
+ }
+ }
+ vst1q_f32(packet.t, best);
+ vst1q_f32(packet.u, bestU);
+ vst1q_f32(packet.v, bestV);
+ vst1q_u32(packet.triangle, triangle);
+}
+
+#endif // VENG_BVH_NEON
+
+template <uint32_t kLanes, typename Kernel>
+void IntersectPackets(std::span<const BvhNode> nodes, std::span<const BvhTriangle> triangles, std::span<const uint32_t> triangleIds,
+ std::span<const Ray> rays, std::span<RayHit> hits, Kernel kernel)
+{
+ RayPacket<kLanes> packet;
+ for (size_t first =0; first < rays.size(); first += kLanes) {
+ const uint32_t count = static_cast<uint32_t>(std::min<size_t>(kLanes, rays.size() - first));
+ for (uint32_t lane =0; lane < kLanes; ++lane) {
+ // Spare lanes repeat the last ray with a negative tMax, so they hit nothing
+ const Ray& ray = rays[first + std::min(lane, count -1)];
+ const glm::vec3 inverse = SafeInverse(ray.direction);
+ packet.originX[lane] = ray.origin.x;
+ packet.originY[lane] = ray.origin.y;
+ packet.originZ[lane] = ray.origin.z;
+ packet.directionX[lane] = ray.direction.x;
+ packet.directionY[lane] = ray.direction.y;
+ packet.directionZ[lane] = ray.direction.z;
+ packet.inverseX[lane] = inverse.x;
+ packet.inverseY[lane] = inverse.y;
+ packet.inverseZ[lane] = inverse.z;
+ packet.t[lane] = lane < count ? ray.tMax : -1.0f;
+ }
+ kernel(nodes, triangles, packet);
+ for (uint32_t lane =0; lane < count; ++lane) {
+ RayHit& hit = hits[first + lane];
+ hit = RayHit{};
+ if (packet.triangle[lane] != UINT32_MAX) {
+ hit.t = packet.t[lane];
+ hit.triangle = triangleIds[packet.triangle[lane]];
+ hit.barycentrics = glm::vec2(packet.u[lane], packet.v[lane]);
+ }
+ }
+ }
+}
+
+} // namespace
+
+void Bvh::Build(std::span<const Vertex> vertices, std::span<const std::uint32_t> indices, const BvhBuildOptions& options)
+{
+ const auto start = std::chrono::steady_clock::now();
+ Clear();
+ const uint32_t triangleCount = static_cast<uint32_t>(indices.size() /3);
+ m_Stats.triangles = triangleCount;
+ if (triangleCount ==0) {
+ return;
+ }
+ for (std::uint32_t index : indices) {
+ if (index >= vertices.size()) {
+ throw std::runtime_error("BVH input index out of range");
+ }
+ }
+
+ ThreadPool& pool = ThreadPool::Shared();
+ const uint32_t chunks = (triangleCount + kChunkTriangles -1) / kChunkTriangles;
+ std::vector<Bounds> triangleBounds(triangleCount);
+ std::vector<glm::vec3> centroids(triangleCount);
+ std::vector<uint32_t> order(triangleCount);
+ Bounds rootBounds;
+ std::vector<Bounds> chunkBounds(chunks);
+ pool.ParallelFor(chunks, [&](uint32_t chunk) {
+ const uint32_t end = std::min(triangleCount, (chunk +1) * kChunkTriangles);
+ for (uint32_t triangle = chunk * kChunkTriangles; triangle < end; ++triangle) {
+ Bounds bounds;
+ for (uint32_t corner =0; corner <3; ++corner) {
+ bounds.Grow(vertices[indices[triangle *3 + corner]].position);
+ }
+ triangleBounds[triangle] = bounds;
+ centroids[triangle] = (bounds.min + bounds.max) *0.5f;
+ order[triangle] = triangle;
+ chunkBounds[chunk].Grow(bounds);
+ }
+ }, options.maxThreads);
+ for (const Bounds& bounds : chunkBounds) {
+ rootBounds.Grow(bounds);
+ }
+
+ // The top of the tree on this thread, down to subtrees small enough to be
+ // tasks; the split never depends on the thread count
+ const uint32_t maxLeafTriangles = std::max(options.maxLeafTriangles,1u);
+ const uint32_t taskTriangles = std::max(kMinTaskTriangles, triangleCount /256);
+ m_Nodes.reserve(static_cast<size_t>(triangleCount) *2);
+ m_Nodes.push_back(MakeNode(rootBounds,0, triangleCount));
+ std::vector<BuildTask> tasks;
+ Builder top(triangleBounds, centroids, order, maxLeafTriangles, taskTriangles);
+ top.Split(m_Nodes,0,0, &tasks);
+ m_Stats.maxDepth = top.GetMaxDepth();
+
+ // Each task builds its subtree into nodes of its own, its root first
+ std::vector<std::vector<BvhNode>> subtrees(tasks.size());
+ std::vector<uint32_t> subtreeDepths(tasks.size(),0);
+ pool.ParallelFor(static_cast<uint32_t>(tasks.size()), [&](uint32_t task) {
+ std::vector<BvhNode>& nodes = subtrees[task];
+ nodes.reserve(static_cast<size_t>(m_Nodes[tasks[task].node].count) *2);
+ nodes.push_back(m_Nodes[tasks[task].node]);
+ Builder builder(triangleBounds, centroids, order, maxLeafTriangles, taskTriangles);
+ builder.Split(nodes,0, tasks[task].depth, nullptr);
+ subtreeDepths[task] = builder.GetMaxDepth();
+ }, options.maxThreads);
+ const uint32_t poolThreads = options.maxThreads ==0 ? pool.GetThreadCount() : std::min(options.maxThreads, pool.GetThreadCount());
+ m_Stats.threads = std::max(1u, std::min(static_cast<uint32_t>(tasks.size()), poolThreads));
+
+ // Appended in task order; a subtree's root replaces the task's node and
+ // its other nodes move from index i to base + i - 1
+ for (size_t task =0; task < tasks.size(); ++task) {
+ const std::vector<BvhNode>& nodes = subtrees[task];
+ const uint32_t base = static_cast<uint32_t>(m_Nodes.size());
+ for (size_t i =0; i < nodes.size(); ++i) {
+ BvhNode node = nodes[i];
+ if (!node.IsLeaf()) {
+ node.leftFirst += base -1;
+ }
+ if (i ==0) {
+ m_Nodes[tasks[task].node] = node;
+ } else {
+ m_Nodes.push_back(node);
+ }
+ }
+ m_Stats.maxDepth = std::max(m_Stats.maxDepth, subtreeDepths[task]);
+ }
+ m_Nodes.shrink_to_fit();
+
+ m_Triangles.resize(triangleCount);
+ m_TriangleIds = std::move(order);
+ pool.ParallelFor(chunks, [&](uint32_t chunk) {
+ const uint32_t end = std::min(triangleCount, (chunk +1) * kChunkTriangles);
+ for (uint32_t i = chunk * kChunkTriangles; i < end; ++i) {
+ const uint32_t triangle = m_TriangleIds[i];
+ const glm::vec3& v0 = vertices[indices[triangle *3]].position;
+ m_Triangles[i].v0 = v0;
+ m_Triangles[i].edge1 = vertices[indices[triangle *3 +1]].position - v0;
+ m_Triangles[i].edge2 = vertices[indices[triangle *3 +2]].position - v0;
+ }
+ }, options.maxThreads);
+
+ // SAH cost of the finished tree: a ray hitting the root visits each node
+ // with the odds of its area over the root's
+ const float rootArea = rootBounds.Area();
+ double cost =0.0;
+ for (const BvhNode& node : m_Nodes) {
+ Bounds bounds;
+ bounds.min = node.min;
+ bounds.max = node.max;
+ const double odds = rootArea >0.0f ? bounds.Area() / rootArea :1.0;
+ cost += odds * (node.IsLeaf() ? node.count : kTraversalCost);
+ m_Stats.leaves += node.IsLeaf() ?1 :0;
+ }
+ m_Stats.sahCost = static_cast<float>(cost);
+ m_Stats.nodes = static_cast<uint32_t>(m_Nodes.size());
+ m_Stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Bvh::Clear()
+{
+ m_Nodes.clear();
+ m_Triangles.clear();
+ m_TriangleIds.clear();
+ m_Stats = {};
+}
+
+Aabb Bvh::GetBounds() const
+{
+ if (m_Nodes.empty()) {
+ return {};
+ }
+ return Aabb::FromMinMax(m_Nodes[0].min, m_Nodes[0].max);
+}
+
+bool Bvh::Intersect(const Ray& ray, RayHit& hit) const
+{
+ if (m_Nodes.empty()) {
+ return false;
+ }
+ RayHit closest;
+ if (!Traverse<false>(m_Nodes, m_Triangles, ray, closest)) {
+ return false;
+ }
+ closest.triangle = m_TriangleIds[closest.triangle];
+ hit = closest;
+ return true;
+}
+
+bool Bvh::IntersectSegment(const glm::vec3& from, const glm::vec3& to, RayHit& hit) const
+{
+ return Intersect({ from, to - from,1.0f }, hit);
+}
+
+bool Bvh::IsSegmentBlocked(const glm::vec3& from, const glm::vec3& to) const
+{
+ if (m_Nodes.empty()) {
+ return false;
+ }
+ RayHit any;
+ return Traverse<true>(m_Nodes, m_Triangles, { from, to - from,1.0f }, any);
+}
+
+void Bvh::IntersectRays(std::span<const Ray> rays, std::span<RayHit> hits, CullKernel kernel) const
+{
+ if (hits.size() < rays.size()) {
+ throw std::runtime_error("Bvh::IntersectRays needs a hit per ray");
+ }
+ if (m_Nodes.empty()) {
+ std::fill(hits.begin(), hits.begin() + rays.size(), RayHit{});
+ return;
+ }
+ if (!IsCullKernelSupported(kernel)) {
+ kernel = CullKernel::Scalar;
+ }
+ switch (kernel) {
+#ifdef VENG_BVH_X86
+ case CullKernel::Avx:
+ IntersectPackets<8>(m_Nodes, m_Triangles, m_TriangleIds, rays, hits, IntersectPacketAvx);
+ return;
+ case CullKernel::Sse:
+ IntersectPackets<4>(m_Nodes, m_Triangles, m_TriangleIds, rays, hits, IntersectPacketSse);
+ return;
+#endif
+#ifdef VENG_BVH_NEON
+ case CullKernel::Neon:
+ IntersectPackets<4>(m_Nodes, m_Triangles, m_TriangleIds, rays, hits, IntersectPacketNeon);
+ return;
+#endif
+ default:
+ for (size_t i =0; i < rays.size(); ++i) {
+ hits[i] = RayHit{};
+ Intersect(rays[i], hits[i]);
+ }
+ return;
+ }
+}
+
+} // namespace veng
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "culling.h"
+#include "vertex.h"
+
+namespace veng {
+
+// A node of Bvh: its bounds and where its contents are. An inner node
+// (count 0) has its children at leftFirst and leftFirst + 1; a leaf holds
+// `count` triangles starting at leftFirst in the Bvh's triangle order.
+// 32 bytes, two to a cache line.
+struct BvhNode {
+ glm::vec3 min{0.0f};
+ uint32_t leftFirst =0;
+ glm::vec3 max{0.0f};
+ uint32_t count =0;
+
+ bool IsLeaf() const { return count >0; }
+};
+static_assert(sizeof(BvhNode) ==32, "BvhNode must stay 32 bytes");
+
+// A triangle as the Moller-Trumbore test reads it
+struct BvhTriangle {
+ glm::vec3 v0{0.0f};
+ glm::vec3 edge1{0.0f}; // v1 - v0
+ glm::vec3 edge2{0.0f}; // v2 - v0
+};
+
+// Points origin + t * direction for 0 <= t < tMax; the direction need not
+// be normalized, t is in its units
+struct Ray {
+ glm::vec3 origin{0.0f};
+ glm::vec3 direction{0.0f,0.0f,1.0f};
+ float tMax = std::numeric_limits<float>::infinity();
+};
+
+struct RayHit {
+ float t = std::numeric_limits<float>::infinity();
+ uint32_t triangle = UINT32_MAX;  // first index / 3 in the indices given to Build
+ glm::vec2 barycentrics{0.0f};    // weights of the triangle's second and third vertex
+
+ bool IsHit() const { return triangle != UINT32_MAX; }
+};
+
+struct BvhBuildOptions {
+ uint32_t maxThreads =0;        // 0: every thread of ThreadPool::Shared()
+ uint32_t maxLeafTriangles =8;  // leaves never hold more
+};
+
+struct BvhBuildStats {
+ double ms =0.0;
+ uint32_t triangles =0;
+ uint32_t nodes =0;
+ uint32_t leaves =0;
+ uint32_t maxDepth =0;
+ uint32_t threads =0;
+ float sahCost =0.0f; // expected node visits and triangle tests of a random ray hitting the root
+};
+
+// Bounding volume hierarchy over the triangles of one mesh, for ray queries
+// on the CPU (viewport picking, visibility between points).
+//
+// Built top-down with the surface area heuristic over kBins bins of
+// triangle centroids per axis. The top of the tree is split on the calling
+// thread until subtrees are small enough, then those are built in parallel
+// on ThreadPool::Shared() and appended in a fixed order, so the tree is the
+// same whatever the thread count. Triangles are copied in leaf order, ready
+// for the intersection test, so queries never touch the vertex data.
+//
+// Single rays traverse near child first. IntersectRays tests packets of 4
+// (Sse, Neon) or 8 (Avx) rays against each node together, which pays off for
+// coherent rays such as a camera's; the kernels evaluate the same
+// expressions as the scalar test, without fused multiply-adds, so they find
+// the same hits.
+class Bvh {
+public:
+ static constexpr uint32_t kBins =16;
+
+ // Replaces the tree; a mesh without triangles gives an empty tree
+ void Build(std::span<const Vertex> vertices, std::span<const std::uint32_t> indices, const BvhBuildOptions& options = {});
+ void Clear();
+
+ bool IsEmpty() const { return m_Nodes.empty(); }
+ // Bounds of every triangle; an empty box at the origin for an empty tree
+ Aabb GetBounds() const;
+ std::span<const BvhNode> GetNodes() const { return m_Nodes; }
+ // In leaf order; GetTriangleIds()[i] is the input triangle of GetTriangles()[i]
+ std::span<const BvhTriangle> GetTriangles() const { return m_Triangles; }
+ std::span<const uint32_t> GetTriangleIds() const { return m_TriangleIds; }
+ const BvhBuildStats& GetBuildStats() const { return m_Stats; }
+
+ // Closest hit along the ray; false, and `hit` untouched, for none.
+ // Triangles are hit from either side.
+ bool Intersect(const Ray& ray, RayHit& hit) const;
+ // Closest hit between two points; hit.t runs from 0 at `from` to 1 at `to`
+ bool IntersectSegment(const glm::vec3& from, const glm::vec3& to, RayHit& hit) const;
+ // Whether any triangle lies between two points; stops at the first found
+ bool IsSegmentBlocked(const glm::vec3& from, const glm::vec3& to) const;
+
+ // Closest hit of every ray, hits[i] for rays[i] (a miss is RayHit{}).
+ // `hits` must be as long as `rays`.
+ void IntersectRays(std::span<const Ray> rays, std::span<RayHit> hits, CullKernel kernel = GetBestCullKernel()) const;
+
+private:
+ std::vector<BvhNode> m_Nodes; // the root first
+ std::vector<BvhTriangle> m_Triangles;
+ std::vector<uint32_t> m_TriangleIds;
+ BvhBuildStats m_Stats;
+};
+
+} // namespace veng
@@ -0,0 +1,525 @@
+#include "culling.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VENG_CULL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles AVX intrinsics in any function
+#define VENG_TARGET_AVX
+#else
+#define VENG_TARGET_AVX __attribute__((target("avx")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VENG_CULL_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace veng {
+
+Aabb Aabb::Transformed(const glm::mat4& transform) const
+{
+ // Arvo: the new half size along each axis is the absolute row of the
+ // linear part times the old half size (glm is column-major: m[col][row])
+ Aabb result;
+ result.center = glm::vec3(transform * glm::vec4(center,1.0f));
+ for (int row =0; row <3; ++row) {
+ result.extent[row] = std::abs(transform[0][row]) * extent.x + std::abs(transform[1][row]) * extent.y + std::abs(transform[2][row]) * extent.z;
+ }
+ return result;
+}
+
+Aabb ComputeBounds(std::span<const Vertex> vertices)
+{
+ if (vertices.empty()) {
+ return {};
+ }
+ glm::vec3 min = vertices.front().position;
+ glm::vec3 max = min;
+ for (const Vertex& vertex : vertices) {
+ min = glm::min(min, vertex.position);
+ max = glm::max(max, vertex.position);
+ }
+ return Aabb::FromMinMax(min, max);
+}
+
+// Gribb and Hartmann: each plane is the last row of the matrix plus or minus
+// another row. Vulkan clips depth to [0, w], so near is the third row alone.
+Frustum Frustum::FromViewProjection(const glm::mat4& viewProjection)
+{
+ auto row = [&](int r) { return glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]); };
+ Frustum frustum;
+ frustum.planes[0] = row(3) + row(0); // left
+ frustum.planes[1] = row(3) - row(0); // right
+ frustum.planes[2] = row(3) + row(1); // bottom (top with a flipped y)
+ frustum.planes[3] = row(3) - row(1);
+ frustum.planes[4] = row(2);          // near
+ frustum.planes[5] = row(3) - row(2); // far
+ for (glm::vec4& plane : frustum.planes) {
+ const float length = glm::length(glm::vec3(plane));
+ if (length >0.0f) {
+ plane /= length;
+ }
+ }
+ return frustum;
+}
+
+uint32_t CullingSet::Add(const Aabb& box)
+{
+ if (m_Size % kBatch ==0) {
+ // Start a new batch of empty boxes; the kernels mask the unused lanes
+ for (std::vector<float>* component : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ }) {
+ component->resize(m_Size + kBatch,0.0f);
+ }
+ }
+ m_CenterX[m_Size] = box.center.x;
+ m_CenterY[m_Size] = box.center.y;
+ m_CenterZ[m_Size] = box.center.z;
+ m_ExtentX[m_Size] = box.extent.x;
+ m_ExtentY[m_Size] = box.extent.y;
+ m_ExtentZ[m_Size] = box.extent.z;
+ return m_Size++;
+}
+
+void CullingSet::Clear()
+{
+ for (std::vector<float>* component : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ }) {
+ component->clear();
+ }
+ m_Size =0;
+}
+
+void CullingSet::Reserve(uint32_t count)
+{
+ const size_t padded = (static_cast<size_t>(count) + kBatch -1) / kBatch * kBatch;
+ for (std::vector<float>* component : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ }) {
+ component->reserve(padded);
+ }
+}
+
+uint32_t ClusterCullingSet::Add(const ClusterBounds& bounds)
+{
+ if (m_Size % kBatch ==0) {
+ for (std::vector<float>* component : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius, &m_AxisX, &m_AxisY, &m_AxisZ, &m_Cutoff }) {
+ component->resize(m_Size + kBatch,0.0f);
+ }
+ }
+ m_CenterX[m_Size] = bounds.center.x;
+ m_CenterY[m_Size] = bounds.center.y;
+ m_CenterZ[m_Size] = bounds.center.z;
+ m_Radius[m_Size] = bounds.radius;
+ m_AxisX[m_Size] = bounds.coneAxis.x;
+ m_AxisY[m_Size] = bounds.coneAxis.y;
+ m_AxisZ[m_Size] = bounds.coneAxis.z;
+ m_Cutoff[m_Size] = bounds.coneCutoff;
+ return m_Size++;
+}
+
+void ClusterCullingSet::Clear()
+{
+ for (std::vector<float>* component : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius, &m_AxisX, &m_AxisY, &m_AxisZ, &m_Cutoff }) {
+ component->clear();
+ }
+ m_Size =0;
+}
+
+void ClusterCullingSet::Reserve(uint32_t count)
+{
+ const size_t padded = (static_cast<size_t>(count) + kBatch -1) / kBatch * kBatch;
+ for (std::vector<float>* component : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius, &m_AxisX, &m_AxisY, &m_AxisZ, &m_Cutoff }) {
+ component->reserve(padded);
+ }
+}
+
+namespace {
+
+// Per plane: normal, its absolute value and distance, each ready to broadcast
+struct PlaneConstants {
+ float nx[6], ny[6], nz[6];
+ float ax[6], ay[6], az[6];
+ float w[6];
+};
+
+PlaneConstants GetPlaneConstants(const Frustum& frustum)
+{
+ PlaneConstants c{};
+ for (int p =0; p <6; ++p) {
+ const glm::vec4& plane = frustum.planes[p];
+ c.nx[p] = plane.x;
+ c.ny[p] = plane.y;
+ c.nz[p] = plane.z;
+ c.ax[p] = std::abs(plane.x);
+ c.ay[p] = std::abs(plane.y);
+ c.az[p] = std::abs(plane.z);
+ c.w[p] = plane.w;
+ }
+ return c;
+}
+
+// Appends the set bits of one batch's visibility mask as object indices,
+// dropping the padding lanes of the last batch
+uint32_t EmitVisible(uint32_t mask, uint32_t first, uint32_t size, std::vector<uint32_t>& visible)
+{
+ if (size - first < CullingSet::kBatch) {
+ mask &= (1u << (size - first)) -1;
+ }
+ const uint32_t count = static_cast<uint32_t>(std::popcount(mask));
+ while (mask !=0) {
+ visible.push_back(first + static_cast<uint32_t>(std::countr_zero(mask)));
+ mask &= mask -1;
+ }
+ return count;
+}
+
+// The test every kernel evaluates, in this order: the box is outside a plane
+// when its center's distance plus its projected radius is negative
+uint32_t CullScalar(const PlaneConstants& c, const CullingSet& boxes, std::vector<uint32_t>& visible)
+{
+ const float* cx = boxes.GetCenterX();
+ const float* cy = boxes.GetCenterY();
+ const float* cz = boxes.GetCenterZ();
+ const float* ex = boxes.GetExtentX();
+ const float* ey = boxes.GetExtentY();
+ const float* ez = boxes.GetExtentZ();
+ uint32_t count =0;
+ for (uint32_t first =0; first < boxes.GetSize(); first += CullingSet::kBatch) {
+ uint32_t mask =0;
+ for (uint32_t lane =0; lane < CullingSet::kBatch; ++lane) {
+ const uint32_t i = first + lane;
+ bool inside = true;
+ for (int p =0; p <6 && inside; ++p) {
+ const float distance = cx[i] * c.nx[p] + cy[i] * c.ny[p] + cz[i] * c.nz[p] + c.w[p];
+ const float radius = ex[i] * c.ax[p] + ey[i] * c.ay[p] + ez[i] * c.az[p];
+ inside = distance + radius >=0.0f;
+ }
+ mask |= inside ? (1u << lane) :0u;
+ }
+ count += EmitVisible(mask, first, boxes.GetSize(), visible);
+ }
+ return count;
+}
+
+// Sphere against the planes as for boxes, then the cone test of
+// ClusterBounds; every cluster kernel evaluates it in this order
+uint32_t CullClustersScalar(const PlaneConstants& c, const glm::vec3& camera, const ClusterCullingSet& clusters, std::vector<uint32_t>& visible)
+{
+ const float* cx = clusters.GetCenterX();
+ const float* cy = clusters.GetCenterY();
+ const float* cz = clusters.GetCenterZ();
+ const float* r = clusters.GetRadius();
+ const float* ax = clusters.GetAxisX();
+ const float* ay = clusters.GetAxisY();
+ const float* az = clusters.GetAxisZ();
+ const float* cutoff = clusters.GetCutoff();
+ uint32_t count =0;
+ for (uint32_t first =0; first < clusters.GetSize(); first += ClusterCullingSet::kBatch) {
+ uint32_t mask =0;
+ for (uint32_t lane =0; lane < ClusterCullingSet::kBatch; ++lane) {
+ const uint32_t i = first + lane;
+ bool inside = true;
+ for (int p =0; p <6 && inside; ++p) {
+ const float distance = cx[i] * c.nx[p] + cy[i] * c.ny[p] + cz[i] * c.nz[p] + c.w[p];
+ inside = distance + r[i] >=0.0f;
+ }
+ const float dx = cx[i] - camera.x;
+ const float dy = cy[i] - camera.y;
+ const float dz = cz[i] - camera.z;
+ const float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+ const bool backfacing = dx * ax[i] + dy * ay[i] + dz * az[i] >= cutoff[i] * length + r[i];
+ mask |= inside && !backfacing ? (1u << lane) :0u;
+ }
+ count += EmitVisible(mask, first, clusters.GetSize(), visible);
+ }
+ return count;
+}
+
+#ifdef VENG_CULL_X86
+
+uint32_t CullSse(const PlaneConstants& c, const CullingSet& boxes, std::vector<uint32_t>& visible)
+{
+ uint32_t count =0;
+ for (uint32_t first =0; first < boxes.GetSize(); first += CullingSet::kBatch) {
+ uint32_t mask =0;
+ for (uint32_t half =0; half < CullingSet::kBatch; half +=4) {
+ const uint32_t i = first + half;
+ const __m128 cx = _mm_loadu_ps(boxes.GetCenterX() + i);
+ const __m128 cy = _mm_loadu_ps(boxes.GetCenterY() + i);
+ const __m128 cz = _mm_loadu_ps(boxes.GetCenterZ() + i);
+ const __m128 ex = _mm_loadu_ps(boxes.GetExtentX() + i);
+ const __m128 ey = _mm_loadu_ps(boxes.GetExtentY() + i);
+ const __m128 ez = _mm_loadu_ps(boxes.GetExtentZ() + i);
+ __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+ for (int p =0; p <6; ++p) {
+ const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(c.nx[p])), _mm_mul_ps(cy, _mm_set1_ps(c.ny[p]))),
+ _mm_mul_ps(cz, _mm_set1_ps(c.nz[p]))), _mm_set1_ps(c.w[p]));
+ const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(c.ax[p])), _mm_mul_ps(ey, _mm_set1_ps(c.ay[p]))),
+ _mm_mul_ps(ez, _mm_set1_ps(c.az[p])));
+ inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+ }
+ mask |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << half;
+ }
+ count += EmitVisible(mask, first, boxes.GetSize(), visible);
+ }
+ return count;
+}
+
+VENG_TARGET_AVX uint32_t CullAvx(const PlaneConstants& c, const CullingSet& boxes, std::vector<uint32_t>& visible)
+{
+ uint32_t count =0;
+ for (uint32_t first =0; first < boxes.GetSize(); first += CullingSet::kBatch) {
+ const __m256 cx = _mm256_loadu_ps(boxes.GetCenterX() + first);
+ const __m256 cy = _mm256_loadu_ps(boxes.GetCenterY() + first);
+ const __m256 cz = _mm256_loadu_ps(boxes.GetCenterZ() + first);
+ const __m256 ex = _mm256_loadu_ps(boxes.GetExtentX() + first);
+ const __m256 ey = _mm256_loadu_ps(boxes.GetExtentY() + first);
+ const __m256 ez = _mm256_loadu_ps(boxes.GetExtentZ() + first);
+ __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+ for (int p =0; p <6; ++p) {
+ const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(c.nx[p])), _mm256_mul_ps(cy, _mm256_set1_ps(c.ny[p]))),
+ _mm256_mul_ps(cz, _mm256_set1_ps(c.nz[p]))), _mm256_set1_ps(c.w[p]));
+ const __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(c.ax[p])), _mm256_mul_ps(ey, _mm256_set1_ps(c.ay[p]))),
+ _mm256_mul_ps(ez, _mm256_set1_ps(c.az[p])));
+ inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+ }
+ count += EmitVisible(static_cast<uint32_t>(_mm256_movemask_ps(inside)), first, boxes.GetSize(), visible);
+ }
+ return count;
+}
+
+uint32_t CullClustersSse(const PlaneConstants& c, const glm::vec3& camera, const ClusterCullingSet& clusters, std::vector<uint32_t>& visible)
+{
+ const __m128 camX = _mm_set1_ps(camera.x);
+ const __m128 camY = _mm_set1_ps(camera.y);
+ const __m128 camZ = _mm_set1_ps(camera.z);
+ uint32_t count =0;
+ for (uint32_t first =0; first < clusters.GetSize(); first += ClusterCullingSet::kBatch) {
+ uint32_t mask =0;
+ for (uint32_t half =0; half < ClusterCullingSet::kBatch; half +=4) {
+ const uint32_t i = first + half;
+ const __m128 cx = _mm_loadu_ps(clusters.GetCenterX() + i);
+ const __m128 cy = _mm_loadu_ps(clusters.GetCenterY() + i);
+ const __m128 cz = _mm_loadu_ps(clusters.GetCenterZ() + i);
+ const __m128 r = _mm_loadu_ps(clusters.GetRadius() + i);
+ __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+ for (int p =0; p <6; ++p) {
+ const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(c.nx[p])), _mm_mul_ps(cy, _mm_set1_ps(c.ny[p]))),
+ _mm_mul_ps(cz, _mm_set1_ps(c.nz[p]))), _mm_set1_ps(c.w[p]));
+ inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), _mm_setzero_ps()));
+ }
+ const __m128 dx = _mm_sub_ps(cx, camX);
+ const __m128 dy = _mm_sub_ps(cy, camY);
+ const __m128 dz = _mm_sub_ps(cz, camZ);
+ const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+ const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(clusters.GetAxisX() + i)), _mm_mul_ps(dy, _mm_loadu_ps(clusters.GetAxisY() + i))),
+ _mm_mul_ps(dz, _mm_loadu_ps(clusters.GetAxisZ() + i)));
+ const __m128 backfacing = _mm_cmpge_ps(dot, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(clusters.GetCutoff() + i), length), r));
+ mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_andnot_ps(backfacing, inside))) << half;
+ }
+ count += EmitVisible(mask, first, clusters.GetSize(), visible);
+ }
+ return count;
+}
+
+VENG_TARGET_AVX uint32_t CullClustersAvx(const PlaneConstants& c, const glm::vec3& camera, const ClusterCullingSet& clusters, std::vector<uint32_t>& visible)
+{
+ const __m256 camX = _mm256_set1_ps(camera.x);
+ const __m256 camY = _mm256_set1_ps(camera.y);
+ const __m256 camZ = _mm256_set1_ps(camera.z);
+ uint32_t count =0;
+ for (uint32_t first =0; first < clusters.GetSize(); first += ClusterCullingSet::kBatch) {
+ const __m256 cx = _mm256_loadu_ps(clusters.GetCenterX() + first);
+ const __m256 cy = _mm256_loadu_ps(clusters.GetCenterY() + first);
+ const __m256 cz = _mm256_loadu_ps(clusters.GetCenterZ() + first);
+ const __m256 r = _mm256_loadu_ps(clusters.GetRadius() + first);
+ __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+ for (int p =0; p <6; ++p) {
+ const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(c.nx[p])), _mm256_mul_ps(cy, _mm256_set1_ps(c.ny[p]))),
+ _mm256_mul_ps(cz, _mm256_set1_ps(c.nz[p]))), _mm256_set1_ps(c.w[p]));
+ inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+ }
+ const __m256 dx = _mm256_sub_ps(cx, camX);
+ const __m256 dy = _mm256_sub_ps(cy, camY);
+ const __m256 dz = _mm256_sub_ps(cz, camZ);
+ const __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+ const __m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, _mm256_loadu_ps(clusters.GetAxisX() + first)), _mm256_mul_ps(dy, _mm256_loadu_ps(clusters.GetAxisY() + first))),
+ _mm256_mul_ps(dz, _mm256_loadu_ps(clusters.GetAxisZ() + first)));
+ const __m256 backfacing = _mm256_cmp_ps(dot, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(clusters.GetCutoff() + first), length), r), _CMP_GE_OQ);
+ count += EmitVisible(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_andnot_ps(backfacing, inside))), first, clusters.GetSize(), visible);
+ }
+ return count;
+}
+
+bool DetectAvx()
+{
+#if defined(_MSC_VER)
+ int info[4];
+ __cpuid(info,1);
+ const bool osxsave = (info[2] & (1 <<27)) !=0;
+ const bool avx = (info[2] & (1 <<28)) !=0;
+ // The OS must save the YMM registers on context switches
+ return osxsave && avx && (_xgetbv(0) &0x6) ==0x6;
+#else
+ return __builtin_cpu_supports("avx");
+#endif
+}
+
+#endif // VENG_CULL_X86
+
+#ifdef VENG_CULL_NEON
+
+uint32_t CullNeon(const PlaneConstants& c, const CullingSet& boxes, std::vector<uint32_t>& visible)
+{
+ static const uint32_t kLaneBits[4] = {1,2,4,8 };
+ const uint32x4_t laneBits = vld1q_u32(kLaneBits);
+ uint32_t count =0;
+ for (uint32_t first =0; first < boxes.GetSize(); first += CullingSet::kBatch) {
+ uint32_t mask =0;
+ for (uint32_t half =0; half < CullingSet::kBatch; half +=4) {
+ const uint32_t i = first + half;
+ const float32x4_t cx = vld1q_f32(boxes.GetCenterX() + i);
+ const float32x4_t cy = vld1q_f32(boxes.GetCenterY() + i);
+ const float32x4_t cz = vld1q_f32(boxes.GetCenterZ() + i);
+ const float32x4_t ex = vld1q_f32(boxes.GetExtentX() + i);
+ const float32x4_t ey = vld1q_f32(boxes.GetExtentY() + i);
+ const float32x4_t ez = vld1q_f32(boxes.GetExtentZ() + i);
+ uint32x4_t inside = vdupq_n_u32(0xffffffffu);
+ for (int p =0; p <6; ++p) {
+ // Separate multiplies and adds, not vfmaq: same rounding as the scalar test
+ const float32x4_t distance = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_n_f32(cx, c.nx[p]), vmulq_n_f32(cy, c.ny[p])),
+ vmulq_n_f32(cz, c.nz[p])), vdupq_n_f32(c.w[p]));
+ const float32x4_t radius = vaddq_f32(vaddq_f32(vmulq_n_f32(ex, c.ax[p]), vmulq_n_f32(ey, c.ay[p])), vmulq_n_f32(ez, c.az[p]));
+ inside = vandq_u32(inside, vcgezq_f32(vaddq_f32(distance, radius)));
+ }
+ mask |= vaddvq_u32(vandq_u32(inside, laneBits)) << half;
+ }
+ count += EmitVisible(mask, first, boxes.GetSize(), visible);
+ }
+ return count;
+}
+
+uint32_t CullClustersNeon(const PlaneConstants& c, const glm::vec3& camera, const ClusterCullingSet& clusters, std::vector<uint32_t>& visible)
+{
+ static const uint32_t kLaneBits[4] = {1,2,4,8 };
+ const uint32x4_t laneBits = vld1q_u32(kLaneBits);
+ uint32_t count =0;
+ for (uint32_t first =0; first < clusters.GetSize(); first += ClusterCullingSet::kBatch) {
+ uint32_t mask =0;
+ for (uint32_t half =0; half < ClusterCullingSet::kBatch; half +=4) {
+ const uint32_t i = first + half;
+ const float32x4_t cx = vld1q_f32(clusters.GetCenterX() + i);
+ const float32x4_t cy = vld1q_f32(clusters.GetCenterY() + i);
+ const float32x4_t cz = vld1q_f32(clusters.GetCenterZ() + i);
+ const float32x4_t r = vld1q_f32(clusters.GetRadius() + i);
+ uint32x4_t inside = vdupq_n_u32(0xffffffffu);
+ for (int p =0; p <6; ++p) {
+ const float32x4_t distance = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_n_f32(cx, c.nx[p]), vmulq_n_f32(cy, c.ny[p])),
+ vmulq_n_f32(cz, c.nz[p])), vdupq_n_f32(c.w[p]));
+ inside = vandq_u32(inside, vcgezq_f32(vaddq_f32(distance, r)));
+ }
+ const float32x4_t dx = vsubq_f32(cx, vdupq_n_f32(camera.x));
+ const float32x4_t dy = vsubq_f32(cy, vdupq_n_f32(camera.y));
+ const float32x4_t dz = vsubq_f32(cz, vdupq_n_f32(camera.z));
+ const float32x4_t length = vsqrtq_f32(vaddq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)), vmulq_f32(dz, dz)));
+ const float32x4_t dot = vaddq_f32(vaddq_f32(vmulq_f32(dx, vld1q_f32(clusters.GetAxisX() + i)), vmulq_f32(dy, vld1q_f32(clusters.GetAxisY() + i))),
+ vmulq_f32(dz, vld1q_f32(clusters.GetAxisZ() + i)));
+ const uint32x4_t backfacing = vcgeq_f32(dot, vaddq_f32(vmulq_f32(vld1q_f32(clusters.GetCutoff() + i), length), r));
+ mask |= vaddvq_u32(vandq_u32(vbicq_u32(inside, backfacing), laneBits)) << half;
+ }
+ count += EmitVisible(mask, first, clusters.GetSize(), visible);
+ }
+ return count;
+}
+
+#endif // VENG_CULL_NEON
+
+} // namespace
+
+const char* GetCullKernelName(CullKernel kernel)
+{
+ switch (kernel) {
+ case CullKernel::Scalar: return "scalar";
+ case CullKernel::Sse: return "sse";
+ case CullKernel::Avx: return "avx";
+ case CullKernel::Neon: return "neon";
+ }
+ return "unknown";
+}
+
+bool IsCullKernelSupported(CullKernel kernel)
+{
+ switch (kernel) {
+ case CullKernel::Scalar:
+ return true;
+#ifdef VENG_CULL_X86
+ case CullKernel::Sse:
+ return true; // part of x86-64
+ case CullKernel::Avx: {
+ static const bool supported = DetectAvx();
+ return supported;
+ }
+#endif
+#ifdef VENG_CULL_NEON
+ case CullKernel::Neon:
+ return true; // part of AArch64
+#endif
+ default:
+ return false;
+ }
+}
+
+CullKernel GetBestCullKernel()
+{
+ for (CullKernel kernel : { CullKernel::Avx, CullKernel::Neon, CullKernel::Sse }) {
+ if (IsCullKernelSupported(kernel)) {
+ return kernel;
+ }
+ }
+ return CullKernel::Scalar;
+}
+
+uint32_t CullBoxes(const Frustum& frustum, const CullingSet& boxes, std::vector<uint32_t>& visible, CullKernel kernel)
+{
+ if (boxes.IsEmpty()) {
+ return 0;
+ }
+ const PlaneConstants constants = GetPlaneConstants(frustum);
+ if (!IsCullKernelSupported(kernel)) {
+ kernel = CullKernel::Scalar;
+ }
+ switch (kernel) {
+#ifdef VENG_CULL_X86
+ case CullKernel::Avx: return CullAvx(constants, boxes, visible);
+ case CullKernel::Sse: return CullSse(constants, boxes, visible);
+#endif
+#ifdef VENG_CULL_NEON
+ case CullKernel::Neon: return CullNeon(constants, boxes, visible);
+#endif
+ default: return CullScalar(constants, boxes, visible);
+ }
+}
+
+uint32_t CullClusters(const Frustum& frustum, const glm::vec3& camera, const ClusterCullingSet& clusters, std::vector<uint32_t>& visible, CullKernel kernel)
+{
+ if (clusters.IsEmpty()) {
+ return 0;
+ }
+ const PlaneConstants constants = GetPlaneConstants(frustum);
+ if (!IsCullKernelSupported(kernel)) {
+ kernel = CullKernel::Scalar;
+ }
+ switch (kernel) {
+#ifdef VENG_CULL_X86
+ case CullKernel::Avx: return CullClustersAvx(constants, camera, clusters, visible);
+ case CullKernel::Sse: return CullClustersSse(constants, camera, clusters, visible);
+#endif
+#ifdef VENG_CULL_NEON
+ case CullKernel::Neon: return CullClustersNeon(constants, camera, clusters, visible);
+#endif
+ default: return CullClustersScalar(constants, camera, clusters, visible);
+ }
+}
+
+} // namespace veng
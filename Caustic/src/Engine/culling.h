@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "vertex.h"
+
+namespace veng {
+
+// Axis aligned box as center and half size, the form the culling test uses
+struct Aabb {
+ glm::vec3 center{0.0f};
+ glm::vec3 extent{0.0f};
+
+ static Aabb FromMinMax(glm::vec3 min, glm::vec3 max) { return { (min + max) *0.5f, (max - min) *0.5f }; }
+ // Smallest box holding this one after an affine transform
+ Aabb Transformed(const glm::mat4& transform) const;
+};
+
+// Bounds of the vertex positions; an empty box at the origin for no vertices
+Aabb ComputeBounds(std::span<const Vertex> vertices);
+
+// Planes of a view-projection's clip volume (Vulkan depth range, 0 <= z <= w),
+// normalized and pointing inwards: p is inside plane i when dot(xyz, p) + w >= 0
+struct Frustum {
+ std::array<glm::vec4,6> planes{};
+
+ static Frustum FromViewProjection(const glm::mat4& viewProjection);
+};
+
+// World space boxes of many objects, one array per component, so the culling
+// kernels load the same component of kBatch objects with one instruction. The
+// arrays are padded to a multiple of kBatch; padding is never reported visible.
+class CullingSet {
+public:
+ static constexpr uint32_t kBatch =8;
+
+ // Index of the box, in the order added
+ uint32_t Add(const Aabb& box);
+ void Clear();
+ void Reserve(uint32_t count);
+
+ uint32_t GetSize() const { return m_Size; }
+ bool IsEmpty() const { return m_Size ==0; }
+
+ const float* GetCenterX() const { return m_CenterX.data(); }
+ const float* GetCenterY() const { return m_CenterY.data(); }
+ const float* GetCenterZ() const { return m_CenterZ.data(); }
+ const float* GetExtentX() const { return m_ExtentX.data(); }
+ const float* GetExtentY() const { return m_ExtentY.data(); }
+ const float* GetExtentZ() const { return m_ExtentZ.data(); }
+
+private:
+ std::vector<float> m_CenterX;
+ std::vector<float> m_CenterY;
+ std::vector<float> m_CenterZ;
+ std::vector<float> m_ExtentX;
+ std::vector<float> m_ExtentY;
+ std::vector<float> m_ExtentZ;
+ uint32_t m_Size =0;
+};
+
+// Instruction sets the box test is written for. Avx tests 8 boxes per step,
+// Sse and Neon two groups of 4. Avx is picked at run time, so builds for any
+// x86-64 CPU still use it where present.
+enum class CullKernel {
+ Scalar,
+ Sse,
+ Avx,
+ Neon
+};
+
+const char* GetCullKernelName(CullKernel kernel);
+bool IsCullKernelSupported(CullKernel kernel);
+// Fastest supported kernel, detected once
+CullKernel GetBestCullKernel();
+
+// Appends the index of every box at least partly inside `frustum` to `visible`
+// (ascending) and returns how many were appended. Boxes are tested against
+// each plane on its own, so a box just outside a frustum corner may be kept;
+// nothing inside is ever dropped. The kernels evaluate the same expression in
+// the same order without fused multiply-adds, so they agree on every box.
+uint32_t CullBoxes(const Frustum& frustum, const CullingSet& boxes, std::vector<uint32_t>& visible, CullKernel kernel = GetBestCullKernel());
+
+// Bounding sphere and normal cone of a cluster of triangles (see meshlet.h),
+// in the space of its mesh. Seen from `camera`, every triangle of the cluster
+// faces away when
+//   dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius
+// coneCutoff is the sine of the cone's half angle; 1 never passes the test.
+struct ClusterBounds {
+ glm::vec3 center{0.0f};
+ float radius =0.0f;
+ glm::vec3 coneAxis{0.0f,0.0f,1.0f};
+ float coneCutoff =1.0f;
+};
+
+// ClusterBounds of many clusters, one array per component like CullingSet
+class ClusterCullingSet {
+public:
+ static constexpr uint32_t kBatch = CullingSet::kBatch;
+
+ uint32_t Add(const ClusterBounds& bounds);
+ void Clear();
+ void Reserve(uint32_t count);
+
+ uint32_t GetSize() const { return m_Size; }
+ bool IsEmpty() const { return m_Size ==0; }
+
+ const float* GetCenterX() const { return m_CenterX.data(); }
+ const float* GetCenterY() const { return m_CenterY.data(); }
+ const float* GetCenterZ() const { return m_CenterZ.data(); }
+ const float* GetRadius() const { return m_Radius.data(); }
+ const float* GetAxisX() const { return m_AxisX.data(); }
+ const float* GetAxisY() const { return m_AxisY.data(); }
+ const float* GetAxisZ() const { return m_AxisZ.data(); }
+ const float* GetCutoff() const { return m_Cutoff.data(); }
+
+private:
+ std::vector<float> m_CenterX;
+ std::vector<float> m_CenterY;
+ std::vector<float> m_CenterZ;
+ std::vector<float> m_Radius;
+ std::vector<float> m_AxisX;
+ std::vector<float> m_AxisY;
+ std::vector<float> m_AxisZ;
+ std::vector<float> m_Cutoff;
+ uint32_t m_Size =0;
+};
+
+// Appends the index of every cluster whose sphere is at least partly inside
+// `frustum` and that does not face away from `camera` (ascending), and
+// returns how many were appended. `frustum` and `camera` are in the space of
+// the bounds: for a mesh placed by `model`, the frustum of
+// viewProjection * model and the camera position through inverse(model).
+// Same guarantees as CullBoxes: conservative, and every kernel agrees.
+uint32_t CullClusters(const Frustum& frustum, const glm::vec3& camera, const ClusterCullingSet& clusters, std::vector<uint32_t>& visible,
+ CullKernel kernel = GetBestCullKernel());
+
+} // namespace veng
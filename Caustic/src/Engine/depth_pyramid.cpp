@@ -0,0 +1,345 @@
+#include "depth_pyramid.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace veng {
+
+namespace {
+
+// Matches the push constant block of the shader
+struct LevelConstants {
+ int32_t sourceWidth =0;
+ int32_t sourceHeight =0;
+ int32_t width =0;
+ int32_t height =0;
+};
+
+constexpr VkFormat kPyramidFormat = VK_FORMAT_R32_SFLOAT;
+
+} // namespace
+
+DepthPyramid::DepthPyramid(VkDevice device, DeviceAllocator& allocator, const std::vector<char>& shaderCode)
+ : m_Device(device), m_Allocator(allocator)
+{
+ // Nearest and clamped; the shaders only use texelFetch
+ VkSamplerCreateInfo samplerInfo{};
+ samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+ samplerInfo.magFilter = VK_FILTER_NEAREST;
+ samplerInfo.minFilter = VK_FILTER_NEAREST;
+ samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+ samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+ samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+ samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+ samplerInfo.minLod =0.0f;
+ samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+ if (vkCreateSampler(m_Device, &samplerInfo, nullptr, &m_Sampler) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create depth pyramid sampler");
+ }
+ if (shaderCode.empty()) {
+ return;
+ }
+
+ try {
+ std::array<VkDescriptorSetLayoutBinding,2> bindings{};
+ bindings[0].binding =0;
+ bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+ bindings[0].descriptorCount =1;
+ bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+ bindings[1].binding =1;
+ bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+ bindings[1].descriptorCount =1;
+ bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+ VkDescriptorSetLayoutCreateInfo layoutInfo{};
+ layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+ layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+ layoutInfo.pBindings = bindings.data();
+ if (vkCreateDescriptorSetLayout(m_Device, &layoutInfo, nullptr, &m_DescriptorSetLayout) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create depth pyramid descriptor set layout");
+ }
+
+ VkPushConstantRange pushConstant{};
+ pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+ pushConstant.offset =0;
+ pushConstant.size = sizeof(LevelConstants);
+
+ VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+ pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+ pipelineLayoutInfo.setLayoutCount =1;
+ pipelineLayoutInfo.pSetLayouts = &m_DescriptorSetLayout;
+ pipelineLayoutInfo.pushConstantRangeCount =1;
+ pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+ if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create depth pyramid pipeline layout");
+ }
+
+ VkShaderModuleCreateInfo moduleInfo{};
+ moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+ moduleInfo.codeSize = shaderCode.size();
+ moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+ VkShaderModule module = VK_NULL_HANDLE;
+ if (vkCreateShaderModule(m_Device, &moduleInfo, nullptr, &module) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create depth pyramid shader module");
+ }
+
+ VkComputePipelineCreateInfo pipelineInfo{};
+ pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+ pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+ pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+ pipelineInfo.stage.module = module;
+ pipelineInfo.stage.pName = "main";
+ pipelineInfo.layout = m_PipelineLayout;
+ const VkResult result = vkCreateComputePipelines(m_Device, VK_NULL_HANDLE,1, &pipelineInfo, nullptr, &m_Pipeline);
+ vkDestroyShaderModule(m_Device, module, nullptr);
+ if (result != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create depth pyramid pipeline");
+ }
+ } catch (...) {
+ // The destructor does not run for a throwing constructor
+ vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
+ vkDestroyDescriptorSetLayout(m_Device, m_DescriptorSetLayout, nullptr);
+ vkDestroySampler(m_Device, m_Sampler, nullptr);
+ throw;
+ }
+}
+
+DepthPyramid::~DepthPyramid()
+{
+ Release();
+ // Null handles are ignored, as when there was no shader
+ vkDestroyPipeline(m_Device, m_Pipeline, nullptr);
+ vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
+ vkDestroyDescriptorSetLayout(m_Device, m_DescriptorSetLayout, nullptr);
+ vkDestroySampler(m_Device, m_Sampler, nullptr);
+}
+
+void DepthPyramid::Resize(uint32_t width, uint32_t height, std::span<const VkImageView> depthViews)
+{
+ Release();
+ m_Width = std::max(width,1u);
+ m_Height = std::max(height,1u);
+
+ // Each level half the one before, rounded up so it still covers the whole
+ // target, down to a single texel
+ VkExtent2D size = { m_Width, m_Height };
+ do {
+ size = { (size.width +1) /2, (size.height +1) /2 };
+ m_LevelSizes.push_back(size);
+ } while (size.width >1 || size.height >1);
+ const uint32_t levelCount = GetLevelCount();
+
+ VkImageCreateInfo imageInfo{};
+ imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+ imageInfo.imageType = VK_IMAGE_TYPE_2D;
+ imageInfo.extent = { m_LevelSizes[0].width, m_LevelSizes[0].height,1 };
+ imageInfo.mipLevels = levelCount;
+ imageInfo.arrayLayers =1;
+ imageInfo.format = kPyramidFormat;
+ imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+ imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+ imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+ imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+ imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+ if (vkCreateImage(m_Device, &imageInfo, nullptr, &m_Image) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create depth pyramid image");
+ }
+ m_ImageMemory = m_Allocator.AllocateForImage(m_Image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+ VkImageViewCreateInfo viewInfo{};
+ viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+ viewInfo.image = m_Image;
+ viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+ viewInfo.format = kPyramidFormat;
+ viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+ viewInfo.subresourceRange.baseMipLevel =0;
+ viewInfo.subresourceRange.levelCount = levelCount;
+ viewInfo.subresourceRange.baseArrayLayer =0;
+ viewInfo.subresourceRange.layerCount =1;
+ if (vkCreateImageView(m_Device, &viewInfo, nullptr, &m_View) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create depth pyramid view");
+ }
+ m_LevelViews.resize(levelCount, VK_NULL_HANDLE);
+ viewInfo.subresourceRange.levelCount =1;
+ for (uint32_t level =0; level < levelCount; ++level) {
+ viewInfo.subresourceRange.baseMipLevel = level;
+ if (vkCreateImageView(m_Device, &viewInfo, nullptr, &m_LevelViews[level]) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create depth pyramid level view");
+ }
+ }
+
+ if (IsSupported()) {
+ CreateDescriptorSets(depthViews);
+ }
+}
+
+void DepthPyramid::Release()
+{
+ if (m_DescriptorPool != VK_NULL_HANDLE) {
+ vkDestroyDescriptorPool(m_Device, m_DescriptorPool, nullptr);
+ m_DescriptorPool = VK_NULL_HANDLE;
+ }
+ m_DescriptorSets.clear();
+ for (VkImageView view : m_LevelViews) {
+ vkDestroyImageView(m_Device, view, nullptr);
+ }
+ m_LevelViews.clear();
+ if (m_View != VK_NULL_HANDLE) {
+ vkDestroyImageView(m_Device, m_View, nullptr);
+ m_View = VK_NULL_HANDLE;
+ }
+ if (m_Image != VK_NULL_HANDLE) {
+ vkDestroyImage(m_Device, m_Image, nullptr);
+ m_Image = VK_NULL_HANDLE;
+ }
+ m_Allocator.Free(m_ImageMemory);
+ m_LevelSizes.clear();
+ m_LayoutReady = false;
+}
+
+void DepthPyramid::CreateDescriptorSets(std::span<const VkImageView> depthViews)
+{
+ const uint32_t levelCount = GetLevelCount();
+ const uint32_t setCount = static_cast<uint32_t>(depthViews.size()) * levelCount;
+
+ std::array<VkDescriptorPoolSize,2> poolSizes{};
+ poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+ poolSizes[0].descriptorCount = setCount;
+ poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+ poolSizes[1].descriptorCount = setCount;
+ VkDescriptorPoolCreateInfo poolInfo{};
+ poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+ poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+ poolInfo.pPoolSizes = poolSizes.data();
+ poolInfo.maxSets = setCount;
+ if (vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &m_DescriptorPool) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create depth pyramid descriptor pool");
+ }
+
+ std::vector<VkDescriptorSetLayout> layouts(setCount, m_DescriptorSetLayout);
+ m_DescriptorSets.resize(setCount);
+ VkDescriptorSetAllocateInfo allocInfo{};
+ allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+ allocInfo.descriptorPool = m_DescriptorPool;
+ allocInfo.descriptorSetCount = setCount;
+ allocInfo.pSetLayouts = layouts.data();
+ if (vkAllocateDescriptorSets(m_Device, &allocInfo, m_DescriptorSets.data()) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to allocate depth pyramid descriptor sets");
+ }
+
+ std::vector<VkDescriptorImageInfo> sources(setCount);
+ std::vector<VkDescriptorImageInfo> destinations(setCount);
+ std::vector<VkWriteDescriptorSet> writes;
+ writes.reserve(setCount *2);
+ for (uint32_t set =0; set < setCount; ++set) {
+ const uint32_t slot = set / levelCount;
+ const uint32_t level = set % levelCount;
+ sources[set].sampler = m_Sampler;
+ sources[set].imageView = level ==0 ? depthViews[slot] : m_LevelViews[level -1];
+ sources[set].imageLayout = level ==0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+ destinations[set].imageView = m_LevelViews[level];
+ destinations[set].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+ VkWriteDescriptorSet write{};
+ write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+ write.dstSet = m_DescriptorSets[set];
+ write.descriptorCount =1;
+ write.dstBinding =0;
+ write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+ write.pImageInfo = &sources[set];
+ writes.push_back(write);
+ write.dstBinding =1;
+ write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+ write.pImageInfo = &destinations[set];
+ writes.push_back(write);
+ }
+ vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(writes.size()), writes.data(),0, nullptr);
+}
+
+void DepthPyramid::RecordInitialLayout(VkCommandBuffer cmd)
+{
+ if (m_LayoutReady || m_Image == VK_NULL_HANDLE) {
+ return;
+ }
+ VkImageMemoryBarrier barrier{};
+ barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+ barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+ barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+ barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+ barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+ barrier.image = m_Image;
+ barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT,0, GetLevelCount(),0,1 };
+ barrier.srcAccessMask =0;
+ barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,0, nullptr,0, nullptr,1, &barrier);
+ m_LayoutReady = true;
+}
+
+void DepthPyramid::Record(VkCommandBuffer cmd, uint32_t frameIndex, VkImage depthImage)
+{
+ if (!IsSupported() || m_Image == VK_NULL_HANDLE) {
+ return;
+ }
+ RecordInitialLayout(cmd);
+ const uint32_t levelCount = GetLevelCount();
+
+ // Depth writes done before the reduction reads them; the last frame's
+ // culling done reading the pyramid before it is overwritten
+ std::array<VkImageMemoryBarrier,2> barriers{};
+ barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+ barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+ barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+ barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+ barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+ barriers[0].image = depthImage;
+ barriers[0].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT,0,1,0,1 };
+ barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+ barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+ barriers[1] = barriers[0];
+ barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+ barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+ barriers[1].image = m_Image;
+ barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT,0, levelCount,0,1 };
+ barriers[1].srcAccessMask =0;
+ barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+ 0,0, nullptr,0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+ vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+ VkExtent2D sourceSize = { m_Width, m_Height };
+ for (uint32_t level =0; level < levelCount; ++level) {
+ const VkExtent2D size = m_LevelSizes[level];
+ LevelConstants constants;
+ constants.sourceWidth = static_cast<int32_t>(sourceSize.width);
+ constants.sourceHeight = static_cast<int32_t>(sourceSize.height);
+ constants.width = static_cast<int32_t>(size.width);
+ constants.height = static_cast<int32_t>(size.height);
+ vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout,0,1, &m_DescriptorSets[frameIndex * levelCount + level],0, nullptr);
+ vkCmdPushConstants(cmd, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,0, sizeof(constants), &constants);
+ vkCmdDispatch(cmd, (size.width + kWorkgroupSize -1) / kWorkgroupSize, (size.height + kWorkgroupSize -1) / kWorkgroupSize,1);
+
+ // The next level, and after the last one the culling, reads this one
+ VkImageMemoryBarrier written{};
+ written.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+ written.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+ written.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+ written.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+ written.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+ written.image = m_Image;
+ written.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level,1,0,1 };
+ written.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+ written.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,0, nullptr,0, nullptr,1, &written);
+ sourceSize = size;
+ }
+
+ // Back to depth testing once level 0 has read it
+ VkImageMemoryBarrier depth = barriers[0];
+ depth.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+ depth.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+ depth.srcAccessMask =0;
+ depth.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+ 0,0, nullptr,0, nullptr,1, &depth);
+}
+
+} // namespace veng
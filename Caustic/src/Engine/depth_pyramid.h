@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "device_allocator.h"
+
+namespace veng {
+
+// Hierarchical-Z pyramid of a depth target: a mip chain of R32 images, each
+// texel the farthest depth of the 2x2 texels under it in the level before,
+// level 0 a reduction of the depth target itself (shaders/depth_pyramid.comp).
+// A box whose nearest depth is beyond the pyramid's value over its screen
+// rectangle is hidden by what was drawn.
+//
+// The pyramid is kept in VK_IMAGE_LAYOUT_GENERAL, sampled by GetView() with
+// GetSampler() and texelFetch.
+class DepthPyramid {
+public:
+ static constexpr uint32_t kWorkgroupSize =8; // local_size_x and _y of the shader
+
+ // `shaderCode` is shaders/depth_pyramid.comp.spv; without it the pyramid
+ // images still exist (for descriptors to point at) but cannot be built
+ DepthPyramid(VkDevice device, DeviceAllocator& allocator, const std::vector<char>& shaderCode);
+ ~DepthPyramid();
+
+ DepthPyramid(const DepthPyramid&) = delete;
+ DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+ bool IsSupported() const { return m_Pipeline != VK_NULL_HANDLE; }
+
+ // (Re)creates the pyramid for depth targets of this size; `depthViews` are
+ // the VK_FORMAT_D32_SFLOAT views of every frame slot's target, sampled as
+ // VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. Nothing may still use the
+ // previous pyramid.
+ void Resize(uint32_t width, uint32_t height, std::span<const VkImageView> depthViews);
+ void Release();
+
+ // Moves a new pyramid out of VK_IMAGE_LAYOUT_UNDEFINED, once; anything
+ // sampling it must be recorded after
+ void RecordInitialLayout(VkCommandBuffer cmd);
+ // Reduces frame slot `frameIndex`'s depth target, written by the render pass
+ // just ended and left in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+ // into the pyramid. Hands the target back in that layout for more depth
+ // testing, and the pyramid over to compute shader reads.
+ void Record(VkCommandBuffer cmd, uint32_t frameIndex, VkImage depthImage);
+
+ VkImageView GetView() const { return m_View; }
+ VkSampler GetSampler() const { return m_Sampler; }
+ uint32_t GetLevelCount() const { return static_cast<uint32_t>(m_LevelSizes.size()); }
+
+private:
+ void CreateDescriptorSets(std::span<const VkImageView> depthViews);
+
+ VkDevice m_Device = VK_NULL_HANDLE;
+ DeviceAllocator& m_Allocator;
+
+ VkDescriptorSetLayout m_DescriptorSetLayout = VK_NULL_HANDLE;
+ VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+ VkPipeline m_Pipeline = VK_NULL_HANDLE;
+ VkSampler m_Sampler = VK_NULL_HANDLE;
+
+ uint32_t m_Width =0;  // of the depth target
+ uint32_t m_Height =0;
+ std::vector<VkExtent2D> m_LevelSizes;
+ VkImage m_Image = VK_NULL_HANDLE;
+ Allocation m_ImageMemory{};
+ VkImageView m_View = VK_NULL_HANDLE;        // every level
+ std::vector<VkImageView> m_LevelViews;      // one level each
+ bool m_LayoutReady = false;
+ VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+ // Level l of frame slot f at f * GetLevelCount() + l; only level 0 differs
+ // between slots
+ std::vector<VkDescriptorSet> m_DescriptorSets;
+};
+
+} // namespace veng
@@ -0,0 +1,667 @@
+#include "device_allocator.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <stdexcept>
+
+namespace veng {
+
+namespace {
+
+constexpr VkDeviceSize kDeviceLocalBlockSize = 64ull *1024 *1024;
+constexpr VkDeviceSize kHostVisibleBlockSize = 16ull *1024 *1024;
+constexpr VkDeviceSize kArenaChunkSize = 4ull *1024 *1024;
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+ return alignment <=1 ? value : (value + alignment -1) / alignment * alignment;
+}
+
+VkDeviceSize AlignDown(VkDeviceSize value, VkDeviceSize alignment)
+{
+ return alignment <=1 ? value : value / alignment * alignment;
+}
+
+} // namespace
+
+// Two-level segregated fit over one VkDeviceMemory block: O(1) allocate and
+// free with bounded fragmentation. Nodes describe contiguous ranges in address
+// order; free nodes are additionally linked into per-size-class lists whose
+// occupancy is tracked in two bitmaps.
+class DeviceAllocator::TlsfBlock {
+public:
+ explicit TlsfBlock(VkDeviceSize size)
+ : m_Size(size), m_FreeBytes(size)
+ {
+ for (auto& row : m_Heads) {
+ row.fill(kNone);
+ }
+ uint32_t node = NewNode();
+ m_Nodes[node].offset =0;
+ m_Nodes[node].size = size;
+ InsertFree(node);
+ }
+
+ bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset, uint32_t& outNode)
+ {
+ size = std::max<VkDeviceSize>(size, kMinNodeSize);
+ // Reserve room for worst-case alignment padding so the first fit always fits
+ VkDeviceSize searchSize = size + (alignment >1 ? alignment -1 :0);
+ uint32_t fl, sl;
+ MappingSearch(searchSize, fl, sl);
+ uint32_t node = FindFree(fl, sl);
+ if (node == kNone) {
+ return false;
+ }
+ RemoveFree(node);
+
+ // Split off alignment padding at the front as its own free node
+ VkDeviceSize aligned = AlignUp(m_Nodes[node].offset, alignment);
+ VkDeviceSize padding = aligned - m_Nodes[node].offset;
+ if (padding >0) {
+ uint32_t front = node;
+ node = SplitAt(front, padding);
+ InsertFree(front);
+ }
+
+ // Return the tail to the free lists when it is worth tracking
+ if (m_Nodes[node].size - size >= kMinNodeSize) {
+ uint32_t tail = SplitAt(node, size);
+ InsertFree(tail);
+ }
+
+ m_Nodes[node].free = false;
+ m_FreeBytes -= m_Nodes[node].size;
+ outOffset = m_Nodes[node].offset;
+ outNode = node;
+ return true;
+ }
+
+ void Free(uint32_t node)
+ {
+ m_FreeBytes += m_Nodes[node].size;
+ m_Nodes[node].free = true;
+
+ uint32_t prev = m_Nodes[node].prevPhys;
+ if (prev != kNone && m_Nodes[prev].free) {
+ RemoveFree(prev);
+ Merge(prev, node);
+ node = prev;
+ }
+ uint32_t next = m_Nodes[node].nextPhys;
+ if (next != kNone && m_Nodes[next].free) {
+ RemoveFree(next);
+ Merge(node, next);
+ }
+ InsertFree(node);
+ }
+
+ VkDeviceSize GetAllocationSize(uint32_t node) const { return m_Nodes[node].size; }
+ VkDeviceSize GetSize() const { return m_Size; }
+ VkDeviceSize GetFreeBytes() const { return m_FreeBytes; }
+ bool IsEmpty() const { return m_FreeBytes == m_Size; }
+
+ VkDeviceSize GetLargestFreeRange() const
+ {
+ if (m_FLBitmap ==0) {
+ return 0;
+ }
+ uint32_t fl =63 - std::countl_zero(m_FLBitmap);
+ uint32_t sl =31 - std::countl_zero(m_SLBitmap[fl]);
+ VkDeviceSize largest =0;
+ for (uint32_t node = m_Heads[fl][sl]; node != kNone; node = m_Nodes[node].nextFree) {
+ largest = std::max(largest, m_Nodes[node].size);
+ }
+ return largest;
+ }
+
+private:
+ static constexpr uint32_t kNone = UINT32_MAX;
+ static constexpr uint32_t kSLShift =5;
+ static constexpr uint32_t kSLCount =1u << kSLShift;
+ static constexpr uint32_t kFLOffset =8;
+ static constexpr VkDeviceSize kSmallSize =1ull << kFLOffset;
+ static constexpr uint32_t kFLCount =64 - kFLOffset +1;
+ static constexpr VkDeviceSize kMinNodeSize =64;
+
+ struct Node {
+ VkDeviceSize offset =0;
+ VkDeviceSize size =0;
+ uint32_t prevPhys = kNone;
+ uint32_t nextPhys = kNone;
+ uint32_t prevFree = kNone;
+ uint32_t nextFree = kNone;
+ bool free = false;
+ };
+
+ static void Mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+ {
+ if (size < kSmallSize) {
+ fl =0;
+ sl = static_cast<uint32_t>(size / (kSmallSize / kSLCount));
+ return;
+ }
+ uint32_t msb =63 - std::countl_zero(size);
+ sl = static_cast<uint32_t>(size >> (msb - kSLShift)) ^ kSLCount;
+ fl = msb - kFLOffset +1;
+ }
+
+ // Round up to the next size class so any block found in it is large enough
+ static void MappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+ {
+ if (size < kSmallSize) {
+ size = AlignUp(size, kSmallSize / kSLCount);
+ } else {
+ uint32_t msb =63 - std::countl_zero(size);
+ size += (1ull << (msb - kSLShift)) -1;
+ }
+ Mapping(size, fl, sl);
+ }
+
+ uint32_t FindFree(uint32_t& fl, uint32_t& sl) const
+ {
+ if (fl >= kFLCount) {
+ return kNone;
+ }
+ uint32_t slMap = m_SLBitmap[fl] & (~0u << sl);
+ if (slMap ==0) {
+ uint64_t flMap = fl +1 <64 ? m_FLBitmap & (~0ull << (fl +1)) :0;
+ if (flMap ==0) {
+ return kNone;
+ }
+ fl = std::countr_zero(flMap);
+ slMap = m_SLBitmap[fl];
+ }
+ sl = std::countr_zero(slMap);
+ return m_Heads[fl][sl];
+ }
+
+ void InsertFree(uint32_t node)
+ {
+ uint32_t fl, sl;
+ Mapping(m_Nodes[node].size, fl, sl);
+ Node& n = m_Nodes[node];
+ n.free = true;
+ n.prevFree = kNone;
+ n.nextFree = m_Heads[fl][sl];
+ if (n.nextFree != kNone) {
+ m_Nodes[n.nextFree].prevFree = node;
+ }
+ m_Heads[fl][sl] = node;
+ m_FLBitmap |=1ull << fl;
+ m_SLBitmap[fl] |=1u << sl;
+ }
+
+ void RemoveFree(uint32_t node)
+ {
+ uint32_t fl, sl;
+ Mapping(m_Nodes[node].size, fl, sl);
+ Node& n = m_Nodes[node];
+ if (n.prevFree != kNone) {
+ m_Nodes[n.prevFree].nextFree = n.nextFree;
+ } else {
+ m_Heads[fl][sl] = n.nextFree;
+ }
+ if (n.nextFree != kNone) {
+ m_Nodes[n.nextFree].prevFree = n.prevFree;
+ }
+ n.prevFree = n.nextFree = kNone;
+ if (m_Heads[fl][sl] == kNone) {
+ m_SLBitmap[fl] &= ~(1u << sl);
+ if (m_SLBitmap[fl] ==0) {
+ m_FLBitmap &= ~(1ull << fl);
+ }
+ }
+ }
+
+ // Cut `node` after `size` bytes; returns the new node holding the remainder
+ uint32_t SplitAt(uint32_t node, VkDeviceSize size)
+ {
+ uint32_t rest = NewNode();
+ Node& n = m_Nodes[node];
+ Node& r = m_Nodes[rest];
+ r.offset = n.offset + size;
+ r.size = n.size - size;
+ r.prevPhys = node;
+ r.nextPhys = n.nextPhys;
+ if (r.nextPhys != kNone) {
+ m_Nodes[r.nextPhys].prevPhys = rest;
+ }
+ n.size = size;
+ n.nextPhys = rest;
+ return rest;
+ }
+
+ // Fold `right` (physically following `left`) into `left`
+ void Merge(uint32_t left, uint32_t right)
+ {
+ Node& l = m_Nodes[left];
+ Node& r = m_Nodes[right];
+ l.size += r.size;
+ l.nextPhys = r.nextPhys;
+ if (l.nextPhys != kNone) {
+ m_Nodes[l.nextPhys].prevPhys = left;
+ }
+ m_SpareNodes.push_back(right);
+ }
+
+ uint32_t NewNode()
+ {
+ if (!m_SpareNodes.empty()) {
+ uint32_t node = m_SpareNodes.back();
+ m_SpareNodes.pop_back();
+ m_Nodes[node] = Node{};
+ return node;
+ }
+ m_Nodes.emplace_back();
+ return static_cast<uint32_t>(m_Nodes.size() -1);
+ }
+
+ VkDeviceSize m_Size =0;
+ VkDeviceSize m_FreeBytes =0;
+ std::vector<Node> m_Nodes;
+ std::vector<uint32_t> m_SpareNodes;
+ uint64_t m_FLBitmap =0;
+ std::array<uint32_t, kFLCount> m_SLBitmap{};
+ std::array<std::array<uint32_t, kSLCount>, kFLCount> m_Heads;
+};
+
+struct DeviceAllocator::Block {
+ VkDeviceMemory memory = VK_NULL_HANDLE;
+ void* mapped = nullptr;
+ std::unique_ptr<TlsfBlock> tlsf; // null for dedicated allocations
+ VkDeviceSize dedicatedSize =0;
+};
+
+struct DeviceAllocator::Pool {
+ uint32_t memoryType =0;
+ std::vector<std::unique_ptr<Block>> blocks; // freed dedicated blocks leave null slots
+};
+
+struct DeviceAllocator::ArenaChunk {
+ VkDeviceMemory memory = VK_NULL_HANDLE;
+ void* mapped = nullptr;
+ VkDeviceSize size =0;
+ VkDeviceSize head =0;
+ VkDeviceSize used =0;
+};
+
+DeviceAllocator::DeviceAllocator(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t framesInFlight)
+ : m_PhysicalDevice(physicalDevice), m_Device(device), m_FramesInFlight(std::max(framesInFlight,1u))
+{
+ vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &m_MemoryProperties);
+
+ VkPhysicalDeviceProperties properties;
+ vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+ m_NonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize,1);
+ m_MaxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+ m_Pools.resize(static_cast<size_t>(m_MemoryProperties.memoryTypeCount) *2);
+ m_Arenas.resize(static_cast<size_t>(m_FramesInFlight) * m_MemoryProperties.memoryTypeCount);
+}
+
+DeviceAllocator::~DeviceAllocator()
+{
+ for (auto& pool : m_Pools) {
+ if (!pool) continue;
+ for (auto& block : pool->blocks) {
+ if (block) {
+ FreeDeviceMemory(block->memory, block->mapped != nullptr);
+ }
+ }
+ }
+ for (auto& arena : m_Arenas) {
+ for (auto& chunk : arena) {
+ FreeDeviceMemory(chunk->memory, chunk->mapped != nullptr);
+ }
+ }
+}
+
+uint32_t DeviceAllocator::FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) const
+{
+ if (preferred !=0) {
+ VkMemoryPropertyFlags wanted = required | preferred;
+ for (uint32_t i =0; i < m_MemoryProperties.memoryTypeCount; ++i) {
+ if ((typeBits & (1u << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+ return i;
+ }
+ }
+ }
+ for (uint32_t i =0; i < m_MemoryProperties.memoryTypeCount; ++i) {
+ if ((typeBits & (1u << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & required) == required) {
+ return i;
+ }
+ }
+ throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+bool DeviceAllocator::IsHostVisible(uint32_t memoryType) const
+{
+ return (m_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) !=0;
+}
+
+bool DeviceAllocator::IsCoherent(uint32_t memoryType) const
+{
+ return (m_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) !=0;
+}
+
+// Small heaps (integrated GPUs, the 256 MiB BAR window) get proportionally smaller blocks
+VkDeviceSize DeviceAllocator::GetBlockSize(uint32_t memoryType) const
+{
+ VkDeviceSize preferred = IsHostVisible(memoryType) ? kHostVisibleBlockSize : kDeviceLocalBlockSize;
+ uint32_t heap = m_MemoryProperties.memoryTypes[memoryType].heapIndex;
+ VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[heap].size;
+ return std::min(preferred, std::max<VkDeviceSize>(heapSize /8,1ull *1024 *1024));
+}
+
+VkDeviceMemory DeviceAllocator::AllocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, void** mapped)
+{
+ VkMemoryAllocateInfo allocInfo{};
+ allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+ allocInfo.allocationSize = size;
+ allocInfo.memoryTypeIndex = memoryType;
+
+ VkDeviceMemory memory = VK_NULL_HANDLE;
+ if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to allocate device memory block!");
+ }
+
+ *mapped = nullptr;
+ if (IsHostVisible(memoryType)) {
+ if (vkMapMemory(m_Device, memory,0, VK_WHOLE_SIZE,0, mapped) != VK_SUCCESS) {
+ vkFreeMemory(m_Device, memory, nullptr);
+ throw std::runtime_error("Failed to map device memory block!");
+ }
+ }
+
+ ++m_DeviceMemoryObjects;
+ ++m_FrameDeviceAllocations;
+ return memory;
+}
+
+void DeviceAllocator::FreeDeviceMemory(VkDeviceMemory memory, bool mapped)
+{
+ if (memory == VK_NULL_HANDLE) {
+ return;
+ }
+ if (mapped) {
+ vkUnmapMemory(m_Device, memory);
+ }
+ vkFreeMemory(m_Device, memory, nullptr);
+ --m_DeviceMemoryObjects;
+}
+
+Allocation DeviceAllocator::AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags required, AllocationLifetime lifetime, VkMemoryPropertyFlags preferred)
+{
+ VkMemoryRequirements requirements;
+ vkGetBufferMemoryRequirements(m_Device, buffer, &requirements);
+
+ Allocation allocation = Allocate(requirements, required, preferred, ResourceKind::Buffer, lifetime);
+ if (vkBindBufferMemory(m_Device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+ Free(allocation);
+ throw std::runtime_error("Failed to bind buffer memory!");
+ }
+ return allocation;
+}
+
+Allocation DeviceAllocator::AllocateForImage(VkImage image, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+ VkMemoryRequirements requirements;
+ vkGetImageMemoryRequirements(m_Device, image, &requirements);
+
+ Allocation allocation = Allocate(requirements, required, preferred, ResourceKind::Image, AllocationLifetime::Persistent);
+ if (vkBindImageMemory(m_Device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+ Free(allocation);
+ throw std::runtime_error("Failed to bind image memory!");
+ }
+ return allocation;
+}
+
+Allocation DeviceAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, ResourceKind kind, AllocationLifetime lifetime)
+{
+ uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, required, preferred);
+
+ std::lock_guard<std::mutex> lock(m_Mutex);
+ Allocation allocation = lifetime == AllocationLifetime::Frame && kind == ResourceKind::Buffer
+ ? AllocateTransient(memoryType, requirements)
+ : AllocatePersistent(memoryType, requirements, kind);
+
+ allocation.coherent = IsCoherent(memoryType);
+ ++m_FrameAllocations;
+ return allocation;
+}
+
+Allocation DeviceAllocator::AllocatePersistent(uint32_t memoryType, const VkMemoryRequirements& requirements, ResourceKind kind)
+{
+ uint32_t poolIndex = memoryType *2 + static_cast<uint32_t>(kind);
+ auto& pool = m_Pools[poolIndex];
+ if (!pool) {
+ pool = std::make_unique<Pool>();
+ pool->memoryType = memoryType;
+ }
+
+ Allocation allocation;
+ allocation.pool = poolIndex;
+ allocation.lifetime = AllocationLifetime::Persistent;
+
+ VkDeviceSize blockSize = GetBlockSize(memoryType);
+
+ // Anything bigger than half a block would mostly waste the rest of it
+ if (requirements.size > blockSize /2) {
+ auto block = std::make_unique<Block>();
+ block->memory = AllocateDeviceMemory(memoryType, requirements.size, &block->mapped);
+ block->dedicatedSize = requirements.size;
+
+ auto slot = std::find(pool->blocks.begin(), pool->blocks.end(), nullptr);
+ if (slot == pool->blocks.end()) {
+ slot = pool->blocks.insert(pool->blocks.end(), nullptr);
+ }
+ allocation.block = static_cast<uint32_t>(slot - pool->blocks.begin());
+ allocation.memory = block->memory;
+ allocation.offset =0;
+ allocation.size = requirements.size;
+ allocation.mapped = block->mapped;
+ *slot = std::move(block);
+
+ m_UsedBytes += allocation.size;
+ ++m_LiveAllocations;
+ return allocation;
+ }
+
+ for (uint32_t i =0; i <= pool->blocks.size(); ++i) {
+ bool fresh = i == pool->blocks.size() || !pool->blocks[i];
+ if (fresh) {
+ // No existing block had room: reserve a new one (reusing an empty slot if any)
+ auto slot = std::find(pool->blocks.begin(), pool->blocks.end(), nullptr);
+ if (slot == pool->blocks.end()) {
+ slot = pool->blocks.insert(pool->blocks.end(), nullptr);
+ }
+ auto block = std::make_unique<Block>();
+ block->memory = AllocateDeviceMemory(memoryType, blockSize, &block->mapped);
+ block->tlsf = std::make_unique<TlsfBlock>(blockSize);
+ *slot = std::move(block);
+ i = static_cast<uint32_t>(slot - pool->blocks.begin());
+ }
+
+ Block& block = *pool->blocks[i];
+ if (!block.tlsf) {
+ continue;
+ }
+
+ VkDeviceSize offset;
+ uint32_t node;
+ if (block.tlsf->Allocate(requirements.size, requirements.alignment, offset, node)) {
+ allocation.block = i;
+ allocation.node = node;
+ allocation.memory = block.memory;
+ allocation.offset = offset;
+ allocation.size = block.tlsf->GetAllocationSize(node);
+ allocation.mapped = block.mapped ? static_cast<uint8_t*>(block.mapped) + offset : nullptr;
+
+ m_UsedBytes += allocation.size;
+ ++m_LiveAllocations;
+ return allocation;
+ }
+ if (fresh) {
+ break;
+ }
+ }
+
+ throw std::runtime_error("Failed to sub-allocate device memory!");
+}
+
+Allocation DeviceAllocator::AllocateTransient(uint32_t memoryType, const VkMemoryRequirements& requirements)
+{
+ auto& arena = m_Arenas[static_cast<size_t>(m_FrameIndex) * m_MemoryProperties.memoryTypeCount + memoryType];
+
+ ArenaChunk* chunk = nullptr;
+ VkDeviceSize offset =0;
+ for (auto& candidate : arena) {
+ offset = AlignUp(candidate->head, requirements.alignment);
+ if (offset + requirements.size <= candidate->size) {
+ chunk = candidate.get();
+ break;
+ }
+ }
+ if (!chunk) {
+ auto fresh = std::make_unique<ArenaChunk>();
+ fresh->size = std::max(kArenaChunkSize, AlignUp(requirements.size, requirements.alignment));
+ fresh->memory = AllocateDeviceMemory(memoryType, fresh->size, &fresh->mapped);
+ chunk = fresh.get();
+ arena.push_back(std::move(fresh));
+ offset =0;
+ }
+
+ chunk->head = offset + requirements.size;
+ chunk->used += requirements.size;
+
+ Allocation allocation;
+ allocation.lifetime = AllocationLifetime::Frame;
+ allocation.memory = chunk->memory;
+ allocation.offset = offset;
+ allocation.size = requirements.size;
+ allocation.mapped = chunk->mapped ? static_cast<uint8_t*>(chunk->mapped) + offset : nullptr;
+ m_UsedBytes += allocation.size;
+ return allocation;
+}
+
+void DeviceAllocator::Free(Allocation& allocation)
+{
+ if (allocation.memory == VK_NULL_HANDLE || allocation.lifetime == AllocationLifetime::Frame) {
+ allocation = Allocation{};
+ return;
+ }
+
+ std::lock_guard<std::mutex> lock(m_Mutex);
+ Pool& pool = *m_Pools[allocation.pool];
+ auto& block = pool.blocks[allocation.block];
+
+ m_UsedBytes -= allocation.size;
+ --m_LiveAllocations;
+
+ if (!block->tlsf) {
+ FreeDeviceMemory(block->memory, block->mapped != nullptr);
+ block.reset();
+ } else {
+ block->tlsf->Free(allocation.node);
+ // Keep one empty block per pool around to absorb churn; release the rest
+ if (block->tlsf->IsEmpty()) {
+ size_t emptyBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const std::unique_ptr<Block>& b) {
+ return b && b->tlsf && b->tlsf->IsEmpty();
+ });
+ if (emptyBlocks >1) {
+ FreeDeviceMemory(block->memory, block->mapped != nullptr);
+ block.reset();
+ }
+ }
+ }
+
+ allocation = Allocation{};
+}
+
+void DeviceAllocator::BeginFrame(uint32_t frameIndex)
+{
+ std::lock_guard<std::mutex> lock(m_Mutex);
+ m_FrameIndex = frameIndex % m_FramesInFlight;
+
+ for (uint32_t type =0; type < m_MemoryProperties.memoryTypeCount; ++type) {
+ for (auto& chunk : m_Arenas[static_cast<size_t>(m_FrameIndex) * m_MemoryProperties.memoryTypeCount + type]) {
+ m_UsedBytes -= chunk->used;
+ chunk->head =0;
+ chunk->used =0;
+ }
+ }
+
+ m_LastFrameAllocations = m_FrameAllocations;
+ m_LastFrameDeviceAllocations = m_FrameDeviceAllocations;
+ m_FrameAllocations =0;
+ m_FrameDeviceAllocations =0;
+}
+
+void DeviceAllocator::FlushOrInvalidate(const Allocation& allocation, bool flush) const
+{
+ if (allocation.coherent || allocation.memory == VK_NULL_HANDLE) {
+ return;
+ }
+
+ // Ranges must be aligned to nonCoherentAtomSize; blocks are mapped whole so
+ // widening the range never leaves the mapping.
+ VkMappedMemoryRange range{};
+ range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+ range.memory = allocation.memory;
+ range.offset = AlignDown(allocation.offset, m_NonCoherentAtomSize);
+ range.size = AlignUp(allocation.offset + allocation.size - range.offset, m_NonCoherentAtomSize);
+
+ if (flush) {
+ vkFlushMappedMemoryRanges(m_Device,1, &range);
+ } else {
+ vkInvalidateMappedMemoryRanges(m_Device,1, &range);
+ }
+}
+
+void DeviceAllocator::Flush(const Allocation& allocation) const
+{
+ FlushOrInvalidate(allocation, true);
+}
+
+void DeviceAllocator::Invalidate(const Allocation& allocation) const
+{
+ FlushOrInvalidate(allocation, false);
+}
+
+AllocatorStats DeviceAllocator::GetStats() const
+{
+ std::lock_guard<std::mutex> lock(m_Mutex);
+
+ AllocatorStats stats;
+ VkDeviceSize freeBytes =0;
+ for (const auto& pool : m_Pools) {
+ if (!pool) continue;
+ for (const auto& block : pool->blocks) {
+ if (!block) continue;
+ if (block->tlsf) {
+ stats.reservedBytes += block->tlsf->GetSize();
+ freeBytes += block->tlsf->GetFreeBytes();
+ stats.largestFreeRange = std::max(stats.largestFreeRange, block->tlsf->GetLargestFreeRange());
+ } else {
+ stats.reservedBytes += block->dedicatedSize;
+ }
+ }
+ }
+ for (const auto& arena : m_Arenas) {
+ for (const auto& chunk : arena) {
+ stats.reservedBytes += chunk->size;
+ }
+ }
+
+ stats.usedBytes = m_UsedBytes;
+ stats.fragmentation = freeBytes ==0 ?0.0f :1.0f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(freeBytes);
+ stats.deviceMemoryObjects = m_DeviceMemoryObjects;
+ stats.maxDeviceMemoryObjects = m_MaxAllocationCount;
+ stats.liveAllocations = m_LiveAllocations;
+ stats.allocationsLastFrame = m_LastFrameAllocations;
+ stats.deviceAllocationsLastFrame = m_LastFrameDeviceAllocations;
+ return stats;
+}
+
+} // namespace veng
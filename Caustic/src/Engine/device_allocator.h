@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace veng {
+
+// How long an allocation lives.
+// Persistent memory is sub-allocated from TLSF managed blocks and handed back
+// with Free. Frame memory is bump-allocated from the arena of the current frame
+// in flight and released wholesale when that slot comes around again, so Free
+// is a no-op for it.
+enum class AllocationLifetime {
+ Persistent,
+ Frame
+};
+
+struct Allocation {
+ VkDeviceMemory memory = VK_NULL_HANDLE; // shared block; never free directly
+ VkDeviceSize offset =0;                 // where the resource is bound inside memory
+ VkDeviceSize size =0;
+ void* mapped = nullptr;                 // persistent host pointer at offset (host-visible memory only)
+ bool coherent = true;
+
+ // Bookkeeping for DeviceAllocator::Free
+ uint32_t pool = UINT32_MAX;
+ uint32_t block = UINT32_MAX;
+ uint32_t node = UINT32_MAX;
+ AllocationLifetime lifetime = AllocationLifetime::Persistent;
+};
+
+struct AllocatorStats {
+ VkDeviceSize reservedBytes =0;           // obtained from vkAllocateMemory
+ VkDeviceSize usedBytes =0;               // handed out to resources
+ VkDeviceSize largestFreeRange =0;
+ float fragmentation =0.0f;               // 1 - largest free range / free bytes, over persistent blocks
+ uint32_t deviceMemoryObjects =0;         // live VkDeviceMemory objects (see maxMemoryAllocationCount)
+ uint32_t maxDeviceMemoryObjects =0;
+ uint32_t liveAllocations =0;
+ uint32_t allocationsLastFrame =0;        // sub-allocations served during the last frame
+ uint32_t deviceAllocationsLastFrame =0;  // vkAllocateMemory calls made during the last frame
+};
+
+// Block based device memory sub-allocator.
+// Keeps one pool per (memory type, resource kind): buffers and optimal-tiling
+// images never share a block, which sidesteps bufferImageGranularity. Large
+// requests get a dedicated VkDeviceMemory; host-visible blocks are mapped once
+// for their whole lifetime.
+class DeviceAllocator {
+public:
+ DeviceAllocator(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t framesInFlight);
+ ~DeviceAllocator();
+
+ DeviceAllocator(const DeviceAllocator&) = delete;
+ DeviceAllocator& operator=(const DeviceAllocator&) = delete;
+
+ // Allocate and bind memory for an existing resource. `preferred` flags are
+ // honoured when a compatible memory type offers them (e.g. HOST_CACHED for readback).
+ Allocation AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags required, AllocationLifetime lifetime = AllocationLifetime::Persistent, VkMemoryPropertyFlags preferred =0);
+ Allocation AllocateForImage(VkImage image, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred =0);
+ void Free(Allocation& allocation);
+
+ // Make host writes visible to the device / device writes visible to the host.
+ // No-ops for coherent memory.
+ void Flush(const Allocation& allocation) const;
+ void Invalidate(const Allocation& allocation) const;
+
+ // Called once the frame slot's fence has signaled: recycles that slot's
+ // transient arena and rolls the per-frame counters.
+ void BeginFrame(uint32_t frameIndex);
+
+ AllocatorStats GetStats() const;
+ uint32_t FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred =0) const;
+
+private:
+ enum class ResourceKind { Buffer, Image };
+
+ class TlsfBlock;
+ struct Block;
+ struct Pool;
+ struct ArenaChunk;
+
+ Allocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, ResourceKind kind, AllocationLifetime lifetime);
+ Allocation AllocatePersistent(uint32_t memoryType, const VkMemoryRequirements& requirements, ResourceKind kind);
+ Allocation AllocateTransient(uint32_t memoryType, const VkMemoryRequirements& requirements);
+ VkDeviceMemory AllocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, void** mapped);
+ void FreeDeviceMemory(VkDeviceMemory memory, bool mapped);
+ VkDeviceSize GetBlockSize(uint32_t memoryType) const;
+ bool IsHostVisible(uint32_t memoryType) const;
+ bool IsCoherent(uint32_t memoryType) const;
+ void FlushOrInvalidate(const Allocation& allocation, bool flush) const;
+
+ VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
+ VkDevice m_Device = VK_NULL_HANDLE;
+ VkPhysicalDeviceMemoryProperties m_MemoryProperties{};
+ VkDeviceSize m_NonCoherentAtomSize =1;
+ uint32_t m_MaxAllocationCount =0;
+
+ mutable std::mutex m_Mutex;
+ std::vector<std::unique_ptr<Pool>> m_Pools; // indexed by memoryType * 2 + kind
+
+ // Linear arenas, one list of chunks per frame in flight and memory type
+ std::vector<std::vector<std::unique_ptr<ArenaChunk>>> m_Arenas;
+ uint32_t m_FrameIndex =0;
+ uint32_t m_FramesInFlight =1;
+
+ uint32_t m_DeviceMemoryObjects =0;
+ uint32_t m_LiveAllocations =0;
+ VkDeviceSize m_UsedBytes =0;
+ uint32_t m_FrameAllocations =0;
+ uint32_t m_FrameDeviceAllocations =0;
+ uint32_t m_LastFrameAllocations =0;
+ uint32_t m_LastFrameDeviceAllocations =0;
+};
+
+} // namespace veng
@@ -0,0 +1,576 @@
+#include "gpu_culling.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace veng {
+
+namespace {
+
+// Matches the push constant block of the shader
+struct CullingConstants {
+ uint32_t objectCount =0;
+ uint32_t frustumCulling =0;
+ uint32_t phase =0;
+ uint32_t lateFirstDraw =0;
+ float depthWidth =0.0f;
+ float depthHeight =0.0f;
+};
+
+// Matches Page of the shader
+struct PageRecord {
+ uint32_t count =0;
+ uint32_t firstDraw =0;
+ uint32_t lateCount =0;
+ uint32_t unused =0;
+};
+
+// Phases of the shader
+constexpr uint32_t kPhaseAll =0;
+constexpr uint32_t kPhaseEarly =1;
+constexpr uint32_t kPhaseLate =2;
+
+constexpr uint32_t kMinObjectCapacity =256;
+constexpr uint32_t kMinPageCapacity =16;
+// camera, objects, instances, pages, commands, visibility, then the depth pyramid
+constexpr uint32_t kBufferBindingCount =6;
+constexpr uint32_t kBindingCount = kBufferBindingCount +1;
+
+VkDescriptorType GetBindingType(uint32_t binding)
+{
+ if (binding ==0) {
+ return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+ }
+ return binding < kBufferBindingCount ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+}
+
+} // namespace
+
+GpuCulling::GpuCulling(VkDevice device, DeviceAllocator& allocator, MeshPool& pool, uint32_t framesInFlight, const std::vector<char>& shaderCode)
+ : m_Device(device), m_Allocator(allocator), m_Pool(pool), m_Slots(std::max(framesInFlight,1u))
+{
+ if (shaderCode.empty()) {
+ return;
+ }
+
+ // Binding 0 is the camera of common.glsl
+ std::array<VkDescriptorSetLayoutBinding, kBindingCount> bindings{};
+ for (uint32_t i =0; i < kBindingCount; ++i) {
+ bindings[i].binding = i;
+ bindings[i].descriptorType = GetBindingType(i);
+ bindings[i].descriptorCount =1;
+ bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+ }
+ VkDescriptorSetLayoutCreateInfo layoutInfo{};
+ layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+ layoutInfo.bindingCount = kBindingCount;
+ layoutInfo.pBindings = bindings.data();
+ if (vkCreateDescriptorSetLayout(m_Device, &layoutInfo, nullptr, &m_DescriptorSetLayout) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create GPU culling descriptor set layout");
+ }
+
+ try {
+ VkPushConstantRange pushConstant{};
+ pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+ pushConstant.offset =0;
+ pushConstant.size = sizeof(CullingConstants);
+
+ VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+ pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+ pipelineLayoutInfo.setLayoutCount =1;
+ pipelineLayoutInfo.pSetLayouts = &m_DescriptorSetLayout;
+ pipelineLayoutInfo.pushConstantRangeCount =1;
+ pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+ if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create GPU culling pipeline layout");
+ }
+
+ VkShaderModuleCreateInfo moduleInfo{};
+ moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+ moduleInfo.codeSize = shaderCode.size();
+ moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+ VkShaderModule module = VK_NULL_HANDLE;
+ if (vkCreateShaderModule(m_Device, &moduleInfo, nullptr, &module) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create GPU culling shader module");
+ }
+
+ VkComputePipelineCreateInfo pipelineInfo{};
+ pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+ pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+ pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+ pipelineInfo.stage.module = module;
+ pipelineInfo.stage.pName = "main";
+ pipelineInfo.layout = m_PipelineLayout;
+ const VkResult result = vkCreateComputePipelines(m_Device, VK_NULL_HANDLE,1, &pipelineInfo, nullptr, &m_Pipeline);
+ vkDestroyShaderModule(m_Device, module, nullptr);
+ if (result != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create GPU culling pipeline");
+ }
+
+ const uint32_t slotCount = static_cast<uint32_t>(m_Slots.size());
+ std::array<VkDescriptorPoolSize,3> poolSizes{};
+ poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+ poolSizes[0].descriptorCount = slotCount;
+ poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+ poolSizes[1].descriptorCount = slotCount * (kBufferBindingCount -1);
+ poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+ poolSizes[2].descriptorCount = slotCount;
+ VkDescriptorPoolCreateInfo poolInfo{};
+ poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+ poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+ poolInfo.pPoolSizes = poolSizes.data();
+ poolInfo.maxSets = slotCount;
+ if (vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &m_DescriptorPool) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create GPU culling descriptor pool");
+ }
+
+ std::vector<VkDescriptorSetLayout> layouts(slotCount, m_DescriptorSetLayout);
+ std::vector<VkDescriptorSet> sets(slotCount);
+ VkDescriptorSetAllocateInfo allocInfo{};
+ allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+ allocInfo.descriptorPool = m_DescriptorPool;
+ allocInfo.descriptorSetCount = slotCount;
+ allocInfo.pSetLayouts = layouts.data();
+ if (vkAllocateDescriptorSets(m_Device, &allocInfo, sets.data()) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to allocate GPU culling descriptor sets");
+ }
+ for (uint32_t i =0; i < slotCount; ++i) {
+ m_Slots[i].descriptorSet = sets[i];
+ }
+ } catch (...) {
+ // The destructor does not run for a throwing constructor
+ if (m_DescriptorPool != VK_NULL_HANDLE) {
+ vkDestroyDescriptorPool(m_Device, m_DescriptorPool, nullptr);
+ }
+ if (m_Pipeline != VK_NULL_HANDLE) {
+ vkDestroyPipeline(m_Device, m_Pipeline, nullptr);
+ }
+ if (m_PipelineLayout != VK_NULL_HANDLE) {
+ vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
+ }
+ vkDestroyDescriptorSetLayout(m_Device, m_DescriptorSetLayout, nullptr);
+ throw;
+ }
+}
+
+GpuCulling::~GpuCulling()
+{
+ for (Slot& slot : m_Slots) {
+ for (BufferHandle* buffer : { &slot.objects, &slot.instances, &slot.pages, &slot.commands }) {
+ DestroyBuffer(*buffer);
+ }
+ for (BufferHandle& buffer : slot.retired) {
+ DestroyBuffer(buffer);
+ }
+ }
+ DestroyBuffer(m_Visibility);
+ // Null handles are ignored, as when there was no shader
+ vkDestroyDescriptorPool(m_Device, m_DescriptorPool, nullptr);
+ vkDestroyPipeline(m_Device, m_Pipeline, nullptr);
+ vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
+ vkDestroyDescriptorSetLayout(m_Device, m_DescriptorSetLayout, nullptr);
+}
+
+GpuObjectHandle GpuCulling::Add(MeshHandle mesh, const InstanceData& instance)
+{
+ if (!mesh.IsValid()) {
+ return {};
+ }
+ const VkDrawIndexedIndirectCommand command = m_Pool.GetDrawCommand(mesh);
+ const Aabb& bounds = m_Pool.GetBounds(mesh);
+ GpuObject object;
+ object.center = glm::vec4(bounds.center,0.0f);
+ object.extent = glm::vec4(bounds.extent,0.0f);
+ object.indexCount = command.indexCount;
+ object.firstIndex = command.firstIndex;
+ object.vertexOffset = command.vertexOffset;
+ object.page = m_Pool.GetPage(mesh);
+
+ GpuObjectHandle handle;
+ if (!m_FreeHandles.empty()) {
+ handle.index = m_FreeHandles.back();
+ m_FreeHandles.pop_back();
+ } else {
+ handle.index = static_cast<uint32_t>(m_HandleObjects.size());
+ m_HandleObjects.push_back(UINT32_MAX);
+ }
+ const uint32_t index = static_cast<uint32_t>(m_Objects.size());
+ m_HandleObjects[handle.index] = index;
+ m_ObjectHandles.push_back(handle.index);
+ m_Objects.push_back(object);
+ m_Instances.push_back(instance);
+ m_Meshes.push_back(mesh);
+ if (object.page >= m_PageObjects.size()) {
+ m_PageObjects.resize(object.page +1,0);
+ }
+ ++m_PageObjects[object.page];
+ MarkDirty(index);
+ return handle;
+}
+
+void GpuCulling::Update(GpuObjectHandle object, const InstanceData& instance)
+{
+ if (!object.IsValid() || object.index >= m_HandleObjects.size() || m_HandleObjects[object.index] == UINT32_MAX) {
+ return;
+ }
+ const uint32_t index = m_HandleObjects[object.index];
+ m_Instances[index] = instance;
+ MarkDirty(index);
+}
+
+void GpuCulling::Remove(GpuObjectHandle object)
+{
+ if (!object.IsValid() || object.index >= m_HandleObjects.size() || m_HandleObjects[object.index] == UINT32_MAX) {
+ return;
+ }
+ const uint32_t index = m_HandleObjects[object.index];
+ const uint32_t last = static_cast<uint32_t>(m_Objects.size() -1);
+ --m_PageObjects[m_Objects[index].page];
+ if (index != last) {
+ // The last object fills the hole, so the arrays stay dense
+ m_Objects[index] = m_Objects[last];
+ m_Instances[index] = m_Instances[last];
+ m_Meshes[index] = m_Meshes[last];
+ m_ObjectHandles[index] = m_ObjectHandles[last];
+ m_HandleObjects[m_ObjectHandles[index]] = index;
+ MarkDirty(index);
+ }
+ m_Objects.pop_back();
+ m_Instances.pop_back();
+ m_Meshes.pop_back();
+ m_ObjectHandles.pop_back();
+ m_HandleObjects[object.index] = UINT32_MAX;
+ m_FreeHandles.push_back(object.index);
+}
+
+void GpuCulling::MarkDirty(uint32_t index)
+{
+ if (!IsSupported()) {
+ return;
+ }
+ for (Slot& slot : m_Slots) {
+ if (slot.fullCopy) {
+ continue;
+ }
+ if (index >= slot.marked.size()) {
+ slot.marked.resize(std::max<size_t>(index +1, slot.marked.size() *2),0);
+ }
+ if (!slot.marked[index]) {
+ slot.marked[index] =1;
+ slot.dirty.push_back(index);
+ }
+ // Past half the objects one copy of everything is cheaper
+ if (slot.dirty.size() > m_Objects.size() /2 + kMinObjectCapacity) {
+ slot.fullCopy = true;
+ slot.dirty.clear();
+ std::fill(slot.marked.begin(), slot.marked.end(),0);
+ }
+ }
+}
+
+void GpuCulling::BeginFrame(uint32_t frameIndex)
+{
+ m_FrameIndex = frameIndex % static_cast<uint32_t>(m_Slots.size());
+ m_Prepared = false;
+ m_PageDraws.clear();
+
+ Slot& slot = m_Slots[m_FrameIndex];
+ for (BufferHandle& buffer : slot.retired) {
+ DestroyBuffer(buffer);
+ }
+ slot.retired.clear();
+ if (slot.culledObjects ==0) {
+ return;
+ }
+ m_Allocator.Invalidate(slot.pages.allocation);
+ const PageRecord* pages = static_cast<const PageRecord*>(slot.pages.allocation.mapped);
+ uint32_t visible =0;
+ uint32_t lateVisible =0;
+ for (uint32_t p =0; p < slot.culledPages; ++p) {
+ visible += pages[p].count + pages[p].lateCount;
+ lateVisible += pages[p].lateCount;
+ }
+ m_LastTested = slot.culledObjects;
+ m_LastVisible = visible;
+ m_LastLateVisible = lateVisible;
+ slot.culledObjects =0;
+ slot.culledPages =0;
+}
+
+void GpuCulling::SetDepthPyramid(VkImageView view, VkSampler sampler, uint32_t width, uint32_t height)
+{
+ m_DepthPyramidView = view;
+ m_DepthPyramidSampler = sampler;
+ m_DepthWidth = width;
+ m_DepthHeight = height;
+ for (Slot& slot : m_Slots) {
+ slot.descriptorsStale = true;
+ }
+}
+
+bool GpuCulling::Prepare(VkBuffer camera, bool occlusion)
+{
+ m_Prepared = false;
+ m_PageDraws.clear();
+ if (!IsSupported() || m_Objects.empty()) {
+ return false;
+ }
+ // The shader's pyramid binding is statically used, so it must be valid for
+ // frustum-only dispatches too
+ if (m_DepthPyramidView == VK_NULL_HANDLE) {
+ throw std::runtime_error("GPU culling needs a depth pyramid");
+ }
+
+ Slot& slot = m_Slots[m_FrameIndex];
+ const uint32_t objectCount = static_cast<uint32_t>(m_Objects.size());
+ const uint32_t pageCount = static_cast<uint32_t>(m_PageObjects.size());
+ ReserveSlot(slot, objectCount, pageCount);
+ ReserveVisibility(objectCount);
+ if (slot.camera != camera) {
+ slot.camera = camera;
+ slot.descriptorsStale = true;
+ }
+ if (slot.descriptorsStale) {
+ UpdateDescriptorSet(slot);
+ }
+
+ GpuObject* objects = static_cast<GpuObject*>(slot.objects.allocation.mapped);
+ InstanceData* instances = static_cast<InstanceData*>(slot.instances.allocation.mapped);
+ if (slot.fullCopy) {
+ std::memcpy(objects, m_Objects.data(), m_Objects.size() * sizeof(GpuObject));
+ std::memcpy(instances, m_Instances.data(), m_Instances.size() * sizeof(InstanceData));
+ slot.fullCopy = false;
+ } else {
+ for (uint32_t index : slot.dirty) {
+ // Indices past the end were swap-removed since
+ if (index < objectCount) {
+ objects[index] = m_Objects[index];
+ instances[index] = m_Instances[index];
+ }
+ slot.marked[index] =0;
+ }
+ }
+ slot.dirty.clear();
+ m_Allocator.Flush(slot.objects.allocation);
+ m_Allocator.Flush(slot.instances.allocation);
+
+ // Each page gets a range as long as its object count, in page order; the
+ // late ranges follow in the same order
+ PageRecord* pages = static_cast<PageRecord*>(slot.pages.allocation.mapped);
+ uint32_t firstDraw =0;
+ for (uint32_t p =0; p < pageCount; ++p) {
+ pages[p] = { 0, firstDraw,0,0 };
+ if (m_PageObjects[p] >0) {
+ PageDraws draws;
+ draws.page = p;
+ draws.commandOffset = static_cast<VkDeviceSize>(firstDraw) * sizeof(VkDrawIndexedIndirectCommand);
+ draws.countOffset = static_cast<VkDeviceSize>(p) * sizeof(PageRecord);
+ draws.lateCommandOffset = static_cast<VkDeviceSize>(objectCount + firstDraw) * sizeof(VkDrawIndexedIndirectCommand);
+ draws.lateCountOffset = draws.countOffset + offsetof(PageRecord, lateCount);
+ draws.maxDraws = m_PageObjects[p];
+ m_PageDraws.push_back(draws);
+ }
+ firstDraw += m_PageObjects[p];
+ }
+ m_Allocator.Flush(slot.pages.allocation);
+
+ slot.culledObjects = objectCount;
+ slot.culledPages = pageCount;
+ m_Occlusion = occlusion;
+ m_Prepared = true;
+ return true;
+}
+
+void GpuCulling::RecordCulling(VkCommandBuffer cmd, bool frustumCulling, bool zeroCommands)
+{
+ if (!m_Prepared) {
+ return;
+ }
+ const Slot& slot = m_Slots[m_FrameIndex];
+
+ if (zeroCommands || !m_VisibilityCleared) {
+ if (zeroCommands) {
+ const uint32_t ranges = m_Occlusion ?2 :1;
+ vkCmdFillBuffer(cmd, slot.commands.buffer,0, static_cast<VkDeviceSize>(slot.culledObjects) * ranges * sizeof(VkDrawIndexedIndirectCommand),0);
+ }
+ if (!m_VisibilityCleared) {
+ vkCmdFillBuffer(cmd, m_Visibility.buffer,0, VK_WHOLE_SIZE,0);
+ m_VisibilityCleared = true;
+ }
+ VkMemoryBarrier cleared{};
+ cleared.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+ cleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+ cleared.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,1, &cleared,0, nullptr,0, nullptr);
+ }
+
+ // The visibility the last frame's late phase wrote
+ VkMemoryBarrier visibility{};
+ visibility.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+ visibility.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+ visibility.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,1, &visibility,0, nullptr,0, nullptr);
+
+ RecordDispatch(cmd, frustumCulling, m_Occlusion ? kPhaseEarly : kPhaseAll);
+ m_Prepared = false;
+}
+
+void GpuCulling::RecordLateCulling(VkCommandBuffer cmd, bool frustumCulling)
+{
+ if (!m_Prepared || !m_Occlusion) {
+ return;
+ }
+ // The early dispatch, submitted before, done reading the visibility; the
+ // pyramid's own barrier covers its levels
+ VkMemoryBarrier early{};
+ early.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+ early.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+ early.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,1, &early,0, nullptr,0, nullptr);
+
+ RecordDispatch(cmd, frustumCulling, kPhaseLate);
+}
+
+void GpuCulling::RecordDispatch(VkCommandBuffer cmd, bool frustumCulling, uint32_t phase)
+{
+ const Slot& slot = m_Slots[m_FrameIndex];
+ CullingConstants constants;
+ constants.objectCount = slot.culledObjects;
+ constants.frustumCulling = frustumCulling ?1u :0u;
+ constants.phase = phase;
+ constants.lateFirstDraw = slot.culledObjects;
+ constants.depthWidth = static_cast<float>(m_DepthWidth);
+ constants.depthHeight = static_cast<float>(m_DepthHeight);
+ vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+ vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout,0,1, &slot.descriptorSet,0, nullptr);
+ vkCmdPushConstants(cmd, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,0, sizeof(constants), &constants);
+ vkCmdDispatch(cmd, (slot.culledObjects + kWorkgroupSize -1) / kWorkgroupSize,1,1);
+
+ // Commands and counts feed the draws; the counts are read back at BeginFrame
+ VkMemoryBarrier written{};
+ written.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+ written.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+ written.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+ vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT,0,1, &written,0, nullptr,0, nullptr);
+}
+
+GpuCullingStats GpuCulling::GetStats() const
+{
+ GpuCullingStats stats;
+ stats.objects = static_cast<uint32_t>(m_Objects.size());
+ stats.tested = m_LastTested;
+ stats.visible = m_LastVisible;
+ stats.lateVisible = m_LastLateVisible;
+ return stats;
+}
+
+// Only called for a slot whose fence has signaled, so its buffers are free.
+// Buffers grow to at least twice their size and never shrink.
+void GpuCulling::ReserveSlot(Slot& slot, uint32_t capacity, uint32_t pageCapacity)
+{
+ if (capacity > slot.capacity) {
+ for (BufferHandle* buffer : { &slot.objects, &slot.instances, &slot.commands }) {
+ DestroyBuffer(*buffer);
+ }
+ slot.capacity = std::max({ capacity, slot.capacity *2, kMinObjectCapacity });
+ const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+ slot.objects = CreateBuffer(static_cast<VkDeviceSize>(slot.capacity) * sizeof(GpuObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible);
+ slot.instances = CreateBuffer(static_cast<VkDeviceSize>(slot.capacity) * sizeof(InstanceData),
+ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, hostVisible);
+ slot.commands = CreateBuffer(static_cast<VkDeviceSize>(slot.capacity) *2 * sizeof(VkDrawIndexedIndirectCommand),
+ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+ slot.fullCopy = true;
+ slot.dirty.clear();
+ std::fill(slot.marked.begin(), slot.marked.end(),0);
+ slot.descriptorsStale = true;
+ }
+ if (pageCapacity > slot.pageCapacity) {
+ DestroyBuffer(slot.pages);
+ slot.pageCapacity = std::max({ pageCapacity, slot.pageCapacity *2, kMinPageCapacity });
+ slot.pages = CreateBuffer(static_cast<VkDeviceSize>(slot.pageCapacity) * sizeof(PageRecord),
+ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+ slot.descriptorsStale = true;
+ }
+}
+
+// Shared, so only grown once every frame is done with the old buffer: it is
+// retired to the current slot
+void GpuCulling::ReserveVisibility(uint32_t capacity)
+{
+ if (capacity <= m_VisibilityCapacity) {
+ return;
+ }
+ if (m_Visibility.buffer != VK_NULL_HANDLE) {
+ m_Slots[m_FrameIndex].retired.push_back(m_Visibility);
+ }
+ m_VisibilityCapacity = std::max({ capacity, m_VisibilityCapacity *2, kMinObjectCapacity });
+ m_Visibility = CreateBuffer(static_cast<VkDeviceSize>(m_VisibilityCapacity) * sizeof(uint32_t),
+ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+ m_VisibilityCleared = false;
+ for (Slot& slot : m_Slots) {
+ slot.descriptorsStale = true;
+ }
+}
+
+void GpuCulling::UpdateDescriptorSet(Slot& slot)
+{
+ const std::array<VkBuffer, kBufferBindingCount> buffers = { slot.camera, slot.objects.buffer, slot.instances.buffer, slot.pages.buffer, slot.commands.buffer, m_Visibility.buffer };
+ std::array<VkDescriptorBufferInfo, kBufferBindingCount> infos{};
+ std::array<VkWriteDescriptorSet, kBindingCount> writes{};
+ for (uint32_t i =0; i < kBindingCount; ++i) {
+ writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+ writes[i].dstSet = slot.descriptorSet;
+ writes[i].dstBinding = i;
+ writes[i].descriptorCount =1;
+ writes[i].descriptorType = GetBindingType(i);
+ if (i < kBufferBindingCount) {
+ infos[i].buffer = buffers[i];
+ infos[i].offset =0;
+ infos[i].range = VK_WHOLE_SIZE;
+ writes[i].pBufferInfo = &infos[i];
+ }
+ }
+ VkDescriptorImageInfo pyramid{};
+ pyramid.sampler = m_DepthPyramidSampler;
+ pyramid.imageView = m_DepthPyramidView;
+ pyramid.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+ writes[kBufferBindingCount].pImageInfo = &pyramid;
+ vkUpdateDescriptorSets(m_Device, kBindingCount, writes.data(),0, nullptr);
+ slot.descriptorsStale = false;
+}
+
+BufferHandle GpuCulling::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+{
+ BufferHandle handle{};
+
+ VkBufferCreateInfo bufferInfo{};
+ bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+ bufferInfo.size = size;
+ bufferInfo.usage = usage;
+ bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+ if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &handle.buffer) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create GPU culling buffer");
+ }
+
+ try {
+ handle.allocation = m_Allocator.AllocateForBuffer(handle.buffer, properties);
+ } catch (...) {
+ vkDestroyBuffer(m_Device, handle.buffer, nullptr);
+ throw;
+ }
+ return handle;
+}
+
+void GpuCulling::DestroyBuffer(BufferHandle& buffer)
+{
+ if (buffer.buffer != VK_NULL_HANDLE) {
+ vkDestroyBuffer(m_Device, buffer.buffer, nullptr);
+ m_Allocator.Free(buffer.allocation);
+ }
+ buffer = {};
+}
+
+} // namespace veng
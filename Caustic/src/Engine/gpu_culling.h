@@ -0,0 +1,204 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "buffer_handle.h"
+#include "device_allocator.h"
+#include "instance_data.h"
+#include "mesh_pool.h"
+
+namespace veng {
+
+// An object drawn by GpuCulling. Handles of removed objects are recycled, so
+// they must not be used after GpuCulling::Remove.
+struct GpuObjectHandle {
+ uint32_t index = UINT32_MAX;
+
+ bool IsValid() const { return index != UINT32_MAX; }
+};
+
+// Per object, as shaders/gpu_cull.comp reads it (std430)
+struct GpuObject {
+ glm::vec4 center{0.0f}; // object space bounds of the mesh; w unused
+ glm::vec4 extent{0.0f};
+ uint32_t indexCount =0;
+ uint32_t firstIndex =0;
+ int32_t vertexOffset =0;
+ uint32_t page =0;
+};
+
+struct GpuCullingStats {
+ uint32_t objects =0;
+ uint32_t tested =0;  // by the last dispatch read back, MAX_FRAMES_IN_FLIGHT frames old
+ uint32_t visible =0;
+ uint32_t lateVisible =0; // of those, drawn by the late occlusion phase
+};
+
+// Pooled meshes culled and turned into draw commands on the GPU.
+//
+// Objects (a MeshPool mesh and its InstanceData) stay resident in storage
+// buffers, one copy per frame in flight; each copy is brought up to date with
+// only the objects changed since that slot was last used, so a frame costs the
+// CPU the same whatever the object count. A compute dispatch tests every
+// object's box against the frustum of the frame's camera and appends a
+// command for each visible one to its pool page's range of the command
+// buffer, counting them per page. The draws then read that count
+// (vkCmdDrawIndexedIndirectCount) or, without it, go through every slot of
+// the range, which the dispatch zeroes first so unused ones draw nothing.
+// Each command's firstInstance is the object's index, so the instance buffer
+// doubles as the vertex binding 1 of the draws.
+//
+// With occlusion culling the objects are drawn in two phases against a
+// DepthPyramid. The early dispatch only keeps objects the last frame found
+// visible; once they (and everything else of the render pass) are drawn, the
+// pyramid is built from the depth target and the late dispatch tests every
+// object against it, draws those visible but not drawn early into a second
+// range of commands and counts, and records what it found visible for the
+// next frame. Objects coming into view are drawn the same frame, so nothing
+// pops in.
+class GpuCulling {
+public:
+ static constexpr uint32_t kWorkgroupSize =64; // local_size_x of the shader
+
+ // `shaderCode` is shaders/gpu_cull.comp.spv. Without it only the object
+ // list is kept, for the caller to draw some other way.
+ GpuCulling(VkDevice device, DeviceAllocator& allocator, MeshPool& pool, uint32_t framesInFlight, const std::vector<char>& shaderCode);
+ ~GpuCulling();
+
+ GpuCulling(const GpuCulling&) = delete;
+ GpuCulling& operator=(const GpuCulling&) = delete;
+
+ // The mesh must stay in the pool while the object uses it
+ GpuObjectHandle Add(MeshHandle mesh, const InstanceData& instance);
+ void Update(GpuObjectHandle object, const InstanceData& instance);
+ void Remove(GpuObjectHandle object);
+ uint32_t GetObjectCount() const { return static_cast<uint32_t>(m_Objects.size()); }
+ // Every object, in no particular order; same index in both
+ std::span<const MeshHandle> GetMeshes() const { return m_Meshes; }
+ std::span<const InstanceData> GetInstances() const { return m_Instances; }
+
+ bool IsSupported() const { return m_Pipeline != VK_NULL_HANDLE; }
+
+ // Called once the frame slot's fence has signaled: reads back what the
+ // slot's last dispatch found visible
+ void BeginFrame(uint32_t frameIndex);
+
+ // Range of the command buffer holding one page's draws, and how many the
+ // page's objects could fill; the count sits in the count buffer at
+ // countOffset. The late phase's draws have a range and count of their own.
+ struct PageDraws {
+ uint32_t page =0;
+ VkDeviceSize commandOffset =0;
+ VkDeviceSize countOffset =0;
+ VkDeviceSize lateCommandOffset =0;
+ VkDeviceSize lateCountOffset =0;
+ uint32_t maxDraws =0;
+ };
+
+ // The pyramid the late phase tests against, of a `width` x `height` depth
+ // target. Must be set before the first Prepare, with or without occlusion
+ // (the shader's pyramid binding is always bound), and again whenever the
+ // pyramid is recreated; takes effect as each slot is next prepared.
+ void SetDepthPyramid(VkImageView view, VkSampler sampler, uint32_t width, uint32_t height);
+
+ // Writes the objects changed since the slot was last prepared into its
+ // buffers and lays out the page ranges. Once per frame, before the draws
+ // are recorded: later changes show up in the next frame. `camera` is the
+ // frame's UniformTransformations buffer; `occlusion` splits the frame into
+ // the early and late phases. False when there is nothing to draw.
+ bool Prepare(VkBuffer camera, bool occlusion);
+ bool IsPrepared() const { return m_Prepared; }
+ bool IsOcclusionPrepared() const { return m_Prepared && m_Occlusion; }
+ std::span<const PageDraws> GetPageDraws() const { return m_PageDraws; }
+ VkBuffer GetCommandBuffer() const { return m_Slots[m_FrameIndex].commands.buffer; }
+ VkBuffer GetCountBuffer() const { return m_Slots[m_FrameIndex].pages.buffer; }
+ VkBuffer GetInstanceBuffer() const { return m_Slots[m_FrameIndex].instances.buffer; }
+
+ // The dispatch (the early one with occlusion), outside a render pass and
+ // submitted ahead of the draws. `zeroCommands` clears the command ranges
+ // first, for draws without a count buffer.
+ void RecordCulling(VkCommandBuffer cmd, bool frustumCulling, bool zeroCommands);
+ // The late dispatch, outside a render pass, after DepthPyramid::Record of
+ // the frame's depth and ahead of the late draws. Must be recorded before
+ // RecordCulling, which ends the frame's preparation.
+ void RecordLateCulling(VkCommandBuffer cmd, bool frustumCulling);
+
+ GpuCullingStats GetStats() const;
+
+private:
+ // Host-visible copies of one frame in flight, except the commands, which
+ // only the GPU touches
+ struct Slot {
+ BufferHandle objects;   // GpuObject per object
+ BufferHandle instances; // InstanceData per object
+ BufferHandle pages;     // { count, first command, late count } per pool page
+ BufferHandle commands;  // VkDrawIndexedIndirectCommand per object, twice
+ uint32_t capacity =0;   // objects the buffers hold
+ uint32_t pageCapacity =0;
+ VkBuffer camera = VK_NULL_HANDLE;
+ VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+ bool descriptorsStale = true;
+ // Replaced shared buffers, destroyed when the slot comes around again
+ std::vector<BufferHandle> retired;
+ // Objects to copy at the next Prepare; all of them after a reallocation
+ std::vector<uint32_t> dirty;
+ std::vector<uint8_t> marked;
+ bool fullCopy = true;
+ // What its last dispatch covered, for the readback; the late commands
+ // start after culledObjects of them
+ uint32_t culledObjects =0;
+ uint32_t culledPages =0;
+ };
+
+ void MarkDirty(uint32_t index);
+ void ReserveSlot(Slot& slot, uint32_t capacity, uint32_t pageCapacity);
+ void ReserveVisibility(uint32_t capacity);
+ void RecordDispatch(VkCommandBuffer cmd, bool frustumCulling, uint32_t phase);
+ void UpdateDescriptorSet(Slot& slot);
+ BufferHandle CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+ void DestroyBuffer(BufferHandle& buffer);
+
+ VkDevice m_Device = VK_NULL_HANDLE;
+ DeviceAllocator& m_Allocator;
+ MeshPool& m_Pool;
+
+ VkDescriptorSetLayout m_DescriptorSetLayout = VK_NULL_HANDLE;
+ VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+ VkPipeline m_Pipeline = VK_NULL_HANDLE;
+ VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+
+ // Dense arrays, swap-removed; handles map to and from their index
+ std::vector<GpuObject> m_Objects;
+ std::vector<InstanceData> m_Instances;
+ std::vector<MeshHandle> m_Meshes;
+ std::vector<uint32_t> m_ObjectHandles;  // index -> handle
+ std::vector<uint32_t> m_HandleObjects;  // handle -> index
+ std::vector<uint32_t> m_FreeHandles;
+ std::vector<uint32_t> m_PageObjects;    // objects per pool page
+
+ // One flag per object, written by the late phase and read by the next
+ // frame's phases whatever their slot. Indices move with swap-removes and
+ // new buffers start cleared, which at worst draws an object late or once
+ // too often.
+ BufferHandle m_Visibility;
+ uint32_t m_VisibilityCapacity =0;
+ bool m_VisibilityCleared = false;
+ VkImageView m_DepthPyramidView = VK_NULL_HANDLE;
+ VkSampler m_DepthPyramidSampler = VK_NULL_HANDLE;
+ uint32_t m_DepthWidth =0;
+ uint32_t m_DepthHeight =0;
+
+ std::vector<Slot> m_Slots;
+ uint32_t m_FrameIndex =0;
+ bool m_Prepared = false;
+ bool m_Occlusion = false;
+ std::vector<PageDraws> m_PageDraws;
+ uint32_t m_LastTested =0;
+ uint32_t m_LastVisible =0;
+ uint32_t m_LastLateVisible =0;
+};
+
+} // namespace veng
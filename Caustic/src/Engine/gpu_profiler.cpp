@@ -0,0 +1,195 @@
+#include "gpu_profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace veng {
+
+uint32_t GpuProfiler::QueryTimestampValidBits(VkPhysicalDevice physicalDevice, uint32_t queueFamily)
+{
+ uint32_t count =0;
+ vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, nullptr);
+ std::vector<VkQueueFamilyProperties> families(count);
+ vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, families.data());
+ return queueFamily < count ? families[queueFamily].timestampValidBits :0;
+}
+
+GpuProfiler::GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, uint32_t maxScopesPerFrame)
+ : m_Device(device), m_MaxScopes(maxScopesPerFrame)
+{
+ VkPhysicalDeviceProperties props{};
+ vkGetPhysicalDeviceProperties(physicalDevice, &props);
+ m_TimestampPeriod = props.limits.timestampPeriod;
+ m_ValidBits = QueryTimestampValidBits(physicalDevice, queueFamily);
+ m_Supported = m_ValidBits >0 && m_TimestampPeriod >0.0f;
+
+ m_Slots.resize(framesInFlight);
+ if (!m_Supported) {
+ return;
+ }
+
+ VkQueryPoolCreateInfo poolInfo{};
+ poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+ poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+ poolInfo.queryCount = m_MaxScopes *2;
+
+ for (FrameSlot& slot : m_Slots) {
+ if (vkCreateQueryPool(m_Device, &poolInfo, nullptr, &slot.pool) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create timestamp query pool");
+ }
+ slot.scopes.reserve(m_MaxScopes);
+ }
+ // Result value + availability word per query
+ m_Results.resize(static_cast<size_t>(m_MaxScopes) *2 *2);
+}
+
+GpuProfiler::~GpuProfiler()
+{
+ for (FrameSlot& slot : m_Slots) {
+ if (slot.pool != VK_NULL_HANDLE) {
+ vkDestroyQueryPool(m_Device, slot.pool, nullptr);
+ }
+ }
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer cmd, uint32_t frameIndex)
+{
+ m_CurrentSlot = frameIndex;
+ if (!m_Supported) {
+ return;
+ }
+
+ FrameSlot& slot = m_Slots[frameIndex];
+ if (slot.recorded) {
+ Resolve(slot);
+ }
+ slot.scopes.clear();
+ slot.recorded = true;
+ vkCmdResetQueryPool(cmd, slot.pool,0, m_MaxScopes *2);
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer cmd, const char* name)
+{
+ if (!m_Supported) {
+ return UINT32_MAX;
+ }
+ FrameSlot& slot = m_Slots[m_CurrentSlot];
+ if (slot.scopes.size() >= m_MaxScopes) {
+ return UINT32_MAX;
+ }
+
+ Scope scope{};
+ scope.name = name;
+ scope.query = static_cast<uint32_t>(slot.scopes.size()) *2;
+ vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.pool, scope.query);
+ slot.scopes.push_back(scope);
+ return static_cast<uint32_t>(slot.scopes.size() -1);
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer cmd, uint32_t scope)
+{
+ if (!m_Supported || scope == UINT32_MAX) {
+ return;
+ }
+ Scope& s = m_Slots[m_CurrentSlot].scopes[scope];
+ vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_Slots[m_CurrentSlot].pool, s.query +1);
+ s.closed = true;
+}
+
+void GpuProfiler::Resolve(FrameSlot& slot)
+{
+ if (slot.scopes.empty()) {
+ return;
+ }
+
+ const uint32_t queryCount = static_cast<uint32_t>(slot.scopes.size()) *2;
+ // No WAIT bit: the slot's fence has signaled, and anything unexpectedly
+ // unavailable is skipped rather than stalling the frame
+ VkResult result = vkGetQueryPoolResults(m_Device, slot.pool,0, queryCount,
+ queryCount *2 * sizeof(uint64_t), m_Results.data(),2 * sizeof(uint64_t),
+ VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+ if (result != VK_SUCCESS && result != VK_NOT_READY) {
+ return;
+ }
+
+ const uint64_t mask = m_ValidBits >=64 ? ~0ull : ((1ull << m_ValidBits) -1);
+ const double msPerTick = static_cast<double>(m_TimestampPeriod) /1.0e6;
+
+ // Sum scopes sharing a name so each name yields one sample per frame
+ std::vector<std::pair<const char*, double>> totals;
+ for (const Scope& scope : slot.scopes) {
+ if (!scope.closed) {
+ continue;
+ }
+ const uint64_t* begin = &m_Results[static_cast<size_t>(scope.query) *2];
+ const uint64_t* end = begin +2;
+ if (begin[1] ==0 || end[1] ==0) {
+ continue;
+ }
+ double ms = static_cast<double>((end[0] - begin[0]) & mask) * msPerTick;
+
+ auto it = std::find_if(totals.begin(), totals.end(), [&](const auto& t) { return std::strcmp(t.first, scope.name) ==0; });
+ if (it == totals.end()) {
+ totals.emplace_back(scope.name, ms);
+ } else {
+ it->second += ms;
+ }
+ }
+
+ for (const auto& [name, ms] : totals) {
+ AddSample(name, static_cast<float>(ms));
+ }
+}
+
+GpuProfiler::History& GpuProfiler::FindHistory(const char* name)
+{
+ for (History& history : m_History) {
+ if (history.name == name) {
+ return history;
+ }
+ }
+ History& history = m_History.emplace_back();
+ history.name = name;
+ return history;
+}
+
+void GpuProfiler::AddSample(const char* name, float ms)
+{
+ History& history = FindHistory(name);
+ history.samples[history.head] = ms;
+ history.head = (history.head +1) % kHistorySize;
+ history.count = std::min(history.count +1, kHistorySize);
+ history.last = ms;
+}
+
+std::vector<GpuScopeStats> GpuProfiler::GetStats() const
+{
+ std::vector<GpuScopeStats> stats;
+ stats.reserve(m_History.size());
+
+ std::vector<float> sorted;
+ for (const History& history : m_History) {
+ if (history.count ==0) {
+ continue;
+ }
+ sorted.assign(history.samples.begin(), history.samples.begin() + history.count);
+ std::sort(sorted.begin(), sorted.end());
+
+ GpuScopeStats s{};
+ s.name = history.name;
+ s.lastMs = history.last;
+ s.minMs = sorted.front();
+ double sum =0.0;
+ for (float v : sorted) {
+ sum += v;
+ }
+ s.avgMs = static_cast<float>(sum / sorted.size());
+ size_t p99 = std::min(sorted.size() -1, static_cast<size_t>(sorted.size() *0.99));
+ s.p99Ms = sorted[p99];
+ s.samples = history.count;
+ stats.push_back(std::move(s));
+ }
+ return stats;
+}
+
+} // namespace veng
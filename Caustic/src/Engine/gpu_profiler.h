@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace veng {
+
+// Rolling GPU time of one named scope, in milliseconds. Scopes recorded more
+// than once per frame (e.g. one per draw) are summed into one sample per frame.
+struct GpuScopeStats {
+ std::string name;
+ float lastMs =0.0f;
+ float minMs =0.0f;
+ float avgMs =0.0f;
+ float p99Ms =0.0f;
+ uint32_t samples =0;
+};
+
+// Timestamp query profiler for the frame command buffers.
+// Each frame in flight owns a query pool; scopes write a timestamp pair into
+// the slot's pool and the results are read back when the slot comes around
+// again, after its fence has signaled, so resolving never stalls the GPU.
+class GpuProfiler {
+public:
+ static constexpr uint32_t kHistorySize =240;
+
+ GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, uint32_t maxScopesPerFrame =64);
+ ~GpuProfiler();
+
+ GpuProfiler(const GpuProfiler&) = delete;
+ GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+ // False when the queue family reports no timestamp bits; every call is then a no-op
+ bool IsSupported() const { return m_Supported; }
+ float GetTimestampPeriod() const { return m_TimestampPeriod; }
+ uint32_t GetTimestampValidBits() const { return m_ValidBits; }
+
+ // Resolve what the slot recorded last time (its fence must have signaled) and
+ // reset its queries. Record at the start of the frame, outside a render pass.
+ void BeginFrame(VkCommandBuffer cmd, uint32_t frameIndex);
+
+ // `name` must outlive the frame (string literals)
+ uint32_t BeginScope(VkCommandBuffer cmd, const char* name);
+ void EndScope(VkCommandBuffer cmd, uint32_t scope);
+
+ // Feed GPU time measured elsewhere (e.g. upload batches) into the same statistics
+ void AddSample(const char* name, float ms);
+
+ std::vector<GpuScopeStats> GetStats() const;
+
+ static uint32_t QueryTimestampValidBits(VkPhysicalDevice physicalDevice, uint32_t queueFamily);
+
+private:
+ struct Scope {
+ const char* name = nullptr;
+ uint32_t query =0; // begin timestamp; end is query + 1
+ bool closed = false;
+ };
+ struct FrameSlot {
+ VkQueryPool pool = VK_NULL_HANDLE;
+ std::vector<Scope> scopes;
+ bool recorded = false;
+ };
+ struct History {
+ std::string name;
+ std::array<float, kHistorySize> samples{};
+ uint32_t count =0;
+ uint32_t head =0;
+ float last =0.0f;
+ };
+
+ void Resolve(FrameSlot& slot);
+ History& FindHistory(const char* name);
+
+ VkDevice m_Device = VK_NULL_HANDLE;
+ bool m_Supported = false;
+ float m_TimestampPeriod =1.0f; // nanoseconds per tick
+ uint32_t m_ValidBits =0;
+ uint32_t m_MaxScopes =0;
+ uint32_t m_CurrentSlot =0;
+
+ std::vector<FrameSlot> m_Slots;
+ std::vector<History> m_History;
+ std::vector<uint64_t> m_Results; // scratch for vkGetQueryPoolResults
+};
+
+} // namespace veng
@@ -0,0 +1,217 @@
+#include "graphics_device.h"
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace veng {
+
+static constexpr const char* kValidationLayer = "VK_LAYER_KHRONOS_validation";
+
+static bool HasGraphicsQueue(VkPhysicalDevice physicalDevice)
+{
+ uint32_t count =0;
+ vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, nullptr);
+ std::vector<VkQueueFamilyProperties> families(count);
+ vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, families.data());
+ for (const VkQueueFamilyProperties& family : families) {
+ if (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+ return true;
+ }
+ }
+ return false;
+}
+
+static int DeviceTypeRank(VkPhysicalDeviceType type)
+{
+ switch (type) {
+ case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+ case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+ case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+ case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1;
+ default: return 0;
+ }
+}
+
+HeadlessDevice::HeadlessDevice(const HeadlessDeviceOptions& options)
+{
+ CreateInstance(options.validation);
+ try {
+ PickPhysicalDevice(options.preferredDevice);
+ CreateDevice();
+ } catch (...) {
+ vkDestroyInstance(m_Device.instance, nullptr);
+ throw;
+ }
+}
+
+HeadlessDevice::~HeadlessDevice()
+{
+ if (m_Device.device != VK_NULL_HANDLE) {
+ vkDeviceWaitIdle(m_Device.device);
+ vkDestroyDevice(m_Device.device, nullptr);
+ }
+ if (m_Device.instance != VK_NULL_HANDLE) {
+ vkDestroyInstance(m_Device.instance, nullptr);
+ }
+}
+
+void HeadlessDevice::CreateInstance(bool validation)
+{
+ VkApplicationInfo appInfo{};
+ appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+ appInfo.pApplicationName = "Caustic Headless";
+ appInfo.applicationVersion = VK_MAKE_VERSION(1,0,0);
+ appInfo.pEngineName = "Caustic";
+ appInfo.engineVersion = VK_MAKE_VERSION(1,0,0);
+ appInfo.apiVersion = VK_API_VERSION_1_0;
+
+ std::vector<const char*> layers;
+ if (validation) {
+ uint32_t layerCount =0;
+ vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+ std::vector<VkLayerProperties> available(layerCount);
+ vkEnumerateInstanceLayerProperties(&layerCount, available.data());
+ bool found = false;
+ for (const VkLayerProperties& layer : available) {
+ found |= std::strcmp(layer.layerName, kValidationLayer) ==0;
+ }
+ if (found) {
+ layers.push_back(kValidationLayer);
+ } else {
+ std::cout << "WARNING: " << kValidationLayer << " is not installed; running without validation" << std::endl;
+ }
+ }
+
+ // No extensions: nothing is presented, frames only leave through readback
+ VkInstanceCreateInfo createInfo{};
+ createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+ createInfo.pApplicationInfo = &appInfo;
+ createInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
+ createInfo.ppEnabledLayerNames = layers.data();
+
+ if (vkCreateInstance(&createInfo, nullptr, &m_Device.instance) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create headless Vulkan instance (is a Vulkan driver installed?)");
+ }
+}
+
+void HeadlessDevice::PickPhysicalDevice(const std::string& preferredDevice)
+{
+ uint32_t count =0;
+ vkEnumeratePhysicalDevices(m_Device.instance, &count, nullptr);
+ std::vector<VkPhysicalDevice> devices(count);
+ vkEnumeratePhysicalDevices(m_Device.instance, &count, devices.data());
+
+ int bestRank = -1;
+ for (VkPhysicalDevice candidate : devices) {
+ if (!HasGraphicsQueue(candidate)) {
+ continue;
+ }
+ VkPhysicalDeviceProperties props{};
+ vkGetPhysicalDeviceProperties(candidate, &props);
+
+ int rank = DeviceTypeRank(props.deviceType);
+ if (!preferredDevice.empty() && std::strstr(props.deviceName, preferredDevice.c_str())) {
+ rank +=100;
+ }
+ if (rank > bestRank) {
+ bestRank = rank;
+ m_Device.physicalDevice = candidate;
+ m_Properties = props;
+ }
+ }
+
+ if (m_Device.physicalDevice == VK_NULL_HANDLE) {
+ throw std::runtime_error("No Vulkan device with a graphics queue found");
+ }
+ if (!preferredDevice.empty() && bestRank <100) {
+ std::cout << "WARNING: No device matching \"" << preferredDevice << "\"; using " << m_Properties.deviceName << std::endl;
+ }
+}
+
+void HeadlessDevice::CreateDevice()
+{
+ uint32_t count =0;
+ vkGetPhysicalDeviceQueueFamilyProperties(m_Device.physicalDevice, &count, nullptr);
+ std::vector<VkQueueFamilyProperties> families(count);
+ vkGetPhysicalDeviceQueueFamilyProperties(m_Device.physicalDevice, &count, families.data());
+
+ // Same family selection as Walnut: first graphics family, and a transfer
+ // family without graphics (transfer-only preferred) when there is one
+ uint32_t graphicsFamily = UINT32_MAX;
+ uint32_t transferFamily = UINT32_MAX;
+ for (uint32_t i =0; i < count; ++i) {
+ const VkQueueFlags flags = families[i].queueFlags;
+ if (graphicsFamily == UINT32_MAX && (flags & VK_QUEUE_GRAPHICS_BIT)) {
+ graphicsFamily = i;
+ }
+ if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+ const bool transferOnly = !(flags & VK_QUEUE_COMPUTE_BIT);
+ if (transferFamily == UINT32_MAX || (transferOnly && (families[transferFamily].queueFlags & VK_QUEUE_COMPUTE_BIT))) {
+ transferFamily = i;
+ }
+ }
+ }
+
+ const float priority =1.0f;
+ std::vector<VkDeviceQueueCreateInfo> queueInfos;
+ VkDeviceQueueCreateInfo queueInfo{};
+ queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+ queueInfo.queueFamilyIndex = graphicsFamily;
+ queueInfo.queueCount =1;
+ queueInfo.pQueuePriorities = &priority;
+ queueInfos.push_back(queueInfo);
+ if (transferFamily != UINT32_MAX) {
+ queueInfo.queueFamilyIndex = transferFamily;
+ queueInfos.push_back(queueInfo);
+ }
+
+ VkPhysicalDeviceFeatures supported{};
+ vkGetPhysicalDeviceFeatures(m_Device.physicalDevice, &supported);
+ VkPhysicalDeviceFeatures features{};
+ features.samplerAnisotropy = supported.samplerAnisotropy;
+ features.multiDrawIndirect = supported.multiDrawIndirect;
+ features.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+ if (!supported.samplerAnisotropy) {
+ std::cout << "WARNING: " << m_Properties.deviceName << " has no anisotropic filtering" << std::endl;
+ }
+
+ // Draw counts written by GPU culling; a 1.0 device extension, core in 1.2
+ uint32_t extensionCount =0;
+ vkEnumerateDeviceExtensionProperties(m_Device.physicalDevice, nullptr, &extensionCount, nullptr);
+ std::vector<VkExtensionProperties> available(extensionCount);
+ vkEnumerateDeviceExtensionProperties(m_Device.physicalDevice, nullptr, &extensionCount, available.data());
+ std::vector<const char*> extensions;
+ for (const VkExtensionProperties& extension : available) {
+ if (std::strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) ==0) {
+ extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+ }
+ }
+
+ VkDeviceCreateInfo createInfo{};
+ createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+ createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueInfos.size());
+ createInfo.pQueueCreateInfos = queueInfos.data();
+ createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+ createInfo.ppEnabledExtensionNames = extensions.data();
+ createInfo.pEnabledFeatures = &features;
+
+ if (vkCreateDevice(m_Device.physicalDevice, &createInfo, nullptr, &m_Device.device) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create headless Vulkan device");
+ }
+
+ m_Device.graphicsQueueFamily = graphicsFamily;
+ m_Device.multiDrawIndirect = features.multiDrawIndirect == VK_TRUE;
+ m_Device.drawIndirectFirstInstance = features.drawIndirectFirstInstance == VK_TRUE;
+ m_Device.drawIndirectCount = !extensions.empty();
+ vkGetDeviceQueue(m_Device.device, graphicsFamily,0, &m_Device.graphicsQueue);
+ if (transferFamily != UINT32_MAX) {
+ m_Device.transferQueueFamily = transferFamily;
+ vkGetDeviceQueue(m_Device.device, transferFamily,0, &m_Device.transferQueue);
+ } else {
+ m_Device.transferQueueFamily = graphicsFamily;
+ m_Device.transferQueue = m_Device.graphicsQueue;
+ }
+}
+
+} // namespace veng
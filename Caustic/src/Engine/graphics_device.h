@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+
+namespace veng {
+
+// The Vulkan objects WalnutGraphics renders with. In the GUI app they come from
+// Walnut::Application; headless runs create their own with HeadlessDevice.
+struct GraphicsDevice {
+ VkInstance instance = VK_NULL_HANDLE;
+ VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+ VkDevice device = VK_NULL_HANDLE;
+ uint32_t graphicsQueueFamily =0;
+ VkQueue graphicsQueue = VK_NULL_HANDLE;
+ uint32_t transferQueueFamily =0;          // same as graphicsQueueFamily without a dedicated family
+ VkQueue transferQueue = VK_NULL_HANDLE;
+ // Enabled device features the renderer can take advantage of
+ bool multiDrawIndirect = false;
+ bool drawIndirectFirstInstance = false;
+ bool drawIndirectCount = false;           // VK_KHR_draw_indirect_count
+};
+
+struct HeadlessDeviceOptions {
+ bool validation = false;     // enable VK_LAYER_KHRONOS_validation when it is installed
+ std::string preferredDevice; // substring of the device name, e.g. "llvmpipe"; empty picks the fastest
+};
+
+// Instance and device with no surface, swapchain or window system extensions,
+// for offscreen rendering on machines without a display. Software drivers
+// (lavapipe, SwiftShader) are accepted and used when nothing else is present.
+class HeadlessDevice {
+public:
+ explicit HeadlessDevice(const HeadlessDeviceOptions& options = {});
+ ~HeadlessDevice();
+
+ HeadlessDevice(const HeadlessDevice&) = delete;
+ HeadlessDevice& operator=(const HeadlessDevice&) = delete;
+
+ const GraphicsDevice& Get() const { return m_Device; }
+ const VkPhysicalDeviceProperties& GetProperties() const { return m_Properties; }
+
+private:
+ void CreateInstance(bool validation);
+ void PickPhysicalDevice(const std::string& preferredDevice);
+ void CreateDevice();
+
+ GraphicsDevice m_Device;
+ VkPhysicalDeviceProperties m_Properties{};
+};
+
+} // namespace veng
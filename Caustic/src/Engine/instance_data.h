@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace veng {
+
+// Per-instance input of WalnutGraphics::RenderIndexedInstanced, read from
+// vertex binding 1 by shaders/basic_instanced.vert.
+struct InstanceData {
+  glm::mat4 transformation{1.0f};
+  glm::vec4 color{1.0f}; // multiplies the vertex color
+
+  static constexpr uint32_t kBinding = 1;
+  static constexpr uint32_t kAttributeCount = 5;
+
+  static VkVertexInputBindingDescription GetBindingDescription() {
+    VkVertexInputBindingDescription description = {};
+    description.binding = kBinding;
+    description.stride = sizeof(InstanceData);
+    description.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return description;
+  }
+
+  // A mat4 input takes one location per column: 3-6, then the color at 7
+  static std::array<VkVertexInputAttributeDescription, kAttributeCount> GetAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, kAttributeCount> descriptions = {};
+
+    for (uint32_t column = 0; column < 4; ++column) {
+      descriptions[column].binding = kBinding;
+      descriptions[column].location = 3 + column;
+      descriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+      descriptions[column].offset = static_cast<uint32_t>(offsetof(InstanceData, transformation) + column * sizeof(glm::vec4));
+    }
+
+    descriptions[4].binding = kBinding;
+    descriptions[4].location = 7;
+    descriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    descriptions[4].offset = offsetof(InstanceData, color);
+
+    return descriptions;
+  }
+};
+
+}  // namespace veng
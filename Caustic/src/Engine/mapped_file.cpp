@@ -0,0 +1,87 @@
+#include "mapped_file.h"
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace veng {
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+ HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+ if (file == INVALID_HANDLE_VALUE) {
+ return;
+ }
+ LARGE_INTEGER size{};
+ if (GetFileSizeEx(file, &size) && size.QuadPart >0) {
+ HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY,0,0, nullptr);
+ if (mapping) {
+ // The view keeps the mapping alive; both handles can go
+ m_Data = static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ,0,0,0));
+ m_Size = m_Data ? static_cast<size_t>(size.QuadPart) :0;
+ CloseHandle(mapping);
+ }
+ }
+ CloseHandle(file);
+#else
+ const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+ if (fd <0) {
+ return;
+ }
+ struct stat info{};
+ if (fstat(fd, &info) ==0 && info.st_size >0) {
+ void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd,0);
+ if (data != MAP_FAILED) {
+ // Consumers stream through the file front to back
+ madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+ m_Data = static_cast<const std::uint8_t*>(data);
+ m_Size = static_cast<size_t>(info.st_size);
+ }
+ }
+ close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+ Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+ : m_Data(std::exchange(other.m_Data, nullptr)), m_Size(std::exchange(other.m_Size,0))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+ if (this != &other) {
+ Close();
+ m_Data = std::exchange(other.m_Data, nullptr);
+ m_Size = std::exchange(other.m_Size,0);
+ }
+ return *this;
+}
+
+void MappedFile::Close()
+{
+ if (!m_Data) {
+ return;
+ }
+#ifdef _WIN32
+ UnmapViewOfFile(m_Data);
+#else
+ munmap(const_cast<std::uint8_t*>(m_Data), m_Size);
+#endif
+ m_Data = nullptr;
+ m_Size =0;
+}
+
+} // namespace veng
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace veng {
+
+// Read-only memory mapping of a whole file. The pages are faulted in on first
+// touch, so reading a region costs one copy out of the page cache instead of
+// a read() into a heap buffer followed by another copy.
+class MappedFile {
+public:
+ MappedFile() = default;
+ // IsOpen() is false if the file is missing, empty or cannot be mapped
+ explicit MappedFile(const std::filesystem::path& path);
+ ~MappedFile();
+
+ MappedFile(MappedFile&& other) noexcept;
+ MappedFile& operator=(MappedFile&& other) noexcept;
+ MappedFile(const MappedFile&) = delete;
+ MappedFile& operator=(const MappedFile&) = delete;
+
+ bool IsOpen() const { return m_Data != nullptr; }
+ const std::uint8_t* GetData() const { return m_Data; }
+ size_t GetSize() const { return m_Size; }
+
+ void Close();
+
+private:
+ const std::uint8_t* m_Data = nullptr;
+ size_t m_Size =0;
+};
+
+} // namespace veng
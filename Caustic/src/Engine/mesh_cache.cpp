@@ -0,0 +1,288 @@
+#include "mesh_cache.h"
+#include "utilities.h"
+#include "Walnut/Serialization/FileStream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace veng {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point start)
+{
+ return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+constexpr char kMagic[4] = { 'C', 'M', 'S', 'H' };
+// Bump when the layout below changes
+constexpr uint32_t kFormatVersion =2;
+// Blob offsets are multiples of this, which covers every copy offset
+// alignment the staging path and Vulkan ask for
+constexpr uint64_t kBlobAlignment =256;
+
+enum ImportFlags : uint32_t {
+ kFlipTexCoordV =1u <<0,
+ kDeduplicate =1u <<1,
+ kNormalsAsColor =1u <<2,
+ kOptimize =1u <<3,
+ kLodLevelsShift =4, // 4 bits of ObjImportOptions::lodLevels
+};
+
+// Fixed size, native endian: the cache is a local artifact, never shipped
+struct MeshCacheHeader {
+ char magic[4];
+ uint32_t formatVersion;
+ uint32_t importerVersion;
+ uint32_t importFlags;
+ uint64_t sourceHash;
+ uint64_t sourceSize;
+ int64_t sourceWriteTime;
+ float boundsMin[3];
+ float boundsMax[3];
+ uint32_t vertexStride;
+ uint32_t vertexCount;
+ uint32_t indexCount;
+ uint32_t lodCount;
+ uint64_t vertexOffset;
+ uint64_t indexOffset;
+ uint64_t lodOffset;
+ uint64_t fileSize;
+};
+static_assert(sizeof(MeshCacheHeader) ==112, "MeshCacheHeader layout changed; bump kFormatVersion");
+
+uint32_t GetImportFlags(const ObjImportOptions& options)
+{
+ return (options.flipTexCoordV ? kFlipTexCoordV :0u) | (options.deduplicate ? kDeduplicate :0u)
+ | (options.normalsAsColor ? kNormalsAsColor :0u) | (options.optimize ? kOptimize :0u)
+ | (std::min(options.lodLevels,15u) << kLodLevelsShift);
+}
+
+uint64_t AlignUp(uint64_t value)
+{
+ return (value + kBlobAlignment -1) & ~(kBlobAlignment -1);
+}
+
+int64_t GetWriteTime(const std::filesystem::path& path)
+{
+ std::error_code error;
+ const auto time = std::filesystem::last_write_time(path, error);
+ return error ?0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+// Header checks that do not involve the source; also guards every offset so
+// a truncated or foreign file can never be read out of bounds
+bool IsUsable(const MeshCacheHeader& header, size_t fileSize, uint32_t importFlags)
+{
+ if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) !=0 || header.formatVersion != kFormatVersion
+ || header.importerVersion != kObjImporterVersion || header.importFlags != importFlags
+ || header.vertexStride != sizeof(Vertex) || header.fileSize != fileSize) {
+ return false;
+ }
+ const uint64_t vertexBytes = static_cast<uint64_t>(header.vertexCount) * sizeof(Vertex);
+ const uint64_t indexBytes = static_cast<uint64_t>(header.indexCount) * sizeof(uint32_t);
+ const uint64_t lodBytes = static_cast<uint64_t>(header.lodCount) * sizeof(MeshLod);
+ return header.vertexOffset % kBlobAlignment ==0 && header.indexOffset % kBlobAlignment ==0 && header.lodOffset % kBlobAlignment ==0
+ && header.vertexOffset >= sizeof(MeshCacheHeader) && header.vertexOffset + vertexBytes <= fileSize
+ && header.indexOffset >= header.vertexOffset + vertexBytes && header.indexOffset + indexBytes <= fileSize
+ && header.lodOffset >= header.indexOffset + indexBytes && header.lodOffset + lodBytes <= fileSize;
+}
+
+// LOD ranges must stay inside the index array the file holds
+bool AreLodsValid(std::span<const MeshLod> lods, uint32_t indexCount)
+{
+ for (const MeshLod& lod : lods) {
+ if (lod.firstIndex > indexCount || lod.indexCount > indexCount - lod.firstIndex) {
+ return false;
+ }
+ }
+ return true;
+}
+
+bool WriteCache(const std::filesystem::path& path, const MeshData& mesh, MeshCacheHeader header)
+{
+ const uint64_t vertexBytes = mesh.vertices.size() * sizeof(Vertex);
+ const uint64_t indexBytes = mesh.indices.size() * sizeof(uint32_t);
+ const uint64_t lodBytes = mesh.lods.size() * sizeof(MeshLod);
+ header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+ header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+ header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+ header.vertexOffset = AlignUp(sizeof(MeshCacheHeader));
+ header.indexOffset = AlignUp(header.vertexOffset + vertexBytes);
+ header.lodOffset = AlignUp(header.indexOffset + indexBytes);
+ header.fileSize = header.lodOffset + lodBytes;
+
+ std::error_code error;
+ if (path.has_parent_path()) {
+ std::filesystem::create_directories(path.parent_path(), error);
+ }
+
+ // Write next to the target and rename, so a crash never leaves a torn
+ // cache and readers that still map the old file keep their view
+ std::filesystem::path temporary = path;
+ temporary += ".tmp";
+ {
+ Walnut::FileStreamWriter writer(temporary);
+ if (!writer) {
+ return false;
+ }
+ writer.WriteRaw(header);
+ writer.WriteZero(header.vertexOffset - sizeof(MeshCacheHeader));
+ writer.WriteData(reinterpret_cast<const char*>(mesh.vertices.data()), vertexBytes);
+ writer.WriteZero(header.indexOffset - header.vertexOffset - vertexBytes);
+ writer.WriteData(reinterpret_cast<const char*>(mesh.indices.data()), indexBytes);
+ writer.WriteZero(header.lodOffset - header.indexOffset - indexBytes);
+ writer.WriteData(reinterpret_cast<const char*>(mesh.lods.data()), lodBytes);
+ }
+ // FileStreamWriter does not report write errors; a short file does
+ if (std::filesystem::file_size(temporary, error) != header.fileSize || error) {
+ std::filesystem::remove(temporary, error);
+ return false;
+ }
+ std::filesystem::rename(temporary, path, error);
+ if (error) {
+ std::filesystem::remove(temporary, error);
+ return false;
+ }
+ return true;
+}
+
+} // namespace
+
+std::filesystem::path GetMeshCachePath(const std::filesystem::path& source, const MeshCacheOptions& cacheOptions)
+{
+ std::filesystem::path name = source.filename();
+ if (cacheOptions.directory.empty()) {
+ name += ".cmesh";
+ return source.parent_path() / name;
+ }
+
+ // One directory for many sources: tell same-named files apart by their path
+ std::error_code error;
+ const std::string absolute = std::filesystem::absolute(source, error).generic_string();
+ char suffix[24];
+ std::snprintf(suffix, sizeof(suffix), "-%016llx.cmesh", static_cast<unsigned long long>(HashBytes(absolute.data(), absolute.size())));
+ name += suffix;
+ return cacheOptions.directory / name;
+}
+
+MeshAsset LoadMesh(const std::filesystem::path& source, const ObjImportOptions& importOptions,
+ const MeshCacheOptions& cacheOptions, MeshLoadStats* stats)
+{
+ const Clock::time_point start = Clock::now();
+ MeshLoadStats local;
+ MeshLoadStats& s = stats ? *stats : local;
+ s = {};
+ s.cachePath = GetMeshCachePath(source, cacheOptions);
+
+ std::error_code error;
+ const uint64_t sourceSize = std::filesystem::file_size(source, error);
+ if (error) {
+ throw std::runtime_error("Mesh source not found: " + source.string());
+ }
+ const int64_t sourceWriteTime = GetWriteTime(source);
+ const uint32_t importFlags = GetImportFlags(importOptions);
+
+ MeshAsset asset;
+ MappedFile sourceFile;
+ uint64_t sourceHash =0;
+ bool haveHash = false;
+ const auto hashSource = [&] {
+ const Clock::time_point hashStart = Clock::now();
+ sourceFile = MappedFile(source);
+ if (!sourceFile.IsOpen()) {
+ throw std::runtime_error("Failed to map mesh source " + source.string());
+ }
+ sourceHash = HashBytes(sourceFile.GetData(), sourceFile.GetSize());
+ haveHash = true;
+ s.hashMs += MillisecondsSince(hashStart);
+ };
+
+ MappedFile cache(s.cachePath);
+ MeshCacheHeader header{};
+ if (cache.IsOpen() && cache.GetSize() >= sizeof(header)) {
+ std::memcpy(&header, cache.GetData(), sizeof(header));
+ }
+ if (cache.IsOpen() && cache.GetSize() >= sizeof(header) && IsUsable(header, cache.GetSize(), importFlags)
+ && header.sourceSize == sourceSize) {
+ bool valid = header.sourceWriteTime == sourceWriteTime;
+ if (!valid) {
+ // Touched, checked out again or copied: only the content counts
+ hashSource();
+ s.sourceHashed = true;
+ valid = header.sourceHash == sourceHash;
+ if (valid && cacheOptions.write) {
+ std::fstream patch(s.cachePath, std::ios::in | std::ios::out | std::ios::binary);
+ patch.seekp(offsetof(MeshCacheHeader, sourceWriteTime));
+ patch.write(reinterpret_cast<const char*>(&sourceWriteTime), sizeof(sourceWriteTime));
+ }
+ }
+ const uint8_t* data = cache.GetData();
+ const std::span<const MeshLod> lods(reinterpret_cast<const MeshLod*>(data + header.lodOffset), header.lodCount);
+ valid = valid && AreLodsValid(lods, header.indexCount);
+ if (valid) {
+ asset.m_Vertices = { reinterpret_cast<const Vertex*>(data + header.vertexOffset), header.vertexCount };
+ asset.m_Indices = { reinterpret_cast<const uint32_t*>(data + header.indexOffset), header.indexCount };
+ asset.m_Lods = lods;
+ asset.m_BoundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+ asset.m_BoundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+ asset.m_Mapping = std::move(cache);
+ s.cacheHit = true;
+ s.cacheBytes = header.fileSize;
+ s.totalMs = MillisecondsSince(start);
+ return asset;
+ }
+ }
+ // Windows cannot replace a file that is still mapped
+ cache.Close();
+
+ if (!haveHash) {
+ hashSource();
+ }
+ const Clock::time_point importStart = Clock::now();
+ asset.m_Imported = ImportObjFromMemory(std::string_view(reinterpret_cast<const char*>(sourceFile.GetData()), sourceFile.GetSize()), importOptions);
+ sourceFile.Close();
+ s.importMs = MillisecondsSince(importStart);
+
+ const MeshData& mesh = asset.m_Imported;
+ asset.m_Vertices = mesh.vertices;
+ asset.m_Indices = mesh.indices;
+ asset.m_Lods = mesh.lods;
+ asset.m_BoundsMin = mesh.boundsMin;
+ asset.m_BoundsMax = mesh.boundsMax;
+
+ if (cacheOptions.write) {
+ const Clock::time_point writeStart = Clock::now();
+ MeshCacheHeader written{};
+ std::memcpy(written.magic, kMagic, sizeof(kMagic));
+ written.formatVersion = kFormatVersion;
+ written.importerVersion = kObjImporterVersion;
+ written.importFlags = importFlags;
+ written.sourceHash = sourceHash;
+ written.sourceSize = sourceSize;
+ written.sourceWriteTime = sourceWriteTime;
+ for (int axis =0; axis <3; ++axis) {
+ written.boundsMin[axis] = mesh.boundsMin[axis];
+ written.boundsMax[axis] = mesh.boundsMax[axis];
+ }
+ written.vertexStride = sizeof(Vertex);
+ if (WriteCache(s.cachePath, mesh, written)) {
+ s.cacheBytes = std::filesystem::file_size(s.cachePath, error);
+ } else {
+ std::cout << "WARNING: Could not write mesh cache " << s.cachePath.string() << std::endl;
+ }
+ s.writeMs = MillisecondsSince(writeStart);
+ }
+
+ s.totalMs = MillisecondsSince(start);
+ return asset;
+}
+
+} // namespace veng
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <glm/glm.hpp>
+#include "mapped_file.h"
+#include "mesh_importer.h"
+
+namespace veng {
+
+struct MeshCacheOptions {
+ std::filesystem::path directory; // empty: next to the source, as <source>.cmesh
+ bool write = true;               // false: use a valid cache but never create one
+};
+
+struct MeshLoadStats {
+ bool cacheHit = false;
+ bool sourceHashed = false;   // size/time did not match and the source content was compared
+ double totalMs =0.0;
+ double hashMs =0.0;
+ double importMs =0.0;
+ double writeMs =0.0;
+ uint64_t cacheBytes =0;
+ std::filesystem::path cachePath;
+};
+
+class MeshAsset;
+
+// Loads a source mesh (OBJ) through the binary mesh cache.
+// The cache file holds a fixed header, the bounds and the Vertex, uint32
+// index and MeshLod arrays at 256-byte aligned offsets, written with
+// Walnut::StreamWriter.
+// It is used when its format version, importer version and import options
+// match and the source is unchanged: same size and write time, or failing
+// that, the same content hash. Otherwise the source is imported and the
+// cache rewritten. A cache that cannot be written only costs the next load
+// another import.
+MeshAsset LoadMesh(const std::filesystem::path& source, const ObjImportOptions& importOptions = {},
+ const MeshCacheOptions& cacheOptions = {}, MeshLoadStats* stats = nullptr);
+
+// A mesh ready for CreateVertexBuffer / CreateIndexBuffer. Loaded from the
+// binary cache the spans point straight into the file mapping, so creating
+// the buffers copies from the page cache into staging memory and nothing else.
+class MeshAsset {
+public:
+ std::span<const Vertex> GetVertices() const { return m_Vertices; }
+ // Every LOD level back to back when GetLods() is not empty; draw the
+ // ranges of GetLods(), not the whole array
+ std::span<const std::uint32_t> GetIndices() const { return m_Indices; }
+ std::span<const MeshLod> GetLods() const { return m_Lods; }
+ glm::vec3 GetBoundsMin() const { return m_BoundsMin; }
+ glm::vec3 GetBoundsMax() const { return m_BoundsMax; }
+ // False when the data was imported from source in this call
+ bool IsMapped() const { return m_Mapping.IsOpen(); }
+
+private:
+ friend MeshAsset LoadMesh(const std::filesystem::path&, const ObjImportOptions&, const MeshCacheOptions&, MeshLoadStats*);
+
+ MappedFile m_Mapping;
+ MeshData m_Imported;
+ std::span<const Vertex> m_Vertices;
+ std::span<const std::uint32_t> m_Indices;
+ std::span<const MeshLod> m_Lods;
+ glm::vec3 m_BoundsMin{0.0f};
+ glm::vec3 m_BoundsMax{0.0f};
+};
+
+std::filesystem::path GetMeshCachePath(const std::filesystem::path& source, const MeshCacheOptions& cacheOptions = {});
+
+} // namespace veng
@@ -0,0 +1,590 @@
+#include "mesh_importer.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "thread_pool.h"
+#include "utilities.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace veng {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point start)
+{
+ return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Powers of ten that are exact in a double: m * 10^e with m < 2^53 and
+// |e| <= 22 is a single correctly rounded operation
+constexpr double kPow10[] = {
+ 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+ 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool IsDigit(char c)
+{
+ return static_cast<unsigned>(c - '0') <10u;
+}
+
+const char* SkipSpaces(const char* p, const char* end)
+{
+ while (p < end && (*p == ' ' || *p == '\t')) {
+ ++p;
+ }
+ return p;
+}
+
+// Decimal float without locale or allocation. Mesh data is short plain
+// decimals, which take the fast path; anything else (long mantissas, huge
+// exponents, inf/nan) goes through std::from_chars.
+const char* ParseFloat(const char* p, const char* end, float& out)
+{
+ const char* start = p;
+ bool negative = false;
+ if (p < end && (*p == '-' || *p == '+')) {
+ negative = *p == '-';
+ ++p;
+ }
+
+ uint64_t mantissa =0;
+ int significantDigits =0;
+ int exponent =0;
+ bool anyDigit = false;
+ for (; p < end && IsDigit(*p); ++p) {
+ anyDigit = true;
+ if (significantDigits <19) {
+ mantissa = mantissa *10 + static_cast<uint64_t>(*p - '0');
+ significantDigits += mantissa !=0;
+ } else {
+ ++exponent;
+ }
+ }
+ if (p < end && *p == '.') {
+ for (++p; p < end && IsDigit(*p); ++p) {
+ anyDigit = true;
+ if (significantDigits <19) {
+ mantissa = mantissa *10 + static_cast<uint64_t>(*p - '0');
+ significantDigits += mantissa !=0;
+ --exponent;
+ }
+ }
+ }
+ if (anyDigit && p < end && (*p == 'e' || *p == 'E')) {
+ const char* e = p +1;
+ bool negativeExponent = false;
+ if (e < end && (*e == '-' || *e == '+')) {
+ negativeExponent = *e == '-';
+ ++e;
+ }
+ if (e < end && IsDigit(*e)) {
+ int value =0;
+ for (; e < end && IsDigit(*e); ++e) {
+ value = std::min(value *10 + (*e - '0'),100000);
+ }
+ exponent += negativeExponent ? -value : value;
+ p = e;
+ }
+ }
+
+ if (anyDigit && (mantissa ==0 || (mantissa < (1ull <<53) && exponent >= -22 && exponent <=22))) {
+ double value = static_cast<double>(mantissa);
+ value = exponent <0 ? value / kPow10[-exponent] : value * kPow10[exponent];
+ out = static_cast<float>(negative ? -value : value);
+ return p;
+ }
+
+ const char* first = start + (start < end && *start == '+');
+ std::from_chars_result result = std::from_chars(first, end, out);
+ if (result.ec == std::errc::result_out_of_range) {
+ // from_chars leaves `out` untouched; clamp like strtof does
+ out = negative ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+ }
+ if (result.ptr == first) {
+ out =0.0f;
+ return start; // not a number: caller stops reading floats on this line
+ }
+ return result.ptr;
+}
+
+const char* ParseInt(const char* p, const char* end, int64_t& out, bool& ok)
+{
+ bool negative = false;
+ if (p < end && (*p == '-' || *p == '+')) {
+ negative = *p == '-';
+ ++p;
+ }
+ ok = p < end && IsDigit(*p);
+ int64_t value =0;
+ for (; p < end && IsDigit(*p); ++p) {
+ value = std::min<int64_t>(value *10 + (*p - '0'),1ll <<40);
+ }
+ out = negative ? -value : value;
+ return p;
+}
+
+enum class LineType : uint8_t { Other, Position, TexCoord, Normal, Face };
+
+// Classifies the line at p (after leading whitespace); shared by both passes
+// so their counts always agree
+LineType Classify(const char* p, const char* end)
+{
+ if (end - p <2) {
+ return LineType::Other;
+ }
+ const auto isSpace = [](char c) { return c == ' ' || c == '\t'; };
+ if (p[0] == 'v') {
+ if (isSpace(p[1])) {
+ return LineType::Position;
+ }
+ if (end - p >=3 && isSpace(p[2])) {
+ if (p[1] == 't') {
+ return LineType::TexCoord;
+ }
+ if (p[1] == 'n') {
+ return LineType::Normal;
+ }
+ }
+ return LineType::Other;
+ }
+ if (p[0] == 'f' && isSpace(p[1])) {
+ return LineType::Face;
+ }
+ return LineType::Other;
+}
+
+const char* LineEnd(const char* p, const char* end)
+{
+ const void* newline = std::memchr(p, '\n', static_cast<size_t>(end - p));
+ return newline ? static_cast<const char*>(newline) : end;
+}
+
+// Corner of a triangle, as 0-based indices into the whole file; -1 = absent
+struct Corner {
+ int32_t position;
+ int32_t texCoord;
+ int32_t normal;
+
+ bool operator==(const Corner& other) const
+ {
+ return position == other.position && texCoord == other.texCoord && normal == other.normal;
+ }
+};
+
+uint32_t HashCorner(const Corner& c)
+{
+ uint32_t h = static_cast<uint32_t>(c.position) *0x9E3779B1u;
+ h ^= static_cast<uint32_t>(c.texCoord) *0x85EBCA77u + (h <<6) + (h >>2);
+ h ^= static_cast<uint32_t>(c.normal) *0xC2B2AE3Du + (h <<6) + (h >>2);
+ h ^= h >>16;
+ h *=0x7FEB352Du;
+ h ^= h >>15;
+ return h;
+}
+
+// Open addressing Corner -> id map; ids are dense and in insertion order
+class CornerTable {
+public:
+ explicit CornerTable(size_t expected)
+ {
+ size_t capacity =16;
+ while (capacity < expected *2) {
+ capacity *=2;
+ }
+ m_Slots.assign(capacity,0);
+ m_Keys.reserve(expected);
+ }
+
+ // Returns the id of `key`, inserting it with the next id if it is new
+ uint32_t Insert(const Corner& key)
+ {
+ if ((m_Keys.size() +1) *2 > m_Slots.size()) {
+ Grow();
+ }
+ const size_t mask = m_Slots.size() -1;
+ for (size_t slot = HashCorner(key) & mask;; slot = (slot +1) & mask) {
+ const uint32_t entry = m_Slots[slot];
+ if (entry ==0) {
+ m_Keys.push_back(key);
+ m_Slots[slot] = static_cast<uint32_t>(m_Keys.size());
+ return static_cast<uint32_t>(m_Keys.size()) -1;
+ }
+ if (m_Keys[entry -1] == key) {
+ return entry -1;
+ }
+ }
+ }
+
+ const std::vector<Corner>& GetKeys() const { return m_Keys; }
+
+private:
+ void Grow()
+ {
+ std::vector<uint32_t> slots(m_Slots.size() *2,0);
+ const size_t mask = slots.size() -1;
+ for (uint32_t id =0; id < m_Keys.size(); ++id) {
+ size_t slot = HashCorner(m_Keys[id]) & mask;
+ while (slots[slot] !=0) {
+ slot = (slot +1) & mask;
+ }
+ slots[slot] = id +1;
+ }
+ m_Slots.swap(slots);
+ }
+
+ std::vector<uint32_t> m_Slots; // id + 1, 0 = empty
+ std::vector<Corner> m_Keys;
+};
+
+struct ChunkCounts {
+ size_t positions =0;
+ size_t texCoords =0;
+ size_t normals =0;
+};
+
+struct Chunk {
+ const char* begin = nullptr;
+ const char* end = nullptr;
+ ChunkCounts counts;
+ ChunkCounts base;              // elements in all earlier chunks
+
+ std::vector<Corner> corners;   // 3 per triangle
+ bool hasColors = false;
+ glm::vec3 boundsMin{ std::numeric_limits<float>::max() };
+ glm::vec3 boundsMax{ -std::numeric_limits<float>::max() };
+
+ // Deduplication: corner -> chunk local vertex, then local -> global vertex
+ std::vector<uint32_t> localIndices;
+ std::vector<Corner> uniqueCorners;
+ std::vector<uint32_t> remap;
+};
+
+// Shared attribute arrays; each chunk writes its own disjoint range
+struct Attributes {
+ std::vector<glm::vec3> positions;
+ std::vector<glm::vec3> colors;    // one per position; dropped after parsing if no line had colors
+ std::vector<glm::vec2> texCoords;
+ std::vector<glm::vec3> normals;
+};
+
+std::vector<Chunk> SplitLines(std::string_view text, size_t chunkSize)
+{
+ std::vector<Chunk> chunks;
+ const char* p = text.data();
+ const char* end = text.data() + text.size();
+ chunkSize = std::max<size_t>(chunkSize,4096);
+ while (p < end) {
+ const char* split = end - p > static_cast<std::ptrdiff_t>(chunkSize) ? LineEnd(p + chunkSize, end) : end;
+ if (split < end) {
+ ++split; // keep the newline with the line it ends
+ }
+ Chunk chunk;
+ chunk.begin = p;
+ chunk.end = split;
+ chunks.push_back(std::move(chunk));
+ p = split;
+ }
+ return chunks;
+}
+
+void CountChunk(Chunk& chunk)
+{
+ for (const char* line = chunk.begin; line < chunk.end;) {
+ const char* lineEnd = LineEnd(line, chunk.end);
+ switch (Classify(SkipSpaces(line, lineEnd), lineEnd)) {
+ case LineType::Position: ++chunk.counts.positions; break;
+ case LineType::TexCoord: ++chunk.counts.texCoords; break;
+ case LineType::Normal: ++chunk.counts.normals; break;
+ default: break;
+ }
+ line = lineEnd < chunk.end ? lineEnd +1 : chunk.end;
+ }
+}
+
+// Reads up to `maxCount` floats; missing values stay as they were
+int ParseFloats(const char* p, const char* end, float* values, int maxCount)
+{
+ int count =0;
+ while (count < maxCount) {
+ p = SkipSpaces(p, end);
+ const char* next = ParseFloat(p, end, values[count]);
+ if (next == p) {
+ break;
+ }
+ p = next;
+ ++count;
+ }
+ return count;
+}
+
+int32_t ResolveIndex(int64_t index, size_t countSoFar, size_t total)
+{
+ // 1-based from the start, or negative from the last element defined so far
+ const int64_t resolved = index >0 ? index -1 : static_cast<int64_t>(countSoFar) + index;
+ if (index ==0 || resolved <0 || resolved >= static_cast<int64_t>(total)) {
+ throw std::runtime_error("OBJ face references an element that does not exist (index " + std::to_string(index) + ")");
+ }
+ return static_cast<int32_t>(resolved);
+}
+
+void ParseChunk(Chunk& chunk, Attributes& attributes, const ChunkCounts& totals, const ObjImportOptions& options)
+{
+ size_t positions = chunk.base.positions;
+ size_t texCoords = chunk.base.texCoords;
+ size_t normals = chunk.base.normals;
+ std::vector<Corner> polygon;
+
+ for (const char* line = chunk.begin; line < chunk.end;) {
+ const char* lineEnd = LineEnd(line, chunk.end);
+ const char* p = SkipSpaces(line, lineEnd);
+ switch (Classify(p, lineEnd)) {
+ case LineType::Position: {
+ // "v x y z [w]" or the common "v x y z r g b" vertex color extension
+ float values[6] = {0.0f,0.0f,0.0f,1.0f,1.0f,1.0f};
+ const int count = ParseFloats(p +1, lineEnd, values,6);
+ const glm::vec3 position(values[0], values[1], values[2]);
+ attributes.positions[positions] = position;
+ if (count >=6) {
+ attributes.colors[positions] = glm::vec3(values[3], values[4], values[5]);
+ chunk.hasColors = true;
+ }
+ chunk.boundsMin = glm::min(chunk.boundsMin, position);
+ chunk.boundsMax = glm::max(chunk.boundsMax, position);
+ ++positions;
+ break;
+ }
+ case LineType::TexCoord: {
+ float values[2] = {0.0f,0.0f};
+ ParseFloats(p +2, lineEnd, values,2);
+ attributes.texCoords[texCoords++] = glm::vec2(values[0], options.flipTexCoordV ?1.0f - values[1] : values[1]);
+ break;
+ }
+ case LineType::Normal: {
+ float values[3] = {0.0f,0.0f,0.0f};
+ ParseFloats(p +2, lineEnd, values,3);
+ attributes.normals[normals++] = glm::vec3(values[0], values[1], values[2]);
+ break;
+ }
+ case LineType::Face: {
+ polygon.clear();
+ for (p = SkipSpaces(p +1, lineEnd); p < lineEnd && *p != '\r' && *p != '#'; p = SkipSpaces(p, lineEnd)) {
+ int64_t value =0;
+ bool ok = false;
+ Corner corner{ -1, -1, -1 };
+ p = ParseInt(p, lineEnd, value, ok);
+ if (!ok) {
+ throw std::runtime_error("Malformed OBJ face");
+ }
+ corner.position = ResolveIndex(value, positions, totals.positions);
+ if (p < lineEnd && *p == '/') {
+ ++p;
+ if (p < lineEnd && *p != '/') {
+ p = ParseInt(p, lineEnd, value, ok);
+ if (ok) {
+ corner.texCoord = ResolveIndex(value, texCoords, totals.texCoords);
+ }
+ }
+ if (p < lineEnd && *p == '/') {
+ p = ParseInt(p +1, lineEnd, value, ok);
+ if (ok) {
+ corner.normal = ResolveIndex(value, normals, totals.normals);
+ }
+ }
+ }
+ polygon.push_back(corner);
+ }
+ // Fan triangulation, exact for the convex polygons exporters write
+ for (size_t i =2; i < polygon.size(); ++i) {
+ chunk.corners.push_back(polygon[0]);
+ chunk.corners.push_back(polygon[i -1]);
+ chunk.corners.push_back(polygon[i]);
+ }
+ break;
+ }
+ default:
+ break;
+ }
+ line = lineEnd < chunk.end ? lineEnd +1 : chunk.end;
+ }
+}
+
+void DeduplicateChunk(Chunk& chunk)
+{
+ CornerTable table(chunk.corners.size() /2 +1);
+ chunk.localIndices.resize(chunk.corners.size());
+ for (size_t i =0; i < chunk.corners.size(); ++i) {
+ chunk.localIndices[i] = table.Insert(chunk.corners[i]);
+ }
+ chunk.uniqueCorners = table.GetKeys();
+}
+
+Vertex BuildVertex(const Corner& corner, const Attributes& attributes, bool hasColors, bool normalsAsColor)
+{
+ Vertex vertex{};
+ vertex.position = attributes.positions[corner.position];
+ vertex.color = glm::vec3(1.0f);
+ if (hasColors) {
+ vertex.color = attributes.colors[corner.position];
+ } else if (normalsAsColor && corner.normal >=0) {
+ vertex.color = attributes.normals[corner.normal] *0.5f +0.5f;
+ }
+ vertex.texCoord = corner.texCoord >=0 ? attributes.texCoords[corner.texCoord] : glm::vec2(0.0f);
+ return vertex;
+}
+
+} // namespace
+
+MeshData ImportObjFromMemory(std::string_view text, const ObjImportOptions& options, ObjImportStats* stats)
+{
+ ThreadPool& pool = ThreadPool::Shared();
+ const uint32_t threads = options.maxThreads >0 ? std::min(options.maxThreads, pool.GetThreadCount()) : pool.GetThreadCount();
+
+ const Clock::time_point parseStart = Clock::now();
+ std::vector<Chunk> chunks = SplitLines(text, options.chunkSize);
+ const uint32_t chunkCount = static_cast<uint32_t>(chunks.size());
+
+ // Pass 1: element counts, so pass 2 knows each chunk's base indices
+ pool.ParallelFor(chunkCount, [&](uint32_t i) { CountChunk(chunks[i]); }, threads);
+
+ ChunkCounts totals;
+ for (Chunk& chunk : chunks) {
+ chunk.base = totals;
+ totals.positions += chunk.counts.positions;
+ totals.texCoords += chunk.counts.texCoords;
+ totals.normals += chunk.counts.normals;
+ }
+ if (totals.positions > static_cast<size_t>(INT32_MAX)) {
+ throw std::runtime_error("OBJ has too many vertices");
+ }
+
+ // Pass 2: attributes straight into their final slots, faces per chunk
+ Attributes attributes;
+ attributes.positions.resize(totals.positions);
+ attributes.colors.resize(totals.positions, glm::vec3(1.0f));
+ attributes.texCoords.resize(totals.texCoords);
+ attributes.normals.resize(totals.normals);
+ pool.ParallelFor(chunkCount, [&](uint32_t i) { ParseChunk(chunks[i], attributes, totals, options); }, threads);
+ const double parseMs = MillisecondsSince(parseStart);
+
+ const Clock::time_point mergeStart = Clock::now();
+ MeshData mesh;
+ bool hasColors = false;
+ size_t cornerCount =0;
+ std::vector<size_t> cornerBase(chunkCount);
+ for (uint32_t i =0; i < chunkCount; ++i) {
+ hasColors |= chunks[i].hasColors;
+ cornerBase[i] = cornerCount;
+ cornerCount += chunks[i].corners.size();
+ mesh.boundsMin = i ==0 ? chunks[i].boundsMin : glm::min(mesh.boundsMin, chunks[i].boundsMin);
+ mesh.boundsMax = i ==0 ? chunks[i].boundsMax : glm::max(mesh.boundsMax, chunks[i].boundsMax);
+ }
+ if (totals.positions ==0) {
+ mesh.boundsMin = mesh.boundsMax = glm::vec3(0.0f);
+ }
+ if (!hasColors) {
+ attributes.colors = {};
+ }
+ mesh.indices.resize(cornerCount);
+
+ if (!options.deduplicate) {
+ mesh.vertices.resize(cornerCount);
+ pool.ParallelFor(chunkCount, [&](uint32_t i) {
+ const Chunk& chunk = chunks[i];
+ for (size_t c =0; c < chunk.corners.size(); ++c) {
+ mesh.vertices[cornerBase[i] + c] = BuildVertex(chunk.corners[c], attributes, hasColors, options.normalsAsColor);
+ mesh.indices[cornerBase[i] + c] = static_cast<uint32_t>(cornerBase[i] + c);
+ }
+ }, threads);
+ } else {
+ pool.ParallelFor(chunkCount, [&](uint32_t i) { DeduplicateChunk(chunks[i]); }, threads);
+
+ // Only corners unique within a chunk reach the serial step; walking the
+ // chunks in file order keeps vertex ids in first use order
+ size_t uniqueCount =0;
+ for (const Chunk& chunk : chunks) {
+ uniqueCount += chunk.uniqueCorners.size();
+ }
+ CornerTable global(std::max(totals.positions, uniqueCount /2));
+ for (Chunk& chunk : chunks) {
+ chunk.remap.resize(chunk.uniqueCorners.size());
+ for (size_t u =0; u < chunk.uniqueCorners.size(); ++u) {
+ chunk.remap[u] = global.Insert(chunk.uniqueCorners[u]);
+ }
+ }
+
+ const std::vector<Corner>& corners = global.GetKeys();
+ mesh.vertices.resize(corners.size());
+ constexpr uint32_t kVerticesPerTask =16384;
+ const uint32_t vertexTasks = static_cast<uint32_t>((corners.size() + kVerticesPerTask -1) / kVerticesPerTask);
+ pool.ParallelFor(vertexTasks + chunkCount, [&](uint32_t task) {
+ if (task < vertexTasks) {
+ const size_t first = static_cast<size_t>(task) * kVerticesPerTask;
+ const size_t last = std::min(first + kVerticesPerTask, corners.size());
+ for (size_t v = first; v < last; ++v) {
+ mesh.vertices[v] = BuildVertex(corners[v], attributes, hasColors, options.normalsAsColor);
+ }
+ return;
+ }
+ const uint32_t i = task - vertexTasks;
+ const Chunk& chunk = chunks[i];
+ for (size_t c =0; c < chunk.localIndices.size(); ++c) {
+ mesh.indices[cornerBase[i] + c] = chunk.remap[chunk.localIndices[c]];
+ }
+ }, threads);
+ }
+ const double mergeMs = MillisecondsSince(mergeStart);
+
+ const Clock::time_point optimizeStart = Clock::now();
+ if (options.optimize) {
+ WeldVertices(mesh);
+ OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+ OptimizeVertexFetch(mesh);
+ }
+ const double optimizeMs = MillisecondsSince(optimizeStart);
+
+ const Clock::time_point lodStart = Clock::now();
+ if (options.lodLevels >0) {
+ LodOptions lodOptions;
+ lodOptions.levels = options.lodLevels;
+ GenerateLods(mesh, lodOptions);
+ }
+ const double lodMs = MillisecondsSince(lodStart);
+
+ if (stats) {
+ stats->parseMs = parseMs;
+ stats->mergeMs = mergeMs;
+ stats->optimizeMs = optimizeMs;
+ stats->lodMs = lodMs;
+ stats->chunks = chunkCount;
+ stats->threads = std::min(threads, std::max(chunkCount,1u));
+ stats->positions = totals.positions;
+ stats->texCoords = totals.texCoords;
+ stats->normals = totals.normals;
+ }
+ return mesh;
+}
+
+MeshData ImportObj(const std::filesystem::path& path, const ObjImportOptions& options, ObjImportStats* stats)
+{
+ const Clock::time_point readStart = Clock::now();
+ if (!std::filesystem::is_regular_file(path)) {
+ throw std::runtime_error("OBJ file not found: " + path.string());
+ }
+ const std::vector<std::uint8_t> bytes = ReadFile(path);
+ const double readMs = MillisecondsSince(readStart);
+
+ MeshData mesh = ImportObjFromMemory(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()), options, stats);
+ if (stats) {
+ stats->readMs = readMs;
+ }
+ return mesh;
+}
+
+} // namespace veng
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+#include <glm/glm.hpp>
+#include "vertex.h"
+
+namespace veng {
+
+// Bump whenever ImportObj produces different output for the same input and
+// options; cached meshes written by older importers are then re-imported
+constexpr uint32_t kObjImporterVersion =2;
+
+// A level of detail: a range of the mesh's index buffer over the same
+// vertices. `error` is its largest deviation from the base mesh, in mesh units.
+struct MeshLod {
+ uint32_t firstIndex =0;
+ uint32_t indexCount =0;
+ float error =0.0f;
+};
+
+// Vertex and index arrays ready for CreateVertexBuffer / CreateIndexBuffer
+struct MeshData {
+ std::vector<Vertex> vertices;
+ std::vector<std::uint32_t> indices; // triangle list
+ glm::vec3 boundsMin{0.0f};
+ glm::vec3 boundsMax{0.0f};
+ // Empty, or the base mesh followed by coarser levels (GenerateLods); then
+ // `indices` holds every level back to back, the base mesh first
+ std::vector<MeshLod> lods;
+};
+
+struct ObjImportOptions {
+ uint32_t maxThreads =0;          // 0: every thread of ThreadPool::Shared()
+ size_t chunkSize =256 *1024;     // bytes per parse task, extended to the next line end
+ bool flipTexCoordV = true;       // OBJ puts v=0 at the bottom, Vulkan at the top
+ bool deduplicate = true;         // faces sharing a v/vt/vn triple share the vertex
+ bool normalsAsColor = false;     // no vertex colors in the file: color = normal * 0.5 + 0.5
+ bool optimize = true;            // OptimizeMesh: weld, vertex cache and fetch order (mesh_optimizer.h)
+ uint32_t lodLevels =0;           // GenerateLods levels after the base mesh (mesh_simplifier.h), at most 15
+};
+
+struct ObjImportStats {
+ double readMs =0.0;
+ double parseMs =0.0;   // both parallel passes over the text
+ double mergeMs =0.0;   // deduplication and vertex/index assembly
+ double optimizeMs =0.0;
+ double lodMs =0.0;
+ uint32_t chunks =0;
+ uint32_t threads =0;
+ size_t positions =0;
+ size_t texCoords =0;
+ size_t normals =0;
+};
+
+// Wavefront OBJ geometry import (v, vt, vn, f; everything else is skipped).
+// The text is split into line aligned chunks that are parsed on the thread
+// pool: one pass counts elements so every chunk knows where its positions,
+// normals and texture coordinates start, the second parses them in place and
+// resolves face indices (including negative ones). Polygons are fan
+// triangulated. Output order does not depend on the number of threads.
+// With `optimize` the result then goes through OptimizeMesh, so triangle and
+// vertex order are the optimizer's rather than the file's; with `lodLevels`
+// it then gets a LOD chain.
+// Throws std::runtime_error when the file cannot be read or a face references
+// an element that does not exist.
+MeshData ImportObj(const std::filesystem::path& path, const ObjImportOptions& options = {}, ObjImportStats* stats = nullptr);
+MeshData ImportObjFromMemory(std::string_view text, const ObjImportOptions& options = {}, ObjImportStats* stats = nullptr);
+
+} // namespace veng
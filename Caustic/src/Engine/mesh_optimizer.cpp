@@ -0,0 +1,255 @@
+#include "mesh_optimizer.h"
+#include "utilities.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace veng {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point start)
+{
+ return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+constexpr uint32_t kInvalid = std::numeric_limits<uint32_t>::max();
+
+// Weights from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+constexpr float kCacheDecayPower =1.5f;
+constexpr float kLastTriangleScore =0.75f;
+constexpr float kValenceBoostScale =2.0f;
+constexpr float kValenceBoostPower =0.5f;
+constexpr uint32_t kMaxValence =64;
+
+Vertex CanonicalVertex(const Vertex& vertex)
+{
+ Vertex key = vertex;
+ float* values = reinterpret_cast<float*>(&key);
+ for (size_t i =0; i < sizeof(Vertex) / sizeof(float); ++i) {
+ if (values[i] ==0.0f) {
+ values[i] =0.0f;
+ }
+ }
+ return key;
+}
+
+} // namespace
+
+VertexCacheStats AnalyzeVertexCache(std::span<const std::uint32_t> indices, size_t vertexCount, uint32_t cacheSize)
+{
+ VertexCacheStats stats;
+ if (indices.empty() || vertexCount ==0) {
+ return stats;
+ }
+
+ // FIFO: a vertex is a hit while fewer than cacheSize misses happened since
+ // it was last transformed
+ std::vector<uint32_t> insertedAt(vertexCount,0);
+ uint32_t time = cacheSize +1;
+ for (const uint32_t index : indices) {
+ if (time - insertedAt[index] > cacheSize) {
+ insertedAt[index] = time++;
+ ++stats.transformedVertices;
+ }
+ }
+ stats.acmr = static_cast<float>(stats.transformedVertices) / static_cast<float>(indices.size() /3);
+ stats.atvr = static_cast<float>(stats.transformedVertices) / static_cast<float>(vertexCount);
+ return stats;
+}
+
+size_t WeldVertices(MeshData& mesh)
+{
+ const size_t vertexCount = mesh.vertices.size();
+ const size_t capacity = std::bit_ceil(std::max<size_t>(vertexCount *2,16));
+ std::vector<uint32_t> slots(capacity, kInvalid);
+ std::vector<uint32_t> remap(vertexCount);
+ std::vector<Vertex> keys(vertexCount);
+ std::vector<Vertex> welded;
+ welded.reserve(vertexCount);
+
+ for (size_t v =0; v < vertexCount; ++v) {
+ keys[v] = CanonicalVertex(mesh.vertices[v]);
+ size_t slot = HashBytes(&keys[v], sizeof(Vertex)) & (capacity -1);
+ while (slots[slot] != kInvalid && std::memcmp(&keys[slots[slot]], &keys[v], sizeof(Vertex)) !=0) {
+ slot = (slot +1) & (capacity -1);
+ }
+ if (slots[slot] == kInvalid) {
+ slots[slot] = static_cast<uint32_t>(v);
+ remap[v] = static_cast<uint32_t>(welded.size());
+ welded.push_back(mesh.vertices[v]);
+ } else {
+ remap[v] = remap[slots[slot]];
+ }
+ }
+
+ for (uint32_t& index : mesh.indices) {
+ index = remap[index];
+ }
+ mesh.vertices = std::move(welded);
+ return mesh.vertices.size();
+}
+
+void OptimizeVertexCache(std::span<std::uint32_t> indices, size_t vertexCount, uint32_t cacheSize)
+{
+ const size_t triangleCount = indices.size() /3;
+ if (triangleCount ==0 || vertexCount ==0) {
+ return;
+ }
+ cacheSize = std::clamp(cacheSize,4u,64u);
+
+ std::vector<float> cacheScores(cacheSize);
+ for (uint32_t i =0; i < cacheSize; ++i) {
+ cacheScores[i] = i <3 ? kLastTriangleScore : std::pow(1.0f - static_cast<float>(i -3) / static_cast<float>(cacheSize -3), kCacheDecayPower);
+ }
+ std::array<float, kMaxValence +1> valenceScores{};
+ for (uint32_t i =1; i <= kMaxValence; ++i) {
+ valenceScores[i] = kValenceBoostScale * std::pow(static_cast<float>(i), -kValenceBoostPower);
+ }
+ const auto vertexScore = [&](uint32_t cachePosition, uint32_t liveTriangles) {
+ if (liveTriangles ==0) {
+ return -1.0f;
+ }
+ const float cacheScore = cachePosition < cacheSize ? cacheScores[cachePosition] :0.0f;
+ return cacheScore + valenceScores[std::min(liveTriangles, kMaxValence)];
+ };
+
+ // Triangles around each vertex; the first liveTriangles[v] entries of a
+ // vertex's range are the ones not emitted yet
+ std::vector<uint32_t> liveTriangles(vertexCount,0);
+ for (const uint32_t index : indices) {
+ ++liveTriangles[index];
+ }
+ std::vector<uint32_t> adjacencyOffsets(vertexCount +1,0);
+ for (size_t v =0; v < vertexCount; ++v) {
+ adjacencyOffsets[v +1] = adjacencyOffsets[v] + liveTriangles[v];
+ }
+ std::vector<uint32_t> adjacency(indices.size());
+ {
+ std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() -1);
+ for (size_t i =0; i < indices.size(); ++i) {
+ adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i /3);
+ }
+ }
+
+ std::vector<uint32_t> cachePositions(vertexCount, kInvalid);
+ std::vector<float> vertexScores(vertexCount);
+ for (size_t v =0; v < vertexCount; ++v) {
+ vertexScores[v] = vertexScore(kInvalid, liveTriangles[v]);
+ }
+ std::vector<float> triangleScores(triangleCount);
+ uint32_t best =0;
+ for (size_t t =0; t < triangleCount; ++t) {
+ triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t +1]] + vertexScores[indices[3 * t +2]];
+ if (triangleScores[t] > triangleScores[best]) {
+ best = static_cast<uint32_t>(t);
+ }
+ }
+
+ std::vector<uint8_t> emitted(triangleCount,0);
+ std::vector<uint32_t> output;
+ output.reserve(indices.size());
+ std::vector<uint32_t> cache;
+ std::vector<uint32_t> nextCache;
+ cache.reserve(cacheSize +3);
+ nextCache.reserve(cacheSize +3);
+ size_t cursor =0;
+
+ while (output.size() < indices.size()) {
+ if (best == kInvalid) {
+ // Nothing in the cache touches a live triangle: continue in input order
+ while (emitted[cursor]) {
+ ++cursor;
+ }
+ best = static_cast<uint32_t>(cursor);
+ }
+ const uint32_t* corners = &indices[3 * static_cast<size_t>(best)];
+ emitted[best] =1;
+ output.insert(output.end(), corners, corners +3);
+
+ nextCache.clear();
+ for (int c =0; c <3; ++c) {
+ const uint32_t v = corners[c];
+ uint32_t* first = &adjacency[adjacencyOffsets[v]];
+ uint32_t* last = first + liveTriangles[v];
+ std::iter_swap(std::find(first, last, best), last -1);
+ --liveTriangles[v];
+ if ((c <1 || v != corners[0]) && (c <2 || v != corners[1])) {
+ nextCache.push_back(v);
+ }
+ }
+ for (const uint32_t v : cache) {
+ if (v != corners[0] && v != corners[1] && v != corners[2]) {
+ nextCache.push_back(v);
+ }
+ }
+
+ // Rescore everything that moved in or fell out of the cache and pick
+ // the best live triangle around the vertices still in it
+ best = kInvalid;
+ float bestScore = -1.0f;
+ for (uint32_t i =0; i < nextCache.size(); ++i) {
+ const uint32_t v = nextCache[i];
+ cachePositions[v] = i < cacheSize ? i : kInvalid;
+ const float score = vertexScore(cachePositions[v], liveTriangles[v]);
+ const float delta = score - vertexScores[v];
+ vertexScores[v] = score;
+ for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + liveTriangles[v]; ++a) {
+ triangleScores[adjacency[a]] += delta;
+ }
+ }
+ for (uint32_t i =0; i < nextCache.size() && i < cacheSize; ++i) {
+ const uint32_t v = nextCache[i];
+ for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + liveTriangles[v]; ++a) {
+ if (triangleScores[adjacency[a]] > bestScore) {
+ bestScore = triangleScores[adjacency[a]];
+ best = adjacency[a];
+ }
+ }
+ }
+ nextCache.resize(std::min<size_t>(nextCache.size(), cacheSize));
+ std::swap(cache, nextCache);
+ }
+
+ std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void OptimizeVertexFetch(MeshData& mesh)
+{
+ std::vector<uint32_t> remap(mesh.vertices.size(), kInvalid);
+ std::vector<Vertex> ordered;
+ ordered.reserve(mesh.vertices.size());
+ for (uint32_t& index : mesh.indices) {
+ if (remap[index] == kInvalid) {
+ remap[index] = static_cast<uint32_t>(ordered.size());
+ ordered.push_back(mesh.vertices[index]);
+ }
+ index = remap[index];
+ }
+ mesh.vertices = std::move(ordered);
+}
+
+MeshOptimizeStats OptimizeMesh(MeshData& mesh)
+{
+ MeshOptimizeStats stats;
+ stats.verticesBefore = mesh.vertices.size();
+ stats.before = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+ const Clock::time_point start = Clock::now();
+
+ WeldVertices(mesh);
+ OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+ OptimizeVertexFetch(mesh);
+ stats.milliseconds = MillisecondsSince(start);
+
+ stats.verticesAfter = mesh.vertices.size();
+ stats.after = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+ return stats;
+}
+
+} // namespace veng
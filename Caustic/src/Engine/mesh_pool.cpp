@@ -0,0 +1,304 @@
+#include "mesh_pool.h"
+#include "vertex_layout.h"
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+namespace veng {
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+ : m_Capacity(capacity), m_FreeSize(capacity)
+{
+ if (capacity >0) {
+ m_FreeRanges.emplace(0, capacity);
+ }
+}
+
+uint32_t RangeAllocator::Allocate(uint32_t size)
+{
+ if (size ==0 || size > m_FreeSize) {
+ return kInvalidOffset;
+ }
+ for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it) {
+ if (it->second < size) {
+ continue;
+ }
+ const uint32_t offset = it->first;
+ const uint32_t remaining = it->second - size;
+ m_FreeRanges.erase(it);
+ if (remaining >0) {
+ m_FreeRanges.emplace(offset + size, remaining);
+ }
+ m_FreeSize -= size;
+ return offset;
+ }
+ return kInvalidOffset;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t size)
+{
+ if (size ==0) {
+ return;
+ }
+ m_FreeSize += size;
+
+ auto next = m_FreeRanges.lower_bound(offset);
+ if (next != m_FreeRanges.end() && offset + size == next->first) {
+ size += next->second;
+ next = m_FreeRanges.erase(next);
+ }
+ if (next != m_FreeRanges.begin()) {
+ auto previous = std::prev(next);
+ if (previous->first + previous->second == offset) {
+ previous->second += size;
+ return;
+ }
+ }
+ m_FreeRanges.emplace_hint(next, offset, size);
+}
+
+MeshPool::MeshPool(VkDevice device, DeviceAllocator& allocator, UploadContext& uploads, uint32_t framesInFlight,
+ uint32_t pageVertices, uint32_t pageIndices)
+ : m_Device(device), m_Allocator(allocator), m_Uploads(uploads),
+ m_PageVertices(std::max(pageVertices,1u)), m_PageIndices(std::max(pageIndices,1u)),
+ m_Retired(std::max(framesInFlight,1u))
+{
+}
+
+MeshPool::~MeshPool()
+{
+ for (Page& page : m_Pages) {
+ for (BufferHandle* buffer : { &page.vertices, &page.indices }) {
+ if (buffer->buffer != VK_NULL_HANDLE) {
+ vkDestroyBuffer(m_Device, buffer->buffer, nullptr);
+ }
+ m_Allocator.Free(buffer->allocation);
+ }
+ }
+}
+
+MeshHandle MeshPool::Add(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+ if (vertices.empty() || indices.empty()) {
+ return {};
+ }
+ const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+ const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+ Mesh mesh;
+ mesh.vertexCount = vertexCount;
+ mesh.indexCount = indexCount;
+ mesh.bounds = ComputeBounds(vertices);
+ mesh.live =true;
+ mesh.page = static_cast<uint32_t>(m_Pages.size());
+ for (uint32_t i =0; i < m_Pages.size(); ++i) {
+ Page& page = m_Pages[i];
+ const uint32_t firstVertex = page.vertexRanges.Allocate(vertexCount);
+ if (firstVertex == RangeAllocator::kInvalidOffset) {
+ continue;
+ }
+ const uint32_t firstIndex = page.indexRanges.Allocate(indexCount);
+ if (firstIndex == RangeAllocator::kInvalidOffset) {
+ page.vertexRanges.Free(firstVertex, vertexCount);
+ continue;
+ }
+ mesh.page = i;
+ mesh.firstVertex = firstVertex;
+ mesh.firstIndex = firstIndex;
+ break;
+ }
+ if (mesh.page == m_Pages.size()) {
+ CreatePage(std::max(m_PageVertices, vertexCount), std::max(m_PageIndices, indexCount));
+ Page& page = m_Pages.back();
+ mesh.firstVertex = page.vertexRanges.Allocate(vertexCount);
+ mesh.firstIndex = page.indexRanges.Allocate(indexCount);
+ }
+
+ const Page& page = m_Pages[mesh.page];
+ const VkDeviceSize vertexOffset = static_cast<VkDeviceSize>(mesh.firstVertex) * GpuVertexLayout::kStride;
+ const VkDeviceSize vertexSize = static_cast<VkDeviceSize>(vertexCount) * GpuVertexLayout::kStride;
+ if constexpr (std::is_same_v<GpuVertexLayout, FullVertexLayout>) {
+ Upload(page.vertices.buffer, vertexOffset, vertices.data(), vertexSize);
+ } else {
+ std::vector<std::byte> packed(vertexSize);
+ GpuVertexLayout::Pack(vertices, packed.data());
+ Upload(page.vertices.buffer, vertexOffset, packed.data(), vertexSize);
+ }
+ Upload(page.indices.buffer, static_cast<VkDeviceSize>(mesh.firstIndex) * sizeof(uint32_t), indices.data(), indices.size_bytes());
+
+ MeshHandle handle;
+ if (!m_FreeMeshes.empty()) {
+ handle.index = m_FreeMeshes.back();
+ m_FreeMeshes.pop_back();
+ m_Meshes[handle.index] = mesh;
+ } else {
+ handle.index = static_cast<uint32_t>(m_Meshes.size());
+ m_Meshes.push_back(mesh);
+ }
+ ++m_LiveMeshes;
+ return handle;
+}
+
+void MeshPool::Remove(MeshHandle mesh)
+{
+ // A second Remove would retire the slot twice and free its ranges again
+ if (!mesh.IsValid() || mesh.index >= m_Meshes.size() || !m_Meshes[mesh.index].live) {
+ return;
+ }
+ m_Meshes[mesh.index].live =false;
+ // Frames still in flight may draw it; see BeginFrame
+ m_Retired[m_FrameIndex].push_back(mesh.index);
+ --m_LiveMeshes;
+}
+
+uint32_t MeshPool::GetIndexCount(MeshHandle mesh) const
+{
+ return mesh.IsValid() && mesh.index < m_Meshes.size() ? m_Meshes[mesh.index].indexCount :0;
+}
+
+VkDrawIndexedIndirectCommand MeshPool::GetDrawCommand(MeshHandle mesh) const
+{
+ const Mesh& pooled = m_Meshes[mesh.index];
+ VkDrawIndexedIndirectCommand command{};
+ command.indexCount = pooled.indexCount;
+ command.instanceCount =1;
+ command.firstIndex = pooled.firstIndex;
+ command.vertexOffset = static_cast<int32_t>(pooled.firstVertex);
+ return command;
+}
+
+void MeshPool::BeginFrame(uint32_t frameIndex)
+{
+ m_FrameIndex = frameIndex % static_cast<uint32_t>(m_Retired.size());
+ for (uint32_t mesh : m_Retired[m_FrameIndex]) {
+ Release(mesh);
+ }
+ m_Retired[m_FrameIndex].clear();
+}
+
+void MeshPool::Release(uint32_t mesh)
+{
+ Mesh& released = m_Meshes[mesh];
+ Page& page = m_Pages[released.page];
+ page.vertexRanges.Free(released.firstVertex, released.vertexCount);
+ page.indexRanges.Free(released.firstIndex, released.indexCount);
+ released = {};
+ m_FreeMeshes.push_back(mesh);
+}
+
+MeshPool::DrawList MeshPool::BuildDrawList(std::span<const MeshDraw> draws)
+{
+ m_Commands.clear();
+ m_Instances.clear();
+ m_Batches.clear();
+
+ // Counting sort by page keeps the caller's order within a page
+ m_PageCounts.assign(m_Pages.size() +1,0);
+ for (const MeshDraw& draw : draws) {
+ if (draw.mesh.IsValid()) {
+ ++m_PageCounts[m_Meshes[draw.mesh.index].page +1];
+ }
+ }
+ for (size_t i =1; i < m_PageCounts.size(); ++i) {
+ m_PageCounts[i] += m_PageCounts[i -1];
+ }
+ m_SortedDraws.resize(m_PageCounts.back());
+ for (const MeshDraw& draw : draws) {
+ if (draw.mesh.IsValid()) {
+ m_SortedDraws[m_PageCounts[m_Meshes[draw.mesh.index].page]++] = &draw;
+ }
+ }
+
+ m_Instances.reserve(m_SortedDraws.size());
+ uint32_t previousMesh = UINT32_MAX;
+ for (const MeshDraw* draw : m_SortedDraws) {
+ const Mesh& mesh = m_Meshes[draw->mesh.index];
+ if (m_Batches.empty() || m_Batches.back().page != mesh.page) {
+ m_Batches.push_back({ mesh.page, static_cast<uint32_t>(m_Commands.size()),0 });
+ previousMesh = UINT32_MAX;
+ }
+ if (draw->mesh.index == previousMesh) {
+ ++m_Commands.back().instanceCount;
+ } else {
+ VkDrawIndexedIndirectCommand command{};
+ command.indexCount = mesh.indexCount;
+ command.instanceCount =1;
+ command.firstIndex = mesh.firstIndex;
+ command.vertexOffset = static_cast<int32_t>(mesh.firstVertex);
+ command.firstInstance = static_cast<uint32_t>(m_Instances.size());
+ m_Commands.push_back(command);
+ ++m_Batches.back().commandCount;
+ previousMesh = draw->mesh.index;
+ }
+ m_Instances.push_back(draw->instance);
+ }
+
+ return { m_Commands, m_Instances, m_Batches };
+}
+
+MeshPoolStats MeshPool::GetStats() const
+{
+ MeshPoolStats stats;
+ stats.meshes = m_LiveMeshes;
+ stats.pages = static_cast<uint32_t>(m_Pages.size());
+ for (const Page& page : m_Pages) {
+ stats.vertexBytes += static_cast<uint64_t>(page.vertexRanges.GetCapacity()) * GpuVertexLayout::kStride;
+ stats.indexBytes += static_cast<uint64_t>(page.indexRanges.GetCapacity()) * sizeof(uint32_t);
+ stats.usedVertices += page.vertexRanges.GetCapacity() - page.vertexRanges.GetFreeSize();
+ stats.usedIndices += page.indexRanges.GetCapacity() - page.indexRanges.GetFreeSize();
+ }
+ return stats;
+}
+
+uint32_t MeshPool::CreatePage(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+ Page page;
+ page.vertices = CreateBuffer(static_cast<VkDeviceSize>(vertexCapacity) * GpuVertexLayout::kStride, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+ try {
+ page.indices = CreateBuffer(static_cast<VkDeviceSize>(indexCapacity) * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+ } catch (...) {
+ vkDestroyBuffer(m_Device, page.vertices.buffer, nullptr);
+ m_Allocator.Free(page.vertices.allocation);
+ throw;
+ }
+ page.vertexRanges = RangeAllocator(vertexCapacity);
+ page.indexRanges = RangeAllocator(indexCapacity);
+ m_Pages.push_back(std::move(page));
+ return static_cast<uint32_t>(m_Pages.size() -1);
+}
+
+BufferHandle MeshPool::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage)
+{
+ BufferHandle handle{};
+
+ VkBufferCreateInfo bufferInfo{};
+ bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+ bufferInfo.size = size;
+ bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+ bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+ if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &handle.buffer) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create mesh pool buffer");
+ }
+
+ try {
+ handle.allocation = m_Allocator.AllocateForBuffer(handle.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+ } catch (...) {
+ vkDestroyBuffer(m_Device, handle.buffer, nullptr);
+ throw;
+ }
+ return handle;
+}
+
+// Graphics queue only, see the class comment
+void MeshPool::Upload(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+ const UploadContext::StagingSpan staging = m_Uploads.Stage(data, size);
+
+ VkBufferCopy copy{};
+ copy.srcOffset = staging.offset;
+ copy.dstOffset = offset;
+ copy.size = size;
+ vkCmdCopyBuffer(m_Uploads.GetGraphicsCommandBuffer(), staging.buffer, buffer,1, &copy);
+}
+
+} // namespace veng
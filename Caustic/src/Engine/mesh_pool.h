@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <vector>
+#include "buffer_handle.h"
+#include "culling.h"
+#include "device_allocator.h"
+#include "instance_data.h"
+#include "upload_context.h"
+#include "vertex.h"
+
+namespace veng {
+
+// A mesh living in a MeshPool. Handles of removed meshes are recycled, so
+// they must not be used after MeshPool::Remove.
+struct MeshHandle {
+ uint32_t index = UINT32_MAX;
+
+ bool IsValid() const { return index != UINT32_MAX; }
+};
+
+// One draw of a pooled mesh; `instance.transformation` places it in the world
+struct MeshDraw {
+ MeshHandle mesh;
+ InstanceData instance;
+};
+
+// First-fit allocator of element ranges inside a fixed capacity. Freed ranges
+// are merged with their free neighbours.
+class RangeAllocator {
+public:
+ static constexpr uint32_t kInvalidOffset = UINT32_MAX;
+
+ explicit RangeAllocator(uint32_t capacity =0);
+
+ // kInvalidOffset when no free range is large enough
+ uint32_t Allocate(uint32_t size);
+ void Free(uint32_t offset, uint32_t size);
+
+ uint32_t GetCapacity() const { return m_Capacity; }
+ uint32_t GetFreeSize() const { return m_FreeSize; }
+
+private:
+ std::map<uint32_t, uint32_t> m_FreeRanges; // offset -> size
+ uint32_t m_Capacity =0;
+ uint32_t m_FreeSize =0;
+};
+
+struct MeshPoolStats {
+ uint32_t meshes =0;
+ uint32_t pages =0;
+ uint64_t vertexBytes =0;   // reserved by the pages
+ uint64_t indexBytes =0;
+ uint32_t usedVertices =0;
+ uint32_t usedIndices =0;
+};
+
+// Sub-allocates the vertices and indices of many meshes out of a few large
+// buffers, so they can be drawn with a handful of indirect draws instead of
+// one bind and draw per mesh.
+//
+// Meshes are packed into pages: one vertex buffer (GpuVertexLayout) and one
+// uint32 index buffer each. A new page is created when no existing one has
+// room; a mesh larger than the page size gets a page of its own. Indices stay
+// relative to the mesh, the draw's vertexOffset points at its vertices.
+//
+// Copies are recorded on the graphics half of the upload batch: the pages are
+// written again after their first use, which rules out handing them back and
+// forth between queue families. Removed meshes keep their ranges until the
+// frame slot they were removed in comes around again.
+class MeshPool {
+public:
+ MeshPool(VkDevice device, DeviceAllocator& allocator, UploadContext& uploads, uint32_t framesInFlight,
+  uint32_t pageVertices =1u <<20, uint32_t pageIndices =1u <<22);
+ ~MeshPool();
+
+ MeshPool(const MeshPool&) = delete;
+ MeshPool& operator=(const MeshPool&) = delete;
+
+ // Stages the data into the open upload batch (see UploadContext tickets)
+ MeshHandle Add(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+ void Remove(MeshHandle mesh);
+ uint32_t GetIndexCount(MeshHandle mesh) const;
+ // Object space bounds, computed by Add
+ const Aabb& GetBounds(MeshHandle mesh) const { return m_Meshes[mesh.index].bounds; }
+ // Page holding the mesh, and its draw as one instance at firstInstance 0
+ uint32_t GetPage(MeshHandle mesh) const { return m_Meshes[mesh.index].page; }
+ VkDrawIndexedIndirectCommand GetDrawCommand(MeshHandle mesh) const;
+
+ // Called once the frame slot's fence has signaled: meshes removed while it
+ // was last recorded give back their ranges
+ void BeginFrame(uint32_t frameIndex);
+
+ // Draws of one page: `commandCount` commands starting at `firstCommand`
+ struct PageBatch {
+ uint32_t page =0;
+ uint32_t firstCommand =0;
+ uint32_t commandCount =0;
+ };
+
+ // Commands and instance data for `draws`, grouped by page. Consecutive draws
+ // of the same mesh share a command with a larger instanceCount. Each
+ // command's firstInstance indexes `instances`. The spans stay valid until the
+ // next call.
+ struct DrawList {
+ std::span<const VkDrawIndexedIndirectCommand> commands;
+ std::span<const InstanceData> instances;
+ std::span<const PageBatch> batches;
+ };
+ DrawList BuildDrawList(std::span<const MeshDraw> draws);
+
+ VkBuffer GetVertexBuffer(uint32_t page) const { return m_Pages[page].vertices.buffer; }
+ VkBuffer GetIndexBuffer(uint32_t page) const { return m_Pages[page].indices.buffer; }
+
+ MeshPoolStats GetStats() const;
+
+private:
+ struct Page {
+ BufferHandle vertices;
+ BufferHandle indices;
+ RangeAllocator vertexRanges;
+ RangeAllocator indexRanges;
+ };
+
+ struct Mesh {
+ uint32_t page =0;
+ uint32_t firstVertex =0;
+ uint32_t vertexCount =0;
+ uint32_t firstIndex =0;
+ uint32_t indexCount =0;
+ Aabb bounds;
+ bool live =false; // cleared by Remove, before the ranges are released
+ };
+
+ uint32_t CreatePage(uint32_t vertexCapacity, uint32_t indexCapacity);
+ BufferHandle CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+ void Upload(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+ void Release(uint32_t mesh);
+
+ VkDevice m_Device = VK_NULL_HANDLE;
+ DeviceAllocator& m_Allocator;
+ UploadContext& m_Uploads;
+ uint32_t m_PageVertices =0;
+ uint32_t m_PageIndices =0;
+
+ std::vector<Page> m_Pages;
+ std::vector<Mesh> m_Meshes;
+ std::vector<uint32_t> m_FreeMeshes;
+ uint32_t m_LiveMeshes =0;
+
+ // Meshes removed while each frame slot was recorded
+ std::vector<std::vector<uint32_t>> m_Retired;
+ uint32_t m_FrameIndex =0;
+
+ // BuildDrawList scratch, kept to avoid per-frame allocations
+ std::vector<uint32_t> m_PageCounts;
+ std::vector<const MeshDraw*> m_SortedDraws;
+ std::vector<VkDrawIndexedIndirectCommand> m_Commands;
+ std::vector<InstanceData> m_Instances;
+ std::vector<PageBatch> m_Batches;
+};
+
+} // namespace veng
@@ -0,0 +1,376 @@
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+#include "utilities.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace veng {
+
+namespace {
+
+constexpr uint32_t kInvalid = std::numeric_limits<uint32_t>::max();
+
+// Area weighted sum of squared distances to planes n.p + d = 0:
+// p^T A p + 2 b.p + c, with A = n n^T, b = d n and c = d^2 per plane
+struct Quadric {
+ double xx =0.0, xy =0.0, xz =0.0, yy =0.0, yz =0.0, zz =0.0;
+ double x =0.0, y =0.0, z =0.0;
+ double c =0.0;
+ double weight =0.0;
+
+ void AddPlane(double nx, double ny, double nz, double d, double w)
+ {
+ xx += w * nx * nx; xy += w * nx * ny; xz += w * nx * nz;
+ yy += w * ny * ny; yz += w * ny * nz; zz += w * nz * nz;
+ x += w * nx * d; y += w * ny * d; z += w * nz * d;
+ c += w * d * d;
+ weight += w;
+ }
+
+ void Add(const Quadric& other)
+ {
+ xx += other.xx; xy += other.xy; xz += other.xz;
+ yy += other.yy; yz += other.yz; zz += other.zz;
+ x += other.x; y += other.y; z += other.z;
+ c += other.c;
+ weight += other.weight;
+ }
+
+ double Evaluate(const glm::vec3& p) const
+ {
+ const double px = p.x, py = p.y, pz = p.z;
+ const double value = xx * px * px + yy * py * py + zz * pz * pz
+ +2.0 * (xy * px * py + xz * px * pz + yz * py * pz)
+ +2.0 * (x * px + y * py + z * pz) + c;
+ return std::max(value,0.0);
+ }
+};
+
+// Mean squared distance of `position` to the planes of both quadrics
+double CollapseCost(const Quadric& from, const Quadric& to, const glm::vec3& position)
+{
+ const double weight = from.weight + to.weight;
+ return weight >0.0 ? (from.Evaluate(position) + to.Evaluate(position)) / weight :0.0;
+}
+
+glm::vec3 TriangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+ return glm::cross(b - a, c - a);
+}
+
+// Vertex of the first vertex with the same position, for every vertex
+std::vector<uint32_t> GroupByPosition(std::span<const Vertex> vertices)
+{
+ const size_t vertexCount = vertices.size();
+ const size_t capacity = std::bit_ceil(std::max<size_t>(vertexCount *2,16));
+ std::vector<uint32_t> slots(capacity, kInvalid);
+ std::vector<uint32_t> groups(vertexCount);
+ for (size_t v =0; v < vertexCount; ++v) {
+ glm::vec3 key = vertices[v].position;
+ for (int axis =0; axis <3; ++axis) {
+ if (key[axis] ==0.0f) {
+ key[axis] =0.0f; // -0.0 and +0.0 hash alike
+ }
+ }
+ size_t slot = HashBytes(&key, sizeof(key)) & (capacity -1);
+ while (slots[slot] != kInvalid && vertices[slots[slot]].position != key) {
+ slot = (slot +1) & (capacity -1);
+ }
+ if (slots[slot] == kInvalid) {
+ slots[slot] = static_cast<uint32_t>(v);
+ }
+ groups[v] = slots[slot];
+ }
+ return groups;
+}
+
+struct Collapse {
+ uint32_t from =0;   // position group that goes away
+ uint32_t to =0;     // vertex it is replaced with
+ float cost =0.0f;
+};
+
+} // namespace
+
+std::vector<std::uint32_t> SimplifyMesh(std::span<const Vertex> vertices, std::span<const std::uint32_t> indices,
+ size_t targetIndexCount, float* resultError)
+{
+ std::vector<uint32_t> result(indices.begin(), indices.end());
+ double maxCost =0.0;
+ const size_t vertexCount = vertices.size();
+ const size_t targetTriangles = targetIndexCount /3;
+ if (result.size() /3 <= targetTriangles || vertexCount ==0) {
+ if (resultError) {
+ *resultError =0.0f;
+ }
+ return result;
+ }
+
+ // Vertices sharing a position move together, so topology and error are
+ // tracked per position group
+ const std::vector<uint32_t> groups = GroupByPosition(vertices);
+ std::vector<uint32_t> referencing(vertexCount,0); // referenced vertices per group
+ {
+ std::vector<uint8_t> referenced(vertexCount,0);
+ for (uint32_t index : result) {
+ if (!referenced[index]) {
+ referenced[index] =1;
+ ++referencing[groups[index]];
+ }
+ }
+ }
+ std::vector<uint8_t> locked(vertexCount,0);
+ for (size_t g =0; g < vertexCount; ++g) {
+ locked[g] = referencing[g] >1;
+ }
+
+ // An edge without its reverse lies on an open border
+ std::vector<uint64_t> edges;
+ edges.reserve(result.size());
+ const auto edgeKey = [](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(a) <<32) | b; };
+ for (size_t i =0; i < result.size(); i +=3) {
+ for (int k =0; k <3; ++k) {
+ edges.push_back(edgeKey(groups[result[i + k]], groups[result[i + (k +1) %3]]));
+ }
+ }
+ std::sort(edges.begin(), edges.end());
+ for (uint64_t edge : edges) {
+ const uint32_t a = static_cast<uint32_t>(edge >>32);
+ const uint32_t b = static_cast<uint32_t>(edge);
+ if (!std::binary_search(edges.begin(), edges.end(), edgeKey(b, a))) {
+ locked[a] =1;
+ locked[b] =1;
+ }
+ }
+ edges = {};
+
+ std::vector<Quadric> quadrics(vertexCount);
+ for (size_t i =0; i < result.size(); i +=3) {
+ const glm::vec3& p0 = vertices[result[i]].position;
+ const glm::vec3 normal = TriangleNormal(p0, vertices[result[i +1]].position, vertices[result[i +2]].position);
+ const double length = glm::length(normal);
+ if (length <=0.0) {
+ continue;
+ }
+ const double nx = normal.x / length, ny = normal.y / length, nz = normal.z / length;
+ const double d = -(nx * p0.x + ny * p0.y + nz * p0.z);
+ for (int k =0; k <3; ++k) {
+ quadrics[groups[result[i + k]]].AddPlane(nx, ny, nz, d, length *0.5);
+ }
+ }
+
+ std::vector<uint32_t> triangleStarts(vertexCount +1);
+ std::vector<uint32_t> groupTriangles;
+ std::vector<Collapse> collapses;
+ std::vector<uint32_t> collapseTo(vertexCount, kInvalid);
+ std::vector<uint8_t> touched(vertexCount,0);
+ std::vector<uint32_t> ring;
+ std::vector<uint32_t> common;
+
+ // Passes of independent collapses, cheapest first; a collapse reserves the
+ // neighbourhood it changes until the next pass rebuilds the adjacency
+ while (result.size() /3 > targetTriangles) {
+ const uint32_t triangleCount = static_cast<uint32_t>(result.size() /3);
+ std::fill(triangleStarts.begin(), triangleStarts.end(),0);
+ for (uint32_t index : result) {
+ ++triangleStarts[groups[index] +1];
+ }
+ for (size_t g =0; g < vertexCount; ++g) {
+ triangleStarts[g +1] += triangleStarts[g];
+ }
+ groupTriangles.resize(result.size());
+ {
+ std::vector<uint32_t> next(triangleStarts.begin(), triangleStarts.end() -1);
+ for (uint32_t t =0; t < triangleCount; ++t) {
+ for (int k =0; k <3; ++k) {
+ groupTriangles[next[groups[result[t *3 + k]]]++] = t;
+ }
+ }
+ }
+ const auto trianglesOf = [&](uint32_t group) {
+ return std::span<const uint32_t>(groupTriangles.data() + triangleStarts[group], triangleStarts[group +1] - triangleStarts[group]);
+ };
+
+ // Each interior edge once, from the triangle where it runs low to high
+ collapses.clear();
+ for (uint32_t t =0; t < triangleCount; ++t) {
+ for (int k =0; k <3; ++k) {
+ const uint32_t a = result[t *3 + k];
+ const uint32_t b = result[t *3 + (k +1) %3];
+ const uint32_t ga = groups[a];
+ const uint32_t gb = groups[b];
+ if (ga >= gb) {
+ continue;
+ }
+ if (!locked[ga]) {
+ collapses.push_back({ ga, b, static_cast<float>(CollapseCost(quadrics[ga], quadrics[gb], vertices[b].position)) });
+ }
+ if (!locked[gb]) {
+ collapses.push_back({ gb, a, static_cast<float>(CollapseCost(quadrics[gb], quadrics[ga], vertices[a].position)) });
+ }
+ }
+ }
+ std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+ std::fill(touched.begin(), touched.end(),0);
+ uint32_t removed =0;
+ uint32_t applied =0;
+ for (const Collapse& collapse : collapses) {
+ const uint32_t from = collapse.from;
+ const uint32_t to = groups[collapse.to];
+ if (touched[from] || touched[to]) {
+ continue;
+ }
+
+ // Link condition: on a manifold surface the edge has two triangles and
+ // its ends share exactly their two third vertices
+ ring.clear();
+ uint32_t shared =0;
+ for (uint32_t t : trianglesOf(from)) {
+ bool hasTo = false;
+ for (int k =0; k <3; ++k) {
+ const uint32_t g = groups[result[t *3 + k]];
+ hasTo |= g == to;
+ if (g != from && g != to && std::find(ring.begin(), ring.end(), g) == ring.end()) {
+ ring.push_back(g);
+ }
+ }
+ shared += hasTo;
+ }
+ if (shared !=2) {
+ continue;
+ }
+ common.clear();
+ for (uint32_t t : trianglesOf(to)) {
+ for (int k =0; k <3; ++k) {
+ const uint32_t g = groups[result[t *3 + k]];
+ if (g != from && g != to && std::find(ring.begin(), ring.end(), g) != ring.end()
+ && std::find(common.begin(), common.end(), g) == common.end()) {
+ common.push_back(g);
+ }
+ }
+ }
+ if (common.size() !=2) {
+ continue;
+ }
+
+ // The triangles that stay must not fold over
+ bool flips = false;
+ const glm::vec3& target = vertices[collapse.to].position;
+ for (uint32_t t : trianglesOf(from)) {
+ glm::vec3 before[3];
+ glm::vec3 after[3];
+ bool hasTo = false;
+ for (int k =0; k <3; ++k) {
+ const uint32_t index = result[t *3 + k];
+ hasTo |= groups[index] == to;
+ before[k] = vertices[index].position;
+ after[k] = groups[index] == from ? target : before[k];
+ }
+ if (hasTo) {
+ continue;
+ }
+ const glm::vec3 oldNormal = TriangleNormal(before[0], before[1], before[2]);
+ const glm::vec3 newNormal = TriangleNormal(after[0], after[1], after[2]);
+ if (glm::dot(oldNormal, newNormal) <=0.25f * glm::length(oldNormal) * glm::length(newNormal)) {
+ flips = true;
+ break;
+ }
+ }
+ if (flips) {
+ continue;
+ }
+
+ collapseTo[from] = collapse.to;
+ quadrics[to].Add(quadrics[from]);
+ maxCost = std::max(maxCost, static_cast<double>(collapse.cost));
+ touched[from] =1;
+ touched[to] =1;
+ for (uint32_t g : ring) {
+ touched[g] =1;
+ }
+ removed +=2;
+ ++applied;
+ if (triangleCount - removed <= targetTriangles) {
+ break;
+ }
+ }
+ if (applied ==0) {
+ break;
+ }
+
+ // `from` groups have a single vertex, so the group is the vertex
+ size_t write =0;
+ for (size_t i =0; i < result.size(); i +=3) {
+ uint32_t triangle[3];
+ for (int k =0; k <3; ++k) {
+ const uint32_t index = result[i + k];
+ triangle[k] = collapseTo[groups[index]] != kInvalid ? collapseTo[groups[index]] : index;
+ }
+ const uint32_t g0 = groups[triangle[0]], g1 = groups[triangle[1]], g2 = groups[triangle[2]];
+ if (g0 == g1 || g1 == g2 || g0 == g2) {
+ continue;
+ }
+ result[write++] = triangle[0];
+ result[write++] = triangle[1];
+ result[write++] = triangle[2];
+ }
+ result.resize(write);
+ for (const Collapse& collapse : collapses) {
+ collapseTo[collapse.from] = kInvalid;
+ }
+ }
+
+ if (resultError) {
+ *resultError = static_cast<float>(std::sqrt(maxCost));
+ }
+ return result;
+}
+
+void GenerateLods(MeshData& mesh, const LodOptions& options)
+{
+ mesh.lods.clear();
+ if (mesh.indices.empty()) {
+ return;
+ }
+ mesh.lods.push_back({0, static_cast<uint32_t>(mesh.indices.size()),0.0f });
+
+ std::vector<uint32_t> previous = mesh.indices;
+ float error =0.0f;
+ for (uint32_t level =0; level < options.levels; ++level) {
+ const size_t triangles = previous.size() /3;
+ const size_t target = std::max<size_t>(options.minTriangles, static_cast<size_t>(triangles * options.reduction));
+ if (target >= triangles) {
+ break;
+ }
+ float levelError =0.0f;
+ std::vector<uint32_t> lod = SimplifyMesh(mesh.vertices, previous, target *3, &levelError);
+ if (lod.size() /3 > triangles - triangles /10) {
+ break;
+ }
+ OptimizeVertexCache(lod, mesh.vertices.size());
+ error += levelError;
+ mesh.lods.push_back({ static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(lod.size()), error });
+ mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+ previous = std::move(lod);
+ }
+}
+
+uint32_t SelectLod(std::span<const MeshLod> lods, float distance, float pixelsPerUnit, float maxErrorPixels)
+{
+ if (lods.empty() || distance <=0.0f) {
+ return 0;
+ }
+ // Errors only grow along the chain
+ const float maxError = maxErrorPixels * distance / pixelsPerUnit;
+ uint32_t selected =0;
+ while (selected +1 < lods.size() && lods[selected +1].error <= maxError) {
+ ++selected;
+ }
+ return selected;
+}
+
+} // namespace veng
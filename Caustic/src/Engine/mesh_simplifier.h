@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "mesh_importer.h"
+
+namespace veng {
+
+// Quadric error metric simplification (Garland and Heckbert) by half-edge
+// collapses: a vertex merges into a neighbour, so the result indexes the
+// original vertex array and can share its vertex buffer. Vertices on
+// attribute seams (one position, several vertices) and on open borders
+// never move, which keeps texture coordinates and silhouettes intact.
+// Stops at `targetIndexCount` or when no collapse is left. `resultError` is
+// the largest distance, in mesh units, between a removed vertex and the
+// surface that replaced it (RMS over the planes it was on).
+std::vector<std::uint32_t> SimplifyMesh(std::span<const Vertex> vertices, std::span<const std::uint32_t> indices,
+ size_t targetIndexCount, float* resultError = nullptr);
+
+struct LodOptions {
+ uint32_t levels =4;          // besides the base mesh
+ float reduction =0.5f;       // each level keeps this fraction of the previous one's triangles
+ uint32_t minTriangles =64;   // no level goes below this
+};
+
+// Simplifies each level from the one before and appends its indices after
+// mesh.indices, in vertex cache order. mesh.lods[0] is the base mesh; levels
+// that would remove less than a tenth of the previous one's triangles are
+// dropped, so there may be fewer than asked for. Errors add up along the
+// chain, so a level's error bounds its distance from the base mesh.
+void GenerateLods(MeshData& mesh, const LodOptions& options = {});
+
+// Coarsest level whose error, seen from `distance` and scaled by
+// `pixelsPerUnit` (pixels covered by one unit at distance 1), stays at or
+// below `maxErrorPixels`. 0 when `lods` is empty.
+uint32_t SelectLod(std::span<const MeshLod> lods, float distance, float pixelsPerUnit, float maxErrorPixels);
+
+} // namespace veng
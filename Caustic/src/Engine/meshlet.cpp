@@ -0,0 +1,233 @@
+#include "meshlet.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace veng {
+
+namespace {
+
+constexpr uint32_t kInvalid = std::numeric_limits<uint32_t>::max();
+
+// Cost of a candidate triangle: its new vertices, plus this much times
+// (1 - cosine) of its normal against the meshlet's average normal
+constexpr float kConeWeight =0.25f;
+
+// Below this cosine between a face normal and the cone axis the cone would
+// hardly ever cull, so it is disabled
+constexpr float kMinConeCosine =0.1f;
+
+glm::vec3 FaceNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+ const glm::vec3 normal = glm::cross(b - a, c - a);
+ const float length = glm::length(normal);
+ return length >0.0f ? normal / length : glm::vec3(0.0f);
+}
+
+// Ritter's sphere, then the radius widened to the farthest point from its
+// center so rounding never leaves a point outside
+void BoundingSphere(std::span<const glm::vec3> points, glm::vec3& center, float& radius)
+{
+ auto farthest = [&](const glm::vec3& from) {
+ size_t best =0;
+ float bestDistance = -1.0f;
+ for (size_t i =0; i < points.size(); ++i) {
+ const glm::vec3 offset = points[i] - from;
+ const float distance = glm::dot(offset, offset);
+ if (distance > bestDistance) {
+ bestDistance = distance;
+ best = i;
+ }
+ }
+ return points[best];
+ };
+ const glm::vec3 a = farthest(points[0]);
+ const glm::vec3 b = farthest(a);
+ center = (a + b) *0.5f;
+ radius = glm::length(b - a) *0.5f;
+ for (const glm::vec3& point : points) {
+ const float distance = glm::length(point - center);
+ if (distance > radius) {
+ const float grown = (radius + distance) *0.5f;
+ center += (point - center) * ((grown - radius) / distance);
+ radius = grown;
+ }
+ }
+ radius =0.0f;
+ for (const glm::vec3& point : points) {
+ radius = std::max(radius, glm::length(point - center));
+ }
+}
+
+} // namespace
+
+ClusterBounds ComputeClusterBounds(std::span<const Vertex> vertices, std::span<const std::uint32_t> indices)
+{
+ ClusterBounds bounds;
+ if (indices.empty()) {
+ return bounds;
+ }
+
+ std::vector<glm::vec3> points;
+ points.reserve(indices.size());
+ for (std::uint32_t index : indices) {
+ points.push_back(vertices[index].position);
+ }
+ BoundingSphere(points, bounds.center, bounds.radius);
+
+ std::vector<glm::vec3> normals;
+ normals.reserve(indices.size() /3);
+ glm::vec3 axis(0.0f);
+ for (size_t i =0; i +2 < indices.size(); i +=3) {
+ const glm::vec3 normal = FaceNormal(points[i], points[i +1], points[i +2]);
+ if (normal != glm::vec3(0.0f)) {
+ normals.push_back(normal);
+ axis += normal;
+ }
+ }
+ const float axisLength = glm::length(axis);
+ if (axisLength <=0.0f) {
+ return bounds;
+ }
+ axis /= axisLength;
+ float minCosine =1.0f;
+ for (const glm::vec3& normal : normals) {
+ minCosine = std::min(minCosine, glm::dot(normal, axis));
+ }
+ bounds.coneAxis = axis;
+ if (minCosine > kMinConeCosine) {
+ bounds.coneCutoff = std::sqrt(1.0f - minCosine * minCosine);
+ }
+ return bounds;
+}
+
+MeshletMesh BuildMeshlets(std::span<const Vertex> vertices, std::span<const std::uint32_t> indices, const MeshletOptions& options)
+{
+ if (options.maxVertices <3 || options.maxTriangles <1) {
+ throw std::runtime_error("Meshlets must hold at least one triangle");
+ }
+ const size_t vertexCount = vertices.size();
+ const size_t triangleCount = indices.size() /3;
+ for (size_t i =0; i < triangleCount *3; ++i) {
+ if (indices[i] >= vertexCount) {
+ throw std::runtime_error("Meshlet input index out of range");
+ }
+ }
+
+ std::vector<glm::vec3> normals(triangleCount);
+ for (size_t t =0; t < triangleCount; ++t) {
+ normals[t] = FaceNormal(vertices[indices[t *3]].position, vertices[indices[t *3 +1]].position, vertices[indices[t *3 +2]].position);
+ }
+
+ // Triangles around each vertex
+ std::vector<uint32_t> offsets(vertexCount +1,0);
+ for (size_t i =0; i < triangleCount *3; ++i) {
+ ++offsets[indices[i] +1];
+ }
+ for (size_t v =0; v < vertexCount; ++v) {
+ offsets[v +1] += offsets[v];
+ }
+ std::vector<uint32_t> adjacency(triangleCount *3);
+ {
+ std::vector<uint32_t> cursor(offsets.begin(), offsets.end() -1);
+ for (size_t i =0; i < triangleCount *3; ++i) {
+ adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i /3);
+ }
+ }
+
+ MeshletMesh result;
+ result.indices.reserve(triangleCount *3);
+ std::vector<uint8_t> emitted(triangleCount,0);
+ // Last meshlet that used the vertex / listed the triangle as a candidate
+ std::vector<uint32_t> vertexMeshlet(vertexCount, kInvalid);
+ std::vector<uint32_t> candidateMeshlet(triangleCount, kInvalid);
+ std::vector<uint32_t> candidates;
+ size_t emittedCount =0;
+ uint32_t scan =0;
+
+ Meshlet meshlet;
+ uint32_t id =0;
+ glm::vec3 normalSum(0.0f);
+ auto addTriangle = [&](uint32_t t) {
+ emitted[t] =1;
+ ++emittedCount;
+ for (int k =0; k <3; ++k) {
+ const uint32_t v = indices[t *3 + k];
+ result.indices.push_back(v);
+ if (vertexMeshlet[v] != id) {
+ vertexMeshlet[v] = id;
+ ++meshlet.vertexCount;
+ }
+ for (uint32_t a = offsets[v]; a < offsets[v +1]; ++a) {
+ const uint32_t neighbour = adjacency[a];
+ if (!emitted[neighbour] && candidateMeshlet[neighbour] != id) {
+ candidateMeshlet[neighbour] = id;
+ candidates.push_back(neighbour);
+ }
+ }
+ }
+ ++meshlet.triangleCount;
+ normalSum += normals[t];
+ };
+
+ while (emittedCount < triangleCount) {
+ id = static_cast<uint32_t>(result.meshlets.size());
+ meshlet = Meshlet{};
+ meshlet.firstIndex = static_cast<uint32_t>(result.indices.size());
+ normalSum = glm::vec3(0.0f);
+
+ // Continue next to the previous meshlet, else at the first triangle left
+ uint32_t seed = kInvalid;
+ for (uint32_t t : candidates) {
+ if (!emitted[t]) {
+ seed = t;
+ break;
+ }
+ }
+ if (seed == kInvalid) {
+ while (emitted[scan]) {
+ ++scan;
+ }
+ seed = scan;
+ }
+ candidates.clear();
+ addTriangle(seed);
+
+ while (meshlet.triangleCount < options.maxTriangles) {
+ const float sumLength = glm::length(normalSum);
+ const glm::vec3 direction = sumLength >0.0f ? normalSum / sumLength : glm::vec3(0.0f);
+ uint32_t best = kInvalid;
+ float bestCost = std::numeric_limits<float>::max();
+ size_t kept =0;
+ for (size_t c =0; c < candidates.size(); ++c) {
+ const uint32_t t = candidates[c];
+ if (emitted[t]) {
+ continue;
+ }
+ candidates[kept++] = t;
+ const uint32_t newVertices = (vertexMeshlet[indices[t *3]] != id) + (vertexMeshlet[indices[t *3 +1]] != id) + (vertexMeshlet[indices[t *3 +2]] != id);
+ if (meshlet.vertexCount + newVertices > options.maxVertices) {
+ continue;
+ }
+ const float cost = static_cast<float>(newVertices) + kConeWeight * (1.0f - glm::dot(normals[t], direction));
+ if (cost < bestCost) {
+ bestCost = cost;
+ best = t;
+ }
+ }
+ candidates.resize(kept);
+ if (best == kInvalid) {
+ break;
+ }
+ addTriangle(best);
+ }
+
+ meshlet.bounds = ComputeClusterBounds(vertices, std::span<const std::uint32_t>(result.indices).subspan(meshlet.firstIndex, meshlet.triangleCount *3));
+ result.cullingSet.Add(meshlet.bounds);
+ result.meshlets.push_back(meshlet);
+ }
+ return result;
+}
+
+} // namespace veng
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "culling.h"
+#include "mesh_importer.h"
+
+namespace veng {
+
+struct MeshletOptions {
+ uint32_t maxVertices =64;
+ uint32_t maxTriangles =124;
+};
+
+// A cluster of neighbouring triangles: `triangleCount` triangles at
+// `firstIndex` of MeshletMesh::indices, using `vertexCount` distinct vertices
+struct Meshlet {
+ uint32_t firstIndex =0;
+ uint32_t triangleCount =0;
+ uint32_t vertexCount =0;
+ ClusterBounds bounds;
+};
+
+// An index buffer split into meshlets. The indices are the input triangles
+// reordered so each meshlet's are contiguous, meshlets back to back; they
+// still index the original vertices, so the mesh keeps its vertex buffer.
+struct MeshletMesh {
+ std::vector<Meshlet> meshlets;
+ std::vector<std::uint32_t> indices;
+ ClusterCullingSet cullingSet; // bounds of meshlets[i] at index i
+};
+
+// Greedy clustering: a meshlet grows by the adjacent triangle that adds the
+// fewest new vertices, ties going to the one closest in orientation to the
+// meshlet's average normal, until a limit is reached or no neighbour fits.
+// The next meshlet starts from a triangle on the border of the last one.
+MeshletMesh BuildMeshlets(std::span<const Vertex> vertices, std::span<const std::uint32_t> indices, const MeshletOptions& options = {});
+
+// Sphere around the triangles' vertices and cone around their face normals
+// (counter-clockwise winding is the front). The cone is left disabled when
+// the normals spread over more than about 84 degrees from its axis.
+ClusterBounds ComputeClusterBounds(std::span<const Vertex> vertices, std::span<const std::uint32_t> indices);
+
+} // namespace veng
@@ -16,7 +16,9 @@
 // Walnut includes
 #include "Walnut/Application.h"
 #include "Walnut/Layer.h"
+#ifndef WL_HEADLESS
 #include "Walnut/Image.h"
+#endif
 
 // GSL-like replacements
 namespace gsl {
@@ -0,0 +1,97 @@
+#include "render_queue.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace veng {
+
+uint32_t sort_key::DepthBucket(float viewDepth)
+{
+ if (!(viewDepth >0.0f)) {
+ return 0;
+ }
+ uint32_t bits;
+ std::memcpy(&bits, &viewDepth, sizeof(bits));
+ // Sign is clear: 31 bits left, keep the top kDepthBits
+ return bits >> (31 - kDepthBits);
+}
+
+void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch)
+{
+ const size_t count = entries.size();
+ if (count <2) {
+ return;
+ }
+ scratch.resize(count);
+
+ // All eight histograms in one pass over the keys
+ std::array<std::array<uint32_t,256>,8> histograms{};
+ for (const SortEntry& entry : entries) {
+ for (uint32_t pass =0; pass <8; ++pass) {
+ ++histograms[pass][(entry.key >> (pass *8)) &0xff];
+ }
+ }
+
+ SortEntry* source = entries.data();
+ SortEntry* destination = scratch.data();
+ for (uint32_t pass =0; pass <8; ++pass) {
+ std::array<uint32_t,256>& histogram = histograms[pass];
+ if (histogram[(source[0].key >> (pass *8)) &0xff] == count) {
+ continue;
+ }
+ uint32_t offset =0;
+ for (uint32_t& bucket : histogram) {
+ const uint32_t size = bucket;
+ bucket = offset;
+ offset += size;
+ }
+ for (size_t i =0; i < count; ++i) {
+ destination[histogram[(source[i].key >> (pass *8)) &0xff]++] = source[i];
+ }
+ std::swap(source, destination);
+ }
+ if (source != entries.data()) {
+ std::copy(source, source + count, entries.data());
+ }
+}
+
+template <typename Handle>
+uint32_t RenderQueue::Intern(std::vector<Handle>& table, Handle handle)
+{
+ // A frame uses a handful of pipelines and descriptor sets
+ auto it = std::find(table.begin(), table.end(), handle);
+ if (it != table.end()) {
+ return static_cast<uint32_t>(it - table.begin());
+ }
+ table.push_back(handle);
+ return static_cast<uint32_t>(table.size() -1);
+}
+
+void RenderQueue::Submit(const QueuedDraw& draw, float viewDepth)
+{
+ const uint32_t pipeline = Intern(m_Pipelines, draw.pipeline);
+ const uint32_t material = Intern(m_Materials, draw.descriptorSet);
+ const uint32_t mesh = m_Meshes.try_emplace(draw.vertexBuffer, static_cast<uint32_t>(m_Meshes.size())).first->second;
+
+ m_Entries.push_back({ sort_key::Make(pipeline, material, sort_key::DepthBucket(viewDepth), mesh), static_cast<uint32_t>(m_Draws.size()) });
+ m_Draws.push_back(draw);
+ m_IndexCount += draw.indexCount;
+}
+
+std::span<const SortEntry> RenderQueue::Sort()
+{
+ RadixSort(m_Entries, m_Scratch);
+ return m_Entries;
+}
+
+void RenderQueue::Clear()
+{
+ m_Draws.clear();
+ m_Entries.clear();
+ m_IndexCount =0;
+ m_Pipelines.clear();
+ m_Materials.clear();
+ m_Meshes.clear();
+}
+
+} // namespace veng
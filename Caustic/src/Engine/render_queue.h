@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace veng {
+
+// 64-bit draw sort key, most expensive state change in the highest bits:
+//   63..56 pipeline | 55..40 material | 39..28 depth bucket | 27..0 mesh
+// Sorting by key groups draws by pipeline, then descriptor set, then roughly
+// front to back, and keeps draws of one mesh next to each other within a
+// bucket.
+namespace sort_key {
+
+constexpr uint32_t kPipelineBits =8;
+constexpr uint32_t kMaterialBits =16;
+constexpr uint32_t kDepthBits =12;
+constexpr uint32_t kMeshBits =28;
+static_assert(kPipelineBits + kMaterialBits + kDepthBits + kMeshBits ==64);
+
+constexpr uint64_t Make(uint32_t pipeline, uint32_t material, uint32_t depthBucket, uint32_t mesh)
+{
+ return (static_cast<uint64_t>(pipeline & ((1u << kPipelineBits) -1)) << (kMaterialBits + kDepthBits + kMeshBits))
+  | (static_cast<uint64_t>(material & ((1u << kMaterialBits) -1)) << (kDepthBits + kMeshBits))
+  | (static_cast<uint64_t>(depthBucket & ((1u << kDepthBits) -1)) << kMeshBits)
+  | (mesh & ((1u << kMeshBits) -1));
+}
+
+// Monotonic in view depth: the top bits of the float (exponent and 4 mantissa
+// bits), so buckets are about 4% of the distance wide at any range. Depths
+// behind the camera share bucket 0.
+uint32_t DepthBucket(float viewDepth);
+
+} // namespace sort_key
+
+struct SortEntry {
+ uint64_t key =0;
+ uint32_t index =0;
+};
+
+// Stable LSD radix sort by key, 8 bits per pass. Passes whose byte is the same
+// for every key are skipped. `scratch` is resized to entries.size().
+void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch);
+
+// A draw recorded by WalnutGraphics::RenderIndexedBuffer, kept until the queue
+// is flushed at the end of the frame
+struct QueuedDraw {
+ VkPipeline pipeline = VK_NULL_HANDLE;
+ VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+ VkBuffer vertexBuffer = VK_NULL_HANDLE;
+ VkBuffer indexBuffer = VK_NULL_HANDLE;
+ uint32_t indexCount =0;
+ uint32_t firstIndex =0;
+ glm::mat4 model{1.0f};
+};
+
+// Deferred draws of one frame. Pipelines, descriptor sets and vertex buffers
+// get small per-frame ids in submission order for the sort key.
+class RenderQueue {
+public:
+ void Submit(const QueuedDraw& draw, float viewDepth);
+
+ // Draw indices in key order; valid until the next Submit or Clear
+ std::span<const SortEntry> Sort();
+ const QueuedDraw& GetDraw(uint32_t index) const { return m_Draws[index]; }
+
+ bool IsEmpty() const { return m_Draws.empty(); }
+ uint32_t GetDrawCount() const { return static_cast<uint32_t>(m_Draws.size()); }
+ uint64_t GetIndexCount() const { return m_IndexCount; }
+ void Clear();
+
+private:
+ template <typename Handle>
+ static uint32_t Intern(std::vector<Handle>& table, Handle handle);
+
+ std::vector<QueuedDraw> m_Draws;
+ std::vector<SortEntry> m_Entries;
+ std::vector<SortEntry> m_Scratch;
+ uint64_t m_IndexCount =0;
+
+ std::vector<VkPipeline> m_Pipelines;
+ std::vector<VkDescriptorSet> m_Materials;
+ std::unordered_map<VkBuffer, uint32_t> m_Meshes;
+};
+
+} // namespace veng
@@ -0,0 +1,375 @@
+#include "scene_graph.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VENG_SCENE_SSE 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VENG_SCENE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace veng {
+
+namespace {
+
+// Columns of the local matrix's linear part: the rotation's columns times the
+// scale. The translation is the fourth column.
+void RotationScaleColumns(const glm::quat& q, const glm::vec3& s, float columns[3][4])
+{
+ const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+ const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+ const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+ const float linear[3][3] = {
+  { 1.0f -2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy) },
+  { 2.0f * (xy - wz), 1.0f -2.0f * (xx + zz), 2.0f * (yz + wx) },
+  { 2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f -2.0f * (xx + yy) },
+ };
+ for (int c =0; c <3; ++c) {
+ for (int r =0; r <3; ++r) {
+ columns[c][r] = linear[c][r] * s[c];
+ }
+ columns[c][3] =0.0f;
+ }
+}
+
+// world = parent * local, one column at a time. The vector and scalar paths
+// add the products in the same order without fused multiply-adds, so they
+// produce the same matrices.
+void ComposeWorld(const glm::mat4& parent, const glm::vec3& t, const glm::quat& q, const glm::vec3& s, glm::mat4& world)
+{
+ float local[3][4];
+ RotationScaleColumns(q, s, local);
+#if VENG_SCENE_SSE
+ const __m128 p0 = _mm_loadu_ps(&parent[0][0]);
+ const __m128 p1 = _mm_loadu_ps(&parent[1][0]);
+ const __m128 p2 = _mm_loadu_ps(&parent[2][0]);
+ const __m128 p3 = _mm_loadu_ps(&parent[3][0]);
+ auto transform = [&](float x, float y, float z) {
+ return _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(x)), _mm_mul_ps(p1, _mm_set1_ps(y))), _mm_mul_ps(p2, _mm_set1_ps(z)));
+ };
+ for (int c =0; c <3; ++c) {
+ _mm_storeu_ps(&world[c][0], transform(local[c][0], local[c][1], local[c][2]));
+ }
+ _mm_storeu_ps(&world[3][0], _mm_add_ps(transform(t.x, t.y, t.z), p3));
+#elif VENG_SCENE_NEON
+ const float32x4_t p0 = vld1q_f32(&parent[0][0]);
+ const float32x4_t p1 = vld1q_f32(&parent[1][0]);
+ const float32x4_t p2 = vld1q_f32(&parent[2][0]);
+ const float32x4_t p3 = vld1q_f32(&parent[3][0]);
+ auto transform = [&](float x, float y, float z) {
+ return vaddq_f32(vaddq_f32(vmulq_n_f32(p0, x), vmulq_n_f32(p1, y)), vmulq_n_f32(p2, z));
+ };
+ for (int c =0; c <3; ++c) {
+ vst1q_f32(&world[c][0], transform(local[c][0], local[c][1], local[c][2]));
+ }
+ vst1q_f32(&world[3][0], vaddq_f32(transform(t.x, t.y, t.z), p3));
+#else
+ auto transform = [&](float x, float y, float z) {
+ return (parent[0] * x + parent[1] * y) + parent[2] * z;
+ };
+ for (int c =0; c <3; ++c) {
+ world[c] = transform(local[c][0], local[c][1], local[c][2]);
+ }
+ world[3] = transform(t.x, t.y, t.z) + parent[3];
+#endif
+}
+
+void ComposeRoot(const glm::vec3& t, const glm::quat& q, const glm::vec3& s, glm::mat4& world)
+{
+ float local[3][4];
+ RotationScaleColumns(q, s, local);
+ for (int c =0; c <3; ++c) {
+ world[c] = glm::vec4(local[c][0], local[c][1], local[c][2],0.0f);
+ }
+ world[3] = glm::vec4(t,1.0f);
+}
+
+// Moves every element to its new slot
+template <typename T>
+void Permute(std::vector<T>& values, const std::vector<uint32_t>& newSlots)
+{
+ std::vector<T> permuted(values.size());
+ for (size_t i =0; i < values.size(); ++i) {
+ permuted[newSlots[i]] = values[i];
+ }
+ values.swap(permuted);
+}
+
+} // namespace
+
+NodeHandle SceneGraph::AddNode(const Transform& local, NodeHandle parent)
+{
+ uint32_t parentSlot = kNoParent;
+ uint32_t depth =0;
+ if (parent.IsValid()) {
+ if (parent.index >= m_Slots.size() || m_Slots[parent.index] == UINT32_MAX) {
+ throw std::runtime_error("Scene graph parent node does not exist");
+ }
+ parentSlot = m_Slots[parent.index];
+ depth = m_Depths[parentSlot] +1;
+ }
+
+ NodeHandle node;
+ if (!m_FreeHandles.empty()) {
+ node.index = m_FreeHandles.back();
+ m_FreeHandles.pop_back();
+ } else {
+ node.index = static_cast<uint32_t>(m_Slots.size());
+ m_Slots.push_back(UINT32_MAX);
+ }
+
+ // Appending keeps parents before children; the depth order only breaks when
+ // the new node is shallower than the last one
+ const uint32_t slot = GetNodeCount();
+ if (slot >0 && depth < m_Depths.back()) {
+ m_LayoutDirty = true;
+ }
+ m_Slots[node.index] = slot;
+ m_Translations.push_back(local.translation);
+ m_Rotations.push_back(local.rotation);
+ m_Scales.push_back(local.scale);
+ m_Parents.push_back(parentSlot);
+ m_Depths.push_back(depth);
+ m_Dirty.push_back(1);
+ m_World.push_back(glm::mat4(1.0f));
+ m_Nodes.push_back(node);
+
+ ++m_DirtyCount;
+ m_MinDirtyDepth = std::min(m_MinDirtyDepth, depth);
+ if (m_LevelStarts.size() < depth +2) {
+ m_LayoutDirty = true;
+ } else {
+ // Still sorted: the new node ends the last level
+ m_LevelStarts.back() = slot +1;
+ }
+ return node;
+}
+
+void SceneGraph::RemoveNode(NodeHandle node)
+{
+ if (!node.IsValid() || node.index >= m_Slots.size() || m_Slots[node.index] == UINT32_MAX) {
+ return;
+ }
+
+ // Children come after their parents, so one pass finds the whole subtree
+ const uint32_t first = m_Slots[node.index];
+ const uint32_t count = GetNodeCount();
+ std::vector<uint8_t> removed(count,0);
+ removed[first] =1;
+ for (uint32_t slot = first +1; slot < count; ++slot) {
+ const uint32_t parent = m_Parents[slot];
+ removed[slot] = parent != kNoParent && parent >= first && removed[parent];
+ }
+
+ // Compact in place; the survivors keep their order, so it stays sorted
+ std::vector<uint32_t> newSlots(count, UINT32_MAX);
+ uint32_t kept = first;
+ m_DirtyCount =0;
+ for (uint32_t slot =0; slot < count; ++slot) {
+ if (removed[slot]) {
+ m_Slots[m_Nodes[slot].index] = UINT32_MAX;
+ m_FreeHandles.push_back(m_Nodes[slot].index);
+ continue;
+ }
+ newSlots[slot] = slot < first ? slot : kept;
+ if (slot > first) {
+ const uint32_t target = kept++;
+ m_Translations[target] = m_Translations[slot];
+ m_Rotations[target] = m_Rotations[slot];
+ m_Scales[target] = m_Scales[slot];
+ m_Parents[target] = m_Parents[slot];
+ m_Depths[target] = m_Depths[slot];
+ m_Dirty[target] = m_Dirty[slot];
+ m_World[target] = m_World[slot];
+ m_Nodes[target] = m_Nodes[slot];
+ m_Slots[m_Nodes[target].index] = target;
+ }
+ }
+ for (uint32_t slot = first; slot < kept; ++slot) {
+ if (m_Parents[slot] != kNoParent) {
+ m_Parents[slot] = newSlots[m_Parents[slot]];
+ }
+ }
+ for (uint32_t slot =0; slot < kept; ++slot) {
+ m_DirtyCount += m_Dirty[slot];
+ }
+
+ m_Translations.resize(kept);
+ m_Rotations.resize(kept);
+ m_Scales.resize(kept);
+ m_Parents.resize(kept);
+ m_Depths.resize(kept);
+ m_Dirty.resize(kept);
+ m_World.resize(kept);
+ m_Nodes.resize(kept);
+ m_LayoutDirty = true;
+}
+
+void SceneGraph::Reserve(uint32_t count)
+{
+ m_Translations.reserve(count);
+ m_Rotations.reserve(count);
+ m_Scales.reserve(count);
+ m_Parents.reserve(count);
+ m_Depths.reserve(count);
+ m_Dirty.reserve(count);
+ m_World.reserve(count);
+ m_Nodes.reserve(count);
+ m_Slots.reserve(count);
+}
+
+void SceneGraph::Clear()
+{
+ m_Translations.clear();
+ m_Rotations.clear();
+ m_Scales.clear();
+ m_Parents.clear();
+ m_Depths.clear();
+ m_Dirty.clear();
+ m_World.clear();
+ m_Nodes.clear();
+ m_Slots.clear();
+ m_FreeHandles.clear();
+ m_LevelStarts.clear();
+ m_LayoutDirty = false;
+ m_DirtyCount =0;
+ m_MinDirtyDepth = UINT32_MAX;
+}
+
+void SceneGraph::SetLocal(NodeHandle node, const Transform& local)
+{
+ if (!node.IsValid() || node.index >= m_Slots.size() || m_Slots[node.index] == UINT32_MAX) {
+ return;
+ }
+ const uint32_t slot = m_Slots[node.index];
+ m_Translations[slot] = local.translation;
+ m_Rotations[slot] = local.rotation;
+ m_Scales[slot] = local.scale;
+ if (!m_Dirty[slot]) {
+ m_Dirty[slot] =1;
+ ++m_DirtyCount;
+ m_MinDirtyDepth = std::min(m_MinDirtyDepth, m_Depths[slot]);
+ }
+}
+
+Transform SceneGraph::GetLocal(NodeHandle node) const
+{
+ const uint32_t slot = m_Slots[node.index];
+ return { m_Translations[slot], m_Rotations[slot], m_Scales[slot] };
+}
+
+NodeHandle SceneGraph::GetParent(NodeHandle node) const
+{
+ const uint32_t parent = m_Parents[m_Slots[node.index]];
+ return parent == kNoParent ? NodeHandle{} : m_Nodes[parent];
+}
+
+// Stable counting sort of the slots by depth
+void SceneGraph::SortByDepth()
+{
+ const uint32_t count = GetNodeCount();
+ const uint32_t levels = count ==0 ?0 : *std::max_element(m_Depths.begin(), m_Depths.end()) +1;
+ m_LevelStarts.assign(levels +1,0);
+ for (uint32_t depth : m_Depths) {
+ ++m_LevelStarts[depth +1];
+ }
+ for (uint32_t level =0; level < levels; ++level) {
+ m_LevelStarts[level +1] += m_LevelStarts[level];
+ }
+ if (std::is_sorted(m_Depths.begin(), m_Depths.end())) {
+ return;
+ }
+
+ std::vector<uint32_t> newSlots(count);
+ std::vector<uint32_t> next(m_LevelStarts.begin(), m_LevelStarts.end() -1);
+ for (uint32_t slot =0; slot < count; ++slot) {
+ newSlots[slot] = next[m_Depths[slot]]++;
+ }
+ for (uint32_t& parent : m_Parents) {
+ if (parent != kNoParent) {
+ parent = newSlots[parent];
+ }
+ }
+ Permute(m_Translations, newSlots);
+ Permute(m_Rotations, newSlots);
+ Permute(m_Scales, newSlots);
+ Permute(m_Parents, newSlots);
+ Permute(m_Depths, newSlots);
+ Permute(m_Dirty, newSlots);
+ Permute(m_World, newSlots);
+ Permute(m_Nodes, newSlots);
+ for (uint32_t slot =0; slot < count; ++slot) {
+ m_Slots[m_Nodes[slot].index] = slot;
+ }
+}
+
+// One slice of a level: a node is dirty when it was set or its parent was
+// recomputed on the level before
+void SceneGraph::UpdateRange(uint32_t begin, uint32_t end)
+{
+ for (uint32_t slot = begin; slot < end; ++slot) {
+ const uint32_t parent = m_Parents[slot];
+ if (parent == kNoParent) {
+ if (m_Dirty[slot]) {
+ ComposeRoot(m_Translations[slot], m_Rotations[slot], m_Scales[slot], m_World[slot]);
+ }
+ continue;
+ }
+ if (m_Dirty[slot] || m_Dirty[parent]) {
+ m_Dirty[slot] =1;
+ ComposeWorld(m_World[parent], m_Translations[slot], m_Rotations[slot], m_Scales[slot], m_World[slot]);
+ }
+ }
+}
+
+const SceneUpdateStats& SceneGraph::Update(uint32_t maxThreads)
+{
+ const auto start = std::chrono::steady_clock::now();
+ m_Stats = {};
+ m_Stats.nodes = GetNodeCount();
+ if (m_LayoutDirty) {
+ SortByDepth();
+ m_LayoutDirty = false;
+ m_Stats.relayout = true;
+ }
+
+ if (m_DirtyCount >0) {
+ ThreadPool& pool = ThreadPool::Shared();
+ const uint32_t levels = static_cast<uint32_t>(m_LevelStarts.size()) -1;
+ const uint32_t firstSlot = m_LevelStarts[m_MinDirtyDepth];
+ for (uint32_t level = m_MinDirtyDepth; level < levels; ++level) {
+ const uint32_t begin = m_LevelStarts[level];
+ const uint32_t end = m_LevelStarts[level +1];
+ const uint32_t tasks = (end - begin) / kMinNodesPerTask;
+ if (tasks <2 || maxThreads ==1 || pool.GetThreadCount() ==1) {
+ UpdateRange(begin, end);
+ m_Stats.threads = std::max(m_Stats.threads,1u);
+ } else {
+ const uint32_t taskSize = (end - begin + tasks -1) / tasks;
+ pool.ParallelFor(tasks, [&](uint32_t task) {
+ UpdateRange(begin + task * taskSize, std::min(end, begin + (task +1) * taskSize));
+ }, maxThreads);
+ const uint32_t threads = std::min(tasks, maxThreads ==0 ? pool.GetThreadCount() : std::min(maxThreads, pool.GetThreadCount()));
+ m_Stats.threads = std::max(m_Stats.threads, threads);
+ }
+ ++m_Stats.levels;
+ }
+ // Every dirty flag below the first dirty level was raised by this update
+ for (uint32_t slot = firstSlot; slot < m_Stats.nodes; ++slot) {
+ m_Stats.updated += m_Dirty[slot];
+ }
+ std::memset(m_Dirty.data() + firstSlot,0, m_Stats.nodes - firstSlot);
+ m_DirtyCount =0;
+ m_MinDirtyDepth = UINT32_MAX;
+ }
+
+ m_Stats.ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+ return m_Stats;
+}
+
+} // namespace veng
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace veng {
+
+// A node of a SceneGraph. Handles of removed nodes are recycled, so they must
+// not be used after SceneGraph::RemoveNode.
+struct NodeHandle {
+ uint32_t index = UINT32_MAX;
+
+ bool IsValid() const { return index != UINT32_MAX; }
+};
+
+// Local transform relative to the parent: scale, then rotate, then translate.
+// `rotation` is expected to be a unit quaternion.
+struct Transform {
+ glm::vec3 translation{0.0f};
+ glm::quat rotation{1.0f,0.0f,0.0f,0.0f};
+ glm::vec3 scale{1.0f};
+};
+
+struct SceneUpdateStats {
+ uint32_t nodes =0;
+ uint32_t updated =0;      // world matrices recomputed
+ uint32_t levels =0;       // depth levels visited
+ uint32_t threads =0;      // most threads used on one level
+ bool relayout = false;    // nodes were added or removed since the last update
+ float ms =0.0f;
+};
+
+// Transform hierarchy flattened into arrays: local translation, rotation and
+// scale, parent and world matrix, one entry per node. Update keeps the arrays
+// sorted by depth, so a level only reads world matrices of the level before
+// it and its nodes can be split across threads; parents always come before
+// their children. SetLocal marks a node dirty and Update recomputes exactly
+// the dirty nodes and everything below them.
+class SceneGraph {
+public:
+ // Smallest slice of a level handed to one thread
+ static constexpr uint32_t kMinNodesPerTask =8192;
+
+ // `parent` invalid adds a root
+ NodeHandle AddNode(const Transform& local, NodeHandle parent = {});
+ // Removes the node and all of its descendants
+ void RemoveNode(NodeHandle node);
+ void Reserve(uint32_t count);
+ void Clear();
+
+ void SetLocal(NodeHandle node, const Transform& local);
+ Transform GetLocal(NodeHandle node) const;
+ NodeHandle GetParent(NodeHandle node) const;
+ // As of the last Update
+ const glm::mat4& GetWorld(NodeHandle node) const { return m_World[m_Slots[node.index]]; }
+
+ uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_Nodes.size()); }
+ bool IsEmpty() const { return m_Nodes.empty(); }
+
+ // Recomputes the world matrix of every dirty node and its subtree, levels
+ // with at least 2 * kMinNodesPerTask nodes on ThreadPool::Shared() (at most
+ // maxThreads threads, 0: all). Must not be called from inside a ParallelFor
+ // on the shared pool.
+ const SceneUpdateStats& Update(uint32_t maxThreads =0);
+ const SceneUpdateStats& GetLastUpdateStats() const { return m_Stats; }
+
+ // World matrices in slot order, with the node of each slot; both are
+ // reordered by an Update that follows AddNode or RemoveNode
+ std::span<const glm::mat4> GetWorldMatrices() const { return m_World; }
+ std::span<const NodeHandle> GetSlotNodes() const { return m_Nodes; }
+
+private:
+ static constexpr uint32_t kNoParent = UINT32_MAX;
+
+ void SortByDepth();
+ void UpdateRange(uint32_t begin, uint32_t end);
+
+ // Indexed by slot
+ std::vector<glm::vec3> m_Translations;
+ std::vector<glm::quat> m_Rotations;
+ std::vector<glm::vec3> m_Scales;
+ std::vector<uint32_t> m_Parents;      // slot of the parent, kNoParent for roots
+ std::vector<uint32_t> m_Depths;
+ std::vector<uint8_t> m_Dirty;
+ std::vector<glm::mat4> m_World;
+ std::vector<NodeHandle> m_Nodes;
+
+ // Indexed by NodeHandle::index; UINT32_MAX for free handles
+ std::vector<uint32_t> m_Slots;
+ std::vector<uint32_t> m_FreeHandles;
+
+ // First slot of each depth, plus the end; valid while !m_LayoutDirty
+ std::vector<uint32_t> m_LevelStarts;
+ bool m_LayoutDirty = false;
+ uint32_t m_DirtyCount =0;
+ uint32_t m_MinDirtyDepth = UINT32_MAX;
+ SceneUpdateStats m_Stats;
+};
+
+} // namespace veng
@@ -1,6 +1,10 @@
 #include "texture.h"
 #include "WalnutGraphics.h"
 #include "utilities.h"
+// Walnut compiles stb_image into the GUI library only
+#ifdef WL_HEADLESS
+#define STB_IMAGE_IMPLEMENTATION
+#endif
 #include "../../vendor/stb_image/stb_image.h"
 #include <stdexcept>
 #include <iostream>
@@ -23,9 +27,7 @@ Texture::~Texture()
  if (m_Image != VK_NULL_HANDLE) {
  vkDestroyImage(m_Graphics->m_Device, m_Image, nullptr);
  }
- if (m_ImageMemory != VK_NULL_HANDLE) {
- vkFreeMemory(m_Graphics->m_Device, m_ImageMemory, nullptr);
- }
+ m_Graphics->m_Allocator->Free(m_ImageMemory);
 }
 
 void Texture::LoadFromFile(const std::string& filename)
@@ -69,13 +71,10 @@ void Texture::WriteDescriptor(VkDevice device, VkDescriptorSet dstSet, uint32_t
 
 void Texture::CreateImageAndUpload(const unsigned char* pixels, int width, int height, int channels)
 {
- // Create staging buffer and upload
+ // Copy the pixels into the shared staging ring; the upload is recorded into
+ // the open upload batch and submitted with the next frame
  VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height *4;
- BufferHandle staging = m_Graphics->CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
- void* data;
- vkMapMemory(m_Graphics->m_Device, staging.memory,0, imageSize,0, &data);
- memcpy(data, pixels, static_cast<size_t>(imageSize));
- vkUnmapMemory(m_Graphics->m_Device, staging.memory);
+ UploadContext::StagingSpan staging = m_Graphics->m_Uploads->Stage(pixels, imageSize);
 
  // Determine mip levels
  m_MipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) +1;
@@ -96,38 +95,29 @@ void Texture::CreateImageAndUpload(const unsigned char* pixels, int width, int h
  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
  if (vkCreateImage(m_Graphics->m_Device, &imageInfo, nullptr, &m_Image) != VK_SUCCESS) {
- // cleanup staging explicitly
- vkDestroyBuffer(m_Graphics->m_Device, staging.buffer, nullptr);
- vkFreeMemory(m_Graphics->m_Device, staging.memory, nullptr);
  throw std::runtime_error("Failed to create image");
  }
 
- VkMemoryRequirements memReq;
- vkGetImageMemoryRequirements(m_Graphics->m_Device, m_Image, &memReq);
- VkMemoryAllocateInfo alloc{};
- alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
- alloc.allocationSize = memReq.size;
- alloc.memoryTypeIndex = m_Graphics->FindMemoryType(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
- if (vkAllocateMemory(m_Graphics->m_Device, &alloc, nullptr, &m_ImageMemory) != VK_SUCCESS) {
- // cleanup staging explicitly
- vkDestroyBuffer(m_Graphics->m_Device, staging.buffer, nullptr);
- vkFreeMemory(m_Graphics->m_Device, staging.memory, nullptr);
+ try {
+ m_ImageMemory = m_Graphics->m_Allocator->AllocateForImage(m_Image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+ } catch (...) {
  throw std::runtime_error("Failed to allocate image memory");
  }
 
- vkBindImageMemory(m_Graphics->m_Device, m_Image, m_ImageMemory,0);
-
- // Transition image to transfer-dst and copy staging buffer
- VkCommandBuffer cmd = m_Graphics->BeginTransientCommandBuffer();
+ // Transition image to transfer-dst and copy staging buffer (transfer queue when available)
+ VkCommandBuffer cmd = m_Graphics->m_Uploads->GetTransferCommandBuffer();
  m_Graphics->TransitionImageLayout(cmd, m_Image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,1);
- m_Graphics->CopyBufferToImage(cmd, staging.buffer, m_Image, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
- // Leave base level in TRANSFER_DST for mip generation
- m_Graphics->EndTransientCommandBuffer(cmd);
-
- // cleanup staging buffer explicitly
- vkDestroyBuffer(m_Graphics->m_Device, staging.buffer, nullptr);
- vkFreeMemory(m_Graphics->m_Device, staging.memory, nullptr);
+ m_Graphics->CopyBufferToImage(cmd, staging.buffer, staging.offset, m_Image, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+
+ // Leave base level in TRANSFER_DST for mip generation and hand it to the
+ // graphics queue; blits need a graphics capable queue
+ VkImageSubresourceRange baseLevel{};
+ baseLevel.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+ baseLevel.baseMipLevel =0;
+ baseLevel.levelCount =1;
+ baseLevel.baseArrayLayer =0;
+ baseLevel.layerCount =1;
+ m_Graphics->m_Uploads->ReleaseImage(m_Image, baseLevel, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
  // Generate mipmaps using GPU
  GenerateMipmaps(width, height);
@@ -160,7 +150,10 @@ void Texture::CreateSampler()
  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
- samplerInfo.anisotropyEnable = VK_TRUE;
+ // Software drivers may lack anisotropic filtering
+ VkPhysicalDeviceFeatures features{};
+ vkGetPhysicalDeviceFeatures(m_Graphics->m_PhysicalDevice, &features);
+ samplerInfo.anisotropyEnable = features.samplerAnisotropy;
  // Query device properties for max anisotropy
  VkPhysicalDeviceProperties props{};
  vkGetPhysicalDeviceProperties(m_Graphics->m_PhysicalDevice, &props);
@@ -187,7 +180,8 @@ void Texture::GenerateMipmaps(int width, int height)
  throw std::runtime_error("Device does not support linear blitting for mipmap generation");
  }
 
- VkCommandBuffer cmd = m_Graphics->BeginTransientCommandBuffer();
+ // Recorded into the graphics half of the upload batch, after the base level is acquired
+ VkCommandBuffer cmd = m_Graphics->m_Uploads->GetGraphicsCommandBuffer();
 
  VkImageMemoryBarrier barrier{};
  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -259,8 +253,6 @@ void Texture::GenerateMipmaps(int width, int height)
  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,0,0, nullptr,0, nullptr,1, &barrier);
-
- m_Graphics->EndTransientCommandBuffer(cmd);
 }
 
 } // namespace veng
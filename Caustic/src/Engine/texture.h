@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include "device_allocator.h"
 #include <string>
 #include <memory>
 
@@ -26,7 +27,7 @@ public:
 private:
  WalnutGraphics* m_Graphics = nullptr;
  VkImage m_Image = VK_NULL_HANDLE;
- VkDeviceMemory m_ImageMemory = VK_NULL_HANDLE;
+ Allocation m_ImageMemory;
  VkImageView m_ImageView = VK_NULL_HANDLE;
  VkSampler m_Sampler = VK_NULL_HANDLE;
  uint32_t m_MipLevels =1;
@@ -0,0 +1,123 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace veng {
+
+ThreadPool::ThreadPool(uint32_t workerCount)
+{
+ if (workerCount ==0) {
+ const uint32_t hardware = std::thread::hardware_concurrency();
+ workerCount = hardware >1 ? hardware -1 :0;
+ }
+ m_Workers.reserve(workerCount);
+ for (uint32_t i =0; i < workerCount; ++i) {
+ m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+ }
+}
+
+ThreadPool::~ThreadPool()
+{
+ {
+ std::lock_guard<std::mutex> lock(m_Mutex);
+ m_Stop = true;
+ }
+ m_WorkReady.notify_all();
+ for (std::thread& worker : m_Workers) {
+ worker.join();
+ }
+}
+
+ThreadPool& ThreadPool::Shared()
+{
+ static ThreadPool pool;
+ return pool;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& body, uint32_t maxThreads)
+{
+ if (count ==0) {
+ return;
+ }
+ uint32_t threads = std::min(GetThreadCount(), count);
+ if (maxThreads >0) {
+ threads = std::min(threads, maxThreads);
+ }
+ if (threads <=1) {
+ for (uint32_t i =0; i < count; ++i) {
+ body(i);
+ }
+ return;
+ }
+
+ std::lock_guard<std::mutex> call(m_CallMutex);
+ {
+ std::lock_guard<std::mutex> lock(m_Mutex);
+ m_Body = &body;
+ m_Count = count;
+ m_Next.store(0, std::memory_order_relaxed);
+ m_ActiveWorkers = threads -1;
+ m_BusyWorkers = threads -1;
+ m_Error = nullptr;
+ ++m_Generation;
+ }
+ m_WorkReady.notify_all();
+
+ RunIndices();
+
+ std::exception_ptr error;
+ {
+ std::unique_lock<std::mutex> lock(m_Mutex);
+ m_WorkDone.wait(lock, [this] { return m_BusyWorkers ==0; });
+ m_Body = nullptr;
+ error = m_Error;
+ m_Error = nullptr;
+ }
+ if (error) {
+ std::rethrow_exception(error);
+ }
+}
+
+void ThreadPool::WorkerLoop(uint32_t workerIndex)
+{
+ uint64_t seenGeneration =0;
+ for (;;) {
+ {
+ std::unique_lock<std::mutex> lock(m_Mutex);
+ // Workers past m_ActiveWorkers sit out loops capped by maxThreads
+ m_WorkReady.wait(lock, [&] { return m_Stop || (m_Generation != seenGeneration && workerIndex < m_ActiveWorkers); });
+ if (m_Stop) {
+ return;
+ }
+ seenGeneration = m_Generation;
+ }
+
+ RunIndices();
+
+ std::lock_guard<std::mutex> lock(m_Mutex);
+ if (--m_BusyWorkers ==0) {
+ m_WorkDone.notify_one();
+ }
+ }
+}
+
+void ThreadPool::RunIndices()
+{
+ for (;;) {
+ const uint32_t index = m_Next.fetch_add(1, std::memory_order_relaxed);
+ if (index >= m_Count) {
+ return;
+ }
+ try {
+ (*m_Body)(index);
+ } catch (...) {
+ std::lock_guard<std::mutex> lock(m_Mutex);
+ if (!m_Error) {
+ m_Error = std::current_exception();
+ }
+ // Nothing left to claim: every thread drops out after its current index
+ m_Next.store(m_Count, std::memory_order_relaxed);
+ }
+ }
+}
+
+} // namespace veng
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace veng {
+
+// Fixed set of worker threads for data parallel CPU work (asset import,
+// mesh processing). ParallelFor is the only entry point: the calling thread
+// takes part in the loop and returns once every index has run, so callers
+// never see futures or partially finished work.
+class ThreadPool {
+public:
+ // 0 picks hardware_concurrency - 1 workers (the caller is the last thread)
+ explicit ThreadPool(uint32_t workerCount =0);
+ ~ThreadPool();
+
+ ThreadPool(const ThreadPool&) = delete;
+ ThreadPool& operator=(const ThreadPool&) = delete;
+
+ // Threads that run ParallelFor bodies, including the caller
+ uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()) +1; }
+
+ // Runs body(i) for i in [0, count), at most maxThreads at a time (0: all).
+ // Indices are handed out one at a time, so uneven work balances itself.
+ // The first exception thrown by a body is rethrown here once all threads
+ // have stopped; remaining indices are skipped.
+ // Not reentrant: a body must not call ParallelFor on the same pool.
+ void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& body, uint32_t maxThreads =0);
+
+ // Process wide pool, created on first use
+ static ThreadPool& Shared();
+
+private:
+ void WorkerLoop(uint32_t workerIndex);
+ void RunIndices();
+
+ std::vector<std::thread> m_Workers;
+ std::mutex m_Mutex;
+ std::condition_variable m_WorkReady;
+ std::condition_variable m_WorkDone;
+ std::mutex m_CallMutex; // serializes ParallelFor calls from different threads
+
+ // The loop in progress; published under m_Mutex, indices are claimed from m_Next
+ const std::function<void(uint32_t)>* m_Body = nullptr;
+ uint32_t m_Count =0;
+ std::atomic<uint32_t> m_Next{0};
+ uint32_t m_ActiveWorkers =0;  // workers allowed to join the current loop
+ uint32_t m_BusyWorkers =0;    // of those, the ones that have not finished it yet
+ uint64_t m_Generation =0;
+ std::exception_ptr m_Error;
+ bool m_Stop = false;
+};
+
+} // namespace veng
@@ -0,0 +1,473 @@
+#include "upload_context.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace veng {
+
+static VkCommandPool CreateUploadCommandPool(VkDevice device, uint32_t queueFamily)
+{
+ VkCommandPoolCreateInfo poolInfo{};
+ poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+ poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+ poolInfo.queueFamilyIndex = queueFamily;
+
+ VkCommandPool pool = VK_NULL_HANDLE;
+ if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create upload command pool");
+ }
+ return pool;
+}
+
+UploadContext::UploadContext(VkDevice device, DeviceAllocator& allocator, VkQueue graphicsQueue, uint32_t graphicsFamily,
+ VkQueue transferQueue, uint32_t transferFamily, VkDeviceSize stagingSize)
+ : m_Device(device), m_Allocator(allocator), m_GraphicsQueue(graphicsQueue), m_TransferQueue(transferQueue),
+ m_GraphicsFamily(graphicsFamily), m_TransferFamily(transferFamily), m_StagingSize(stagingSize)
+{
+ m_Dedicated = transferQueue != VK_NULL_HANDLE && transferFamily != graphicsFamily;
+ m_Stats.dedicatedTransferQueue = m_Dedicated;
+
+ m_GraphicsPool = CreateUploadCommandPool(m_Device, m_GraphicsFamily);
+ if (m_Dedicated) {
+ m_TransferPool = CreateUploadCommandPool(m_Device, m_TransferFamily);
+ }
+
+ VkBufferCreateInfo bufferInfo{};
+ bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+ bufferInfo.size = m_StagingSize;
+ bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+ bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+ if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &m_Staging.buffer) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create staging ring buffer");
+ }
+ m_Staging.allocation = m_Allocator.AllocateForBuffer(m_Staging.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+ BeginBatch();
+}
+
+UploadContext::~UploadContext()
+{
+ // Only wait for what is already on the GPU. Pending acquires are not
+ // submitted: the resources they reference may already be destroyed.
+ for (Batch& batch : m_InFlight) {
+ if (m_Dedicated) {
+ vkWaitForFences(m_Device,1, &batch.transferFence, VK_TRUE, UINT64_MAX);
+ }
+ if (batch.acquireSubmitted) {
+ vkWaitForFences(m_Device,1, &batch.fence, VK_TRUE, UINT64_MAX);
+ }
+ DestroyBatch(batch);
+ }
+ // The open batch never reached the queue; its commands are simply dropped
+ DestroyBatch(m_Open);
+ for (Batch& batch : m_FreeBatches) {
+ DestroyBatch(batch);
+ }
+
+ if (m_Staging.buffer != VK_NULL_HANDLE) {
+ vkDestroyBuffer(m_Device, m_Staging.buffer, nullptr);
+ m_Allocator.Free(m_Staging.allocation);
+ }
+ // Destroying the pools frees every command buffer allocated from them
+ vkDestroyCommandPool(m_Device, m_GraphicsPool, nullptr);
+ if (m_TransferPool != VK_NULL_HANDLE) {
+ vkDestroyCommandPool(m_Device, m_TransferPool, nullptr);
+ }
+}
+
+void UploadContext::BeginBatch()
+{
+ if (!m_FreeBatches.empty()) {
+ m_Open = std::move(m_FreeBatches.back());
+ m_FreeBatches.pop_back();
+ vkResetCommandBuffer(m_Open.cmd,0);
+ vkResetFences(m_Device,1, &m_Open.fence);
+ if (m_Dedicated) {
+ vkResetCommandBuffer(m_Open.transferCmd,0);
+ vkResetFences(m_Device,1, &m_Open.transferFence);
+ }
+ } else {
+ m_Open = Batch{};
+
+ VkCommandBufferAllocateInfo allocInfo{};
+ allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+ allocInfo.commandPool = m_GraphicsPool;
+ allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+ allocInfo.commandBufferCount =1;
+ if (vkAllocateCommandBuffers(m_Device, &allocInfo, &m_Open.cmd) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to allocate upload command buffer");
+ }
+
+ VkFenceCreateInfo fenceInfo{};
+ fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+ if (vkCreateFence(m_Device, &fenceInfo, nullptr, &m_Open.fence) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create upload fence");
+ }
+
+ if (m_Dedicated) {
+ allocInfo.commandPool = m_TransferPool;
+ if (vkAllocateCommandBuffers(m_Device, &allocInfo, &m_Open.transferCmd) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to allocate transfer command buffer");
+ }
+ if (vkCreateFence(m_Device, &fenceInfo, nullptr, &m_Open.transferFence) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create transfer fence");
+ }
+ VkSemaphoreCreateInfo semaphoreInfo{};
+ semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+ if (vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_Open.transferDone) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create transfer semaphore");
+ }
+ }
+ }
+
+ m_Open.ticket = m_NextTicket;
+ m_Open.acquireSubmitted = false;
+ m_OpenHasWork = false;
+
+ if (m_TimestampPeriod >0.0f && m_Open.timestamps == VK_NULL_HANDLE) {
+ VkQueryPoolCreateInfo poolInfo{};
+ poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+ poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+ poolInfo.queryCount =2;
+ if (vkCreateQueryPool(m_Device, &poolInfo, nullptr, &m_Open.timestamps) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create upload timestamp pool");
+ }
+ }
+
+ VkCommandBufferBeginInfo beginInfo{};
+ beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+ beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+ vkBeginCommandBuffer(m_Open.cmd, &beginInfo);
+ if (m_Dedicated) {
+ vkBeginCommandBuffer(m_Open.transferCmd, &beginInfo);
+ }
+
+ if (m_Open.timestamps != VK_NULL_HANDLE) {
+ vkCmdResetQueryPool(m_Open.cmd, m_Open.timestamps,0,2);
+ vkCmdWriteTimestamp(m_Open.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_Open.timestamps,0);
+ }
+}
+
+void UploadContext::EnableGpuTiming(float timestampPeriod, uint32_t timestampValidBits)
+{
+ if (timestampPeriod <=0.0f || timestampValidBits ==0) {
+ return;
+ }
+ m_TimestampPeriod = timestampPeriod;
+ m_TimestampMask = timestampValidBits >=64 ? ~0ull : ((1ull << timestampValidBits) -1);
+ // The open batch began untimed; timing starts with the next one
+}
+
+bool UploadContext::ConsumeGpuTime(float& ms)
+{
+ if (!m_HasGpuTime) {
+ return false;
+ }
+ ms = static_cast<float>(m_GpuMs);
+ m_GpuMs =0.0;
+ m_HasGpuTime = false;
+ return true;
+}
+
+void UploadContext::ResolveTimestamps(Batch& batch)
+{
+ if (batch.timestamps == VK_NULL_HANDLE || m_TimestampPeriod <=0.0f) {
+ return;
+ }
+ uint64_t ticks[2] = {};
+ if (vkGetQueryPoolResults(m_Device, batch.timestamps,0,2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+ m_GpuMs += static_cast<double>((ticks[1] - ticks[0]) & m_TimestampMask) * m_TimestampPeriod /1.0e6;
+ m_HasGpuTime = true;
+ }
+}
+
+UploadContext::StagingSpan UploadContext::Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+{
+ m_OpenHasWork = true;
+ m_Stats.bytesUploaded += size;
+ ++m_Stats.uploads;
+
+ // Too big for the ring: give it a one-off buffer that retires with the batch
+ if (size > m_StagingSize) {
+ BufferHandle overflow{};
+ VkBufferCreateInfo bufferInfo{};
+ bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+ bufferInfo.size = size;
+ bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+ bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+ if (vkCreateBuffer(m_Device, &bufferInfo, nullptr, &overflow.buffer) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to create overflow staging buffer");
+ }
+ overflow.allocation = m_Allocator.AllocateForBuffer(overflow.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+ std::memcpy(overflow.allocation.mapped, data, static_cast<size_t>(size));
+ m_Allocator.Flush(overflow.allocation);
+ m_Open.overflow.push_back(overflow);
+ return StagingSpan{ overflow.buffer,0 };
+ }
+
+ for (;;) {
+ // Nothing staged anywhere: restart at the beginning so a large request
+ // never has to wrap around a partially used ring
+ if (m_InFlight.empty() && m_Head == m_Tail) {
+ m_Head = m_Tail =0;
+ }
+
+ uint64_t start = (m_Head + alignment -1) / alignment * alignment;
+ // Never straddle the end of the ring
+ if (start % m_StagingSize + size > m_StagingSize) {
+ start = (start / m_StagingSize +1) * m_StagingSize;
+ }
+ if (start + size - m_Tail <= m_StagingSize) {
+ m_Head = start + size;
+ VkDeviceSize offset = start % m_StagingSize;
+ std::memcpy(static_cast<uint8_t*>(m_Staging.allocation.mapped) + offset, data, static_cast<size_t>(size));
+ return StagingSpan{ m_Staging.buffer, offset };
+ }
+
+ // Ring is full: free the oldest batch, or push out the open one if it
+ // is the one holding the space
+ ++m_Stats.stagingStalls;
+ if (m_InFlight.empty()) {
+ Submit();
+ m_OpenHasWork = true;
+ }
+ RetireOldest();
+ }
+}
+
+VkCommandBuffer UploadContext::GetTransferCommandBuffer()
+{
+ m_OpenHasWork = true;
+ return m_Dedicated ? m_Open.transferCmd : m_Open.cmd;
+}
+
+VkCommandBuffer UploadContext::GetGraphicsCommandBuffer()
+{
+ m_OpenHasWork = true;
+ return m_Open.cmd;
+}
+
+void UploadContext::ReleaseBuffer(VkBuffer buffer)
+{
+ if (!m_Dedicated) {
+ return;
+ }
+
+ // Release half on the transfer queue, acquire half on the graphics queue;
+ // both must describe the same transfer
+ VkBufferMemoryBarrier barrier{};
+ barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+ barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+ barrier.dstAccessMask =0;
+ barrier.srcQueueFamilyIndex = m_TransferFamily;
+ barrier.dstQueueFamilyIndex = m_GraphicsFamily;
+ barrier.buffer = buffer;
+ barrier.offset =0;
+ barrier.size = VK_WHOLE_SIZE;
+ vkCmdPipelineBarrier(m_Open.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,0,0, nullptr,1, &barrier,0, nullptr);
+
+ barrier.srcAccessMask =0;
+ barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+ vkCmdPipelineBarrier(m_Open.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,0,0, nullptr,1, &barrier,0, nullptr);
+}
+
+void UploadContext::ReleaseImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout layout)
+{
+ if (!m_Dedicated) {
+ return;
+ }
+
+ VkImageMemoryBarrier barrier{};
+ barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+ barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+ barrier.dstAccessMask =0;
+ barrier.oldLayout = layout;
+ barrier.newLayout = layout;
+ barrier.srcQueueFamilyIndex = m_TransferFamily;
+ barrier.dstQueueFamilyIndex = m_GraphicsFamily;
+ barrier.image = image;
+ barrier.subresourceRange = range;
+ vkCmdPipelineBarrier(m_Open.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,0,0, nullptr,0, nullptr,1, &barrier);
+
+ barrier.srcAccessMask =0;
+ barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+ vkCmdPipelineBarrier(m_Open.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,0,0, nullptr,0, nullptr,1, &barrier);
+}
+
+UploadTicket UploadContext::UploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+ StagingSpan span = Stage(data, size);
+
+ VkBufferCopy copy{};
+ copy.srcOffset = span.offset;
+ copy.dstOffset = dstOffset;
+ copy.size = size;
+ vkCmdCopyBuffer(GetTransferCommandBuffer(), span.buffer, dst,1, &copy);
+ ReleaseBuffer(dst);
+
+ return GetCurrentTicket();
+}
+
+UploadTicket UploadContext::Submit()
+{
+ Collect();
+
+ if (!m_OpenHasWork) {
+ // Nothing recorded: everything handed out so far has already been submitted
+ return UploadTicket{ m_NextTicket -1 };
+ }
+
+ // Make transfer writes visible to whatever runs after this batch on the graphics queue
+ VkMemoryBarrier barrier{};
+ barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+ barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+ barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+ vkCmdPipelineBarrier(m_Open.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,0,1, &barrier,0, nullptr,0, nullptr);
+ if (m_Open.timestamps != VK_NULL_HANDLE) {
+ vkCmdWriteTimestamp(m_Open.cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_Open.timestamps,1);
+ }
+ vkEndCommandBuffer(m_Open.cmd);
+
+ m_Allocator.Flush(m_Staging.allocation);
+
+ VkSubmitInfo submitInfo{};
+ submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+ submitInfo.commandBufferCount =1;
+ if (m_Dedicated) {
+ // The graphics half is held back until the copies are done (see Collect)
+ vkEndCommandBuffer(m_Open.transferCmd);
+ submitInfo.pCommandBuffers = &m_Open.transferCmd;
+ submitInfo.signalSemaphoreCount =1;
+ submitInfo.pSignalSemaphores = &m_Open.transferDone;
+ if (vkQueueSubmit(m_TransferQueue,1, &submitInfo, m_Open.transferFence) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to submit transfer batch");
+ }
+ } else {
+ submitInfo.pCommandBuffers = &m_Open.cmd;
+ if (vkQueueSubmit(m_GraphicsQueue,1, &submitInfo, m_Open.fence) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to submit upload batch");
+ }
+ m_Open.acquireSubmitted = true;
+ m_ReadyTicket = m_Open.ticket;
+ }
+
+ UploadTicket ticket{ m_Open.ticket };
+ m_Open.ringEnd = m_Head;
+ m_InFlight.push_back(std::move(m_Open));
+ ++m_NextTicket;
+ ++m_Stats.submissions;
+ m_Stats.batchesInFlight = static_cast<uint32_t>(m_InFlight.size());
+
+ BeginBatch();
+ return ticket;
+}
+
+void UploadContext::SubmitAcquire(Batch& batch)
+{
+ VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+ VkSubmitInfo submitInfo{};
+ submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+ submitInfo.waitSemaphoreCount =1;
+ submitInfo.pWaitSemaphores = &batch.transferDone;
+ submitInfo.pWaitDstStageMask = &waitStage;
+ submitInfo.commandBufferCount =1;
+ submitInfo.pCommandBuffers = &batch.cmd;
+ if (vkQueueSubmit(m_GraphicsQueue,1, &submitInfo, batch.fence) != VK_SUCCESS) {
+ throw std::runtime_error("Failed to submit upload acquire batch");
+ }
+ batch.acquireSubmitted = true;
+ m_ReadyTicket = std::max(m_ReadyTicket, batch.ticket);
+}
+
+void UploadContext::RetireOldest()
+{
+ Batch& batch = m_InFlight.front();
+ if (!batch.acquireSubmitted) {
+ SubmitAcquire(batch);
+ }
+ vkWaitForFences(m_Device,1, &batch.fence, VK_TRUE, UINT64_MAX);
+
+ m_Tail = std::max(m_Tail, batch.ringEnd);
+ m_CompletedTicket = std::max(m_CompletedTicket, batch.ticket);
+ ResolveTimestamps(batch);
+ DestroyOverflow(batch);
+
+ m_FreeBatches.push_back(std::move(batch));
+ m_InFlight.pop_front();
+ m_Stats.batchesInFlight = static_cast<uint32_t>(m_InFlight.size());
+}
+
+void UploadContext::Collect()
+{
+ // Acquires go out in submission order, each as soon as its copies are done
+ for (Batch& batch : m_InFlight) {
+ if (batch.acquireSubmitted) {
+ continue;
+ }
+ if (vkGetFenceStatus(m_Device, batch.transferFence) != VK_SUCCESS) {
+ break;
+ }
+ SubmitAcquire(batch);
+ }
+
+ while (!m_InFlight.empty() && m_InFlight.front().acquireSubmitted && vkGetFenceStatus(m_Device, m_InFlight.front().fence) == VK_SUCCESS) {
+ RetireOldest();
+ }
+}
+
+bool UploadContext::IsReady(UploadTicket ticket)
+{
+ // Without a transfer queue the open batch is submitted ahead of the next
+ // frame on the same queue, so every ticket is usable right away
+ if (!m_Dedicated) {
+ return true;
+ }
+ Collect();
+ return ticket.value <= m_ReadyTicket;
+}
+
+bool UploadContext::IsComplete(UploadTicket ticket)
+{
+ Collect();
+ return ticket.value <= m_CompletedTicket;
+}
+
+void UploadContext::Wait(UploadTicket ticket)
+{
+ if (ticket.value >= m_NextTicket) {
+ Submit();
+ }
+ while (ticket.value > m_CompletedTicket && !m_InFlight.empty()) {
+ RetireOldest();
+ }
+}
+
+void UploadContext::WaitIdle()
+{
+ while (!m_InFlight.empty()) {
+ RetireOldest();
+ }
+}
+
+void UploadContext::DestroyOverflow(Batch& batch)
+{
+ for (BufferHandle& overflow : batch.overflow) {
+ vkDestroyBuffer(m_Device, overflow.buffer, nullptr);
+ m_Allocator.Free(overflow.allocation);
+ }
+ batch.overflow.clear();
+}
+
+void UploadContext::DestroyBatch(Batch& batch)
+{
+ DestroyOverflow(batch);
+ vkDestroyFence(m_Device, batch.fence, nullptr);
+ vkDestroyFence(m_Device, batch.transferFence, nullptr);
+ vkDestroySemaphore(m_Device, batch.transferDone, nullptr);
+ if (batch.timestamps != VK_NULL_HANDLE) {
+ vkDestroyQueryPool(m_Device, batch.timestamps, nullptr);
+ }
+}
+
+} // namespace veng
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "buffer_handle.h"
+#include "device_allocator.h"
+
+namespace veng {
+
+// Identifies the batch an upload was recorded into. Once the ticket is ready
+// (UploadContext::IsReady) frames submitted afterwards may use the destination
+// resource; once it is complete the batch has retired and its staging space is reused.
+struct UploadTicket {
+ uint64_t value =0;
+};
+
+struct UploadStats {
+ uint64_t submissions =0;
+ uint64_t uploads =0;
+ uint64_t bytesUploaded =0;
+ uint32_t batchesInFlight =0;
+ uint64_t stagingStalls =0; // times the ring was full and the host had to wait for a batch
+ bool dedicatedTransferQueue = false;
+};
+
+// Batches staging copies into one command buffer per submission. Source bytes
+// are copied into a persistently mapped staging ring, commands for many
+// buffers and images accumulate in the open batch, and Submit hands the whole
+// batch to the queue with a fence instead of draining the queue. Ring space is
+// reclaimed as batches retire.
+//
+// When a separate transfer queue family is given, copies run on it and each
+// batch is split in two: the transfer command buffer ends with queue family
+// release barriers, and a graphics command buffer holding the matching acquire
+// barriers (plus graphics-only work such as mip blits) is submitted once the
+// transfer has finished, waiting on a semaphore. The graphics queue never waits
+// on a copy that is still running.
+class UploadContext {
+public:
+ UploadContext(VkDevice device, DeviceAllocator& allocator, VkQueue graphicsQueue, uint32_t graphicsFamily,
+  VkQueue transferQueue, uint32_t transferFamily, VkDeviceSize stagingSize =64ull *1024 *1024);
+ ~UploadContext();
+
+ UploadContext(const UploadContext&) = delete;
+ UploadContext& operator=(const UploadContext&) = delete;
+
+ struct StagingSpan {
+ VkBuffer buffer = VK_NULL_HANDLE;
+ VkDeviceSize offset =0;
+ };
+
+ // Copy `size` bytes into staging memory owned by the open batch
+ StagingSpan Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment =16);
+
+ // Command buffer of the open batch for copies out of staging memory (transfer queue)
+ VkCommandBuffer GetTransferCommandBuffer();
+ // Command buffer of the open batch for work that must run on the graphics
+ // queue after the copies, e.g. blits and final layout transitions. Same as
+ // the transfer command buffer when there is no dedicated transfer queue.
+ VkCommandBuffer GetGraphicsCommandBuffer();
+
+ // Hand a resource written by the transfer command buffer over to the graphics
+ // queue family. Record after the copies and before any graphics work on it;
+ // no-ops without a dedicated transfer queue.
+ void ReleaseBuffer(VkBuffer buffer);
+ void ReleaseImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout layout);
+
+ // Stage `data`, record a copy into `dst` and release it to the graphics queue
+ UploadTicket UploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+ UploadTicket GetCurrentTicket() const { return UploadTicket{ m_NextTicket }; }
+ bool HasDedicatedTransferQueue() const { return m_Dedicated; }
+
+ // Time the graphics queue part of every batch with timestamp queries (the
+ // whole batch without a dedicated transfer queue). Transfer-only queues
+ // cannot reset query pools, so their copies are not timed.
+ void EnableGpuTiming(float timestampPeriod, uint32_t timestampValidBits);
+ // GPU milliseconds of batches retired since the last call; false if none were timed
+ bool ConsumeGpuTime(float& ms);
+
+ // Submit the open batch (if it recorded anything); returns its ticket
+ UploadTicket Submit();
+
+ // Resources of the ticket may be used by graphics work submitted from now on
+ bool IsReady(UploadTicket ticket);
+ bool IsComplete(UploadTicket ticket);
+ void Wait(UploadTicket ticket);
+ void WaitIdle();
+
+ // Hand finished transfers to the graphics queue, retire finished batches and
+ // reclaim their staging space
+ void Collect();
+
+ const UploadStats& GetStats() const { return m_Stats; }
+
+private:
+ struct Batch {
+ VkCommandBuffer cmd = VK_NULL_HANDLE;          // graphics queue (everything, when shared)
+ VkCommandBuffer transferCmd = VK_NULL_HANDLE;  // transfer queue; dedicated mode only
+ VkFence fence = VK_NULL_HANDLE;                // signals when the whole batch is done
+ VkFence transferFence = VK_NULL_HANDLE;
+ VkSemaphore transferDone = VK_NULL_HANDLE;
+ VkQueryPool timestamps = VK_NULL_HANDLE;        // begin/end of `cmd`
+ bool acquireSubmitted = false;
+ uint64_t ticket =0;
+ uint64_t ringEnd =0;               // absolute ring position released when the batch retires
+ std::vector<BufferHandle> overflow; // one-off staging for uploads larger than the ring
+ };
+
+ void BeginBatch();
+ void SubmitAcquire(Batch& batch);
+ void RetireOldest();
+ void DestroyOverflow(Batch& batch);
+ void DestroyBatch(Batch& batch);
+ void ResolveTimestamps(Batch& batch);
+
+ VkDevice m_Device = VK_NULL_HANDLE;
+ DeviceAllocator& m_Allocator;
+ VkQueue m_GraphicsQueue = VK_NULL_HANDLE;
+ VkQueue m_TransferQueue = VK_NULL_HANDLE;
+ uint32_t m_GraphicsFamily =0;
+ uint32_t m_TransferFamily =0;
+ bool m_Dedicated = false;
+ VkCommandPool m_GraphicsPool = VK_NULL_HANDLE;
+ VkCommandPool m_TransferPool = VK_NULL_HANDLE;
+
+ // Staging ring; head/tail are absolute byte positions, physical offset = pos % size
+ BufferHandle m_Staging{};
+ VkDeviceSize m_StagingSize =0;
+ uint64_t m_Head =0;
+ uint64_t m_Tail =0;
+
+ Batch m_Open;
+ bool m_OpenHasWork = false;
+ std::deque<Batch> m_InFlight;
+ std::vector<Batch> m_FreeBatches;
+
+ uint64_t m_NextTicket =1;
+ uint64_t m_ReadyTicket =0;
+ uint64_t m_CompletedTicket =0;
+ UploadStats m_Stats;
+
+ float m_TimestampPeriod =0.0f; // 0 disables GPU timing
+ uint64_t m_TimestampMask =0;
+ double m_GpuMs =0.0;
+ bool m_HasGpuTime = false;
+};
+
+} // namespace veng
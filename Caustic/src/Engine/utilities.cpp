@@ -3,6 +3,11 @@
 #include <fstream>
 #include <cstring>
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
 namespace veng {
 
 bool streq(const char* left, const char* right) {
@@ -29,4 +34,81 @@ std::vector<std::uint8_t> ReadFile(std::filesystem::path shader_path) {
   return buffer;
 }
 
+std::filesystem::path GetExecutableDirectory() {
+#ifdef _WIN32
+  char path[MAX_PATH];
+  DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+  if(length == 0 || length >= MAX_PATH) {
+    return {};
+  }
+  return std::filesystem::path(path).parent_path();
+#else
+  std::error_code error;
+  std::filesystem::path path = std::filesystem::read_symlink("/proc/self/exe", error);
+  return error ? std::filesystem::path{} : path.parent_path();
+#endif
+}
+
+namespace {
+
+constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9ull;
+constexpr std::uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+constexpr std::uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+std::uint64_t RotateLeft(std::uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+std::uint64_t Load64(const std::uint8_t* p) {
+  std::uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint64_t Round(std::uint64_t accumulator, std::uint64_t input) {
+  accumulator += input * kPrime2;
+  return RotateLeft(accumulator, 31) * kPrime1;
+}
+
+}  // namespace
+
+std::uint64_t HashBytes(const void* data, size_t size, std::uint64_t seed) {
+  const std::uint8_t* p = static_cast<const std::uint8_t*>(data);
+  const std::uint8_t* end = p + size;
+  std::uint64_t hash;
+
+  // Four independent lanes keep the multipliers busy: several GB/s per core
+  if(size >= 32) {
+    std::uint64_t lanes[4] = { seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1 };
+    for(; end - p >= 32; p += 32) {
+      for(int lane = 0; lane < 4; ++lane) {
+        lanes[lane] = Round(lanes[lane], Load64(p + lane * 8));
+      }
+    }
+    hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+    for(std::uint64_t lane : lanes) {
+      hash = (hash ^ Round(0, lane)) * kPrime1 + kPrime4;
+    }
+  } else {
+    hash = seed + kPrime5;
+  }
+
+  hash += static_cast<std::uint64_t>(size);
+  for(; end - p >= 8; p += 8) {
+    hash = RotateLeft(hash ^ Round(0, Load64(p)), 27) * kPrime1 + kPrime4;
+  }
+  for(; p < end; ++p) {
+    hash = RotateLeft(hash ^ (*p * kPrime5), 11) * kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
 }  // namespace veng
@@ -9,5 +9,9 @@ namespace veng {
 
 bool streq(const char* left, const char* right);
 std::vector<std::uint8_t> ReadFile(std::filesystem::path shader_path);
+// Directory of the running executable, empty if it cannot be determined
+std::filesystem::path GetExecutableDirectory();
+// Fast non-cryptographic 64-bit hash (xxHash64 style) for content checks
+std::uint64_t HashBytes(const void* data, size_t size, std::uint64_t seed =0);
 
 }
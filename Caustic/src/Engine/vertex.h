@@ -6,40 +6,12 @@
 
 namespace veng {
 
+// CPU-side vertex as imported and cached. What reaches the GPU is
+// GpuVertexLayout (vertex_layout.h), packed from this by CreateVertexBuffer.
 struct Vertex {
   glm::vec3 position;
   glm::vec3 color;
   glm::vec2 texCoord;
-
-  static VkVertexInputBindingDescription GetBindingDescription() {
-    VkVertexInputBindingDescription description = {};
-    description.binding = 0;
-    description.stride = sizeof(Vertex);
-    description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    return description;
-  }
-
-  static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions() {
-    std::array<VkVertexInputAttributeDescription, 3> descriptions = {};
-
-    descriptions[0].binding = 0;
-    descriptions[0].location = 0;
-    descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    descriptions[0].offset = offsetof(Vertex, position);
-
-    descriptions[1].binding = 0;
-    descriptions[1].location = 1;
-    descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    descriptions[1].offset = offsetof(Vertex, color);
-
-    descriptions[2].binding = 0;
-    descriptions[2].location = 2;
-    descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    descriptions[2].offset = offsetof(Vertex, texCoord);
-
-    return descriptions;
-  }
 };
 
 }  // namespace veng
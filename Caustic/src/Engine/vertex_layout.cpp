@@ -0,0 +1,243 @@
+#include "vertex_layout.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >=2)
+#define VENG_VERTEX_PACK_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace veng {
+
+namespace {
+
+template <typename T>
+void Store(std::byte* out, const T& value)
+{
+ std::memcpy(out, &value, sizeof(T));
+}
+
+uint8_t ToUnorm8(float value)
+{
+ return static_cast<uint8_t>(std::lrint(std::clamp(value,0.0f,1.0f) *255.0f));
+}
+
+uint16_t ToUnorm16(float value)
+{
+ return static_cast<uint16_t>(std::lrint(std::clamp(value,0.0f,1.0f) *65535.0f));
+}
+
+#ifdef VENG_VERTEX_PACK_SSE2
+
+// FloatToHalf on four lanes; the result is in the low 16 bits of each lane
+__m128i FloatToHalf4(__m128 value)
+{
+ const __m128 signMask = _mm_set1_ps(-0.0f);
+ const __m128 sign = _mm_and_ps(value, signMask);
+ const __m128 magnitude = _mm_xor_ps(value, sign);
+ const __m128i bits = _mm_castps_si128(magnitude);
+
+ // At or above 65520 rounds to infinity; NaN keeps a mantissa bit
+ const __m128i isFinite = _mm_cmpgt_epi32(_mm_set1_epi32((127 +16) <<23), bits);
+ const __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(magnitude, magnitude));
+ const __m128i special = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(isNan, _mm_set1_epi32(0x200)));
+
+ // Below the smallest half normal: adding a magic float shifts the mantissa
+ // into place and the FPU does the rounding
+ const __m128i subnormalMagic = _mm_set1_epi32(((127 -15) + (23 -10) +1) <<23);
+ const __m128i isSubnormal = _mm_cmpgt_epi32(_mm_set1_epi32((127 -14) <<23), bits);
+ const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(magnitude, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+ // Normals: rebias the exponent, round the 13 dropped mantissa bits to even
+ const __m128i odd = _mm_srai_epi32(_mm_slli_epi32(bits,31 -13),31);
+ const __m128i rounded = _mm_sub_epi32(_mm_add_epi32(bits, _mm_set1_epi32(0xfff - ((127 -15) <<23))), odd);
+ const __m128i normal = _mm_srli_epi32(rounded,13);
+
+ const __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+ const __m128i half = _mm_or_si128(_mm_and_si128(isFinite, finite), _mm_andnot_si128(isFinite, special));
+ return _mm_or_si128(half, _mm_srli_epi32(_mm_castps_si128(sign),16));
+}
+
+// Packs the low 16 bits of each lane of a and b into eight 16-bit lanes
+__m128i Narrow16(__m128i a, __m128i b)
+{
+ // Sign extend first so the saturating pack is exact for all 16-bit patterns
+ return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a,16),16), _mm_srai_epi32(_mm_slli_epi32(b,16),16));
+}
+
+// Vertex is tightly packed floats; reading four from any member stays inside
+// the vertex except for texCoord, which is loaded as two
+__m128 Load4(const float* values)
+{
+ return _mm_loadu_ps(values);
+}
+
+__m128 Load2(const float* values)
+{
+ return _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(values)));
+}
+
+#endif
+
+} // namespace
+
+std::uint16_t FloatToHalf(float value)
+{
+ uint32_t bits;
+ std::memcpy(&bits, &value, sizeof(bits));
+ const uint32_t sign = (bits >>16) &0x8000u;
+ bits &=0x7fffffffu;
+
+ if (bits >= ((127u +16u) <<23)) {
+ return static_cast<uint16_t>(sign | (bits >0x7f800000u ?0x7e00u :0x7c00u));
+ }
+ if (bits < ((127u -14u) <<23)) {
+ // Subnormal or zero, as in FloatToHalf4
+ float magnitude;
+ std::memcpy(&magnitude, &bits, sizeof(magnitude));
+ const uint32_t magicBits = ((127u -15u) + (23u -10u) +1u) <<23;
+ float magic;
+ std::memcpy(&magic, &magicBits, sizeof(magic));
+ const float sum = magnitude + magic;
+ uint32_t sumBits;
+ std::memcpy(&sumBits, &sum, sizeof(sumBits));
+ return static_cast<uint16_t>(sign | (sumBits - magicBits));
+ }
+ const uint32_t odd = (bits >>13) &1u;
+ bits += 0xfffu - ((127u -15u) <<23) + odd;
+ return static_cast<uint16_t>(sign | (bits >>13));
+}
+
+float HalfToFloat(std::uint16_t value)
+{
+ const uint32_t sign = static_cast<uint32_t>(value &0x8000u) <<16;
+ const uint32_t exponent = (value >>10) &0x1fu;
+ const uint32_t mantissa = value &0x3ffu;
+ float result;
+ if (exponent ==0) {
+ result = std::ldexp(static_cast<float>(mantissa), -24);
+ } else if (exponent ==31) {
+ result = mantissa ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+ } else {
+ result = std::ldexp(static_cast<float>(mantissa |0x400u), static_cast<int>(exponent) -25);
+ }
+ uint32_t bits;
+ std::memcpy(&bits, &result, sizeof(bits));
+ bits |= sign;
+ std::memcpy(&result, &bits, sizeof(result));
+ return result;
+}
+
+void PackPositionsFloat3(std::span<const Vertex> vertices, std::byte* out, uint32_t stride)
+{
+ for (const Vertex& vertex : vertices) {
+ Store(out, vertex.position);
+ out += stride;
+ }
+}
+
+void PackPositionsHalf4(std::span<const Vertex> vertices, std::byte* out, uint32_t stride)
+{
+ size_t i =0;
+#ifdef VENG_VERTEX_PACK_SSE2
+ // Two vertices per iteration; lane 3 (color.r) is replaced by w = 1
+ const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1,0));
+ const __m128 one = _mm_setr_ps(0.0f,0.0f,0.0f,1.0f);
+ for (; i +2 <= vertices.size(); i +=2) {
+ const __m128 a = _mm_or_ps(_mm_and_ps(Load4(&vertices[i].position.x), xyzMask), one);
+ const __m128 b = _mm_or_ps(_mm_and_ps(Load4(&vertices[i +1].position.x), xyzMask), one);
+ const __m128i halves = Narrow16(FloatToHalf4(a), FloatToHalf4(b));
+ _mm_storel_epi64(reinterpret_cast<__m128i*>(out), halves);
+ _mm_storel_epi64(reinterpret_cast<__m128i*>(out + stride), _mm_unpackhi_epi64(halves, halves));
+ out +=2 * static_cast<size_t>(stride);
+ }
+#endif
+ for (; i < vertices.size(); ++i) {
+ const glm::vec3& p = vertices[i].position;
+ const std::array<uint16_t,4> halves = { FloatToHalf(p.x), FloatToHalf(p.y), FloatToHalf(p.z), FloatToHalf(1.0f) };
+ Store(out, halves);
+ out += stride;
+ }
+}
+
+void PackColorsFloat3(std::span<const Vertex> vertices, std::byte* out, uint32_t stride)
+{
+ for (const Vertex& vertex : vertices) {
+ Store(out, vertex.color);
+ out += stride;
+ }
+}
+
+void PackColorsUnorm8(std::span<const Vertex> vertices, std::byte* out, uint32_t stride)
+{
+ size_t i =0;
+#ifdef VENG_VERTEX_PACK_SSE2
+ // Four vertices per iteration; lane 3 (texCoord.x) becomes alpha. Like
+ // lrint, cvtps rounds to nearest even, so both paths give the same bytes.
+ const __m128 zero = _mm_setzero_ps();
+ const __m128 unit = _mm_set1_ps(1.0f);
+ const __m128 scale = _mm_setr_ps(255.0f,255.0f,255.0f,0.0f);
+ const __m128 alpha = _mm_setr_ps(0.0f,0.0f,0.0f,255.0f);
+ const auto convert = [&](const Vertex& vertex) {
+ const __m128 clamped = _mm_min_ps(_mm_max_ps(Load4(&vertex.color.x), zero), unit);
+ return _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(clamped, scale), alpha));
+ };
+ for (; i +4 <= vertices.size(); i +=4) {
+ const __m128i words0 = _mm_packs_epi32(convert(vertices[i]), convert(vertices[i +1]));
+ const __m128i words1 = _mm_packs_epi32(convert(vertices[i +2]), convert(vertices[i +3]));
+ alignas(16) uint32_t colors[4];
+ _mm_store_si128(reinterpret_cast<__m128i*>(colors), _mm_packus_epi16(words0, words1));
+ for (int v =0; v <4; ++v) {
+ Store(out, colors[v]);
+ out += stride;
+ }
+ }
+#endif
+ for (; i < vertices.size(); ++i) {
+ const glm::vec3& c = vertices[i].color;
+ const std::array<uint8_t,4> color = { ToUnorm8(c.x), ToUnorm8(c.y), ToUnorm8(c.z),255 };
+ Store(out, color);
+ out += stride;
+ }
+}
+
+void PackTexCoordsFloat2(std::span<const Vertex> vertices, std::byte* out, uint32_t stride)
+{
+ for (const Vertex& vertex : vertices) {
+ Store(out, vertex.texCoord);
+ out += stride;
+ }
+}
+
+void PackTexCoordsUnorm16(std::span<const Vertex> vertices, std::byte* out, uint32_t stride)
+{
+ size_t i =0;
+#ifdef VENG_VERTEX_PACK_SSE2
+ // Four vertices per iteration, two texture coordinates in each half register
+ const __m128 zero = _mm_setzero_ps();
+ const __m128 unit = _mm_set1_ps(1.0f);
+ const __m128 scale = _mm_set1_ps(65535.0f);
+ const auto convert = [&](const Vertex& first, const Vertex& second) {
+ const __m128 pair = _mm_movelh_ps(Load2(&first.texCoord.x), Load2(&second.texCoord.x));
+ return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(pair, zero), unit), scale));
+ };
+ for (; i +4 <= vertices.size(); i +=4) {
+ alignas(16) uint32_t texCoords[4];
+ _mm_store_si128(reinterpret_cast<__m128i*>(texCoords), Narrow16(convert(vertices[i], vertices[i +1]), convert(vertices[i +2], vertices[i +3])));
+ for (int v =0; v <4; ++v) {
+ Store(out, texCoords[v]);
+ out += stride;
+ }
+ }
+#endif
+ for (; i < vertices.size(); ++i) {
+ const glm::vec2& t = vertices[i].texCoord;
+ const std::array<uint16_t,2> texCoord = { ToUnorm16(t.x), ToUnorm16(t.y) };
+ Store(out, texCoord);
+ out += stride;
+ }
+}
+
+} // namespace veng
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vulkan/vulkan.h>
+#include "vertex.h"
+
+namespace veng {
+
+// Strided converters from Vertex to the packed GPU formats below; SSE2 where
+// available, scalar otherwise. `out` points at the attribute in the first
+// packed vertex.
+void PackPositionsFloat3(std::span<const Vertex> vertices, std::byte* out, uint32_t stride);
+void PackPositionsHalf4(std::span<const Vertex> vertices, std::byte* out, uint32_t stride);
+void PackColorsFloat3(std::span<const Vertex> vertices, std::byte* out, uint32_t stride);
+void PackColorsUnorm8(std::span<const Vertex> vertices, std::byte* out, uint32_t stride);
+void PackTexCoordsFloat2(std::span<const Vertex> vertices, std::byte* out, uint32_t stride);
+void PackTexCoordsUnorm16(std::span<const Vertex> vertices, std::byte* out, uint32_t stride);
+
+// Round to nearest even; overflow becomes infinity
+std::uint16_t FloatToHalf(float value);
+float HalfToFloat(std::uint16_t value);
+
+// Vertex attributes. Each one has the shader location it feeds (see
+// shaders/basic.vert), its Vulkan format and packed size, and a converter.
+// Vertex fetch expands every format to float, so one shader serves all layouts.
+namespace vertex_attribute {
+
+struct PositionFloat3 {
+ static constexpr uint32_t kLocation =0;
+ static constexpr VkFormat kFormat = VK_FORMAT_R32G32B32_SFLOAT;
+ static constexpr uint32_t kSize =12;
+ static void Pack(std::span<const Vertex> v, std::byte* out, uint32_t stride) { PackPositionsFloat3(v, out, stride); }
+};
+
+// w = 1; about 3 significant digits, so meshes should be modelled near the origin
+struct PositionHalf4 {
+ static constexpr uint32_t kLocation =0;
+ static constexpr VkFormat kFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+ static constexpr uint32_t kSize =8;
+ static void Pack(std::span<const Vertex> v, std::byte* out, uint32_t stride) { PackPositionsHalf4(v, out, stride); }
+};
+
+struct ColorFloat3 {
+ static constexpr uint32_t kLocation =1;
+ static constexpr VkFormat kFormat = VK_FORMAT_R32G32B32_SFLOAT;
+ static constexpr uint32_t kSize =12;
+ static void Pack(std::span<const Vertex> v, std::byte* out, uint32_t stride) { PackColorsFloat3(v, out, stride); }
+};
+
+// Clamped to [0, 1], alpha = 1
+struct ColorUnorm8 {
+ static constexpr uint32_t kLocation =1;
+ static constexpr VkFormat kFormat = VK_FORMAT_R8G8B8A8_UNORM;
+ static constexpr uint32_t kSize =4;
+ static void Pack(std::span<const Vertex> v, std::byte* out, uint32_t stride) { PackColorsUnorm8(v, out, stride); }
+};
+
+struct TexCoordFloat2 {
+ static constexpr uint32_t kLocation =2;
+ static constexpr VkFormat kFormat = VK_FORMAT_R32G32_SFLOAT;
+ static constexpr uint32_t kSize =8;
+ static void Pack(std::span<const Vertex> v, std::byte* out, uint32_t stride) { PackTexCoordsFloat2(v, out, stride); }
+};
+
+// Clamped to [0, 1]: tiling texture coordinates need TexCoordFloat2
+struct TexCoordUnorm16 {
+ static constexpr uint32_t kLocation =2;
+ static constexpr VkFormat kFormat = VK_FORMAT_R16G16_UNORM;
+ static constexpr uint32_t kSize =4;
+ static void Pack(std::span<const Vertex> v, std::byte* out, uint32_t stride) { PackTexCoordsUnorm16(v, out, stride); }
+};
+
+} // namespace vertex_attribute
+
+// An interleaved vertex buffer layout, attributes packed in the order given.
+// Binding and attribute descriptions for the pipeline are constant expressions.
+template <typename... Attributes>
+struct VertexLayout {
+ static constexpr uint32_t kStride = (Attributes::kSize + ...);
+ static constexpr uint32_t kAttributeCount = sizeof...(Attributes);
+
+ static constexpr VkVertexInputBindingDescription GetBindingDescription()
+ {
+ VkVertexInputBindingDescription description{};
+ description.binding =0;
+ description.stride = kStride;
+ description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+ return description;
+ }
+
+ static constexpr std::array<VkVertexInputAttributeDescription, kAttributeCount> GetAttributeDescriptions()
+ {
+ std::array<VkVertexInputAttributeDescription, kAttributeCount> descriptions{};
+ uint32_t index =0;
+ uint32_t offset =0;
+ ((descriptions[index++] = { Attributes::kLocation,0, Attributes::kFormat, offset }, offset += Attributes::kSize), ...);
+ return descriptions;
+ }
+
+ // `out` holds vertices.size() * kStride bytes
+ static void Pack(std::span<const Vertex> vertices, std::byte* out)
+ {
+ uint32_t offset =0;
+ ((Attributes::Pack(vertices, out + offset, kStride), offset += Attributes::kSize), ...);
+ }
+};
+
+// Same bytes as Vertex, uploaded without conversion
+using FullVertexLayout = VertexLayout<vertex_attribute::PositionFloat3, vertex_attribute::ColorFloat3, vertex_attribute::TexCoordFloat2>;
+// 16 bytes instead of 32
+using CompactVertexLayout = VertexLayout<vertex_attribute::PositionHalf4, vertex_attribute::ColorUnorm8, vertex_attribute::TexCoordUnorm16>;
+
+static_assert(FullVertexLayout::kStride == sizeof(Vertex), "FullVertexLayout must match Vertex");
+static_assert(CompactVertexLayout::kStride ==16);
+
+// What CreateVertexBuffer uploads and the pipeline reads, chosen when building
+// (premake --vertex-layout=compact defines VENG_COMPACT_VERTICES)
+#ifdef VENG_COMPACT_VERTICES
+using GpuVertexLayout = CompactVertexLayout;
+constexpr const char* kGpuVertexLayoutName = "compact";
+#else
+using GpuVertexLayout = FullVertexLayout;
+constexpr const char* kGpuVertexLayoutName = "full";
+#endif
+
+} // namespace veng
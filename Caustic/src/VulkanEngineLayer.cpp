@@ -3,6 +3,7 @@
 
 #include <imgui.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
 
 // Include the LogMat4 function from WalnutGraphics.cpp
 extern void LogMat4(const glm::mat4& m, const char* name);
@@ -45,6 +46,7 @@ void VulkanEngineLayer::OnUpdate(float ts)
 
 void VulkanEngineLayer::OnUIRender()
 {
+ WL_PROFILE_FUNC();
  RenderEngine();
  RenderUI();
 }
@@ -81,6 +83,11 @@ void VulkanEngineLayer::InitializeEngine()
  };
 
  m_IndexBuffer = m_Graphics->CreateIndexBuffer(indices);
+ m_MeshUploadTicket = m_Graphics->GetPendingUploadTicket();
+
+ // Picking and camera framing go through the BVH of the mesh
+ m_SceneBvh.Build(vertices, indices);
+ m_SceneBounds = m_SceneBvh.GetBounds();
 
  // Load default texture from textures/texture.png
  try {
@@ -94,10 +101,12 @@ void VulkanEngineLayer::InitializeEngine()
  projection[1][1] *= -1; // Flip Y-axis for Vulkan
  glm::mat4 view = glm::lookAt(glm::vec3(2.0f,2.0f,2.0f), glm::vec3(0.0f,0.0f,0.0f), glm::vec3(0.0f,0.0f,1.0f));
  m_Graphics->SetViewProjection(view, projection);
+ m_ViewProjection = projection * view;
 
  // Set the model matrix to position the quad in world space
  glm::mat4 model = glm::rotate(glm::mat4(1.0f), glm::radians(0.0f), glm::vec3(0.0f,0.0f,1.0f));
  m_Graphics->SetModelMatrix(model);
+ m_ModelMatrix = model;
 
  // Log the model matrix for debugging
  LogMat4(model, "Model Matrix");
@@ -142,29 +151,19 @@ void VulkanEngineLayer::CleanupEngine()
 
 void VulkanEngineLayer::RenderEngine()
 {
+ WL_PROFILE_FUNC();
  if (!m_EngineInitialized)
  return;
 
  glm::vec4 bgColor = glm::vec4(0.0f, 0.0f, 0.0f,1.0f);
  m_Graphics->SetClearColor(bgColor);
 
- try {
- if (m_Graphics->BeginFrame()) {
- // Render both quads by using the correct index count (12)
- m_Graphics->RenderIndexedBuffer(m_VertexBuffer, m_IndexBuffer, 12);
- m_Graphics->EndFrame();
- }
- } catch (const std::exception& e) {
- std::cout << "Rendering error: " << e.what() << std::endl;
- // Continue running but skip this frame
- }
-
- // Display the rendered triangle viewport with live image
+ // Display the rendered viewport with live image
  ImGui::Begin("Viewport");
 
- // Detect viewport size and trigger resize if needed
+ // Detect viewport size and resize before rendering, so the target shown
+ // below always holds this frame's contents
  ImVec2 viewportSize = ImGui::GetContentRegionAvail();
- viewportSize.y -=0; // Leave space for controls
 
  uint32_t newWidth = static_cast<uint32_t>(viewportSize.x);
  uint32_t newHeight = static_cast<uint32_t>(viewportSize.y);
@@ -180,15 +179,34 @@ void VulkanEngineLayer::RenderEngine()
  }
  }
 
- // Display the rendered image from the graphics engine
- if (auto renderedImage = m_Graphics->GetRenderedImage()) {
- ImGui::Image(renderedImage->GetDescriptorSet(), viewportSize);
+ try {
+ if (m_Graphics->BeginFrame()) {
+ // Render both quads by using the correct index count (12)
+ if (m_Graphics->IsUploadReady(m_MeshUploadTicket)) {
+ m_Graphics->RenderIndexedBuffer(m_VertexBuffer, m_IndexBuffer, 12, m_SceneBounds);
+ }
+ m_Graphics->EndFrame();
+ }
+ } catch (const std::exception& e) {
+ std::cout << "Rendering error: " << e.what() << std::endl;
+ // Continue running but skip this frame
+ }
+
+ // Zero-copy: the GPU color target itself; CpuReadback: the Walnut::Image copy
+ if (VkDescriptorSet viewportTexture = m_Graphics->GetViewportTexture()) {
+ ImGui::Image(viewportTexture, viewportSize);
+ if (ImGui::IsItemClicked(ImGuiMouseButton_Left)) {
+ const ImVec2 mouse = ImGui::GetMousePos();
+ const ImVec2 origin = ImGui::GetItemRectMin();
+ PickAt(ImVec2(mouse.x - origin.x, mouse.y - origin.y), viewportSize);
+ }
  }
  ImGui::End();
 }
 
 void VulkanEngineLayer::RenderUI()
 {
+ WL_PROFILE_FUNC();
 
  // ImGui demo window for reference
  if (m_ShowDemoWindow)
@@ -196,12 +214,56 @@ void VulkanEngineLayer::RenderUI()
  ImGui::ShowDemoWindow(&m_ShowDemoWindow);
  }
 
+ if (m_ShowProfiler)
+ {
+ m_ProfilerPanel.OnUIRender();
+ }
+
  // Advanced Engine Controls with real-time parameters
  if (ImGui::Begin("Debug"))
  {
  ImGui::Separator();
  ImGui::Text("DEBUG WINDOWS");
  ImGui::Checkbox("Show ImGui Demo", &m_ShowDemoWindow);
+ ImGui::Checkbox("Show CPU Profiler", &m_ShowProfiler);
+
+ if (m_Graphics) {
+ bool zeroCopy = m_Graphics->GetDisplayMode() == veng::DisplayMode::ZeroCopy;
+ if (ImGui::Checkbox("Zero-copy viewport", &zeroCopy)) {
+ m_Graphics->SetDisplayMode(zeroCopy ? veng::DisplayMode::ZeroCopy : veng::DisplayMode::CpuReadback);
+ }
+ bool frustumCulling = m_Graphics->IsFrustumCullingEnabled();
+ if (ImGui::Checkbox("Frustum culling", &frustumCulling)) {
+ m_Graphics->SetFrustumCulling(frustumCulling);
+ }
+ if (m_Graphics->IsOcclusionCullingSupported()) {
+ bool occlusionCulling = m_Graphics->IsOcclusionCullingEnabled();
+ if (ImGui::Checkbox("Occlusion culling", &occlusionCulling)) {
+ m_Graphics->SetOcclusionCulling(occlusionCulling);
+ }
+ }
+ float lodError = m_Graphics->GetLodErrorPixels();
+ if (ImGui::SliderFloat("LOD error (px)", &lodError,0.25f,8.0f)) {
+ m_Graphics->SetLodErrorPixels(lodError);
+ }
+
+ // Upload path comparison: same data through the graphics queue and the transfer queue
+ ImGui::Separator();
+ ImGui::Text("Uploads: %s", m_Graphics->GetUploadStats().dedicatedTransferQueue ? "dedicated transfer queue" : "graphics queue");
+ if (ImGui::Button("Run upload benchmark (256 MiB)")) {
+ m_UploadBenchmark = m_Graphics->RunUploadBenchmark(256ull *1024 *1024,4ull *1024 *1024);
+ m_HasUploadBenchmark = true;
+ }
+ if (m_HasUploadBenchmark) {
+ const double mib = m_UploadBenchmark.bytes / (1024.0 *1024.0);
+ ImGui::Text("Graphics queue: %.1f ms (%.0f MiB/s), frame probe %.2f ms", m_UploadBenchmark.graphicsQueueMs, mib / (m_UploadBenchmark.graphicsQueueMs /1000.0), m_UploadBenchmark.graphicsQueueProbeMs);
+ if (m_UploadBenchmark.transferQueueAvailable) {
+ ImGui::Text("Transfer queue: %.1f ms (%.0f MiB/s), frame probe %.2f ms", m_UploadBenchmark.transferQueueMs, mib / (m_UploadBenchmark.transferQueueMs /1000.0), m_UploadBenchmark.transferQueueProbeMs);
+ } else {
+ ImGui::Text("Transfer queue: not available on this device");
+ }
+ }
+ }
 
  // Camera controls
  ImGui::Separator();
@@ -226,6 +288,17 @@ void VulkanEngineLayer::RenderUI()
  glm::vec3 viewDir = glm::normalize(m_CurrentCameraTarget - m_CurrentCameraPosition);
  ImGui::Text("View Dir: (%.2f, %.2f, %.2f)", viewDir.x, viewDir.y, viewDir.z);
 
+ // Last click in the viewport
+ ImGui::Separator();
+ ImGui::Text("Picking (%u triangles, %u BVH nodes)", m_SceneBvh.GetBuildStats().triangles, m_SceneBvh.GetBuildStats().nodes);
+ if (!m_HasPick) {
+ ImGui::Text("Click the viewport to pick");
+ } else if (!m_PickHit.IsHit()) {
+ ImGui::Text("Nothing under the cursor (%.3f ms)", m_PickMs);
+ } else {
+ ImGui::Text("Triangle %u at (%.2f, %.2f, %.2f) (%.3f ms)", m_PickHit.triangle, m_PickPosition.x, m_PickPosition.y, m_PickPosition.z, m_PickMs);
+ }
+
  // Show viewport / render target sizes to diagnose aspect mismatches
  if (m_Graphics) {
  ImGui::Separator();
@@ -235,10 +308,92 @@ void VulkanEngineLayer::RenderUI()
  float gpuAspect = m_Graphics->GetRenderHeight() ==0 ?0.0f : static_cast<float>(m_Graphics->GetRenderWidth()) / static_cast<float>(m_Graphics->GetRenderHeight());
  ImGui::Text("Aspect (ImGui): %.4f", guiAspect);
  ImGui::Text("Aspect (GPU): %.4f", gpuAspect);
+
+ // GPU timestamps, resolved from frames that already retired
+ ImGui::Separator();
+ ImGui::Text("GPU Timings (ms)");
+ if (!m_Graphics->IsGpuTimingSupported()) {
+ ImGui::Text("Timestamp queries not supported on this queue");
+ } else if (ImGui::BeginTable("GpuTimings",5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+ ImGui::TableSetupColumn("Scope");
+ ImGui::TableSetupColumn("Last");
+ ImGui::TableSetupColumn("Min");
+ ImGui::TableSetupColumn("Avg");
+ ImGui::TableSetupColumn("p99");
+ ImGui::TableHeadersRow();
+ for (const veng::GpuScopeStats& scope : m_Graphics->GetGpuTimings()) {
+ ImGui::TableNextRow();
+ ImGui::TableNextColumn(); ImGui::TextUnformatted(scope.name.c_str());
+ ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.lastMs);
+ ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.minMs);
+ ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.avgMs);
+ ImGui::TableNextColumn(); ImGui::Text("%.3f", scope.p99Ms);
+ }
+ ImGui::EndTable();
+ }
  }
 
  ImGui::End();
  }
+
+ RenderFrameTiming();
+}
+
+// Frame pacing: how long the CPU spent recording, how long it blocked on the
+// frame-slot fence, and how often the GPU was still busy with the previous
+// frame when recording started (i.e. CPU and GPU actually overlapped).
+void VulkanEngineLayer::RenderFrameTiming()
+{
+ if (!m_Graphics) {
+ return;
+ }
+
+ const veng::FrameStats& stats = m_Graphics->GetFrameStats();
+ m_CpuRecordHistory[m_FrameHistoryOffset] = stats.cpuRecordMs;
+ m_FenceWaitHistory[m_FrameHistoryOffset] = stats.fenceWaitMs;
+ m_FrameHistoryOffset = (m_FrameHistoryOffset +1) % kFrameHistorySize;
+
+ if (ImGui::Begin("Frame Timing"))
+ {
+ ImGui::Text("Frame time: %.3f ms (%.1f FPS)", m_LastFrameTime *1000.0f, ImGui::GetIO().Framerate);
+ ImGui::Text("Frames in flight: %u / %d", stats.framesInFlight, veng::WalnutGraphics::MAX_FRAMES_IN_FLIGHT);
+
+ float overlap = stats.totalFrames ==0 ?0.0f : 100.0f * static_cast<float>(stats.overlappedFrames) / static_cast<float>(stats.totalFrames);
+ ImGui::Text("CPU/GPU overlap: %.1f%% of %llu frames", overlap, static_cast<unsigned long long>(stats.totalFrames));
+ ImGui::Text("Readback: %llu frames delivered, %u allocations this frame",
+ static_cast<unsigned long long>(stats.readbackFramesDelivered), stats.readbackAllocations);
+ ImGui::Text("Render queue: %u draws, %u binds (%u skipped)", stats.queuedDraws, stats.queueBinds, stats.queueBindsSaved);
+ ImGui::Text("Queue recording: %.2f ms on %u threads", stats.queueRecordMs, stats.recordingThreads);
+ ImGui::Text("Triangles: %llu", static_cast<unsigned long long>(stats.triangles));
+ ImGui::Text("Culling (%s): %u of %u visible, %.3f ms", veng::GetCullKernelName(m_Graphics->GetCullKernel()), stats.cullVisible, stats.cullTested, stats.cullMs);
+ ImGui::Text("Meshlets: %u of %u drawn", stats.clustersVisible, stats.clustersTested);
+ ImGui::Text("GPU culling: %u of %u visible (%u late)", stats.gpuCullVisible, stats.gpuCullTested, stats.gpuCullLateVisible);
+
+ char overlay[32];
+ snprintf(overlay, sizeof(overlay), "%.3f ms", stats.cpuRecordMs);
+ ImGui::PlotLines("CPU record", m_CpuRecordHistory.data(), kFrameHistorySize, m_FrameHistoryOffset, overlay,0.0f, FLT_MAX, ImVec2(0,60));
+ snprintf(overlay, sizeof(overlay), "%.3f ms", stats.fenceWaitMs);
+ ImGui::PlotLines("Fence wait", m_FenceWaitHistory.data(), kFrameHistorySize, m_FrameHistoryOffset, overlay,0.0f, FLT_MAX, ImVec2(0,60));
+
+ const veng::AllocatorStats memory = m_Graphics->GetMemoryStats();
+ constexpr float kMiB =1024.0f *1024.0f;
+ ImGui::Separator();
+ ImGui::Text("GPU Memory");
+ ImGui::Text("Used / reserved: %.1f / %.1f MiB", memory.usedBytes / kMiB, memory.reservedBytes / kMiB);
+ ImGui::Text("Fragmentation: %.1f%% (largest free range %.1f MiB)", memory.fragmentation *100.0f, memory.largestFreeRange / kMiB);
+ ImGui::Text("Device memory objects: %u / %u", memory.deviceMemoryObjects, memory.maxDeviceMemoryObjects);
+ ImGui::Text("Live allocations: %u", memory.liveAllocations);
+ ImGui::Text("Allocations last frame: %u (%u vkAllocateMemory)", memory.allocationsLastFrame, memory.deviceAllocationsLastFrame);
+
+ const veng::UploadStats& uploads = m_Graphics->GetUploadStats();
+ ImGui::Separator();
+ ImGui::Text("Uploads");
+ ImGui::Text("Uploads / submissions: %llu / %llu", static_cast<unsigned long long>(uploads.uploads), static_cast<unsigned long long>(uploads.submissions));
+ ImGui::Text("Uploaded: %.1f MiB", uploads.bytesUploaded / kMiB);
+ ImGui::Text("Batches in flight: %u (staging stalls %llu)", uploads.batchesInFlight, static_cast<unsigned long long>(uploads.stagingStalls));
+ ImGui::Text("Queue: %s", uploads.dedicatedTransferQueue ? "transfer" : "graphics");
+ }
+ ImGui::End();
 }
 
 // New overload: explicit viewport dimensions
@@ -257,11 +412,8 @@ void VulkanEngineLayer::ResetCamera(uint32_t renderWidth, uint32_t renderHeight)
  const float fitMargin = glm::max(1.0f, m_CameraSettings.fitMargin);
  const float nearClip = glm::max(0.001f, m_CameraSettings.nearClip);
 
- // Approximate scene bounds: the default quad is ~1x1 centered at origin.
- // Replace this with real scene bounds when available.
- const float approxHalfWidth =0.5f;
- const float approxHalfHeight =0.5f;
- const float sceneRadius = glm::sqrt(approxHalfWidth * approxHalfWidth + approxHalfHeight * approxHalfHeight);
+ // Bounding sphere of the scene's box
+ const float sceneRadius = glm::max(0.001f, glm::length(m_SceneBounds.extent));
 
  // Compute required distance so the bounding sphere fits the frustum.
  const float halfV = verticalFOV *0.5f;
@@ -278,7 +430,7 @@ void VulkanEngineLayer::ResetCamera(uint32_t renderWidth, uint32_t renderHeight)
  preferredDir = glm::normalize(preferredDir);
 
  // Set camera in world space (Z-up)
- const glm::vec3 cameraTarget = glm::vec3(0.0f,0.0f,0.0f);
+ const glm::vec3 cameraTarget = m_SceneBounds.center;
  const glm::vec3 cameraPosition = cameraTarget + preferredDir * requiredDistance;
  const glm::vec3 cameraUp = glm::vec3(0.0f,0.0f,1.0f); // Z-up consistent with InitializeEngine
 
@@ -304,6 +456,30 @@ void VulkanEngineLayer::ResetCamera(uint32_t renderWidth, uint32_t renderHeight)
 #endif
 
  m_Graphics->SetViewProjection(view, projection);
+ m_ViewProjection = projection * view;
+}
+
+// Casts the ray under a viewport pixel through the scene BVH. The ray runs
+// from the near to the far plane, unprojected into the mesh's own space.
+void VulkanEngineLayer::PickAt(ImVec2 viewportPosition, ImVec2 viewportSize)
+{
+ if (m_SceneBvh.IsEmpty() || viewportSize.x <=0.0f || viewportSize.y <=0.0f)
+ return;
+
+ const auto start = std::chrono::steady_clock::now();
+ const glm::vec2 ndc(2.0f * viewportPosition.x / viewportSize.x -1.0f,2.0f * viewportPosition.y / viewportSize.y -1.0f);
+ const glm::mat4 toModel = glm::inverse(m_ViewProjection * m_ModelMatrix);
+ const glm::vec4 nearPoint = toModel * glm::vec4(ndc, -1.0f,1.0f);
+ const glm::vec4 farPoint = toModel * glm::vec4(ndc,1.0f,1.0f);
+ const glm::vec3 from = glm::vec3(nearPoint) / nearPoint.w;
+ const glm::vec3 to = glm::vec3(farPoint) / farPoint.w;
+
+ m_PickHit = veng::RayHit{};
+ if (m_SceneBvh.IntersectSegment(from, to, m_PickHit)) {
+ m_PickPosition = glm::vec3(m_ModelMatrix * glm::vec4(from + (to - from) * m_PickHit.t,1.0f));
+ }
+ m_PickMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+ m_HasPick = true;
 }
 
 // Keep no-arg overload for compatibility: forward to explicit version
@@ -3,11 +3,15 @@
 #include "Walnut/Layer.h"
 #include "Walnut/Application.h"
 #include "Walnut/Timer.h"
+#include "Walnut/UI/ProfilerPanel.h"
+
+#include <array>
 
 // Include your Vulkan engine headers
 #include "Engine/WalnutGraphics.h"
 #include "Engine/vertex.h"
 #include "Engine/buffer_handle.h"
+#include "Engine/bvh.h"
 
 class VulkanEngineLayer : public Walnut::Layer
 {
@@ -27,6 +31,8 @@ private:
     void CleanupEngine();
     void RenderEngine();
     void RenderUI();
+    void RenderFrameTiming();
+    void PickAt(ImVec2 viewportPosition, ImVec2 viewportSize);
     ImVec2 GetViewportResolution() const;
 
 
@@ -39,6 +45,12 @@ private:
     // Scene objects
     veng::BufferHandle m_VertexBuffer;
     veng::BufferHandle m_IndexBuffer;
+    // Bounds of the scene mesh, for culling and camera framing
+    veng::Aabb m_SceneBounds;
+    // Ray queries against the scene mesh (viewport picking)
+    veng::Bvh m_SceneBvh;
+    // The mesh is drawn once its upload has reached the graphics queue
+    veng::UploadTicket m_MeshUploadTicket{};
     
     // Walnut integration
     Walnut::Timer m_Timer;
@@ -50,6 +62,10 @@ private:
     // UI state
     bool m_ShowDemoWindow = false;
     bool m_ShowEngineStats = true;
+    bool m_ShowProfiler = true;
+    Walnut::UI::ProfilerPanel m_ProfilerPanel;
+    veng::UploadBenchmarkResult m_UploadBenchmark{};
+    bool m_HasUploadBenchmark = false;
 
     // Camera/settings (moved from cpp globals)
     struct CameraSettings {
@@ -63,6 +79,20 @@ private:
     // Runtime camera state
     glm::vec3 m_CurrentCameraPosition = glm::vec3(2.0f, 2.0f, 2.0f);
     glm::vec3 m_CurrentCameraTarget = glm::vec3(0.0f);
+    glm::mat4 m_ModelMatrix = glm::mat4(1.0f);
+    glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+
+    // Last viewport click, picked against m_SceneBvh
+    bool m_HasPick = false;
+    veng::RayHit m_PickHit{};
+    glm::vec3 m_PickPosition = glm::vec3(0.0f);
+    double m_PickMs = 0.0;
+
+    // Frame timing history (ring buffers fed once per frame)
+    static constexpr int kFrameHistorySize = 240;
+    std::array<float, kFrameHistorySize> m_CpuRecordHistory{};
+    std::array<float, kFrameHistorySize> m_FenceWaitHistory{};
+    int m_FrameHistoryOffset = 0;
 
     // Last viewport size from ImGui
     uint32_t m_LastViewportWidth = 0;
@@ -2,6 +2,7 @@
 
 #include "Walnut/UI/UI.h"
 #include "Walnut/Core/Log.h"
+#include "Walnut/Profiler.h"
 
 //
 // Adapted from Dear ImGui Vulkan example
@@ -14,6 +15,7 @@
 
 #include <stdio.h>          // printf, fprintf
 #include <stdlib.h>         // abort
+#include <string.h>         // strcmp
 #define GLFW_INCLUDE_NONE
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -51,6 +53,10 @@ static VkPhysicalDevice         g_PhysicalDevice = VK_NULL_HANDLE;
 static VkDevice                 g_Device = VK_NULL_HANDLE;
 static uint32_t                 g_QueueFamily = (uint32_t)-1;
 static VkQueue                  g_Queue = VK_NULL_HANDLE;
+static uint32_t                 g_TransferQueueFamily = (uint32_t)-1;
+static VkQueue                  g_TransferQueue = VK_NULL_HANDLE;
+static VkPhysicalDeviceFeatures g_DeviceFeatures = {};
+static bool                     g_DrawIndirectCount = false;
 static VkDebugReportCallbackEXT g_DebugReport = VK_NULL_HANDLE;
 static VkPipelineCache          g_PipelineCache = VK_NULL_HANDLE;
 static VkDescriptorPool         g_DescriptorPool = VK_NULL_HANDLE;
@@ -181,35 +187,80 @@ static void SetupVulkan(const char** extensions, uint32_t extensions_count)
 				g_QueueFamily = i;
 				break;
 			}
+
+		// Prefer a transfer-only family (usually backed by a DMA engine), then any
+		// non-graphics family that can transfer. Without one, uploads share the graphics queue.
+		for (uint32_t i = 0; i < count; i++)
+		{
+			VkQueueFlags flags = queues[i].queueFlags;
+			if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+			{
+				g_TransferQueueFamily = i;
+				break;
+			}
+		}
+		if (g_TransferQueueFamily == (uint32_t)-1)
+		{
+			for (uint32_t i = 0; i < count; i++)
+				if ((queues[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queues[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+				{
+					g_TransferQueueFamily = i;
+					break;
+				}
+		}
 		free(queues);
 		IM_ASSERT(g_QueueFamily != (uint32_t)-1);
 	}
 
-	// Create Logical Device (with 1 queue)
+	// Create Logical Device (with a graphics queue and, if available, a transfer queue)
 	{
+		// Draw counts written by GPU culling, when the device has them
 		int device_extension_count = 1;
-		const char* device_extensions[] = { "VK_KHR_swapchain" };
+		const char* device_extensions[] = { "VK_KHR_swapchain", VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME };
+		{
+			uint32_t properties_count = 0;
+			vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, NULL, &properties_count, NULL);
+			std::vector<VkExtensionProperties> properties(properties_count);
+			vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, NULL, &properties_count, properties.data());
+			for (const VkExtensionProperties& p : properties)
+				if (strcmp(p.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+					g_DrawIndirectCount = true;
+			if (g_DrawIndirectCount)
+				device_extension_count++;
+		}
 		const float queue_priority[] = { 1.0f };
-		VkDeviceQueueCreateInfo queue_info[1] = {};
+		VkDeviceQueueCreateInfo queue_info[2] = {};
 		queue_info[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queue_info[0].queueFamilyIndex = g_QueueFamily;
 		queue_info[0].queueCount = 1;
 		queue_info[0].pQueuePriorities = queue_priority;
+		queue_info[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queue_info[1].queueFamilyIndex = g_TransferQueueFamily;
+		queue_info[1].queueCount = 1;
+		queue_info[1].pQueuePriorities = queue_priority;
 		VkDeviceCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		create_info.queueCreateInfoCount = sizeof(queue_info) / sizeof(queue_info[0]);
+		create_info.queueCreateInfoCount = g_TransferQueueFamily != (uint32_t)-1 ? 2 : 1;
 		create_info.pQueueCreateInfos = queue_info;
 		create_info.enabledExtensionCount = device_extension_count;
 		create_info.ppEnabledExtensionNames = device_extensions;
 
-		// Enable device features we rely on (e.g. anisotropic filtering for samplers)
+		// Enable device features we rely on (e.g. anisotropic filtering for samplers),
+		// plus the indirect draw features when the device has them
+		VkPhysicalDeviceFeatures supportedFeatures{};
+		vkGetPhysicalDeviceFeatures(g_PhysicalDevice, &supportedFeatures);
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
 		create_info.pEnabledFeatures = &deviceFeatures;
 
 		err = vkCreateDevice(g_PhysicalDevice, &create_info, g_Allocator, &g_Device);
 		check_vk_result(err);
+		g_DeviceFeatures = deviceFeatures;
 		vkGetDeviceQueue(g_Device, g_QueueFamily,0, &g_Queue);
+		if (g_TransferQueueFamily != (uint32_t)-1)
+			vkGetDeviceQueue(g_Device, g_TransferQueueFamily, 0, &g_TransferQueue);
 	}
 
 	// Create Descriptor Pool
@@ -869,17 +920,25 @@ namespace Walnut {
 		ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 		ImGuiIO& io = ImGui::GetIO();
 
+		WL_PROFILE_THREAD("Main");
+
 		// Main loop
 		while (!glfwWindowShouldClose(m_WindowHandle) && m_Running)
 		{
+			WL_PROFILE_FRAME();
+
 			// Poll and handle events (inputs, window resize, etc.)
 			// You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
 			// - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
 			// - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
 			// Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-			glfwPollEvents();
+			{
+				WL_PROFILE_SCOPE("PollEvents");
+				glfwPollEvents();
+			}
 
 			{
+				WL_PROFILE_SCOPE("EventQueue");
 				std::scoped_lock<std::mutex> lock(m_EventQueueMutex);
 
 				// Process custom event queue
@@ -891,8 +950,11 @@ namespace Walnut {
 				}
 			}
 
-			for (auto& layer : m_LayerStack)
-				layer->OnUpdate(m_TimeStep);
+			{
+				WL_PROFILE_SCOPE("Layer::OnUpdate");
+				for (auto& layer : m_LayerStack)
+					layer->OnUpdate(m_TimeStep);
+			}
 
 			// Resize swap chain?
 			if (g_SwapChainRebuild)
@@ -975,20 +1037,27 @@ namespace Walnut {
 				if (!m_Specification.CustomTitlebar)
 					UI_DrawMenubar();
 
-				for (auto& layer : m_LayerStack)
-					layer->OnUIRender();
+				{
+					WL_PROFILE_SCOPE("Layer::OnUIRender");
+					for (auto& layer : m_LayerStack)
+						layer->OnUIRender();
+				}
 
 				ImGui::End();
 			}
 			else
 			{
 				// No dockspace - just render windows
+				WL_PROFILE_SCOPE("Layer::OnUIRender");
 				for (auto& layer : m_LayerStack)
 					layer->OnUIRender();
 			}
 
 			// Rendering
-			ImGui::Render();
+			{
+				WL_PROFILE_SCOPE("ImGui::Render");
+				ImGui::Render();
+			}
 			ImDrawData* main_draw_data = ImGui::GetDrawData();
 			const bool main_is_minimized = (main_draw_data->DisplaySize.x <= 0.0f || main_draw_data->DisplaySize.y <= 0.0f);
 			wd->ClearValue.color.float32[0] = clear_color.x * clear_color.w;
@@ -996,18 +1065,25 @@ namespace Walnut {
 			wd->ClearValue.color.float32[2] = clear_color.z * clear_color.w;
 			wd->ClearValue.color.float32[3] = clear_color.w;
 			if (!main_is_minimized)
+			{
+				WL_PROFILE_SCOPE("FrameRender");
 				FrameRender(this, wd, main_draw_data);
+			}
 
 			// Update and Render additional Platform Windows
 			if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
 			{
+				WL_PROFILE_SCOPE("PlatformWindows");
 				ImGui::UpdatePlatformWindows();
 				ImGui::RenderPlatformWindowsDefault();
 			}
 
 			// Present Main Platform Window
 			if (!main_is_minimized)
+			{
+				WL_PROFILE_SCOPE("FramePresent");
 				FramePresent(wd);
+			}
 			else
 				std::this_thread::sleep_for(std::chrono::milliseconds(5));
 
@@ -1057,6 +1133,41 @@ namespace Walnut {
 		return g_Device;
 	}
 
+	uint32_t Application::GetQueueFamilyIndex()
+	{
+		return g_QueueFamily;
+	}
+
+	VkQueue Application::GetQueue()
+	{
+		return g_Queue;
+	}
+
+	uint32_t Application::GetTransferQueueFamilyIndex()
+	{
+		return g_TransferQueue != VK_NULL_HANDLE ? g_TransferQueueFamily : g_QueueFamily;
+	}
+
+	VkQueue Application::GetTransferQueue()
+	{
+		return g_TransferQueue != VK_NULL_HANDLE ? g_TransferQueue : g_Queue;
+	}
+
+	bool Application::HasDedicatedTransferQueue()
+	{
+		return g_TransferQueue != VK_NULL_HANDLE;
+	}
+
+	const VkPhysicalDeviceFeatures& Application::GetEnabledDeviceFeatures()
+	{
+		return g_DeviceFeatures;
+	}
+
+	bool Application::HasDrawIndirectCount()
+	{
+		return g_DrawIndirectCount;
+	}
+
 	VkCommandBuffer Application::GetCommandBuffer(bool begin)
 	{
 		ImGui_ImplVulkanH_Window* wd = &g_MainWindowData;
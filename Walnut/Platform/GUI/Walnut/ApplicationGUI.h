@@ -80,6 +80,21 @@ namespace Walnut {
 		static VkPhysicalDevice GetPhysicalDevice();
 		static VkDevice GetDevice();
 
+		// Graphics/present queue shared with ImGui
+		static uint32_t GetQueueFamilyIndex();
+		static VkQueue GetQueue();
+
+		// Queue for uploads; falls back to the graphics queue when the device
+		// exposes no separate transfer family
+		static uint32_t GetTransferQueueFamilyIndex();
+		static VkQueue GetTransferQueue();
+		static bool HasDedicatedTransferQueue();
+
+		// Features the device was created with
+		static const VkPhysicalDeviceFeatures& GetEnabledDeviceFeatures();
+		// VK_KHR_draw_indirect_count was enabled
+		static bool HasDrawIndirectCount();
+
 		static VkCommandBuffer GetCommandBuffer(bool begin);
 		static void FlushCommandBuffer(VkCommandBuffer commandBuffer);
 
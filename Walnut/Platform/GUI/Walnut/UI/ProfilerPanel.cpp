@@ -0,0 +1,195 @@
+#include "ProfilerPanel.h"
+
+#include "misc/cpp/imgui_stdlib.h"
+
+#include <algorithm>
+#include <format>
+#include <functional>
+#include <vector>
+
+namespace Walnut::UI {
+
+	static ImU32 GetZoneColor(const char* name)
+	{
+		// Stable colour per zone name so the same zone reads the same across frames
+		const size_t hash = std::hash<std::string_view>{}(name);
+		const float hue = (float)(hash % 360) / 360.0f;
+		return ImColor::HSV(hue, 0.45f, 0.7f);
+	}
+
+	ProfilerPanel::ProfilerPanel(std::string_view title)
+		: m_Title(title)
+	{
+	}
+
+	void ProfilerPanel::OnUIRender()
+	{
+		ImGui::SetNextWindowSize(ImVec2(720, 420), ImGuiCond_FirstUseEver);
+		if (!ImGui::Begin(m_Title.c_str()))
+		{
+			ImGui::End();
+			return;
+		}
+
+#if !WL_ENABLE_PROFILING
+		ImGui::TextUnformatted("Profiling is compiled out (WL_ENABLE_PROFILING is 0)");
+#endif
+
+		if (!m_Paused)
+			m_Frame = Profiler::GetLastFrame();
+
+		ImGui::Text("Frame %llu  %.3f ms  %zu zones", (unsigned long long)m_Frame.Index, (m_Frame.End - m_Frame.Start) * 1e-6, m_Frame.Events.size());
+		ImGui::SameLine();
+		ImGui::Checkbox("Pause", &m_Paused);
+
+		uint64_t dropped = 0;
+		for (const ProfileThreadInfo& thread : Profiler::GetThreads())
+			dropped += thread.DroppedEvents;
+		if (dropped > 0)
+		{
+			ImGui::SameLine();
+			ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "%llu events dropped (ring full)", (unsigned long long)dropped);
+		}
+
+		// Capture
+		ImGui::SetNextItemWidth(240.0f);
+		ImGui::InputText("##tracepath", &m_TracePath);
+		ImGui::SameLine();
+		if (Profiler::IsCapturing())
+		{
+			if (ImGui::Button("Stop capture"))
+			{
+				if (Profiler::EndCapture(m_TracePath))
+					m_CaptureStatus = std::format("Wrote {} (open in ui.perfetto.dev or chrome://tracing)", m_TracePath);
+				else
+					m_CaptureStatus = std::format("Failed to write {}", m_TracePath);
+			}
+			ImGui::SameLine();
+			ImGui::Text("Capturing... %zu zones", Profiler::GetCaptureEventCount());
+		}
+		else
+		{
+			if (ImGui::Button("Start capture"))
+			{
+				Profiler::BeginCapture();
+				m_CaptureStatus.clear();
+			}
+			if (!m_CaptureStatus.empty())
+			{
+				ImGui::SameLine();
+				ImGui::TextUnformatted(m_CaptureStatus.c_str());
+			}
+		}
+
+		ImGui::Separator();
+		DrawFlameGraph();
+		ImGui::Separator();
+		DrawZoneTable();
+
+		ImGui::End();
+	}
+
+	void ProfilerPanel::DrawFlameGraph()
+	{
+		const std::vector<ProfileEvent>& events = m_Frame.Events;
+		if (events.empty() || m_Frame.End <= m_Frame.Start)
+			return;
+
+		const std::vector<ProfileThreadInfo> threads = Profiler::GetThreads();
+		const float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+		const float scale = width / (float)(m_Frame.End - m_Frame.Start);
+		const ImVec2 mouse = ImGui::GetIO().MousePos;
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+		// Events are sorted by thread, so each thread is one contiguous run
+		size_t first = 0;
+		while (first < events.size())
+		{
+			const uint32_t threadID = events[first].ThreadID;
+			size_t last = first;
+			uint32_t maxDepth = 0;
+			while (last < events.size() && events[last].ThreadID == threadID)
+				maxDepth = std::max(maxDepth, events[last++].Depth);
+
+			auto thread = std::find_if(threads.begin(), threads.end(), [threadID](const ProfileThreadInfo& info) { return info.ID == threadID; });
+			ImGui::TextUnformatted(thread != threads.end() ? thread->Name.c_str() : "Thread");
+
+			const ImVec2 origin = ImGui::GetCursorScreenPos();
+			ImGui::PushID((int)threadID);
+			ImGui::InvisibleButton("##flamegraph", ImVec2(width, (maxDepth + 1) * m_RowHeight));
+			ImGui::PopID();
+			const bool hovered = ImGui::IsItemHovered();
+
+			for (size_t i = first; i < last; i++)
+			{
+				const ProfileEvent& event = events[i];
+
+				// Zones that straddle the frame marker are clamped to the frame
+				float x0 = origin.x + std::max((float)(event.Start - m_Frame.Start) * scale, 0.0f);
+				float x1 = origin.x + std::min((float)(event.End - m_Frame.Start) * scale, width);
+				x1 = std::max(x1, x0 + 1.0f);
+				const float y0 = origin.y + event.Depth * m_RowHeight;
+				const ImVec2 min(x0, y0);
+				const ImVec2 max(x1, y0 + m_RowHeight - 1.0f);
+
+				drawList->AddRectFilled(min, max, GetZoneColor(event.Name));
+
+				const ImVec2 textSize = ImGui::CalcTextSize(event.Name);
+				if (textSize.x + 6.0f < x1 - x0)
+					drawList->AddText(ImVec2(x0 + 3.0f, y0 + (m_RowHeight - 1.0f - textSize.y) * 0.5f), IM_COL32(255, 255, 255, 255), event.Name);
+
+				if (hovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y)
+				{
+					ImGui::BeginTooltip();
+					ImGui::TextUnformatted(event.Name);
+					ImGui::Text("%.3f ms", (event.End - event.Start) * 1e-6);
+					ImGui::EndTooltip();
+				}
+			}
+
+			first = last;
+		}
+	}
+
+	void ProfilerPanel::DrawZoneTable()
+	{
+		struct ZoneTotal
+		{
+			std::string_view Name;
+			uint32_t Calls = 0;
+			int64_t Total = 0;
+		};
+
+		std::vector<ZoneTotal> totals;
+		for (const ProfileEvent& event : m_Frame.Events)
+		{
+			auto it = std::find_if(totals.begin(), totals.end(), [&](const ZoneTotal& total) { return total.Name == event.Name; });
+			if (it == totals.end())
+				it = totals.insert(totals.end(), ZoneTotal{ event.Name });
+			it->Calls++;
+			it->Total += event.End - event.Start;
+		}
+		std::sort(totals.begin(), totals.end(), [](const ZoneTotal& a, const ZoneTotal& b) { return a.Total > b.Total; });
+
+		if (ImGui::BeginTable("Zones", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp))
+		{
+			ImGui::TableSetupColumn("Zone");
+			ImGui::TableSetupColumn("Calls");
+			ImGui::TableSetupColumn("Total (ms)");
+			ImGui::TableHeadersRow();
+
+			for (const ZoneTotal& total : totals)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(total.Name.data(), total.Name.data() + total.Name.size());
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", total.Calls);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", total.Total * 1e-6);
+			}
+			ImGui::EndTable();
+		}
+	}
+
+}
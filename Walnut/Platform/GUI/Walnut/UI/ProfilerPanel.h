@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Walnut/Profiler.h"
+
+#include <string>
+#include <string_view>
+
+#include <imgui.h>
+
+namespace Walnut::UI {
+
+	// Flame graph of the last frame's CPU zones plus Chrome trace capture controls
+	class ProfilerPanel
+	{
+	public:
+		ProfilerPanel(std::string_view title = "CPU Profiler");
+		~ProfilerPanel() = default;
+
+		void OnUIRender();
+	private:
+		void DrawFlameGraph();
+		void DrawZoneTable();
+	private:
+		std::string m_Title;
+		std::string m_TracePath = "logs/trace.json";
+		std::string m_CaptureStatus;
+
+		ProfileFrame m_Frame;
+		bool m_Paused = false;
+		float m_RowHeight = 18.0f;
+	};
+
+}
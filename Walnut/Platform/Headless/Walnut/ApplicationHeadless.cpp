@@ -1,6 +1,7 @@
 #include "ApplicationHeadless.h"
 
 #include "Walnut/Core/Log.h"
+#include "Walnut/Profiler.h"
 
 #include <iostream>
 #include <chrono>
@@ -53,11 +54,18 @@ namespace Walnut {
 	{
 		m_Running = true;
 
+		WL_PROFILE_THREAD("Main");
+
 		// Main loop
 		while (m_Running)
 		{
-			for (auto& layer : m_LayerStack)
-				layer->OnUpdate(m_TimeStep);
+			WL_PROFILE_FRAME();
+
+			{
+				WL_PROFILE_SCOPE("Layer::OnUpdate");
+				for (auto& layer : m_LayerStack)
+					layer->OnUpdate(m_TimeStep);
+			}
 
 			if (m_Specification.SleepDuration > 0.0f)
 				std::this_thread::sleep_for(std::chrono::milliseconds(m_Specification.SleepDuration));
@@ -0,0 +1,217 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace Walnut {
+
+	// Single producer (the owning thread), single consumer (MarkFrame)
+	struct ThreadRing
+	{
+		std::array<ProfileEvent, Profiler::RingCapacity> Events;
+		std::atomic<uint64_t> WriteIndex = 0;
+		std::atomic<uint64_t> ReadIndex = 0;
+		std::atomic<uint64_t> Dropped = 0;
+		uint32_t ID = 0;
+		std::string Name;
+		bool Retired = false; // owning thread exited; reused once drained
+	};
+
+	static std::mutex s_RingsMutex;
+	static std::vector<std::unique_ptr<ThreadRing>> s_Rings; // never shrinks; rings outlive their threads
+
+	struct ThreadRingOwner
+	{
+		ThreadRing* Ring = nullptr;
+
+		~ThreadRingOwner()
+		{
+			if (!Ring)
+				return;
+
+			std::scoped_lock<std::mutex> lock(s_RingsMutex);
+			Ring->Retired = true;
+		}
+	};
+	static thread_local ThreadRingOwner t_Owner;
+
+	static ThreadRing& GetThreadRing()
+	{
+		if (t_Owner.Ring)
+			return *t_Owner.Ring;
+
+		std::scoped_lock<std::mutex> lock(s_RingsMutex);
+		for (auto& ring : s_Rings)
+		{
+			// Short lived threads hand their ring (and lane in the trace) to the next thread
+			if (ring->Retired && ring->ReadIndex.load(std::memory_order_relaxed) == ring->WriteIndex.load(std::memory_order_relaxed))
+			{
+				ring->Retired = false;
+				ring->Name = std::format("Thread {}", ring->ID);
+				t_Owner.Ring = ring.get();
+				return *ring;
+			}
+		}
+
+		auto& ring = s_Rings.emplace_back(std::make_unique<ThreadRing>());
+		ring->ID = (uint32_t)s_Rings.size();
+		ring->Name = std::format("Thread {}", ring->ID);
+		t_Owner.Ring = ring.get();
+		return *ring;
+	}
+
+	void Profiler::Record(const char* name, int64_t start, int64_t end, uint32_t depth)
+	{
+		ThreadRing& ring = GetThreadRing();
+
+		const uint64_t write = ring.WriteIndex.load(std::memory_order_relaxed);
+		if (write - ring.ReadIndex.load(std::memory_order_acquire) >= RingCapacity)
+		{
+			ring.Dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		ProfileEvent& event = ring.Events[write % RingCapacity];
+		event.Name = name;
+		event.Start = start;
+		event.End = end;
+		event.Depth = depth;
+		event.ThreadID = ring.ID;
+		ring.WriteIndex.store(write + 1, std::memory_order_release);
+	}
+
+	void Profiler::SetThreadName(const char* name)
+	{
+		ThreadRing& ring = GetThreadRing();
+
+		std::scoped_lock<std::mutex> lock(s_RingsMutex);
+		ring.Name = name;
+	}
+
+	static void Drain(ThreadRing& ring, std::vector<ProfileEvent>& out)
+	{
+		const uint64_t read = ring.ReadIndex.load(std::memory_order_relaxed);
+		const uint64_t write = ring.WriteIndex.load(std::memory_order_acquire);
+		for (uint64_t i = read; i < write; i++)
+			out.push_back(ring.Events[i % Profiler::RingCapacity]);
+		ring.ReadIndex.store(write, std::memory_order_release);
+	}
+
+	void Profiler::MarkFrame()
+	{
+		const int64_t now = Now();
+
+		s_LastFrame.Index = s_FrameIndex++;
+		s_LastFrame.Start = s_FrameStart;
+		s_LastFrame.End = now;
+		s_LastFrame.Events.clear();
+		{
+			std::scoped_lock<std::mutex> lock(s_RingsMutex);
+			for (auto& ring : s_Rings)
+				Drain(*ring, s_LastFrame.Events);
+		}
+
+		std::sort(s_LastFrame.Events.begin(), s_LastFrame.Events.end(), [](const ProfileEvent& a, const ProfileEvent& b)
+		{
+			if (a.ThreadID != b.ThreadID)
+				return a.ThreadID < b.ThreadID;
+			if (a.Start != b.Start)
+				return a.Start < b.Start;
+			return a.Depth < b.Depth;
+		});
+
+		if (s_Capturing && s_FrameStart > 0)
+		{
+			ProfileFrame& frame = s_CaptureFrames.emplace_back();
+			frame.Index = s_LastFrame.Index;
+			frame.Start = s_LastFrame.Start;
+			frame.End = s_LastFrame.End;
+
+			const size_t room = MaxCaptureEvents - std::min(MaxCaptureEvents, s_CaptureEvents.size());
+			const size_t count = std::min(room, s_LastFrame.Events.size());
+			s_CaptureEvents.insert(s_CaptureEvents.end(), s_LastFrame.Events.begin(), s_LastFrame.Events.begin() + count);
+		}
+
+		s_FrameStart = now;
+	}
+
+	std::vector<ProfileThreadInfo> Profiler::GetThreads()
+	{
+		std::scoped_lock<std::mutex> lock(s_RingsMutex);
+
+		std::vector<ProfileThreadInfo> threads;
+		threads.reserve(s_Rings.size());
+		for (auto& ring : s_Rings)
+			threads.push_back({ ring->ID, ring->Name, ring->Dropped.load(std::memory_order_relaxed) });
+		return threads;
+	}
+
+	void Profiler::BeginCapture()
+	{
+		s_CaptureEvents.clear();
+		s_CaptureFrames.clear();
+		s_Capturing = true;
+	}
+
+	static void WriteEscaped(std::ofstream& stream, const char* text)
+	{
+		for (const char* c = text; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				stream << '\\';
+			if ((unsigned char)*c >= 0x20)
+				stream << *c;
+		}
+	}
+
+	bool Profiler::EndCapture(const std::filesystem::path& path)
+	{
+		s_Capturing = false;
+
+		if (path.has_parent_path())
+		{
+			std::error_code error;
+			std::filesystem::create_directories(path.parent_path(), error);
+		}
+
+		std::ofstream stream(path);
+		if (!stream)
+			return false;
+
+		// Timestamps are microseconds; frames get their own lane (tid 0) above the threads
+		stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Frames\"}}";
+		for (const ProfileThreadInfo& thread : GetThreads())
+		{
+			stream << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.ID << ",\"args\":{\"name\":\"";
+			WriteEscaped(stream, thread.Name.c_str());
+			stream << "\"}}";
+		}
+
+		for (const ProfileFrame& frame : s_CaptureFrames)
+		{
+			stream << std::format(",\n{{\"name\":\"Frame {}\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":{:.3f},\"dur\":{:.3f}}}",
+				frame.Index, frame.Start * 0.001, (frame.End - frame.Start) * 0.001);
+		}
+
+		for (const ProfileEvent& event : s_CaptureEvents)
+		{
+			stream << ",\n{\"name\":\"";
+			WriteEscaped(stream, event.Name);
+			stream << std::format("\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+				event.ThreadID, event.Start * 0.001, (event.End - event.Start) * 0.001);
+		}
+		stream << "\n]}\n";
+
+		s_CaptureEvents.clear();
+		s_CaptureFrames.clear();
+		s_CaptureEvents.shrink_to_fit();
+		return (bool)stream;
+	}
+
+}
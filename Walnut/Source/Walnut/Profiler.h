@@ -0,0 +1,128 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+//
+// Zone based CPU profiler. Zones are recorded into a lock-free ring buffer owned
+// by the recording thread and collected on the main thread at every frame marker.
+// With WL_ENABLE_PROFILING set to 0 all WL_PROFILE_ macros compile to nothing.
+//
+
+#ifndef WL_ENABLE_PROFILING
+	#define WL_ENABLE_PROFILING !WL_DIST
+#endif
+
+namespace Walnut {
+
+	struct ProfileEvent
+	{
+		const char* Name = nullptr; // must have static storage duration (literals, __FUNCTION__)
+		int64_t Start = 0;          // nanoseconds since profiler start
+		int64_t End = 0;
+		uint32_t Depth = 0;
+		uint32_t ThreadID = 0;
+	};
+
+	struct ProfileFrame
+	{
+		uint64_t Index = 0;
+		int64_t Start = 0;
+		int64_t End = 0;
+		std::vector<ProfileEvent> Events; // sorted by thread, then start time
+	};
+
+	struct ProfileThreadInfo
+	{
+		uint32_t ID = 0;
+		std::string Name;
+		uint64_t DroppedEvents = 0;
+	};
+
+	class Profiler
+	{
+	public:
+		static constexpr uint32_t RingCapacity = 1 << 14; // events per thread between two frame markers
+		static constexpr size_t MaxCaptureEvents = 4 * 1024 * 1024;
+
+		static int64_t Now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_Epoch).count();
+		}
+
+		// Called by the zone destructor; never blocks or allocates after the first event of a thread
+		static void Record(const char* name, int64_t start, int64_t end, uint32_t depth);
+
+		static uint32_t& ThreadDepth()
+		{
+			thread_local uint32_t depth = 0;
+			return depth;
+		}
+
+		static void SetThreadName(const char* name);
+
+		// Ends the current frame: drains every thread's ring into the last frame
+		// (and the running capture). Call from the main thread only.
+		static void MarkFrame();
+
+		static const ProfileFrame& GetLastFrame() { return s_LastFrame; }
+		static std::vector<ProfileThreadInfo> GetThreads();
+
+		static void BeginCapture();
+		// Stops the capture and writes it as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev)
+		static bool EndCapture(const std::filesystem::path& path);
+		static bool IsCapturing() { return s_Capturing; }
+		static size_t GetCaptureEventCount() { return s_CaptureEvents.size(); }
+	private:
+		inline static const std::chrono::steady_clock::time_point s_Epoch = std::chrono::steady_clock::now();
+
+		inline static ProfileFrame s_LastFrame;
+		inline static uint64_t s_FrameIndex = 0;
+		inline static int64_t s_FrameStart = 0;
+
+		inline static bool s_Capturing = false;
+		inline static std::vector<ProfileEvent> s_CaptureEvents;
+		inline static std::vector<ProfileFrame> s_CaptureFrames; // frame ranges only, events live in s_CaptureEvents
+	};
+
+	class ProfileZone
+	{
+	public:
+		ProfileZone(const char* name)
+			: m_Name(name), m_Start(Profiler::Now())
+		{
+			m_Depth = Profiler::ThreadDepth()++;
+		}
+
+		~ProfileZone()
+		{
+			Profiler::ThreadDepth()--;
+			Profiler::Record(m_Name, m_Start, Profiler::Now(), m_Depth);
+		}
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+	private:
+		const char* m_Name;
+		int64_t m_Start;
+		uint32_t m_Depth;
+	};
+
+}
+
+#if WL_ENABLE_PROFILING
+	#define WL_PROFILE_CONCAT_INTERNAL(a, b) a##b
+	#define WL_PROFILE_CONCAT(a, b) WL_PROFILE_CONCAT_INTERNAL(a, b)
+	#define WL_PROFILE_SCOPE(name) ::Walnut::ProfileZone WL_PROFILE_CONCAT(wlProfileZone, __LINE__)(name)
+	#define WL_PROFILE_FUNC() WL_PROFILE_SCOPE(__FUNCTION__)
+	#define WL_PROFILE_FRAME() ::Walnut::Profiler::MarkFrame()
+	#define WL_PROFILE_THREAD(name) ::Walnut::Profiler::SetThreadName(name)
+#else
+	#define WL_PROFILE_SCOPE(name)
+	#define WL_PROFILE_FUNC()
+	#define WL_PROFILE_FRAME()
+	#define WL_PROFILE_THREAD(name)
+#endif
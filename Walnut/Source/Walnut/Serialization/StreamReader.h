@@ -6,6 +6,7 @@
 #include <string>
 #include <map>
 #include <unordered_map>
+#include <vector>
 
 
 namespace Walnut
@@ -116,8 +117,8 @@ namespace Walnut
 			}
 		}
 
-		template<>
-		void ReadArray(std::vector<std::string>& array, uint32_t size)
+		// Overload rather than an in-class specialization, which only MSVC accepts
+		void ReadArray(std::vector<std::string>& array, uint32_t size = 0)
 		{
 			if (size == 0)
 				ReadRaw<uint32_t>(size);
@@ -6,6 +6,7 @@
 #include <string>
 #include <map>
 #include <unordered_map>
+#include <vector>
 
 namespace Walnut
 {
@@ -111,8 +112,8 @@ namespace Walnut
 			}
 		}
 
-		template<>
-		void WriteArray(const std::vector<std::string>& array, bool writeSize)
+		// Overload rather than an in-class specialization, which only MSVC accepts
+		void WriteArray(const std::vector<std::string>& array, bool writeSize = true)
 		{
 			if (writeSize)
 				WriteRaw<uint32_t>((uint32_t)array.size());
@@ -2,7 +2,7 @@
 Build-Shaders.ps1
 
 Inlines `common.glsl` into each shader that uses `#include "common.glsl"`,
-compiles vertex/fragment GLSL to SPIR-V using `glslangValidator`, and copies
+compiles vertex/fragment/compute GLSL to SPIR-V using `glslangValidator`, and copies
 the generated .spv files into the runtime `bin\<Config>-windows-x86_64\Caustic\shaders` folder.
 
 Usage:
@@ -53,9 +53,9 @@ if (-not (Test-Path $common)) {
     exit 4
 }
 
-$shaders = @(Get-ChildItem -Path $shaderDir -File | Where-Object { $_.Extension -in @('.vert', '.frag') })
+$shaders = @(Get-ChildItem -Path $shaderDir -File | Where-Object { $_.Extension -in @('.vert', '.frag', '.comp') })
 if ($shaders.Count -eq 0) {
-    Write-Warning "No .vert or .frag files found in $shaderDir"
+    Write-Warning "No .vert, .frag or .comp files found in $shaderDir"
 }
 
 foreach ($s in $shaders) {
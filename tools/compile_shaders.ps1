@@ -36,7 +36,7 @@ Write-Host "Using shader compiler: $compiler"
 # Include path for #include "common.glsl"
 $includeArg = "-I" + " `"$shaderDir`""
 
-$shaders = Get-ChildItem -Path $shaderDir -Include *.vert,*.frag -File -Recurse
+$shaders = Get-ChildItem -Path $shaderDir -Include *.vert,*.frag,*.comp -File -Recurse
 if ($shaders.Count -eq0) {
  Write-Host "No shader files found in $shaderDir"
  exit0